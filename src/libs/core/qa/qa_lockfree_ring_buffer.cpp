@@ -0,0 +1,179 @@
+
+/***************************************************************************
+ *  qa_lockfree_ring_buffer.cpp - QA for the lock-free ring buffer
+ *
+ *  Created: Fri Oct 16 21:14:37 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+// Do not mention in API doc
+/// @cond QA
+
+#include <core/utils/lockfree_ring_buffer.h>
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace fawkes;
+
+static unsigned int failures = 0;
+
+#define CHECK(cond)                                                      \
+	do {                                                                   \
+		if (!(cond)) {                                                       \
+			printf("FAILED: %s (%s:%i)\n", #cond, __FILE__, __LINE__);         \
+			++failures;                                                        \
+		}                                                                    \
+	} while (0)
+
+static void
+test_capacity()
+{
+	LockFreeRingBuffer<int> b1(1);
+	LockFreeRingBuffer<int> b5(5);
+	LockFreeRingBuffer<int> b8(8);
+	CHECK(b1.capacity() >= 1);
+	CHECK(b5.capacity() == 8);
+	CHECK(b8.capacity() == 8);
+}
+
+static void
+test_wraparound()
+{
+	LockFreeRingBuffer<unsigned int> b(4);
+	unsigned int                     next_push = 0, next_pop = 0, v;
+
+	// keep the fill level varying so that head and tail cross the end of
+	// the slot array at different offsets, for many laps
+	for (unsigned int lap = 0; lap < 1000; ++lap) {
+		unsigned int n = lap % 4 + 1;
+		for (unsigned int i = 0; i < n; ++i) {
+			CHECK(b.push(next_push++));
+		}
+		CHECK(b.size() == n);
+		for (unsigned int i = 0; i < n; ++i) {
+			CHECK(b.pop(v));
+			CHECK(v == next_pop);
+			++next_pop;
+		}
+		CHECK(!b.pop(v));
+		CHECK(b.size() == 0);
+	}
+}
+
+static void
+test_full()
+{
+	LockFreeRingBuffer<unsigned int> b(4);
+	unsigned int                     dropped = 0, v;
+
+	for (unsigned int i = 0; i < 10; ++i) {
+		if (!b.push(std::move(i)))
+			++dropped;
+	}
+	CHECK(dropped == 6);
+	CHECK(b.size() == 4);
+
+	// the oldest elements are kept, a dropped push leaves no trace
+	for (unsigned int i = 0; i < 4; ++i) {
+		CHECK(b.pop(v));
+		CHECK(v == i);
+	}
+	CHECK(!b.pop(v));
+
+	// after draining, the buffer accepts elements again
+	CHECK(b.push(42));
+	CHECK(b.pop(v));
+	CHECK(v == 42);
+}
+
+static void
+test_concurrent_producers()
+{
+	const unsigned int NUM_PRODUCERS = 8;
+	const unsigned int NUM_VALUES    = 100000;
+
+	LockFreeRingBuffer<unsigned long> b(256);
+	std::atomic<unsigned int>         pushed(0), dropped(0);
+	std::atomic<unsigned int>         running(NUM_PRODUCERS);
+	std::vector<std::thread>          producers;
+
+	for (unsigned int p = 0; p < NUM_PRODUCERS; ++p) {
+		producers.emplace_back([&, p] {
+			for (unsigned long i = 0; i < NUM_VALUES; ++i) {
+				if (b.push(((unsigned long)p << 32) | i)) {
+					pushed.fetch_add(1, std::memory_order_relaxed);
+				} else {
+					// give the consumer a chance, so that both pushes and drops occur
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					std::this_thread::yield();
+				}
+			}
+			running.fetch_sub(1);
+		});
+	}
+
+	// single consumer, checks that every producer's values arrive in order
+	// and that no value is seen twice
+	std::vector<long> last(NUM_PRODUCERS, -1);
+	unsigned int      popped = 0;
+	unsigned long     v;
+	while (running.load() > 0 || b.size() > 0) {
+		if (!b.pop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		unsigned int p = v >> 32;
+		long         i = v & 0xFFFFFFFF;
+		CHECK(p < NUM_PRODUCERS);
+		if (p < NUM_PRODUCERS) {
+			CHECK(i > last[p]);
+			last[p] = i;
+		}
+		++popped;
+	}
+	for (std::thread &t : producers) {
+		t.join();
+	}
+	while (b.pop(v))
+		++popped;
+
+	CHECK(pushed + dropped == NUM_PRODUCERS * NUM_VALUES);
+	CHECK(popped == pushed);
+	printf("Concurrent producers: %u pushed, %u dropped, %u popped\n",
+	       pushed.load(),
+	       dropped.load(),
+	       popped);
+}
+
+int
+main(int argc, char **argv)
+{
+	test_capacity();
+	test_wraparound();
+	test_full();
+	test_concurrent_producers();
+
+	if (failures > 0) {
+		printf("%u checks FAILED\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
+
+/// @endcond
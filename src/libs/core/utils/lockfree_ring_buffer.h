@@ -0,0 +1,185 @@
+/***************************************************************************
+ *  lockfree_ring_buffer.h - Bounded lock-free multi-producer ring buffer
+ *
+ *  Created: Fri Oct 16 11:02:14 2026
+ *
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#ifndef __CORE_UTILS_LOCKFREE_RING_BUFFER_H_
+#define __CORE_UTILS_LOCKFREE_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace fawkes {
+
+/** @class LockFreeRingBuffer <core/utils/lockfree_ring_buffer.h>
+ * Bounded lock-free ring buffer.
+ * The buffer has a fixed capacity, which is rounded up to the next power
+ * of two. Any number of threads may push and pop concurrently. Every slot
+ * carries a sequence number which tells producers and consumers whether
+ * the slot is free or filled for the current lap, so neither side ever
+ * blocks. A push on a full buffer fails immediately, it is up to the
+ * caller to account for the dropped element.
+ *
+ * The element type must be default constructible and move assignable.
+ * A popped slot is reset to a default constructed element, so that
+ * resources held by it are released early.
+ * @ingroup FCL
+ */
+template <typename Type>
+class LockFreeRingBuffer
+{
+public:
+	/** Constructor.
+   * @param capacity minimum number of elements the buffer can hold
+   */
+	explicit LockFreeRingBuffer(size_t capacity);
+
+	/** Destructor. */
+	~LockFreeRingBuffer();
+
+	/** Push element to the buffer.
+   * @param x element to add, moved into the buffer on success
+   * @return true if the element was added, false if the buffer is full
+   */
+	bool push(Type &&x);
+
+	/** Pop element from the buffer.
+   * @param x upon success the element is moved here
+   * @return true if an element was retrieved, false if the buffer is empty
+   */
+	bool pop(Type &x);
+
+	/** Get approximate number of elements in the buffer.
+   * The value is only a snapshot and may be outdated when returned.
+   * @return number of elements in the buffer
+   */
+	size_t size() const;
+
+	/** Get capacity.
+   * @return maximum number of elements the buffer can hold
+   */
+	size_t
+	capacity() const
+	{
+		return mask_ + 1;
+	}
+
+private:
+	LockFreeRingBuffer(const LockFreeRingBuffer &) = delete;
+	LockFreeRingBuffer &operator=(const LockFreeRingBuffer &) = delete;
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Type                data;
+	};
+
+	Cell  *buffer_;
+	size_t mask_;
+
+	// separate cache lines, producers and consumer contend on different ends
+	alignas(64) std::atomic<size_t> enqueue_pos_;
+	alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+template <typename Type>
+LockFreeRingBuffer<Type>::LockFreeRingBuffer(size_t capacity)
+{
+	size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+
+	buffer_ = new Cell[size];
+	mask_   = size - 1;
+	for (size_t i = 0; i < size; ++i) {
+		buffer_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	enqueue_pos_.store(0, std::memory_order_relaxed);
+	dequeue_pos_.store(0, std::memory_order_relaxed);
+}
+
+template <typename Type>
+LockFreeRingBuffer<Type>::~LockFreeRingBuffer()
+{
+	delete[] buffer_;
+}
+
+template <typename Type>
+bool
+LockFreeRingBuffer<Type>::push(Type &&x)
+{
+	Cell  *cell;
+	size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+	for (;;) {
+		cell          = &buffer_[pos & mask_];
+		size_t   seq  = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = enqueue_pos_.load(std::memory_order_relaxed);
+		}
+	}
+	cell->data = std::move(x);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename Type>
+bool
+LockFreeRingBuffer<Type>::pop(Type &x)
+{
+	Cell  *cell;
+	size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+	for (;;) {
+		cell          = &buffer_[pos & mask_];
+		size_t   seq  = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+		if (diff == 0) {
+			if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = dequeue_pos_.load(std::memory_order_relaxed);
+		}
+	}
+	x          = std::move(cell->data);
+	cell->data = Type();
+	cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename Type>
+size_t
+LockFreeRingBuffer<Type>::size() const
+{
+	size_t enq = enqueue_pos_.load(std::memory_order_relaxed);
+	size_t deq = dequeue_pos_.load(std::memory_order_relaxed);
+	return (enq > deq) ? (enq - deq) : 0;
+}
+
+} // end namespace fawkes
+
+#endif
@@ -0,0 +1,619 @@
+
+/***************************************************************************
+ *  binary.cpp - Binary structured logger
+ *
+ *  Created: Fri Oct 16 17:05:21 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#include <core/exception.h>
+#include <logging/binary.h>
+#include <sys/time.h>
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+namespace llsfrb {
+
+/** @class BinaryLogger <logging/binary.h>
+ * Logger writing structured binary records.
+ * Messages are not formatted. Instead, each record stores the log level,
+ * the time stamp, the component and format string IDs, and the raw printf
+ * arguments. Format strings and component names are written once, the
+ * first time they are used, as definition entries preceding the first
+ * record that refers to them. Logging thus mostly amounts to copying the
+ * arguments into the stdio buffer. Use the rcll-log-decode tool or
+ * BinaryLogReader to convert the file to text or JSON.
+ *
+ * File layout, all numbers in host byte order:
+ * - header: 8 bytes magic "RCLLBLOG", uint32 version
+ * - format definition: 'F', uint32 id, uint32 length, format string
+ * - component definition: 'C', uint32 id, uint32 length, component name
+ * - record: 'R', uint8 level, int64 seconds, int32 microseconds,
+ *   uint32 component ID, uint32 format ID, uint32 payload length, payload
+ *
+ * The level of records of exception messages is or'ed with
+ * LEVEL_EXCEPTION, their format is "%s" with the message as argument.
+ *
+ * The payload contains the arguments in order. Integers and pointers are
+ * stored as 8 byte integers, floating point values as double, and strings
+ * as uint32 length followed by the characters. Formats with conversions
+ * that cannot be stored, e.g. positional arguments, are formatted at the
+ * call site and stored as argument to the format "%s". The same applies
+ * once the maximum number of format strings has been defined, which
+ * bounds the memory used if formats are built at run time.
+ *
+ * Records of level warn and above flush the file buffer.
+ */
+
+/** Magic bytes at the start of a binary log file. */
+const char BinaryLogger::MAGIC[8] = {'R', 'C', 'L', 'L', 'B', 'L', 'O', 'G'};
+/** Version of the binary log format. */
+const uint32_t BinaryLogger::VERSION = 2;
+/** Flag in the level of records of exception messages. */
+const uint8_t BinaryLogger::LEVEL_EXCEPTION = 0x80;
+
+/// Maximum number of format strings defined in a file.
+static const size_t MAX_FORMATS = 4096;
+/// Maximum number of cached format and component string addresses.
+static const size_t MAX_CACHED_PTRS = 8192;
+
+/** Find the next conversion in a format string.
+ * @param format printf format string
+ * @param pos offset to start searching at
+ * @param c upon return the found conversion
+ * @return true if a conversion was found, false if there is none
+ */
+bool
+BinaryLogger::next_conversion(const char *format, size_t pos, Conversion &c)
+{
+	const char *p = strchr(format + pos, '%');
+	if (!p)
+		return false;
+
+	c.start = p - format;
+	c.stars = 0;
+	c.type  = ARG_INVALID;
+	++p;
+
+	if (*p == '%') {
+		c.type = ARG_NONE;
+		c.end  = p + 1 - format;
+		return true;
+	}
+
+	while (*p && strchr("-+ #0'I", *p))
+		++p;
+	if (*p == '*') {
+		++c.stars;
+		++p;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			++p;
+	}
+	if (*p == '$') {
+		// positional arguments are not supported
+		c.end = p + 1 - format;
+		return true;
+	}
+	if (*p == '.') {
+		++p;
+		if (*p == '*') {
+			++c.stars;
+			++p;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				++p;
+		}
+	}
+
+	ArgType int_type = ARG_INT;
+	bool    ldouble  = false;
+	if (*p == 'h') {
+		++p;
+		if (*p == 'h')
+			++p;
+	} else if (*p == 'l') {
+		++p;
+		int_type = ARG_LONG;
+		if (*p == 'l') {
+			++p;
+			int_type = ARG_LLONG;
+		}
+	} else if (*p == 'q') {
+		++p;
+		int_type = ARG_LLONG;
+	} else if (*p == 'L') {
+		++p;
+		ldouble = true;
+	} else if (*p == 'j') {
+		++p;
+		int_type = ARG_INTMAX;
+	} else if (*p == 'z' || *p == 'Z') {
+		++p;
+		int_type = ARG_SIZE;
+	} else if (*p == 't') {
+		++p;
+		int_type = ARG_PTRDIFF;
+	}
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X': c.type = int_type; break;
+	case 'c': c.type = ARG_INT; break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A': c.type = ldouble ? ARG_LDOUBLE : ARG_DOUBLE; break;
+	case 's': c.type = (int_type == ARG_INT) ? ARG_STRING : ARG_INVALID; break;
+	case 'p': c.type = ARG_POINTER; break;
+	case 'n': c.type = ARG_COUNT; break;
+	default: c.type = ARG_INVALID; break;
+	}
+
+	c.end = (*p ? p + 1 : p) - format;
+	return true;
+}
+
+/** Constructor.
+ * @param filename_pattern the name of the log file, $time will be replaced by a timestamp
+ * @param log_level minimum log level
+ */
+BinaryLogger::BinaryLogger(const char *filename_pattern, LogLevel log_level) : Logger(log_level)
+{
+	std::string filename(filename_pattern);
+	size_t      pos = filename.find("$time");
+	if (pos != std::string::npos) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		struct tm now_s;
+		localtime_r(&now.tv_sec, &now_s);
+		char start_time[32];
+		strftime(start_time, sizeof(start_time), "%Y-%m-%d_%H-%M-%S", &now_s);
+		filename.replace(pos, strlen("$time"), start_time);
+	}
+
+	log_file_ = fopen(filename.c_str(), "w");
+	if (!log_file_) {
+		throw fawkes::Exception(errno, "Failed to open log file %s", filename.c_str());
+	}
+	setvbuf(log_file_, NULL, _IOFBF, 65536);
+
+	fwrite(MAGIC, 1, sizeof(MAGIC), log_file_);
+	fwrite(&VERSION, sizeof(VERSION), 1, log_file_);
+	intern_format("%s", plain_format_id_);
+	fflush(log_file_);
+}
+
+/** Destructor. */
+BinaryLogger::~BinaryLogger()
+{
+	fclose(log_file_);
+}
+
+template <typename T>
+static inline void
+append(std::string &buf, T value)
+{
+	buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void
+BinaryLogger::write_definition(Tag tag, uint32_t id, const std::string &text)
+{
+	std::string entry;
+	append<uint8_t>(entry, tag);
+	append<uint32_t>(entry, id);
+	append<uint32_t>(entry, text.size());
+	entry += text;
+	fwrite(entry.data(), 1, entry.size(), log_file_);
+}
+
+const BinaryLogger::Format *
+BinaryLogger::intern_format(const char *format, uint32_t &id)
+{
+	// Most formats are string literals, look them up by address first.
+	// The address may have been reused for a different string, hence the
+	// comparison of the contents.
+	auto p = format_ptrs_.find(format);
+	if (p != format_ptrs_.end() && formats_[p->second].text == format) {
+		id = p->second;
+		return &formats_[id];
+	}
+
+	auto f = format_ids_.find(format);
+	if (f != format_ids_.end()) {
+		id = f->second;
+	} else if (formats_.size() >= MAX_FORMATS) {
+		return NULL;
+	} else {
+		Format fmt;
+		fmt.text  = format;
+		fmt.valid = true;
+		Conversion c;
+		for (size_t pos = 0; next_conversion(format, pos, c); pos = c.end) {
+			if (c.type == ARG_INVALID) {
+				fmt.valid = false;
+				break;
+			}
+			fmt.args.insert(fmt.args.end(), c.stars, ARG_INT);
+			if (c.type != ARG_NONE)
+				fmt.args.push_back(c.type);
+		}
+		id = formats_.size();
+		formats_.push_back(std::move(fmt));
+		format_ids_[format] = id;
+		write_definition(TAG_FORMAT, id, format);
+	}
+	// formats built at run time would add a new address each time
+	if (format_ptrs_.size() >= MAX_CACHED_PTRS)
+		format_ptrs_.clear();
+	format_ptrs_[format] = id;
+	return &formats_[id];
+}
+
+uint32_t
+BinaryLogger::intern_component(const char *component)
+{
+	auto p = component_ptrs_.find(component);
+	if (p != component_ptrs_.end() && components_[p->second] == component) {
+		return p->second;
+	}
+
+	uint32_t id;
+	auto     c = component_ids_.find(component);
+	if (c != component_ids_.end()) {
+		id = c->second;
+	} else {
+		id = components_.size();
+		components_.push_back(component);
+		component_ids_[component] = id;
+		write_definition(TAG_COMPONENT, id, component);
+	}
+	if (component_ptrs_.size() >= MAX_CACHED_PTRS)
+		component_ptrs_.clear();
+	component_ptrs_[component] = id;
+	return id;
+}
+
+void
+BinaryLogger::write_record(LogLevel              level,
+                           bool                  exception,
+                           const struct timeval *t,
+                           uint32_t              component_id,
+                           uint32_t              format_id)
+{
+	char     header[1 + 1 + 8 + 4 + 4 + 4 + 4];
+	char    *h    = header;
+	uint8_t  tag  = TAG_RECORD;
+	uint8_t  lvl  = exception ? (level | LEVEL_EXCEPTION) : level;
+	int64_t  sec  = t->tv_sec;
+	int32_t  usec = t->tv_usec;
+	uint32_t len  = payload_.size();
+	memcpy(h, &tag, 1);
+	memcpy(h += 1, &lvl, 1);
+	memcpy(h += 1, &sec, 8);
+	memcpy(h += 8, &usec, 4);
+	memcpy(h += 4, &component_id, 4);
+	memcpy(h += 4, &format_id, 4);
+	memcpy(h += 4, &len, 4);
+	fwrite(header, 1, sizeof(header), log_file_);
+	fwrite(payload_.data(), 1, payload_.size(), log_file_);
+
+	if (level >= LL_WARN)
+		fflush(log_file_);
+}
+
+void
+BinaryLogger::write(LogLevel              level,
+                    const struct timeval *t,
+                    const char           *component,
+                    const char           *format,
+                    va_list               va)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	uint32_t      format_id;
+	const Format *fmt          = intern_format(format, format_id);
+	uint32_t      component_id = intern_component(component);
+
+	payload_.clear();
+	if (!fmt || !fmt->valid) {
+		char *msg;
+		if (vasprintf(&msg, format, va) == -1)
+			return;
+		append<uint32_t>(payload_, strlen(msg));
+		payload_ += msg;
+		free(msg);
+		write_record(level, /* exception */ false, t, component_id, plain_format_id_);
+		return;
+	}
+
+	for (ArgType a : fmt->args) {
+		switch (a) {
+		case ARG_INT: append<int64_t>(payload_, va_arg(va, int)); break;
+		case ARG_LONG: append<int64_t>(payload_, va_arg(va, long)); break;
+		case ARG_LLONG: append<int64_t>(payload_, va_arg(va, long long)); break;
+		case ARG_SIZE: append<int64_t>(payload_, va_arg(va, size_t)); break;
+		case ARG_INTMAX: append<int64_t>(payload_, va_arg(va, intmax_t)); break;
+		case ARG_PTRDIFF: append<int64_t>(payload_, va_arg(va, ptrdiff_t)); break;
+		case ARG_DOUBLE: append<double>(payload_, va_arg(va, double)); break;
+		case ARG_LDOUBLE: append<double>(payload_, va_arg(va, long double)); break;
+		case ARG_POINTER: append<uint64_t>(payload_, (uintptr_t)va_arg(va, void *)); break;
+		case ARG_COUNT: va_arg(va, void *); break;
+		case ARG_STRING: {
+			const char *s = va_arg(va, const char *);
+			if (!s)
+				s = "(null)";
+			uint32_t len = strlen(s);
+			append<uint32_t>(payload_, len);
+			payload_.append(s, len);
+			break;
+		}
+		default: break;
+		}
+	}
+	write_record(level, /* exception */ false, t, component_id, format_id);
+}
+
+void
+BinaryLogger::write(LogLevel              level,
+                    const struct timeval *t,
+                    const char           *component,
+                    fawkes::Exception    &e)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	uint32_t component_id = intern_component(component);
+
+	for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
+		uint32_t len = strlen(*i);
+		payload_.clear();
+		append<uint32_t>(payload_, len);
+		payload_.append(*i, len);
+		write_record(level, /* exception */ true, t, component_id, plain_format_id_);
+	}
+}
+
+void
+BinaryLogger::log_debug(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_debug(component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::log_info(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_info(component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::log_warn(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_warn(component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::log_error(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_error(component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::log_debug(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_DEBUG) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_DEBUG, &now, component, e);
+	}
+}
+
+void
+BinaryLogger::log_info(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_INFO) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_INFO, &now, component, e);
+	}
+}
+
+void
+BinaryLogger::log_warn(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_WARN) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_WARN, &now, component, e);
+	}
+}
+
+void
+BinaryLogger::log_error(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_ERROR) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_ERROR, &now, component, e);
+	}
+}
+
+void
+BinaryLogger::vlog_debug(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_DEBUG) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_DEBUG, &now, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vlog_info(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_INFO) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_INFO, &now, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vlog_warn(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_WARN) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_WARN, &now, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vlog_error(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_ERROR) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		write(LL_ERROR, &now, component, format, va);
+	}
+}
+
+void
+BinaryLogger::tlog_debug(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_debug(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::tlog_info(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_info(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::tlog_warn(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_warn(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::tlog_error(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_error(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+BinaryLogger::tlog_debug(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_DEBUG) {
+		write(LL_DEBUG, t, component, e);
+	}
+}
+
+void
+BinaryLogger::tlog_info(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_INFO) {
+		write(LL_INFO, t, component, e);
+	}
+}
+
+void
+BinaryLogger::tlog_warn(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_WARN) {
+		write(LL_WARN, t, component, e);
+	}
+}
+
+void
+BinaryLogger::tlog_error(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_ERROR) {
+		write(LL_ERROR, t, component, e);
+	}
+}
+
+void
+BinaryLogger::vtlog_debug(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_DEBUG) {
+		write(LL_DEBUG, t, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vtlog_info(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_INFO) {
+		write(LL_INFO, t, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vtlog_warn(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_WARN) {
+		write(LL_WARN, t, component, format, va);
+	}
+}
+
+void
+BinaryLogger::vtlog_error(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_ERROR) {
+		write(LL_ERROR, t, component, format, va);
+	}
+}
+
+} // end namespace llsfrb
@@ -0,0 +1,157 @@
+
+/***************************************************************************
+ *  binary.h - Binary structured logger
+ *
+ *  Created: Fri Oct 16 17:05:21 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#ifndef __UTILS_LOGGING_BINARY_H_
+#define __UTILS_LOGGING_BINARY_H_
+
+#include <logging/logger.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llsfrb {
+
+class BinaryLogger : public Logger
+{
+public:
+	/** Type of a stored printf argument. */
+	typedef enum {
+		ARG_NONE,    /**< conversion without argument, e.g. %% */
+		ARG_INT,     /**< int, or smaller integer promoted to int */
+		ARG_LONG,    /**< long */
+		ARG_LLONG,   /**< long long */
+		ARG_SIZE,    /**< size_t */
+		ARG_INTMAX,  /**< intmax_t */
+		ARG_PTRDIFF, /**< ptrdiff_t */
+		ARG_DOUBLE,  /**< double */
+		ARG_LDOUBLE, /**< long double, stored as double */
+		ARG_STRING,  /**< C string */
+		ARG_POINTER, /**< pointer printed with %p */
+		ARG_COUNT,   /**< %n, argument is consumed but not stored */
+		ARG_INVALID  /**< unsupported conversion */
+	} ArgType;
+
+	/** A single conversion in a format string. */
+	struct Conversion
+	{
+		/** Offset of the '%' in the format string. */
+		size_t start;
+		/** Offset just past the conversion character. */
+		size_t end;
+		/** Number of '*' width and precision arguments before the value. */
+		unsigned int stars;
+		/** Type of the value argument. */
+		ArgType type;
+	};
+
+	/** Tags of entries in a binary log file. */
+	typedef enum {
+		TAG_FORMAT    = 'F', /**< format string definition */
+		TAG_COMPONENT = 'C', /**< component name definition */
+		TAG_RECORD    = 'R'  /**< log record */
+	} Tag;
+
+	static const char     MAGIC[8];
+	static const uint32_t VERSION;
+	static const uint8_t  LEVEL_EXCEPTION;
+
+	static bool next_conversion(const char *format, size_t pos, Conversion &c);
+
+	BinaryLogger(const char *filename, LogLevel min_level = LL_DEBUG);
+	virtual ~BinaryLogger();
+
+	virtual void log_debug(const char *component, const char *format, ...);
+	virtual void log_info(const char *component, const char *format, ...);
+	virtual void log_warn(const char *component, const char *format, ...);
+	virtual void log_error(const char *component, const char *format, ...);
+
+	virtual void vlog_debug(const char *component, const char *format, va_list va);
+	virtual void vlog_info(const char *component, const char *format, va_list va);
+	virtual void vlog_warn(const char *component, const char *format, va_list va);
+	virtual void vlog_error(const char *component, const char *format, va_list va);
+
+	virtual void log_debug(const char *component, fawkes::Exception &e);
+	virtual void log_info(const char *component, fawkes::Exception &e);
+	virtual void log_warn(const char *component, fawkes::Exception &e);
+	virtual void log_error(const char *component, fawkes::Exception &e);
+
+	virtual void tlog_debug(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_info(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_warn(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_error(struct timeval *t, const char *component, const char *format, ...);
+
+	virtual void tlog_debug(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_info(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_warn(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_error(struct timeval *t, const char *component, fawkes::Exception &e);
+
+	virtual void
+	vtlog_debug(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void vtlog_info(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void vtlog_warn(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void
+	vtlog_error(struct timeval *t, const char *component, const char *format, va_list va);
+
+private:
+	struct Format
+	{
+		std::string          text;
+		std::vector<ArgType> args;
+		bool                 valid;
+	};
+
+	void write(LogLevel              level,
+	           const struct timeval *t,
+	           const char           *component,
+	           const char           *format,
+	           va_list               va);
+	void write(LogLevel level, const struct timeval *t, const char *component, fawkes::Exception &e);
+	void write_record(LogLevel              level,
+	                  bool                  exception,
+	                  const struct timeval *t,
+	                  uint32_t              component_id,
+	                  uint32_t              format_id);
+
+	const Format *intern_format(const char *format, uint32_t &id);
+	uint32_t      intern_component(const char *component);
+	void          write_definition(Tag tag, uint32_t id, const std::string &text);
+
+private:
+	FILE      *log_file_;
+	std::mutex mutex_;
+
+	std::vector<Format>                        formats_;
+	std::unordered_map<std::string, uint32_t>  format_ids_;
+	std::unordered_map<const char *, uint32_t> format_ptrs_;
+	std::vector<std::string>                   components_;
+	std::unordered_map<std::string, uint32_t>  component_ids_;
+	std::unordered_map<const char *, uint32_t> component_ptrs_;
+	uint32_t                                   plain_format_id_;
+	std::string                                payload_;
+};
+
+} // end namespace llsfrb
+
+#endif
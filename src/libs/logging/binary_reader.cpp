@@ -0,0 +1,260 @@
+
+/***************************************************************************
+ *  binary_reader.cpp - Reader for binary structured logs
+ *
+ *  Created: Fri Oct 16 17:48:09 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#include <core/exception.h>
+#include <logging/binary_reader.h>
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstring>
+
+namespace llsfrb {
+
+/** @class BinaryLogReader <logging/binary_reader.h>
+ * Reader for files written by BinaryLogger.
+ * Records are read sequentially. Format and component definitions are
+ * processed transparently while reading.
+ */
+
+/** Constructor.
+ * @param filename binary log file to read
+ */
+BinaryLogReader::BinaryLogReader(const char *filename) : filename_(filename)
+{
+	file_ = fopen(filename, "r");
+	if (!file_) {
+		throw fawkes::Exception(errno, "Failed to open log file %s", filename);
+	}
+
+	char magic[sizeof(BinaryLogger::MAGIC)];
+	if (fread(magic, 1, sizeof(magic), file_) != sizeof(magic)
+	    || memcmp(magic, BinaryLogger::MAGIC, sizeof(magic)) != 0) {
+		fclose(file_);
+		throw fawkes::Exception("%s is not a binary log file", filename);
+	}
+	uint32_t version;
+	if (fread(&version, sizeof(version), 1, file_) != 1 || version != BinaryLogger::VERSION) {
+		fclose(file_);
+		throw fawkes::Exception("%s has unsupported binary log version", filename);
+	}
+}
+
+/** Destructor. */
+BinaryLogReader::~BinaryLogReader()
+{
+	fclose(file_);
+}
+
+void
+BinaryLogReader::read_bytes(void *buf, size_t size)
+{
+	if (size > 0 && fread(buf, 1, size, file_) != size) {
+		throw fawkes::Exception("Unexpected end of binary log file %s", filename_.c_str());
+	}
+}
+
+template <typename T>
+T
+BinaryLogReader::read_value()
+{
+	T value;
+	read_bytes(&value, sizeof(value));
+	return value;
+}
+
+std::string
+BinaryLogReader::read_string()
+{
+	uint32_t    len = read_value<uint32_t>();
+	std::string s(len, '\0');
+	read_bytes(&s[0], len);
+	return s;
+}
+
+template <typename T>
+static T
+take(const std::string &payload, size_t &pos)
+{
+	T value;
+	if (pos + sizeof(value) > payload.size()) {
+		throw fawkes::Exception("Record payload too short");
+	}
+	memcpy(&value, payload.data() + pos, sizeof(value));
+	pos += sizeof(value);
+	return value;
+}
+
+/** Read next record.
+ * @param record upon success the record read from the file
+ * @return true if a record was read, false if the end of the file has been reached
+ * @exception Exception thrown if the file is truncated or corrupt
+ */
+bool
+BinaryLogReader::read(Record &record)
+{
+	int tag;
+	while ((tag = fgetc(file_)) != EOF) {
+		if (tag == BinaryLogger::TAG_COMPONENT || tag == BinaryLogger::TAG_FORMAT) {
+			uint32_t    id   = read_value<uint32_t>();
+			std::string text = read_string();
+			if (tag == BinaryLogger::TAG_COMPONENT) {
+				if (components_.size() <= id)
+					components_.resize(id + 1);
+				components_[id] = text;
+			} else {
+				if (formats_.size() <= id) {
+					formats_.resize(id + 1);
+					format_args_.resize(id + 1);
+				}
+				format_args_[id].clear();
+				BinaryLogger::Conversion c;
+				for (size_t pos = 0; BinaryLogger::next_conversion(text.c_str(), pos, c); pos = c.end) {
+					format_args_[id].insert(format_args_[id].end(), c.stars, BinaryLogger::ARG_INT);
+					if (c.type != BinaryLogger::ARG_NONE && c.type != BinaryLogger::ARG_COUNT)
+						format_args_[id].push_back(c.type);
+				}
+				formats_[id] = std::move(text);
+			}
+
+		} else if (tag == BinaryLogger::TAG_RECORD) {
+			uint8_t level       = read_value<uint8_t>();
+			record.level        = (Logger::LogLevel)(level & ~BinaryLogger::LEVEL_EXCEPTION);
+			record.exception    = (level & BinaryLogger::LEVEL_EXCEPTION) != 0;
+			record.time.tv_sec  = read_value<int64_t>();
+			record.time.tv_usec = read_value<int32_t>();
+
+			uint32_t    component = read_value<uint32_t>();
+			uint32_t    format    = read_value<uint32_t>();
+			std::string payload   = read_string();
+
+			if (component >= components_.size() || format >= formats_.size()) {
+				throw fawkes::Exception("Undefined component or format in %s", filename_.c_str());
+			}
+			record.component = components_[component];
+			record.format    = formats_[format];
+			record.args.clear();
+
+			size_t pos = 0;
+			for (BinaryLogger::ArgType type : format_args_[format]) {
+				Argument a;
+				a.type = type;
+				a.i    = 0;
+				a.d    = 0.;
+				switch (type) {
+				case BinaryLogger::ARG_DOUBLE:
+				case BinaryLogger::ARG_LDOUBLE: a.d = take<double>(payload, pos); break;
+				case BinaryLogger::ARG_STRING: {
+					uint32_t len = take<uint32_t>(payload, pos);
+					if (pos + len > payload.size()) {
+						throw fawkes::Exception("Record payload too short");
+					}
+					a.s = payload.substr(pos, len);
+					pos += len;
+					break;
+				}
+				default: a.i = take<int64_t>(payload, pos); break;
+				}
+				record.args.push_back(std::move(a));
+			}
+			return true;
+
+		} else {
+			throw fawkes::Exception("Invalid entry in binary log file %s", filename_.c_str());
+		}
+	}
+	return false;
+}
+
+static void
+append_printf(std::string &s, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	char buf[256];
+	int  n = vsnprintf(buf, sizeof(buf), format, arg);
+	va_end(arg);
+	if (n < 0)
+		return;
+	if ((size_t)n < sizeof(buf)) {
+		s.append(buf, n);
+	} else {
+		std::string large(n + 1, '\0');
+		va_start(arg, format);
+		vsnprintf(&large[0], large.size(), format, arg);
+		va_end(arg);
+		s.append(large.data(), n);
+	}
+}
+
+/** Format the message of a record.
+ * @param record record to format
+ * @return message as it would have been printed by a text logger
+ */
+std::string
+BinaryLogReader::message(const Record &record)
+{
+	const char *format = record.format.c_str();
+	std::string rv;
+	size_t      pos = 0;
+	size_t      a   = 0;
+
+	BinaryLogger::Conversion c;
+	while (BinaryLogger::next_conversion(format, pos, c)) {
+		rv.append(format + pos, c.start - pos);
+		pos = c.end;
+
+		if (c.type == BinaryLogger::ARG_NONE) {
+			rv += '%';
+			continue;
+		}
+		if (c.type == BinaryLogger::ARG_COUNT)
+			continue;
+		if (a + c.stars >= record.args.size())
+			break;
+
+		std::string spec(format + c.start, c.end - c.start);
+		for (unsigned int i = 0; i < c.stars; ++i) {
+			spec.replace(spec.find('*'), 1, std::to_string(record.args[a++].i));
+		}
+
+		const Argument &arg = record.args[a++];
+		switch (c.type) {
+		case BinaryLogger::ARG_INT: append_printf(rv, spec.c_str(), (int)arg.i); break;
+		case BinaryLogger::ARG_LONG: append_printf(rv, spec.c_str(), (long)arg.i); break;
+		case BinaryLogger::ARG_LLONG: append_printf(rv, spec.c_str(), (long long)arg.i); break;
+		case BinaryLogger::ARG_SIZE: append_printf(rv, spec.c_str(), (size_t)arg.i); break;
+		case BinaryLogger::ARG_INTMAX: append_printf(rv, spec.c_str(), (intmax_t)arg.i); break;
+		case BinaryLogger::ARG_PTRDIFF: append_printf(rv, spec.c_str(), (ptrdiff_t)arg.i); break;
+		case BinaryLogger::ARG_DOUBLE: append_printf(rv, spec.c_str(), arg.d); break;
+		case BinaryLogger::ARG_LDOUBLE: append_printf(rv, spec.c_str(), (long double)arg.d); break;
+		case BinaryLogger::ARG_STRING: append_printf(rv, spec.c_str(), arg.s.c_str()); break;
+		case BinaryLogger::ARG_POINTER:
+			append_printf(rv, spec.c_str(), (void *)(uintptr_t)arg.i);
+			break;
+		default: break;
+		}
+	}
+	rv.append(format + pos);
+	return rv;
+}
+
+} // end namespace llsfrb
@@ -0,0 +1,94 @@
+
+/***************************************************************************
+ *  binary_reader.h - Reader for binary structured logs
+ *
+ *  Created: Fri Oct 16 17:48:09 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#ifndef __UTILS_LOGGING_BINARY_READER_H_
+#define __UTILS_LOGGING_BINARY_READER_H_
+
+#include <logging/binary.h>
+#include <sys/time.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace llsfrb {
+
+class BinaryLogReader
+{
+public:
+	/** A stored argument of a log record. */
+	struct Argument
+	{
+		/** Type of the argument. */
+		BinaryLogger::ArgType type;
+		/** Value of integer and pointer arguments. */
+		int64_t i;
+		/** Value of floating point arguments. */
+		double d;
+		/** Value of string arguments. */
+		std::string s;
+	};
+
+	/** A decoded log record. */
+	struct Record
+	{
+		/** Log level. */
+		Logger::LogLevel level;
+		/** True if the record is a message of an exception. */
+		bool exception;
+		/** Time of the record. */
+		struct timeval time;
+		/** Component name. */
+		std::string component;
+		/** Format string. */
+		std::string format;
+		/** Arguments, including '*' width and precision arguments. */
+		std::vector<Argument> args;
+	};
+
+	BinaryLogReader(const char *filename);
+	~BinaryLogReader();
+
+	bool read(Record &record);
+
+	static std::string message(const Record &record);
+
+private:
+	void read_bytes(void *buf, size_t size);
+
+	template <typename T>
+	T read_value();
+
+	std::string read_string();
+
+private:
+	FILE       *file_;
+	std::string filename_;
+
+	std::vector<std::string>                        components_;
+	std::vector<std::string>                        formats_;
+	std::vector<std::vector<BinaryLogger::ArgType>> format_args_;
+};
+
+} // end namespace llsfrb
+
+#endif
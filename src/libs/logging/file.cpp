@@ -28,6 +28,7 @@
 #include <sys/time.h>
 
 #include <cerrno>
+#include <cstdarg>
 #include <cstdlib>
 #include <fcntl.h>
 #include <string>
@@ -42,13 +43,24 @@ namespace llsfrb {
  * output will be prepended by a single character which determines the 
  * type of output (E for error, W for warning, etc.).
  *
+ * By default each message is written and flushed synchronously by the
+ * logging thread. After set_async() has been called, messages are only
+ * formatted by the caller and handed to a background thread through a
+ * lock-free ring buffer. The writer thread writes them in batches.
  */
 
 /** Constructor. 
  * @param filename_pattern the name of the log-file, $time will be replaced by a timestamp
  * @param log_level minimum log level
  */
-FileLogger::FileLogger(const char *filename_pattern, LogLevel log_level) : Logger(log_level)
+FileLogger::FileLogger(const char *filename_pattern, LogLevel log_level)
+: Logger(log_level),
+  queue_(NULL),
+  flush_interval_(200),
+  flush_level_(LL_WARN),
+  flush_requested_(false),
+  blocked_(0),
+  shutdown_(false)
 {
 	now_s = (struct tm *)malloc(sizeof(struct tm));
 	struct timeval now;
@@ -112,14 +124,216 @@ FileLogger::FileLogger(const char *filename_pattern, LogLevel log_level) : Logge
 	mutex = new fawkes::Mutex();
 }
 
-/** Destructor. */
+/** Destructor.
+ * In asynchronous mode all queued messages are written before returning.
+ */
 FileLogger::~FileLogger()
 {
+	if (queue_) {
+		{
+			std::lock_guard<std::mutex> lock(wakeup_mutex_);
+			shutdown_ = true;
+		}
+		wakeup_cond_.notify_one();
+		writer_thread_.join();
+		delete queue_;
+	}
 	free(now_s);
 	fclose(log_file);
 	delete mutex;
 }
 
+/** Switch to asynchronous mode.
+ * Messages are formatted by the caller and queued, a background thread
+ * writes them to the file. The writer flushes the queue whenever the flush
+ * interval has elapsed, and immediately when a message of at least
+ * flush_level is logged or the queue is half full. If the queue is full,
+ * the caller blocks until the writer has made room, no messages are lost.
+ * Call this right after construction, before logging from other threads.
+ * @param queue_size maximum number of messages waiting to be written
+ * @param flush_interval_ms maximum time in milliseconds a message waits in
+ * the queue before it is written
+ * @param flush_level messages of this level or higher are written
+ * immediately
+ */
+void
+FileLogger::set_async(size_t queue_size, unsigned int flush_interval_ms, LogLevel flush_level)
+{
+	if (queue_)
+		return;
+
+	flush_interval_ = std::chrono::milliseconds(flush_interval_ms);
+	flush_level_    = flush_level;
+	queue_          = new fawkes::LockFreeRingBuffer<std::string>(queue_size);
+	writer_thread_  = std::thread(&FileLogger::run, this);
+}
+
+static const char *
+level_prefix(Logger::LogLevel level)
+{
+	switch (level) {
+	case Logger::LL_DEBUG: return "D";
+	case Logger::LL_INFO: return "I";
+	case Logger::LL_WARN: return "W";
+	default: return "E";
+	}
+}
+
+void
+FileLogger::write(LogLevel              level,
+                  const struct timeval *t,
+                  const char           *component,
+                  const char           *format,
+                  va_list               va)
+{
+	if (!queue_) {
+		mutex->lock();
+		localtime_r(&t->tv_sec, now_s);
+		fprintf(log_file,
+		        "%s %02d:%02d:%02d.%06ld %s: ",
+		        level_prefix(level),
+		        now_s->tm_hour,
+		        now_s->tm_min,
+		        now_s->tm_sec,
+		        (long)t->tv_usec,
+		        component);
+		vfprintf(log_file, format, va);
+		fprintf(log_file, "\n");
+		fflush(log_file);
+		mutex->unlock();
+		return;
+	}
+
+	struct tm now;
+	localtime_r(&t->tv_sec, &now);
+	char stamp[32];
+	snprintf(stamp,
+	         sizeof(stamp),
+	         "%s %02d:%02d:%02d.%06ld ",
+	         level_prefix(level),
+	         now.tm_hour,
+	         now.tm_min,
+	         now.tm_sec,
+	         (long)t->tv_usec);
+
+	char *msg;
+	if (vasprintf(&msg, format, va) == -1)
+		return;
+
+	std::string record(stamp);
+	record.append(component).append(": ").append(msg).append("\n");
+	free(msg);
+
+	enqueue(level, std::move(record));
+}
+
+void
+FileLogger::write(LogLevel              level,
+                  const struct timeval *t,
+                  const char           *component,
+                  fawkes::Exception    &e)
+{
+	if (!queue_) {
+		mutex->lock();
+		localtime_r(&t->tv_sec, now_s);
+		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
+			fprintf(log_file,
+			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
+			        level_prefix(level),
+			        now_s->tm_hour,
+			        now_s->tm_min,
+			        now_s->tm_sec,
+			        (long)t->tv_usec,
+			        component);
+			fprintf(log_file, "%s", *i);
+			fprintf(log_file, "\n");
+		}
+		fflush(log_file);
+		mutex->unlock();
+		return;
+	}
+
+	struct tm now;
+	localtime_r(&t->tv_sec, &now);
+	char stamp[32];
+	snprintf(stamp,
+	         sizeof(stamp),
+	         "%s %02d:%02d:%02d.%06ld ",
+	         level_prefix(level),
+	         now.tm_hour,
+	         now.tm_min,
+	         now.tm_sec,
+	         (long)t->tv_usec);
+
+	std::string record;
+	for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
+		record.append(stamp).append(component).append(" [EXCEPTION]: ").append(*i).append("\n");
+	}
+
+	enqueue(level, std::move(record));
+}
+
+void
+FileLogger::enqueue(LogLevel level, std::string &&record)
+{
+	if (queue_->push(std::move(record))) {
+		// The wakeup may be missed if the writer is just about to wait. In that
+		// case the message is written when the flush interval expires.
+		if (level >= flush_level_ || queue_->size() >= queue_->capacity() / 2) {
+			flush_requested_.store(true, std::memory_order_relaxed);
+			wakeup_cond_.notify_one();
+		}
+		return;
+	}
+
+	// Queue is full, wait for the writer rather than dropping the message.
+	// The writer signals space_cond_ with wakeup_mutex_ held after each
+	// flush, so retrying the push under the lock cannot miss it.
+	blocked_.fetch_add(1, std::memory_order_relaxed);
+	std::unique_lock<std::mutex> lock(wakeup_mutex_);
+	while (!queue_->push(std::move(record))) {
+		flush_requested_.store(true, std::memory_order_relaxed);
+		wakeup_cond_.notify_one();
+		space_cond_.wait(lock);
+	}
+}
+
+void
+FileLogger::run()
+{
+	std::unique_lock<std::mutex> lock(wakeup_mutex_);
+	while (!shutdown_) {
+		wakeup_cond_.wait_for(lock, flush_interval_, [this] {
+			return shutdown_ || flush_requested_.load(std::memory_order_relaxed);
+		});
+		flush_requested_.store(false, std::memory_order_relaxed);
+		lock.unlock();
+		flush_queue();
+		lock.lock();
+		space_cond_.notify_all();
+	}
+	lock.unlock();
+	flush_queue();
+}
+
+void
+FileLogger::flush_queue()
+{
+	std::string batch;
+	std::string record;
+	while (queue_->pop(record)) {
+		batch += record;
+		if (batch.size() >= 65536) {
+			fwrite(batch.data(), 1, batch.size(), log_file);
+			batch.clear();
+		}
+	}
+	if (!batch.empty()) {
+		fwrite(batch.data(), 1, batch.size(), log_file);
+	}
+	fflush(log_file);
+}
+
 void
 FileLogger::log_debug(const char *component, const char *format, ...)
 {
@@ -162,22 +376,7 @@ FileLogger::log_debug(const char *component, fawkes::Exception &e)
 	if (log_level <= LL_DEBUG) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "D",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)now.tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_DEBUG, &now, component, e);
 	}
 }
 
@@ -187,22 +386,7 @@ FileLogger::log_info(const char *component, fawkes::Exception &e)
 	if (log_level <= LL_INFO) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "I",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)now.tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_INFO, &now, component, e);
 	}
 }
 
@@ -212,22 +396,7 @@ FileLogger::log_warn(const char *component, fawkes::Exception &e)
 	if (log_level <= LL_WARN) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "W",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)now.tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_WARN, &now, component, e);
 	}
 }
 
@@ -237,22 +406,7 @@ FileLogger::log_error(const char *component, fawkes::Exception &e)
 	if (log_level <= LL_ERROR) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "E",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)now.tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_ERROR, &now, component, e);
 	}
 }
 
@@ -262,20 +416,7 @@ FileLogger::vlog_debug(const char *component, const char *format, va_list va)
 	if (log_level <= LL_DEBUG) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "D",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)now.tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_DEBUG, &now, component, format, va);
 	}
 }
 
@@ -285,20 +426,7 @@ FileLogger::vlog_info(const char *component, const char *format, va_list va)
 	if (log_level <= LL_INFO) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "I",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)now.tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_INFO, &now, component, format, va);
 	}
 }
 
@@ -308,20 +436,7 @@ FileLogger::vlog_warn(const char *component, const char *format, va_list va)
 	if (log_level <= LL_WARN) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "W",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)now.tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_WARN, &now, component, format, va);
 	}
 }
 
@@ -331,20 +446,7 @@ FileLogger::vlog_error(const char *component, const char *format, va_list va)
 	if (log_level <= LL_ERROR) {
 		struct timeval now;
 		gettimeofday(&now, NULL);
-		mutex->lock();
-		localtime_r(&now.tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "E",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)now.tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_ERROR, &now, component, format, va);
 	}
 }
 
@@ -388,22 +490,7 @@ void
 FileLogger::tlog_debug(struct timeval *t, const char *component, fawkes::Exception &e)
 {
 	if (log_level <= LL_DEBUG) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "D",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)t->tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_DEBUG, t, component, e);
 	}
 }
 
@@ -411,22 +498,7 @@ void
 FileLogger::tlog_info(struct timeval *t, const char *component, fawkes::Exception &e)
 {
 	if (log_level <= LL_INFO) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "I",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)t->tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_INFO, t, component, e);
 	}
 }
 
@@ -434,22 +506,7 @@ void
 FileLogger::tlog_warn(struct timeval *t, const char *component, fawkes::Exception &e)
 {
 	if (log_level <= LL_WARN) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "W",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)t->tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_WARN, t, component, e);
 	}
 }
 
@@ -457,22 +514,7 @@ void
 FileLogger::tlog_error(struct timeval *t, const char *component, fawkes::Exception &e)
 {
 	if (log_level <= LL_ERROR) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
-			fprintf(log_file,
-			        "%s %02d:%02d:%02d.%06ld %s [EXCEPTION]: ",
-			        "E",
-			        now_s->tm_hour,
-			        now_s->tm_min,
-			        now_s->tm_sec,
-			        (long)t->tv_usec,
-			        component);
-			fprintf(log_file, "%s", *i);
-			fprintf(log_file, "\n");
-		}
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_ERROR, t, component, e);
 	}
 }
 
@@ -480,20 +522,7 @@ void
 FileLogger::vtlog_debug(struct timeval *t, const char *component, const char *format, va_list va)
 {
 	if (log_level <= LL_DEBUG) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "D",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)t->tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_DEBUG, t, component, format, va);
 	}
 }
 
@@ -501,20 +530,7 @@ void
 FileLogger::vtlog_info(struct timeval *t, const char *component, const char *format, va_list va)
 {
 	if (log_level <= LL_INFO) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "I",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)t->tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_INFO, t, component, format, va);
 	}
 }
 
@@ -522,20 +538,7 @@ void
 FileLogger::vtlog_warn(struct timeval *t, const char *component, const char *format, va_list va)
 {
 	if (log_level <= LL_WARN) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "W",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)t->tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_WARN, t, component, format, va);
 	}
 }
 
@@ -543,20 +546,7 @@ void
 FileLogger::vtlog_error(struct timeval *t, const char *component, const char *format, va_list va)
 {
 	if (log_level <= LL_ERROR) {
-		mutex->lock();
-		localtime_r(&t->tv_sec, now_s);
-		fprintf(log_file,
-		        "%s %02d:%02d:%02d.%06ld %s: ",
-		        "E",
-		        now_s->tm_hour,
-		        now_s->tm_min,
-		        now_s->tm_sec,
-		        (long)t->tv_usec,
-		        component);
-		vfprintf(log_file, format, va);
-		fprintf(log_file, "\n");
-		fflush(log_file);
-		mutex->unlock();
+		write(LL_ERROR, t, component, format, va);
 	}
 }
 
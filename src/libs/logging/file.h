@@ -25,10 +25,17 @@
 #ifndef __UTILS_LOGGING_FILE_H_
 #define __UTILS_LOGGING_FILE_H_
 
+#include <core/utils/lockfree_ring_buffer.h>
 #include <logging/logger.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
 
 namespace llsfrb {
 
@@ -40,6 +47,18 @@ public:
 	FileLogger(const char *filename, LogLevel min_level = LL_DEBUG);
 	virtual ~FileLogger();
 
+	void set_async(size_t       queue_size        = 4096,
+	               unsigned int flush_interval_ms = 200,
+	               LogLevel     flush_level       = LL_WARN);
+
+	/** Get number of times a caller had to wait because the queue was full.
+	 * @return number of blocked log calls in asynchronous mode */
+	unsigned long
+	blocked() const
+	{
+		return blocked_.load(std::memory_order_relaxed);
+	}
+
 	virtual void log_debug(const char *component, const char *format, ...);
 	virtual void log_info(const char *component, const char *format, ...);
 	virtual void log_warn(const char *component, const char *format, ...);
@@ -72,11 +91,34 @@ public:
 	virtual void
 	vtlog_error(struct timeval *t, const char *component, const char *format, va_list va);
 
+private:
+	void write(LogLevel              level,
+	           const struct timeval *t,
+	           const char           *component,
+	           const char           *format,
+	           va_list               va);
+	void write(LogLevel level, const struct timeval *t, const char *component, fawkes::Exception &e);
+	void enqueue(LogLevel level, std::string &&record);
+	void run();
+	void flush_queue();
+
 private:
 	struct ::tm *now_s;
 
 	FILE          *log_file;
 	fawkes::Mutex *mutex;
+
+	fawkes::LockFreeRingBuffer<std::string> *queue_;
+	std::chrono::milliseconds                flush_interval_;
+	LogLevel                                 flush_level_;
+	std::atomic<bool>                        flush_requested_;
+	std::atomic<unsigned long>               blocked_;
+
+	std::mutex              wakeup_mutex_;
+	std::condition_variable wakeup_cond_;
+	std::condition_variable space_cond_;
+	bool                    shutdown_;
+	std::thread             writer_thread_;
 };
 
 } // end namespace llsfrb
@@ -67,6 +67,10 @@ public:
  * itself. If you want to take over the loggers without destroying them you
  * have to properly remove them before destroying the multi logger.
  *
+ * All sub-loggers are called with a common lock held, wrap slow
+ * sub-loggers, e.g. those writing to the network or a database, in a
+ * QueuedLogger so that they cannot stall the caller.
+ *
  * @author Tim Niemueller
  */
 
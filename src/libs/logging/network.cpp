@@ -27,6 +27,7 @@
 #include <protobuf_comm/server.h>
 #include <sys/time.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -37,6 +38,19 @@ namespace llsfrb {
 /** @class NetworkLogger <logging/network.h>
  * Interface for logging to network clients.
  * The NetworkLogger will pipe all output to clients.
+ *
+ * By default every record is sent as a LogMessage of its own. With
+ * set_batching() records are collected and sent as LogMessageBatch
+ * once enough records have been collected or the batch interval has
+ * passed, which saves many small frames at debug level.
+ *
+ * With set_rate_limit() the number of records per component is limited
+ * by a token bucket. Records exceeding the limit are not sent, instead
+ * a warning stating the number of suppressed messages is sent once the
+ * component is below its limit again. This keeps remote clients
+ * responsive during error storms.
+ *
+ * Batching and rate limiting should be configured before logging starts.
  * @author Tim Niemueller
  */
 
@@ -45,14 +59,201 @@ namespace llsfrb {
  * @param log_level minimum level to log
  */
 NetworkLogger::NetworkLogger(protobuf_comm::ProtobufStreamServer *server, LogLevel log_level)
-: Logger(log_level), pb_server_(server)
+: Logger(log_level),
+  pb_server_(server),
+  max_batch_size_(1),
+  batch_interval_(0),
+  rate_(0.),
+  burst_(0),
+  shutdown_(false)
 {
 	pb_server_->message_register().add_message_type<llsf_log_msgs::LogMessage>();
+	pb_server_->message_register().add_message_type<llsf_log_msgs::LogMessageBatch>();
 }
 
-/** Destructor. */
+/** Destructor.
+ * Sends pending suppression summaries and the current batch.
+ */
 NetworkLogger::~NetworkLogger()
 {
+	if (worker_thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			shutdown_ = true;
+		}
+		wakeup_cond_.notify_one();
+		worker_thread_.join();
+	}
+}
+
+/** Enable batching of records.
+ * @param max_batch_size maximum number of records sent in one message,
+ * 0 or 1 to send every record on its own
+ * @param interval_ms maximum time in milliseconds that records are held
+ * back before sending an incomplete batch
+ */
+void
+NetworkLogger::set_batching(unsigned int max_batch_size, unsigned int interval_ms)
+{
+	llsf_log_msgs::LogMessageBatch outbox;
+	std::unique_lock<std::mutex>   lock(mutex_);
+	bool                           batched = (bool)batch_;
+	flush(outbox);
+	max_batch_size_ = std::max(max_batch_size, 1u);
+	batch_interval_ = std::chrono::milliseconds(std::max(interval_ms, 1u));
+	if (max_batch_size_ > 1) {
+		batch_ = std::make_unique<llsf_log_msgs::LogMessageBatch>();
+	} else {
+		batch_.reset();
+	}
+	lock.unlock();
+	send(outbox, batched);
+	start_worker();
+}
+
+/** Enable per-component rate limiting.
+ * @param rate average number of records per second and component,
+ * 0 to disable rate limiting
+ * @param burst number of records a component may send in quick
+ * succession before it is limited
+ */
+void
+NetworkLogger::set_rate_limit(double rate, unsigned int burst)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	rate_  = rate;
+	burst_ = std::max(burst, 1u);
+	rate_limits_.clear();
+	lock.unlock();
+	start_worker();
+}
+
+void
+NetworkLogger::start_worker()
+{
+	if (!worker_thread_.joinable() && (batch_ || rate_ > 0.)) {
+		worker_thread_ = std::thread(&NetworkLogger::run, this);
+	}
+}
+
+void
+NetworkLogger::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		// without batching, the interval only defines how quickly a
+		// suppression summary is sent after a message storm
+		if (!shutdown_) {
+			wakeup_cond_.wait_for(lock, batch_ ? batch_interval_ : std::chrono::seconds(1));
+		}
+		bool stop = shutdown_;
+
+		llsf_log_msgs::LogMessageBatch        outbox;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (auto &l : rate_limits_) {
+			if (l.second.suppressed > 0 && (stop || admit(l.second, now))) {
+				emit_suppressed(l.first, l.second, outbox);
+			}
+		}
+		flush(outbox);
+
+		bool batched = (bool)batch_;
+		lock.unlock();
+		send(outbox, batched);
+		if (stop)
+			break;
+		lock.lock();
+	}
+}
+
+bool
+NetworkLogger::admit(RateLimit &limit, std::chrono::steady_clock::time_point now)
+{
+	std::chrono::duration<double> elapsed = now - limit.last;
+	limit.tokens = std::min<double>(burst_, limit.tokens + elapsed.count() * rate_);
+	limit.last   = now;
+	if (limit.tokens < 1.) {
+		return false;
+	}
+	limit.tokens -= 1.;
+	return true;
+}
+
+void
+NetworkLogger::emit_suppressed(const std::string              &component,
+                               RateLimit                      &limit,
+                               llsf_log_msgs::LogMessageBatch &outbox)
+{
+	char *tmp;
+	if (asprintf(&tmp, "%lu messages suppressed", limit.suppressed) != -1) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		emit(LL_WARN, &now, component.c_str(), /* exception? */ false, tmp, outbox);
+		free(tmp);
+	}
+	limit.suppressed = 0;
+}
+
+void
+NetworkLogger::flush(llsf_log_msgs::LogMessageBatch &outbox)
+{
+	if (batch_ && batch_->messages_size() > 0) {
+		if (outbox.messages_size() == 0) {
+			outbox.Swap(batch_.get());
+		} else {
+			outbox.MergeFrom(*batch_);
+			batch_->Clear();
+		}
+	}
+}
+
+/** Send messages collected while holding the mutex.
+ * Called without holding the mutex, so that logging does not wait for the
+ * server to queue messages for its clients.
+ * @param outbox messages to send
+ * @param batched true to send @p outbox as one batch, false to send each
+ * message on its own
+ */
+void
+NetworkLogger::send(llsf_log_msgs::LogMessageBatch &outbox, bool batched)
+{
+	if (outbox.messages_size() == 0)
+		return;
+	if (batched) {
+		pb_server_->send_to_all(outbox);
+	} else {
+		for (llsf_log_msgs::LogMessage &lm : *outbox.mutable_messages()) {
+			pb_server_->send_to_all(lm);
+		}
+	}
+}
+
+void
+NetworkLogger::emit(Logger::LogLevel                level,
+                    const struct timeval           *t,
+                    const char                     *component,
+                    bool                            is_exception,
+                    const char                     *message,
+                    llsf_log_msgs::LogMessageBatch &outbox)
+{
+	llsf_log_msgs::LogMessage &lm = batch_ ? *batch_->add_messages() : *outbox.add_messages();
+	lm.set_ts_sec(t->tv_sec);
+	lm.set_ts_nsec(t->tv_usec * 1000);
+
+	lm.set_component(component);
+	lm.set_is_exception(is_exception);
+	lm.set_message(message);
+	switch (level) {
+	case LL_DEBUG: lm.set_log_level(llsf_log_msgs::LogMessage::LL_DEBUG); break;
+	case LL_INFO: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
+	case LL_WARN: lm.set_log_level(llsf_log_msgs::LogMessage::LL_WARN); break;
+	case LL_ERROR: lm.set_log_level(llsf_log_msgs::LogMessage::LL_ERROR); break;
+	default: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
+	}
+
+	if (batch_ && (unsigned int)batch_->messages_size() >= max_batch_size_) {
+		flush(outbox);
+	}
 }
 
 void
@@ -63,30 +264,10 @@ NetworkLogger::send_message(Logger::LogLevel level,
                             const char      *format,
                             va_list          va)
 {
-	struct timeval now;
-	if (t == NULL) {
-		gettimeofday(&now, NULL);
-		t = &now;
-	}
-
 	char *tmp;
 	if (vasprintf(&tmp, format, va) != -1) {
-		llsf_log_msgs::LogMessage lm;
-		lm.set_ts_sec(now.tv_sec);
-		lm.set_ts_nsec(now.tv_usec * 1000);
-
-		lm.set_component(component);
-		lm.set_is_exception(is_exception);
-		lm.set_message(tmp);
-		switch (level) {
-		case LL_DEBUG: lm.set_log_level(llsf_log_msgs::LogMessage::LL_DEBUG); break;
-		case LL_INFO: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
-		case LL_WARN: lm.set_log_level(llsf_log_msgs::LogMessage::LL_WARN); break;
-		case LL_ERROR: lm.set_log_level(llsf_log_msgs::LogMessage::LL_ERROR); break;
-		default: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
-		}
+		send_message(level, t, component, is_exception, tmp);
 		free(tmp);
-		pb_server_->send_to_all(lm);
 	}
 }
 
@@ -103,21 +284,28 @@ NetworkLogger::send_message(Logger::LogLevel level,
 		t = &now;
 	}
 
-	llsf_log_msgs::LogMessage lm;
-	lm.set_ts_sec(now.tv_sec);
-	lm.set_ts_nsec(now.tv_usec * 1000);
+	llsf_log_msgs::LogMessageBatch outbox;
+	std::unique_lock<std::mutex>   lock(mutex_);
+	if (rate_ > 0.) {
+		std::chrono::steady_clock::time_point mono_now = std::chrono::steady_clock::now();
 
-	lm.set_component(component);
-	lm.set_is_exception(is_exception);
-	lm.set_message(message);
-	switch (level) {
-	case LL_DEBUG: lm.set_log_level(llsf_log_msgs::LogMessage::LL_DEBUG); break;
-	case LL_INFO: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
-	case LL_WARN: lm.set_log_level(llsf_log_msgs::LogMessage::LL_WARN); break;
-	case LL_ERROR: lm.set_log_level(llsf_log_msgs::LogMessage::LL_ERROR); break;
-	default: lm.set_log_level(llsf_log_msgs::LogMessage::LL_INFO); break;
+		auto l = rate_limits_.find(component);
+		if (l == rate_limits_.end()) {
+			l = rate_limits_.emplace(component, RateLimit{(double)burst_, mono_now, 0}).first;
+		}
+		if (!admit(l->second, mono_now)) {
+			l->second.suppressed += 1;
+			return;
+		}
+		if (l->second.suppressed > 0) {
+			emit_suppressed(l->first, l->second, outbox);
+		}
 	}
-	pb_server_->send_to_all(lm);
+	emit(level, t, component, is_exception, message, outbox);
+
+	bool batched = (bool)batch_;
+	lock.unlock();
+	send(outbox, batched);
 }
 
 void
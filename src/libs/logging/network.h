@@ -26,10 +26,22 @@
 
 #include <logging/logger.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
 namespace protobuf_comm {
 class ProtobufStreamServer;
 }
 
+namespace llsf_log_msgs {
+class LogMessageBatch;
+}
+
 namespace llsfrb {
 
 class NetworkLogger : public Logger
@@ -38,6 +50,9 @@ public:
 	NetworkLogger(protobuf_comm::ProtobufStreamServer *server, LogLevel log_level = LL_DEBUG);
 	virtual ~NetworkLogger();
 
+	void set_batching(unsigned int max_batch_size, unsigned int interval_ms);
+	void set_rate_limit(double rate, unsigned int burst);
+
 	virtual void log_debug(const char *component, const char *format, ...);
 	virtual void log_info(const char *component, const char *format, ...);
 	virtual void log_warn(const char *component, const char *format, ...);
@@ -71,6 +86,15 @@ public:
 	vtlog_error(struct timeval *t, const char *component, const char *format, va_list va);
 
 private:
+	/// @cond INTERNALS
+	struct RateLimit
+	{
+		double                                tokens;
+		std::chrono::steady_clock::time_point last;
+		unsigned long                         suppressed;
+	};
+	/// @endcond
+
 	void send_message(Logger::LogLevel level,
 	                  struct timeval  *t,
 	                  const char      *component,
@@ -82,8 +106,34 @@ private:
 	                  const char      *component,
 	                  bool             is_exception,
 	                  const char      *message);
+	void emit(Logger::LogLevel                level,
+	          const struct timeval           *t,
+	          const char                     *component,
+	          bool                            is_exception,
+	          const char                     *message,
+	          llsf_log_msgs::LogMessageBatch &outbox);
+	bool admit(RateLimit &limit, std::chrono::steady_clock::time_point now);
+	void emit_suppressed(const std::string              &component,
+	                     RateLimit                      &limit,
+	                     llsf_log_msgs::LogMessageBatch &outbox);
+	void flush(llsf_log_msgs::LogMessageBatch &outbox);
+	void send(llsf_log_msgs::LogMessageBatch &outbox, bool batched);
+	void start_worker();
+	void run();
 
 	protobuf_comm::ProtobufStreamServer *pb_server_;
+
+	std::mutex                                      mutex_;
+	std::unique_ptr<llsf_log_msgs::LogMessageBatch> batch_;
+	unsigned int                                    max_batch_size_;
+	std::chrono::milliseconds                       batch_interval_;
+	double                                          rate_;
+	unsigned int                                    burst_;
+	std::map<std::string, RateLimit>                rate_limits_;
+
+	std::condition_variable wakeup_cond_;
+	bool                    shutdown_;
+	std::thread             worker_thread_;
 };
 
 } // end namespace llsfrb
@@ -0,0 +1,163 @@
+
+/***************************************************************************
+ *  qa_binary_logger.cpp - QA for binary logging round trip
+ *
+ *  Created: Fri Oct 16 21:14:05 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+// Do not mention in API doc
+/// @cond QA
+
+// Writes the same records with a FileLogger and a BinaryLogger, decodes
+// the binary log with rcll-log-decode and compares the output to the
+// text log line by line.
+
+#include <core/exception.h>
+#include <logging/binary.h>
+#include <logging/file.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <libgen.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace fawkes;
+using namespace llsfrb;
+
+static void
+log_all(Logger *l)
+{
+	struct timeval t = {1476640000, 123456};
+	char           runtime_format[64];
+
+	l->tlog_debug(&t, "QA", "plain message");
+	l->tlog_info(&t, "QA", "int %i, neg %d, unsigned %u, hex %#x", 42, -7, 4000000000u, 255);
+	l->tlog_warn(&t, "Other", "long %ld, llong %lld, size %zu", -1234567890L, 1LL << 40, (size_t)17);
+	l->tlog_error(&t, "QA", "double %f %.2f %e %g, char %c", 3.14159, 2.5, 1e-9, 0.1, 'x');
+	l->tlog_info(&t, "QA", "string '%s' '%10s' '%-5s|' '%.3s', percent %%", "abc", "r", "l", "trunc");
+	l->tlog_info(&t, "QA", "star width '%*d' precision '%.*f'", 6, 12, 3, 1.23456);
+	l->tlog_info(&t, "QA", "positional %2$s %1$s", "world", "hello");
+
+	Exception e("Outer failure %d", 1);
+	e.append("Inner reason: %s", "disk full");
+	l->tlog_error(&t, "QA", e);
+	l->tlog_warn(&t, "Other", e);
+
+	// formats built at run time, all at the same address, more than the
+	// binary logger defines
+	for (int i = 0; i < 5000; ++i) {
+		t.tv_usec = i;
+		snprintf(runtime_format, sizeof(runtime_format), "run time format %d: %%d", i);
+		l->tlog_info(&t, "QA", runtime_format, i * 2);
+	}
+	l->tlog_info(&t, "QA", "still %s after the format limit", "intact");
+}
+
+static std::vector<std::string>
+read_lines(FILE *f)
+{
+	std::vector<std::string> lines;
+	char                    *line = NULL;
+	size_t                   n    = 0;
+	while (getline(&line, &n, f) != -1) {
+		lines.push_back(line);
+	}
+	free(line);
+	return lines;
+}
+
+int
+main(int argc, char **argv)
+{
+	std::string decoder;
+	if (argc > 1) {
+		decoder = argv[1];
+	} else {
+		char *self = strdup(argv[0]);
+		decoder    = std::string(dirname(self)) + "/rcll-log-decode";
+		free(self);
+	}
+
+	char dir_template[] = "/tmp/qa_binary_logger.XXXXXX";
+	if (!mkdtemp(dir_template)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	std::string dir(dir_template);
+	std::string text_file   = dir + "/refbox.log";
+	std::string binary_file = dir + "/refbox.blog";
+
+	try {
+		FileLogger   text(text_file.c_str());
+		BinaryLogger binary(binary_file.c_str());
+		log_all(&text);
+		log_all(&binary);
+	} catch (Exception &e) {
+		printf("Failed to write logs: %s\n", e.what_no_backtrace());
+		return 1;
+	}
+
+	FILE *f = fopen(text_file.c_str(), "r");
+	if (!f) {
+		perror("fopen");
+		return 1;
+	}
+	std::vector<std::string> expected = read_lines(f);
+	fclose(f);
+
+	std::string command = decoder + " " + binary_file;
+	FILE       *p       = popen(command.c_str(), "r");
+	if (!p) {
+		perror("popen");
+		return 1;
+	}
+	std::vector<std::string> decoded = read_lines(p);
+	int                      status  = pclose(p);
+
+	int rv = 0;
+	if (status != 0) {
+		printf("%s exited with status %d\n", command.c_str(), status);
+		rv = 1;
+	}
+	if (decoded.size() != expected.size()) {
+		printf("Decoded %zu lines, expected %zu\n", decoded.size(), expected.size());
+		rv = 1;
+	}
+	for (size_t i = 0; i < std::min(decoded.size(), expected.size()); ++i) {
+		if (decoded[i] != expected[i]) {
+			printf("Line %zu differs\n  expected: %s  decoded:  %s",
+			       i + 1,
+			       expected[i].c_str(),
+			       decoded[i].c_str());
+			rv = 1;
+		}
+	}
+
+	unlink(text_file.c_str());
+	unlink(binary_file.c_str());
+	rmdir(dir.c_str());
+
+	if (rv == 0) {
+		printf("Round trip of %zu lines OK\n", expected.size());
+	}
+	return rv;
+}
+
+/// @endcond
@@ -0,0 +1,424 @@
+
+/***************************************************************************
+ *  queued.cpp - Logger forwarding to a sink from a worker thread
+ *
+ *  Created: Fri Oct 16 19:02:44 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#include <core/exception.h>
+#include <logging/queued.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdlib>
+
+namespace llsfrb {
+
+/** @class QueuedLogger <logging/queued.h>
+ * Logger forwarding to a sink from a worker thread.
+ * Records are formatted by the caller, pushed into a bounded lock-free
+ * ring buffer, and passed to the sink by a dedicated worker thread. A slow
+ * or stalled sink, e.g. a network client that does not read or an
+ * unreachable database, therefore never blocks the caller. If the queue is
+ * full, records are dropped and counted.
+ *
+ * The log level is that of the sink. Records below it are discarded
+ * before they are formatted.
+ *
+ * The queued logger takes ownership of the sink and deletes it on
+ * destruction after all queued records have been forwarded.
+ */
+
+/** Constructor.
+ * @param name name of the sink, used when reporting queue statistics
+ * @param sink logger to forward records to
+ * @param queue_size maximum number of records waiting for the sink
+ */
+QueuedLogger::QueuedLogger(const char *name, Logger *sink, size_t queue_size)
+: Logger(sink->loglevel()),
+  name_(name),
+  sink_(sink),
+  queue_(queue_size),
+  max_depth_(0),
+  dropped_(0),
+  shutdown_(false)
+{
+	worker_thread_ = std::thread(&QueuedLogger::run, this);
+}
+
+/** Destructor.
+ * Forwards all remaining records and deletes the sink.
+ */
+QueuedLogger::~QueuedLogger()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeup_mutex_);
+		shutdown_ = true;
+	}
+	wakeup_cond_.notify_one();
+	worker_thread_.join();
+	delete sink_;
+}
+
+void
+QueuedLogger::set_loglevel(LogLevel level)
+{
+	Logger::set_loglevel(level);
+	sink_->set_loglevel(level);
+}
+
+Logger::LogLevel
+QueuedLogger::loglevel()
+{
+	return log_level;
+}
+
+/** Get maximum queue depth.
+ * @param reset true to reset the maximum to the current depth afterwards
+ * @return maximum number of records that were waiting at the same time
+ */
+size_t
+QueuedLogger::queue_max_depth(bool reset)
+{
+	if (reset)
+		return max_depth_.exchange(queue_.size(), std::memory_order_relaxed);
+	return max_depth_.load(std::memory_order_relaxed);
+}
+
+void
+QueuedLogger::push(Record &&record)
+{
+	if (!queue_.push(std::move(record))) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	size_t depth = queue_.size();
+	size_t max   = max_depth_.load(std::memory_order_relaxed);
+	while (depth > max && !max_depth_.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {
+	}
+
+	// The wakeup may be missed if the worker is just about to wait, it then
+	// picks up the record after its wait timeout.
+	wakeup_cond_.notify_one();
+}
+
+void
+QueuedLogger::enqueue(LogLevel              level,
+                      const struct timeval *t,
+                      const char           *component,
+                      const char           *format,
+                      va_list               va)
+{
+	char *msg;
+	if (vasprintf(&msg, format, va) == -1)
+		return;
+
+	Record r;
+	r.level     = level;
+	r.time      = *t;
+	r.component = component;
+	r.message   = msg;
+	free(msg);
+	push(std::move(r));
+}
+
+void
+QueuedLogger::enqueue(LogLevel              level,
+                      const struct timeval *t,
+                      const char           *component,
+                      fawkes::Exception    &e)
+{
+	Record r;
+	r.level     = level;
+	r.time      = *t;
+	r.component = component;
+	for (fawkes::Exception::iterator i = e.begin(); i != e.end(); ++i) {
+		r.exception.push_back(*i);
+	}
+	push(std::move(r));
+}
+
+void
+QueuedLogger::forward(Record &r)
+{
+	const char *component = r.component.c_str();
+	if (r.exception.empty()) {
+		switch (r.level) {
+		case LL_DEBUG: sink_->tlog_debug(&r.time, component, "%s", r.message.c_str()); break;
+		case LL_INFO: sink_->tlog_info(&r.time, component, "%s", r.message.c_str()); break;
+		case LL_WARN: sink_->tlog_warn(&r.time, component, "%s", r.message.c_str()); break;
+		default: sink_->tlog_error(&r.time, component, "%s", r.message.c_str()); break;
+		}
+	} else {
+		fawkes::Exception e("%s", r.exception[0].c_str());
+		for (size_t i = 1; i < r.exception.size(); ++i) {
+			e.append("%s", r.exception[i].c_str());
+		}
+		switch (r.level) {
+		case LL_DEBUG: sink_->tlog_debug(&r.time, component, e); break;
+		case LL_INFO: sink_->tlog_info(&r.time, component, e); break;
+		case LL_WARN: sink_->tlog_warn(&r.time, component, e); break;
+		default: sink_->tlog_error(&r.time, component, e); break;
+		}
+	}
+}
+
+void
+QueuedLogger::run()
+{
+	Record                       r;
+	std::unique_lock<std::mutex> lock(wakeup_mutex_);
+	while (!shutdown_) {
+		wakeup_cond_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+			return shutdown_ || queue_.size() > 0;
+		});
+		lock.unlock();
+		while (queue_.pop(r)) {
+			try {
+				forward(r);
+			} catch (fawkes::Exception &e) {
+			} // ignored, there is nowhere to report sink failures
+		}
+		lock.lock();
+	}
+	lock.unlock();
+	while (queue_.pop(r)) {
+		try {
+			forward(r);
+		} catch (fawkes::Exception &e) {
+		}
+	}
+}
+
+void
+QueuedLogger::log_debug(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_debug(component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::log_info(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_info(component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::log_warn(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_warn(component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::log_error(const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vlog_error(component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::log_debug(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_DEBUG) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_DEBUG, &now, component, e);
+	}
+}
+
+void
+QueuedLogger::log_info(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_INFO) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_INFO, &now, component, e);
+	}
+}
+
+void
+QueuedLogger::log_warn(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_WARN) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_WARN, &now, component, e);
+	}
+}
+
+void
+QueuedLogger::log_error(const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_ERROR) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_ERROR, &now, component, e);
+	}
+}
+
+void
+QueuedLogger::vlog_debug(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_DEBUG) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_DEBUG, &now, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vlog_info(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_INFO) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_INFO, &now, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vlog_warn(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_WARN) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_WARN, &now, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vlog_error(const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_ERROR) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		enqueue(LL_ERROR, &now, component, format, va);
+	}
+}
+
+void
+QueuedLogger::tlog_debug(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_debug(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::tlog_info(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_info(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::tlog_warn(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_warn(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::tlog_error(struct timeval *t, const char *component, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+	vtlog_error(t, component, format, arg);
+	va_end(arg);
+}
+
+void
+QueuedLogger::tlog_debug(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_DEBUG) {
+		enqueue(LL_DEBUG, t, component, e);
+	}
+}
+
+void
+QueuedLogger::tlog_info(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_INFO) {
+		enqueue(LL_INFO, t, component, e);
+	}
+}
+
+void
+QueuedLogger::tlog_warn(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_WARN) {
+		enqueue(LL_WARN, t, component, e);
+	}
+}
+
+void
+QueuedLogger::tlog_error(struct timeval *t, const char *component, fawkes::Exception &e)
+{
+	if (log_level <= LL_ERROR) {
+		enqueue(LL_ERROR, t, component, e);
+	}
+}
+
+void
+QueuedLogger::vtlog_debug(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_DEBUG) {
+		enqueue(LL_DEBUG, t, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vtlog_info(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_INFO) {
+		enqueue(LL_INFO, t, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vtlog_warn(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_WARN) {
+		enqueue(LL_WARN, t, component, format, va);
+	}
+}
+
+void
+QueuedLogger::vtlog_error(struct timeval *t, const char *component, const char *format, va_list va)
+{
+	if (log_level <= LL_ERROR) {
+		enqueue(LL_ERROR, t, component, format, va);
+	}
+}
+
+} // end namespace llsfrb
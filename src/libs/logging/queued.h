@@ -0,0 +1,144 @@
+
+/***************************************************************************
+ *  queued.h - Logger forwarding to a sink from a worker thread
+ *
+ *  Created: Fri Oct 16 19:02:44 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#ifndef __UTILS_LOGGING_QUEUED_H_
+#define __UTILS_LOGGING_QUEUED_H_
+
+#include <core/utils/lockfree_ring_buffer.h>
+#include <logging/logger.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llsfrb {
+
+class QueuedLogger : public Logger
+{
+public:
+	QueuedLogger(const char *name, Logger *sink, size_t queue_size = 1024);
+	virtual ~QueuedLogger();
+
+	virtual void     set_loglevel(LogLevel level);
+	virtual LogLevel loglevel();
+
+	/** Get name of the sink.
+	 * @return name given on construction */
+	const std::string &
+	name() const
+	{
+		return name_;
+	}
+
+	/** Get number of records currently waiting for the sink.
+	 * @return queue depth */
+	size_t
+	queue_depth() const
+	{
+		return queue_.size();
+	}
+
+	size_t queue_max_depth(bool reset = false);
+
+	/** Get number of records dropped because the queue was full.
+	 * @return number of dropped records */
+	unsigned long
+	dropped() const
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+	virtual void log_debug(const char *component, const char *format, ...);
+	virtual void log_info(const char *component, const char *format, ...);
+	virtual void log_warn(const char *component, const char *format, ...);
+	virtual void log_error(const char *component, const char *format, ...);
+
+	virtual void vlog_debug(const char *component, const char *format, va_list va);
+	virtual void vlog_info(const char *component, const char *format, va_list va);
+	virtual void vlog_warn(const char *component, const char *format, va_list va);
+	virtual void vlog_error(const char *component, const char *format, va_list va);
+
+	virtual void log_debug(const char *component, fawkes::Exception &e);
+	virtual void log_info(const char *component, fawkes::Exception &e);
+	virtual void log_warn(const char *component, fawkes::Exception &e);
+	virtual void log_error(const char *component, fawkes::Exception &e);
+
+	virtual void tlog_debug(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_info(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_warn(struct timeval *t, const char *component, const char *format, ...);
+	virtual void tlog_error(struct timeval *t, const char *component, const char *format, ...);
+
+	virtual void tlog_debug(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_info(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_warn(struct timeval *t, const char *component, fawkes::Exception &e);
+	virtual void tlog_error(struct timeval *t, const char *component, fawkes::Exception &e);
+
+	virtual void
+	vtlog_debug(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void vtlog_info(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void vtlog_warn(struct timeval *t, const char *component, const char *format, va_list va);
+	virtual void
+	vtlog_error(struct timeval *t, const char *component, const char *format, va_list va);
+
+private:
+	struct Record
+	{
+		LogLevel                 level;
+		struct timeval           time;
+		std::string              component;
+		std::string              message;
+		std::vector<std::string> exception;
+	};
+
+	void enqueue(LogLevel              level,
+	             const struct timeval *t,
+	             const char           *component,
+	             const char           *format,
+	             va_list               va);
+	void enqueue(LogLevel              level,
+	             const struct timeval *t,
+	             const char           *component,
+	             fawkes::Exception    &e);
+	void push(Record &&record);
+	void forward(Record &record);
+	void run();
+
+private:
+	std::string name_;
+	Logger     *sink_;
+
+	fawkes::LockFreeRingBuffer<Record> queue_;
+	std::atomic<size_t>                max_depth_;
+	std::atomic<unsigned long>         dropped_;
+
+	std::mutex              wakeup_mutex_;
+	std::condition_variable wakeup_cond_;
+	bool                    shutdown_;
+	std::thread             worker_thread_;
+};
+
+} // end namespace llsfrb
+
+#endif
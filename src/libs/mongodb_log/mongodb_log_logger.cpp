@@ -20,18 +20,13 @@
  *  Read the full text in the LICENSE.GPL file in the doc directory.
  */
 
-#include <core/threading/mutex.h>
-#include <core/threading/mutex_locker.h>
 #include <mongodb_log/mongodb_log_logger.h>
+#include <mongodb_log/mongodb_log_writer.h>
 
 #include <bsoncxx/builder/basic/document.hpp>
 #include <chrono>
-#include <mongocxx/client.hpp>
-#include <mongocxx/exception/operation_exception.hpp>
-#include <mongocxx/uri.hpp>
 #include <string>
 
-using namespace mongo;
 using namespace fawkes;
 
 using bsoncxx::builder::basic::document;
@@ -45,30 +40,33 @@ using bsoncxx::builder::basic::sub_document;
  * @author Tim Niemueller
  */
 
-/** Constructor. */
-MongoDBLogLogger::MongoDBLogLogger(std::string host_port, std::string collection)
+/** Constructor.
+ * Log entries are written asynchronously, see MongoDBLogWriter.
+ * @param host_port host and port of the MongoDB server
+ * @param collection collection in the rcll database to write to
+ * @param queue_size maximum number of entries waiting to be written
+ * @param batch_size maximum number of entries per insert operation
+ * @param flush_interval_ms maximum time in milliseconds before queued
+ * entries are written
+ */
+MongoDBLogLogger::MongoDBLogLogger(std::string  host_port,
+                                   std::string  collection,
+                                   size_t       queue_size,
+                                   size_t       batch_size,
+                                   unsigned int flush_interval_ms)
+: writer_(new MongoDBLogWriter(host_port, collection, queue_size, batch_size, flush_interval_ms))
 {
-	mutex_ = new Mutex();
-	std::string uri{"mongodb://" + host_port};
-	client_     = mongocxx::client{mongocxx::uri{"mongodb://" + host_port}};
-	collection_ = client_["rcll"][collection];
 }
 
 /** Destructor. */
 MongoDBLogLogger::~MongoDBLogLogger()
 {
-	delete mutex_;
 }
 
 void
 MongoDBLogLogger::insert_message(LogLevel ll, const char *component, const char *format, va_list va)
 {
 	if (log_level <= ll) {
-		MutexLocker    lock(mutex_);
-		struct timeval now;
-		gettimeofday(&now, NULL);
-		//Date_t nowd = now.tv_sec * 1000 + now.tv_usec / 1000;
-
 		char *msg;
 		if (vasprintf(&msg, format, va) == -1) {
 			// Cannot do anything useful, drop log message
@@ -86,7 +84,7 @@ MongoDBLogLogger::insert_message(LogLevel ll, const char *component, const char
 		}
 		doc.append(kvp("component", component));
 		doc.append(kvp("message", msg));
-		collection_.insert_one(doc.view());
+		writer_->write(doc.extract());
 		free(msg);
 	}
 }
@@ -95,8 +93,6 @@ void
 MongoDBLogLogger::insert_message(LogLevel ll, const char *component, Exception &e)
 {
 	if (log_level <= ll) {
-		MutexLocker lock(mutex_);
-
 		for (Exception::iterator i = e.begin(); i != e.end(); ++i) {
 			document doc{};
 			switch (ll) {
@@ -109,10 +105,7 @@ MongoDBLogLogger::insert_message(LogLevel ll, const char *component, Exception &
 			doc.append(kvp("time", bsoncxx::types::b_date(std::chrono::system_clock::now())));
 			doc.append(kvp("component", component));
 			doc.append(kvp("message", std::string("[EXCEPTION] ") + *i));
-			try {
-				collection_.insert_one(doc.view());
-			} catch (mongocxx::operation_exception &) {
-			} // ignored
+			writer_->write(doc.extract());
 		}
 	}
 }
@@ -209,8 +202,7 @@ MongoDBLogLogger::tlog_insert_message(LogLevel        ll,
                                       va_list         va)
 {
 	if (log_level <= ll) {
-		MutexLocker lock(mutex_);
-		char       *msg;
+		char *msg;
 		if (vasprintf(&msg, format, va) == -1) {
 			return;
 		}
@@ -225,14 +217,8 @@ MongoDBLogLogger::tlog_insert_message(LogLevel        ll,
 		doc.append(kvp("component", component));
 		doc.append(kvp("time", bsoncxx::types::b_date(std::chrono::system_clock::now())));
 		doc.append(kvp("message", msg));
-		try {
-			collection_.insert_one(doc.view());
-		} catch (mongocxx::operation_exception &) {
-		} // ignored
-
+		writer_->write(doc.extract());
 		free(msg);
-
-		mutex_->unlock();
 	}
 }
 
@@ -243,7 +229,6 @@ MongoDBLogLogger::tlog_insert_message(LogLevel        ll,
                                       Exception      &e)
 {
 	if (log_level <= ll) {
-		MutexLocker lock(mutex_);
 		for (Exception::iterator i = e.begin(); i != e.end(); ++i) {
 			document doc{};
 			switch (ll) {
@@ -256,10 +241,7 @@ MongoDBLogLogger::tlog_insert_message(LogLevel        ll,
 			doc.append(kvp("component", component));
 			doc.append(kvp("time", bsoncxx::types::b_date(std::chrono::system_clock::now())));
 			doc.append(kvp("message", std::string("[EXCEPTION] ") + *i));
-			try {
-				collection_.insert_one(doc.view());
-			} catch (mongocxx::operation_exception &) {
-			} // ignored
+			writer_->write(doc.extract());
 		}
 	}
 }
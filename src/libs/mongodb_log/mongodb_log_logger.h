@@ -26,22 +26,19 @@
 #include <core/exception.h>
 #include <logging/logger.h>
 
-#include <mongocxx/client.hpp>
-#include <mongocxx/uri.hpp>
+#include <memory>
 #include <string>
 
-namespace fawkes {
-class Mutex;
-}
-
-namespace mongo {
-class DBClientBase;
-}
+class MongoDBLogWriter;
 
 class MongoDBLogLogger : public llsfrb::Logger
 {
 public:
-	MongoDBLogLogger(std::string host_port, std::string collection);
+	MongoDBLogLogger(std::string  host_port,
+	                 std::string  collection,
+	                 size_t       queue_size        = 8192,
+	                 size_t       batch_size        = 256,
+	                 unsigned int flush_interval_ms = 500);
 	virtual ~MongoDBLogLogger();
 
 	virtual void log_debug(const char *component, const char *format, ...);
@@ -87,10 +84,17 @@ private:
 	void
 	tlog_insert_message(LogLevel ll, struct timeval *t, const char *component, fawkes::Exception &);
 
+public:
+	/** Get writer used to store documents.
+	 * @return writer */
+	MongoDBLogWriter &
+	writer()
+	{
+		return *writer_;
+	}
+
 private:
-	fawkes::Mutex       *mutex_;
-	mongocxx::client     client_;
-	mongocxx::collection collection_;
+	std::unique_ptr<MongoDBLogWriter> writer_;
 };
 
 #endif
@@ -21,12 +21,11 @@
  */
 
 #include <core/exception.h>
-#include <core/threading/mutex.h>
-#include <core/threading/mutex_locker.h>
 #include <google/protobuf/descriptor.h>
 #include <mongodb_log/mongodb_log_protobuf.h>
+#include <mongodb_log/mongodb_log_writer.h>
 
-#include <mongocxx/exception/operation_exception.hpp>
+#include <bsoncxx/builder/concatenate.hpp>
 
 using namespace google::protobuf;
 
@@ -42,20 +41,27 @@ using bsoncxx::document::view_or_value;
  * @author Tim Niemueller
  */
 
-/** Constructor. */
-MongoDBLogProtobuf::MongoDBLogProtobuf(std::string host_port, std::string collection)
+/** Constructor.
+ * Documents are written asynchronously, see MongoDBLogWriter.
+ * @param host_port host and port of the MongoDB server
+ * @param collection collection in the rcll database to write to
+ * @param queue_size maximum number of documents waiting to be written
+ * @param batch_size maximum number of documents per insert operation
+ * @param flush_interval_ms maximum time in milliseconds before queued
+ * documents are written
+ */
+MongoDBLogProtobuf::MongoDBLogProtobuf(std::string  host_port,
+                                       std::string  collection,
+                                       size_t       queue_size,
+                                       size_t       batch_size,
+                                       unsigned int flush_interval_ms)
+: writer_(new MongoDBLogWriter(host_port, collection, queue_size, batch_size, flush_interval_ms))
 {
-	mutex_ = new fawkes::Mutex();
-
-	std::string uri{"mongodb://" + host_port};
-	client_     = mongocxx::client{mongocxx::uri{"mongodb://" + host_port}};
-	collection_ = client_["rcll"][collection];
 }
 
 /** Destructor. */
 MongoDBLogProtobuf::~MongoDBLogProtobuf()
 {
-	delete mutex_;
 }
 
 void
@@ -161,26 +167,28 @@ MongoDBLogProtobuf::add_message(const google::protobuf::Message &m)
 	return doc;
 }
 
+/** Write a message.
+ * The message is converted to a document immediately, the database
+ * insert happens asynchronously.
+ * @param m message to write
+ */
 void
 MongoDBLogProtobuf::write(const google::protobuf::Message &m)
 {
-	fawkes::MutexLocker lock(mutex_);
-	document            doc{add_message(m)};
+	document doc{add_message(m)};
 	doc.append(kvp("_time", bsoncxx::types::b_date(std::chrono::system_clock::now())));
-	try {
-		collection_.insert_one(doc.view());
-	} catch (mongocxx::operation_exception &) {
-	} // ignored
+	writer_->write(doc.extract());
 }
 
+/** Write a message with additional meta data.
+ * @param m message to write
+ * @param meta_data document whose fields are added to the message document
+ */
 void
 MongoDBLogProtobuf::write(const google::protobuf::Message &m, const view_or_value &meta_data)
 {
-	fawkes::MutexLocker lock(mutex_);
-	document            doc{add_message(m)};
+	document doc{add_message(m)};
 	doc.append(kvp("_time", bsoncxx::types::b_date(std::chrono::system_clock::now())));
-	try {
-		collection_.insert_one(doc.view());
-	} catch (mongocxx::operation_exception &) {
-	} // ignored
+	doc.append(bsoncxx::builder::concatenate(meta_data.view()));
+	writer_->write(doc.extract());
 }
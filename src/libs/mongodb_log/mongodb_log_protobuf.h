@@ -26,17 +26,19 @@
 
 #include <bsoncxx/builder/basic/document.hpp>
 #include <bsoncxx/document/view_or_value.hpp>
-#include <mongocxx/client.hpp>
+#include <memory>
 #include <string>
 
-namespace fawkes {
-class Mutex;
-}
+class MongoDBLogWriter;
 
 class MongoDBLogProtobuf
 {
 public:
-	MongoDBLogProtobuf(std::string host_port, std::string collection);
+	MongoDBLogProtobuf(std::string  host_port,
+	                   std::string  collection,
+	                   size_t       queue_size        = 8192,
+	                   size_t       batch_size        = 256,
+	                   unsigned int flush_interval_ms = 500);
 	virtual ~MongoDBLogProtobuf();
 
 	void write(const google::protobuf::Message &m);
@@ -48,10 +50,17 @@ private:
 	                                            bsoncxx::builder::basic::document         *doc);
 	bsoncxx::builder::basic::document add_message(const google::protobuf::Message &m);
 
+public:
+	/** Get writer used to store documents.
+	 * @return writer */
+	MongoDBLogWriter &
+	writer()
+	{
+		return *writer_;
+	}
+
 private:
-	fawkes::Mutex       *mutex_;
-	mongocxx::client     client_;
-	mongocxx::collection collection_;
+	std::unique_ptr<MongoDBLogWriter> writer_;
 };
 
 #endif
@@ -0,0 +1,149 @@
+
+/***************************************************************************
+ *  mongodb_log_writer.cpp - Asynchronous batched MongoDB writer
+ *
+ *  Created: Fri Oct 16 11:24:50 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+#include <mongodb_log/mongodb_log_writer.h>
+
+#include <mongocxx/exception/exception.hpp>
+#include <mongocxx/options/insert.hpp>
+#include <mongocxx/uri.hpp>
+#include <vector>
+
+/** @class MongoDBLogWriter <mongodb_log/mongodb_log_writer.h>
+ * Asynchronous batched MongoDB writer.
+ * Documents are handed over through a bounded lock-free ring buffer and
+ * written by a background thread using insert_many. The writer thread
+ * flushes whenever a full batch is available or the flush interval has
+ * elapsed. Producers never block: if the database is slow or unreachable
+ * and the queue fills up, new documents are dropped and counted.
+ */
+
+/** Constructor.
+ * @param host_port host and port of the MongoDB server, e.g. localhost:27017
+ * @param collection collection in the rcll database to write to
+ * @param queue_size maximum number of documents waiting to be written
+ * @param batch_size maximum number of documents per insert_many call,
+ * the writer is also woken up early once this many documents are queued
+ * @param flush_interval_ms maximum time in milliseconds a document waits
+ * in the queue before it is written
+ */
+MongoDBLogWriter::MongoDBLogWriter(const std::string &host_port,
+                                   const std::string &collection,
+                                   size_t             queue_size,
+                                   size_t             batch_size,
+                                   unsigned int       flush_interval_ms)
+: client_(mongocxx::uri{"mongodb://" + host_port}),
+  queue_(queue_size),
+  batch_size_(batch_size > 0 ? batch_size : 1),
+  flush_interval_(flush_interval_ms),
+  dropped_(0),
+  failed_(0),
+  shutdown_(false)
+{
+	collection_    = client_["rcll"][collection];
+	writer_thread_ = std::thread(&MongoDBLogWriter::run, this);
+}
+
+/** Destructor.
+ * Writes all remaining queued documents before returning.
+ */
+MongoDBLogWriter::~MongoDBLogWriter()
+{
+	stop();
+}
+
+/** Stop the writer thread.
+ * Writes all remaining queued documents before returning, afterwards the
+ * dropped and failed counters are final. Documents written after this are
+ * dropped.
+ */
+void
+MongoDBLogWriter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeup_mutex_);
+		shutdown_ = true;
+	}
+	wakeup_cond_.notify_one();
+	if (writer_thread_.joinable()) {
+		writer_thread_.join();
+	}
+}
+
+/** Queue a document for writing.
+ * This never blocks. If the queue is full the document is dropped.
+ * @param doc document to write
+ * @return true if the document was queued, false if it was dropped
+ */
+bool
+MongoDBLogWriter::write(bsoncxx::document::value &&doc)
+{
+	if (!queue_.push(DocPtr(new bsoncxx::document::value(std::move(doc))))) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	// The wakeup may be missed if the writer is just about to wait. In that
+	// case the batch is written when the flush interval expires.
+	if (queue_.size() >= batch_size_) {
+		wakeup_cond_.notify_one();
+	}
+	return true;
+}
+
+void
+MongoDBLogWriter::run()
+{
+	std::unique_lock<std::mutex> lock(wakeup_mutex_);
+	while (!shutdown_) {
+		wakeup_cond_.wait_for(lock, flush_interval_, [this] {
+			return shutdown_ || queue_.size() >= batch_size_;
+		});
+		lock.unlock();
+		flush();
+		lock.lock();
+	}
+	lock.unlock();
+	flush();
+}
+
+void
+MongoDBLogWriter::flush()
+{
+	std::vector<bsoncxx::document::value> batch;
+	batch.reserve(batch_size_);
+
+	DocPtr doc;
+	bool   more = true;
+	while (more) {
+		while (batch.size() < batch_size_ && (more = queue_.pop(doc))) {
+			batch.push_back(std::move(*doc));
+		}
+		if (batch.empty())
+			break;
+
+		try {
+			mongocxx::options::insert opts;
+			opts.ordered(false);
+			collection_.insert_many(batch, opts);
+		} catch (mongocxx::exception &) {
+			failed_.fetch_add(batch.size(), std::memory_order_relaxed);
+		}
+		batch.clear();
+	}
+}
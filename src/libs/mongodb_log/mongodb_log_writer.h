@@ -0,0 +1,88 @@
+
+/***************************************************************************
+ *  mongodb_log_writer.h - Asynchronous batched MongoDB writer
+ *
+ *  Created: Fri Oct 16 11:24:50 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+#ifndef __LIBS_MONGODB_LOG_MONGODB_LOG_WRITER_H_
+#define __LIBS_MONGODB_LOG_MONGODB_LOG_WRITER_H_
+
+#include <core/utils/lockfree_ring_buffer.h>
+
+#include <atomic>
+#include <bsoncxx/document/value.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mongocxx/client.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class MongoDBLogWriter
+{
+public:
+	MongoDBLogWriter(const std::string &host_port,
+	                 const std::string &collection,
+	                 size_t             queue_size        = 8192,
+	                 size_t             batch_size        = 256,
+	                 unsigned int       flush_interval_ms = 500);
+	~MongoDBLogWriter();
+
+	bool write(bsoncxx::document::value &&doc);
+	void stop();
+
+	/** Get number of documents dropped because the queue was full.
+	 * @return number of dropped documents */
+	unsigned long
+	dropped() const
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+	/** Get number of documents lost because the database rejected a batch.
+	 * @return number of documents in failed insert operations */
+	unsigned long
+	failed() const
+	{
+		return failed_.load(std::memory_order_relaxed);
+	}
+
+private:
+	void run();
+	void flush();
+
+private:
+	typedef std::unique_ptr<bsoncxx::document::value> DocPtr;
+
+	mongocxx::client     client_;
+	mongocxx::collection collection_;
+
+	fawkes::LockFreeRingBuffer<DocPtr> queue_;
+	size_t                             batch_size_;
+	std::chrono::milliseconds          flush_interval_;
+
+	std::atomic<unsigned long> dropped_;
+	std::atomic<unsigned long> failed_;
+
+	std::mutex              wakeup_mutex_;
+	std::condition_variable wakeup_cond_;
+	bool                    shutdown_;
+	std::thread             writer_thread_;
+};
+
+#endif
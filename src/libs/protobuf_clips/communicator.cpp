@@ -40,8 +40,14 @@
 #include <protobuf_comm/client.h>
 #include <protobuf_comm/peer.h>
 #include <protobuf_comm/server.h>
+#include <utils/time/tracker.h>
 
 #include <boost/bind/bind.hpp>
+#include <mutex>
+#include <unordered_set>
+
+// must come last, CLIPS defines macros which clash with protobuf methods
+#include <clips/clips.h>
 
 using namespace google::protobuf;
 using namespace protobuf_comm;
@@ -52,6 +58,54 @@ namespace protobuf_clips {
 }
 #endif
 
+/// @cond INTERNALS
+// Message pointers owned by a CLIPS external address, see discard_message_ptr()
+static std::mutex                 managed_ptrs_mutex;
+static std::unordered_set<void *> managed_ptrs;
+/// @endcond
+
+/** Release a received message once CLIPS no longer references it.
+ * Called by CLIPS when the external address stored in the ptr slot of a
+ * protobuf-msg fact is garbage collected, i.e., after the fact has been
+ * retracted and no other fact or variable holds the address.
+ * @param env CLIPS environment
+ * @param ptr pointer to the shared pointer of the message
+ * @return always true
+ */
+static intBool
+discard_message_ptr(void *env, void *ptr)
+{
+	{
+		std::lock_guard<std::mutex> lock(managed_ptrs_mutex);
+		managed_ptrs.erase(ptr);
+	}
+	delete static_cast<std::shared_ptr<google::protobuf::Message> *>(ptr);
+	return TRUE;
+}
+
+/** Delete a message pointer passed from CLIPS.
+ * Pointers of received messages are owned by their external address and
+ * released by discard_message_ptr(), they are left untouched.
+ * @param ptr pointer to the shared pointer of the message
+ */
+static void
+release_message_ptr(std::shared_ptr<google::protobuf::Message> *ptr)
+{
+	{
+		std::lock_guard<std::mutex> lock(managed_ptrs_mutex);
+		if (managed_ptrs.find(ptr) != managed_ptrs.end())
+			return;
+	}
+	delete ptr;
+}
+
+static struct externalAddressType message_ptr_type = {"protobuf-msg-ptr",
+                                                      /* short print */ NULL,
+                                                      /* long print */ NULL,
+                                                      discard_message_ptr,
+                                                      /* new */ NULL,
+                                                      /* call */ NULL};
+
 /** @class ClipsProtobufCommunicator <protobuf_clips/communicator.h>
  * CLIPS protobuf integration class.
  * This class adds functionality related to protobuf to a given CLIPS
@@ -67,7 +121,14 @@ namespace protobuf_clips {
  */
 ClipsProtobufCommunicator::ClipsProtobufCommunicator(CLIPS::Environment *env,
                                                      fawkes::Mutex      &env_mutex)
-: clips_(env), clips_mutex_(env_mutex), server_(NULL), next_client_id_(0)
+: clips_(env),
+  clips_mutex_(env_mutex),
+  server_(NULL),
+  next_client_id_(0),
+  latency_tracker_(NULL),
+  latency_class_(0),
+  inbound_max_depth_(0),
+  inbound_overflows_(0)
 {
 	message_register_ = new MessageRegister();
 	setup_clips();
@@ -81,7 +142,14 @@ ClipsProtobufCommunicator::ClipsProtobufCommunicator(CLIPS::Environment *env,
 ClipsProtobufCommunicator::ClipsProtobufCommunicator(CLIPS::Environment       *env,
                                                      fawkes::Mutex            &env_mutex,
                                                      std::vector<std::string> &proto_path)
-: clips_(env), clips_mutex_(env_mutex), server_(NULL), next_client_id_(0)
+: clips_(env),
+  clips_mutex_(env_mutex),
+  server_(NULL),
+  next_client_id_(0),
+  latency_tracker_(NULL),
+  latency_class_(0),
+  inbound_max_depth_(0),
+  inbound_overflows_(0)
 {
 	message_register_ = new MessageRegister(proto_path);
 	setup_clips();
@@ -104,8 +172,15 @@ ClipsProtobufCommunicator::~ClipsProtobufCommunicator()
 	}
 	clients_.clear();
 
-	delete message_register_;
+	for (auto p : peers_) {
+		delete p.second;
+	}
+	peers_.clear();
+
 	delete server_;
+	// queued messages must be released before their message factory
+	inbound_queue_.reset();
+	delete message_register_;
 }
 
 #define ADD_FUNCTION(n, s)    \
@@ -118,6 +193,8 @@ ClipsProtobufCommunicator::setup_clips()
 {
 	fawkes::MutexLocker lock(&clips_mutex_);
 
+	msg_ptr_type_ = InstallExternalAddressType(clips_->cobj(), &message_ptr_type);
+
 	ADD_FUNCTION("pb-register-type",
 	             (sigc::slot<bool, std::string>(
 	               sigc::mem_fun(*this, &ClipsProtobufCommunicator::clips_pb_register_type))));
@@ -160,6 +237,9 @@ ClipsProtobufCommunicator::setup_clips()
 	ADD_FUNCTION("pb-send",
 	             (sigc::slot<void, long int, void *>(
 	               sigc::mem_fun(*this, &ClipsProtobufCommunicator::clips_pb_send))));
+	ADD_FUNCTION("pb-send-multi",
+	             (sigc::slot<void, CLIPS::Values, void *>(
+	               sigc::mem_fun(*this, &ClipsProtobufCommunicator::clips_pb_send_multi))));
 	ADD_FUNCTION("pb-server-enable",
 	             (sigc::slot<void, int>(
 	               sigc::mem_fun(*this, &ClipsProtobufCommunicator::enable_server))));
@@ -202,7 +282,12 @@ void
 ClipsProtobufCommunicator::enable_server(int port)
 {
 	if ((port > 0) && !server_) {
-		server_ = new protobuf_comm::ProtobufStreamServer(port, message_register_);
+		if (executor_) {
+			server_ =
+			  new protobuf_comm::ProtobufStreamServer(port, message_register_, executor_.get());
+		} else {
+			server_ = new protobuf_comm::ProtobufStreamServer(port, message_register_);
+		}
 
 		server_->signal_connected().connect(
 		  boost::bind(&ClipsProtobufCommunicator::handle_server_client_connected, this, _1, _2));
@@ -242,8 +327,14 @@ ClipsProtobufCommunicator::clips_pb_peer_create_local_crypto(std::string address
 		recv_port = send_port;
 
 	if (send_port > 0) {
-		protobuf_comm::ProtobufBroadcastPeer *peer = new protobuf_comm::ProtobufBroadcastPeer(
-		  address, send_port, recv_port, message_register_, crypto_key, cipher);
+		protobuf_comm::ProtobufBroadcastPeer *peer;
+		if (executor_) {
+			peer = new protobuf_comm::ProtobufBroadcastPeer(
+			  address, send_port, recv_port, message_register_, executor_.get(), crypto_key, cipher);
+		} else {
+			peer = new protobuf_comm::ProtobufBroadcastPeer(
+			  address, send_port, recv_port, message_register_, crypto_key, cipher);
+		}
 
 		long int peer_id;
 		{
@@ -349,6 +440,230 @@ ClipsProtobufCommunicator::clips_pb_register_type(std::string full_name)
 	}
 }
 
+/** Inject a message as if it had been received.
+ * The message takes the same path as one received on the network, but
+ * without any network communication involved, e.g., to replay recorded
+ * traffic. With an inbound queue it is queued until the next call to
+ * assert_queued_messages(), otherwise its fact is asserted right away.
+ * The message appears to come from a server client or a broadcast peer
+ * with ID 0. Like the network handlers, this may be called with or
+ * without the CLIPS environment being locked.
+ * @param host host the message appears to be received from
+ * @param port port the message appears to be received from
+ * @param msg the message
+ * @param via_broadcast true to inject the message as received by a
+ * broadcast peer, false to inject it as received on the stream server
+ * @param rcvd_at time when the message was received
+ * @exception std::logic_error thrown if the message has no CompType enum
+ */
+void
+ClipsProtobufCommunicator::inject_message(const std::string                          &host,
+                                          unsigned short                              port,
+                                          std::shared_ptr<google::protobuf::Message> &msg,
+                                          bool                                        via_broadcast,
+                                          const struct timeval                       &rcvd_at)
+{
+	MessageRegister::KeyType key = message_register_->comp_type(*msg);
+	InboundMessage           m;
+	m.endpoint    = std::make_pair(host, port);
+	m.comp_id     = key.first;
+	m.msg_type    = key.second;
+	m.msg         = msg;
+	m.client_type = via_broadcast ? CT_PEER : CT_SERVER;
+	m.client_id   = 0;
+	queue_message(std::move(m), &rcvd_at);
+}
+
+/** Track the time from receiving a message until its fact is asserted.
+ * This includes waiting for the CLIPS environment lock. The tracker must
+ * be set before any messages are received.
+ * @param tracker latency tracker to add values to, NULL to disable
+ * @param cls class ID of the tracker to add values to
+ */
+void
+ClipsProtobufCommunicator::set_latency_tracker(fawkes::LatencyTracker *tracker, unsigned int cls)
+{
+	latency_tracker_ = tracker;
+	latency_class_   = cls;
+}
+
+/** Run I/O of server, clients, and peers on a shared thread pool.
+ * By default, every endpoint runs its own I/O thread, so that all
+ * receiving, decryption, and parsing is serialized per endpoint. With a
+ * shared pool this work is spread across the given number of threads.
+ * Messages of one connection or peer are still processed in order, only
+ * the assertion of facts is serialized by the CLIPS environment lock.
+ * Only endpoints created after this call use the pool, therefore this
+ * should be called before enabling the server.
+ * @param num_threads number of threads in the pool, 0 to keep one
+ * thread per endpoint
+ * @exception std::logic_error thrown if the pool has already been set up
+ */
+void
+ClipsProtobufCommunicator::set_io_threads(unsigned int num_threads)
+{
+	if (executor_) {
+		throw std::logic_error("I/O thread pool has already been set up");
+	}
+	if (num_threads > 0) {
+		executor_.reset(new AsioExecutor(num_threads));
+	}
+}
+
+/** Queue received messages for the CLIPS thread.
+ * By default, I/O threads lock the CLIPS environment and assert a fact
+ * for each received message, competing with the main loop for the lock.
+ * With an inbound queue, I/O threads only hand over parsed messages
+ * through a bounded lock-free queue. Facts are asserted in one batch by
+ * assert_queued_messages(), which must be called before each agenda run.
+ * Should the queue be full, the message is asserted synchronously after
+ * the queue has been drained, such that the order of messages is kept.
+ * This must be called before enabling the server or creating peers.
+ * @param size maximum number of queued messages, 0 to assert each message
+ * synchronously on reception
+ * @exception std::logic_error thrown if the queue has already been set up
+ */
+void
+ClipsProtobufCommunicator::set_inbound_queue_size(size_t size)
+{
+	if (inbound_queue_) {
+		throw std::logic_error("Inbound queue has already been set up");
+	}
+	if (size > 0) {
+		inbound_queue_.reset(new fawkes::LockFreeRingBuffer<InboundMessage>(size));
+	}
+}
+
+/** Assert facts for all queued messages.
+ * The CLIPS environment must be locked when calling this. Messages are
+ * taken from the queue in batches before any fact is asserted, which frees
+ * queue space early for I/O threads that would otherwise have to wait for
+ * the environment lock. The agenda is neither refreshed nor run, the
+ * caller is expected to do this once after the whole batch is asserted.
+ * @return number of asserted messages
+ */
+unsigned int
+ClipsProtobufCommunicator::assert_queued_messages()
+{
+	if (!inbound_queue_)
+		return 0;
+
+	unsigned int num_asserted = 0;
+	bool         more         = true;
+	while (more) {
+		while (inbound_batch_.size() < inbound_queue_->capacity()) {
+			inbound_batch_.emplace_back();
+			if (!(more = inbound_queue_->pop(inbound_batch_.back()))) {
+				inbound_batch_.pop_back();
+				break;
+			}
+		}
+		for (InboundMessage &m : inbound_batch_) {
+			assert_inbound(m);
+		}
+		num_asserted += inbound_batch_.size();
+		inbound_batch_.clear();
+	}
+	return num_asserted;
+}
+
+/** Get number of messages currently waiting in the inbound queue.
+ * @return approximate number of queued messages, 0 if there is no queue
+ */
+size_t
+ClipsProtobufCommunicator::inbound_queue_depth() const
+{
+	return inbound_queue_ ? inbound_queue_->size() : 0;
+}
+
+/** Get maximum number of messages that were waiting in the inbound queue.
+ * @param reset true to reset the value after reading it
+ * @return maximum queue depth since construction or the last reset
+ */
+size_t
+ClipsProtobufCommunicator::inbound_queue_max_depth(bool reset)
+{
+	if (reset) {
+		return inbound_max_depth_.exchange(0, std::memory_order_relaxed);
+	} else {
+		return inbound_max_depth_.load(std::memory_order_relaxed);
+	}
+}
+
+/** Find a field of a message by name.
+ * Field descriptors are cached per message type and name, saving the
+ * descriptor pool lookup on each of the many field accesses per message
+ * from CLIPS. The cache is only used from CLIPS functions, which are
+ * called with the environment locked.
+ * @param m message to look up the field for
+ * @param field_name name of the field
+ * @return field descriptor, nullptr if the message has no such field
+ */
+const FieldDescriptor *
+ClipsProtobufCommunicator::find_field(const google::protobuf::Message &m,
+                                      const std::string               &field_name)
+{
+	const Descriptor    *desc   = m.GetDescriptor();
+	FieldCache          &fields = field_cache_[desc];
+	FieldCache::iterator f      = fields.find(field_name);
+	if (f != fields.end()) {
+		return f->second;
+	}
+	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	fields[field_name]           = field;
+	return field;
+}
+
+/** Create a CLIPS message reference for a sub-message.
+ * The sub-message is not copied. The reference shares ownership with the
+ * enclosing message, which is therefore kept alive as long as the reference
+ * exists, and it reflects later changes of the enclosing message. An unset
+ * field yields a new empty message instead, the default instance returned
+ * by protobuf must not be referenced.
+ * @param parent enclosing message
+ * @param sub sub-message contained in @p parent
+ * @param is_set true if the field containing @p sub is set
+ * @return pointer to a new message reference to pass to CLIPS
+ */
+void *
+ClipsProtobufCommunicator::sub_message_ref(const std::shared_ptr<google::protobuf::Message> &parent,
+                                           const google::protobuf::Message                  &sub,
+                                           bool                                              is_set)
+{
+	if (!is_set) {
+		return new std::shared_ptr<google::protobuf::Message>(sub.New());
+	}
+	google::protobuf::Message *msg = const_cast<google::protobuf::Message *>(&sub);
+	return new std::shared_ptr<google::protobuf::Message>(parent, msg);
+}
+
+/** Copy a message referenced from CLIPS into a field of another message.
+ * Since sub-message references share ownership with their enclosing
+ * message, the source may be the destination itself or be contained in
+ * it, e.g. when assigning a value obtained by pb-field-value back to the
+ * same message. CopyFrom() must not be called on overlapping messages,
+ * in that case the source is copied through a temporary message.
+ * @param owner message containing @p dest
+ * @param dest field message to copy to
+ * @param src message to copy
+ */
+static void
+copy_sub_message(const std::shared_ptr<google::protobuf::Message> &owner,
+                 google::protobuf::Message                        *dest,
+                 const std::shared_ptr<google::protobuf::Message> &src)
+{
+	if (src.get() == dest)
+		return;
+
+	if (!owner.owner_before(src) && !src.owner_before(owner)) {
+		std::unique_ptr<google::protobuf::Message> tmp(src->New());
+		tmp->CopyFrom(*src);
+		dest->CopyFrom(*tmp);
+	} else {
+		dest->CopyFrom(*src);
+	}
+}
+
 CLIPS::Value
 ClipsProtobufCommunicator::clips_pb_create(std::string full_name)
 {
@@ -381,7 +696,7 @@ ClipsProtobufCommunicator::clips_pb_destroy(void *msgptr)
 	if (!*m)
 		return;
 
-	delete m;
+	release_message_ptr(m);
 }
 
 CLIPS::Values
@@ -409,8 +724,7 @@ ClipsProtobufCommunicator::clips_pb_field_type(void *msgptr, std::string field_n
 	if (!*m)
 		return CLIPS::Value("INVALID-MESSAGE", CLIPS::TYPE_SYMBOL);
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		return CLIPS::Value("DOES-NOT-EXIST", CLIPS::TYPE_SYMBOL);
 	}
@@ -444,8 +758,7 @@ ClipsProtobufCommunicator::clips_pb_has_field(void *msgptr, std::string field_na
 	if (!*m)
 		return false;
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field)
 		return false;
 
@@ -466,8 +779,7 @@ ClipsProtobufCommunicator::clips_pb_field_label(void *msgptr, std::string field_
 	if (!*m)
 		return CLIPS::Value("INVALID-MESSAGE", CLIPS::TYPE_SYMBOL);
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		return CLIPS::Value("DOES-NOT-EXIST", CLIPS::TYPE_SYMBOL);
 	}
@@ -487,8 +799,7 @@ ClipsProtobufCommunicator::clips_pb_field_value(void *msgptr, std::string field_
 	if (!*m)
 		return CLIPS::Value("INVALID-MESSAGE", CLIPS::TYPE_SYMBOL);
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		//logger_->log_warn("RefBox", "Field %s of %s does not exist",
 		//   field_name.c_str(), (*m)->GetTypeName().c_str());
@@ -517,10 +828,7 @@ ClipsProtobufCommunicator::clips_pb_field_value(void *msgptr, std::string field_
 	case FieldDescriptor::TYPE_STRING: return CLIPS::Value(refl->GetString(**m, field));
 	case FieldDescriptor::TYPE_MESSAGE: {
 		const google::protobuf::Message &mfield = refl->GetMessage(**m, field);
-		google::protobuf::Message       *mcopy  = mfield.New();
-		mcopy->CopyFrom(mfield);
-		void *ptr = new std::shared_ptr<google::protobuf::Message>(mcopy);
-		return CLIPS::Value(ptr);
+		return CLIPS::Value(sub_message_ref(*m, mfield, refl->HasField(**m, field)));
 	}
 	case FieldDescriptor::TYPE_BYTES: return CLIPS::Value((char *)"bytes");
 	case FieldDescriptor::TYPE_UINT32: return CLIPS::Value(refl->GetUInt32(**m, field));
@@ -544,8 +852,7 @@ ClipsProtobufCommunicator::clips_pb_set_field(void        *msgptr,
 	if (!*m)
 		return;
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		//logger_->log_warn("RefBox", "Could not find field %s", field_name.c_str());
 		return;
@@ -570,8 +877,8 @@ ClipsProtobufCommunicator::clips_pb_set_field(void        *msgptr,
 			std::shared_ptr<google::protobuf::Message> *mfrom =
 			  static_cast<std::shared_ptr<google::protobuf::Message> *>(value.as_address());
 			Message *mut_msg = refl->MutableMessage(m->get(), field);
-			mut_msg->CopyFrom(**mfrom);
-			delete mfrom;
+			copy_sub_message(*m, mut_msg, *mfrom);
+			release_message_ptr(mfrom);
 		} break;
 		case FieldDescriptor::TYPE_BYTES: break;
 		case FieldDescriptor::TYPE_FIXED32:
@@ -604,8 +911,7 @@ ClipsProtobufCommunicator::clips_pb_add_list(void        *msgptr,
 	if (!(m || *m))
 		return;
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		//logger_->log_warn("RefBox", "Could not find field %s", field_name.c_str());
 		return;
@@ -630,8 +936,8 @@ ClipsProtobufCommunicator::clips_pb_add_list(void        *msgptr,
 			std::shared_ptr<google::protobuf::Message> *mfrom =
 			  static_cast<std::shared_ptr<google::protobuf::Message> *>(value.as_address());
 			Message *new_msg = refl->AddMessage(m->get(), field);
-			new_msg->CopyFrom(**mfrom);
-			delete mfrom;
+			copy_sub_message(*m, new_msg, *mfrom);
+			release_message_ptr(mfrom);
 		} break;
 		case FieldDescriptor::TYPE_BYTES: break;
 		case FieldDescriptor::TYPE_FIXED32:
@@ -656,7 +962,9 @@ ClipsProtobufCommunicator::clips_pb_client_connect(std::string host, int port)
 	if (port <= 0)
 		return false;
 
-	ProtobufStreamClient *client = new ProtobufStreamClient(message_register_);
+	ProtobufStreamClient *client = executor_
+	                                 ? new ProtobufStreamClient(message_register_, executor_.get())
+	                                 : new ProtobufStreamClient(message_register_);
 
 	long int client_id;
 	{
@@ -720,6 +1028,55 @@ ClipsProtobufCommunicator::clips_pb_send(long int client_id, void *msgptr)
 	}
 }
 
+/** Send a message to multiple clients.
+ * Server clients are grouped so that the message is serialized only once
+ * for all of them, other clients and peers are sent to individually.
+ * @param client_ids IDs of the clients to send to
+ * @param msgptr pointer to message to send
+ */
+void
+ClipsProtobufCommunicator::clips_pb_send_multi(CLIPS::Values client_ids, void *msgptr)
+{
+	std::shared_ptr<google::protobuf::Message> *m =
+	  static_cast<std::shared_ptr<google::protobuf::Message> *>(msgptr);
+	if (!m || !*m) {
+		//logger_->log_warn("RefBox", "Cannot send to multiple clients: invalid message");
+		return;
+	}
+
+	std::vector<ProtobufStreamServer::ClientID> srv_clients;
+	std::list<long int>                         other_clients;
+	try {
+		fawkes::MutexLocker lock(&map_mutex_);
+
+		for (const CLIPS::Value &v : client_ids) {
+			long int client_id = v.as_integer();
+			if (server_ && server_clients_.find(client_id) != server_clients_.end()) {
+				srv_clients.push_back(server_clients_[client_id]);
+			} else {
+				other_clients.push_back(client_id);
+			}
+		}
+
+		if (!srv_clients.empty()) {
+			server_->send(srv_clients, **m);
+			for (ProtobufStreamServer::ClientID c : srv_clients) {
+				sig_server_sent_(c, *m);
+			}
+		}
+	} catch (google::protobuf::FatalException &e) {
+		//logger_->log_warn("RefBox", "Failed to send message of type %s: %s",
+		//     (*m)->GetTypeName().c_str(), e.what());
+	} catch (std::runtime_error &e) {
+		//logger_->log_warn("RefBox", "Failed to send message of type %s: %s",
+		//     (*m)->GetTypeName().c_str(), e.what());
+	}
+
+	for (long int client_id : other_clients) {
+		clips_pb_send(client_id, msgptr);
+	}
+}
+
 void
 ClipsProtobufCommunicator::clips_pb_broadcast(long int peer_id, void *msgptr)
 {
@@ -775,8 +1132,7 @@ ClipsProtobufCommunicator::clips_pb_field_list(void *msgptr, std::string field_n
 	if (!(m || *m))
 		return CLIPS::Values(1, CLIPS::Value("INVALID-MESSAGE", CLIPS::TYPE_SYMBOL));
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		return CLIPS::Values(1, CLIPS::Value("DOES-NOT-EXIST", CLIPS::TYPE_SYMBOL));
 	}
@@ -817,11 +1173,8 @@ ClipsProtobufCommunicator::clips_pb_field_list(void *msgptr, std::string field_n
 			rv[i] = CLIPS::Value(refl->GetRepeatedString(**m, field, i));
 			break;
 		case FieldDescriptor::TYPE_MESSAGE: {
-			const google::protobuf::Message &msg   = refl->GetRepeatedMessage(**m, field, i);
-			google::protobuf::Message       *mcopy = msg.New();
-			mcopy->CopyFrom(msg);
-			void *ptr = new std::shared_ptr<google::protobuf::Message>(mcopy);
-			rv[i]     = CLIPS::Value(ptr);
+			const google::protobuf::Message &msg = refl->GetRepeatedMessage(**m, field, i);
+			rv[i]                                = CLIPS::Value(sub_message_ref(*m, msg, true));
 		} break;
 		case FieldDescriptor::TYPE_BYTES:
 			rv[i] = CLIPS::Value((char *)"BYTES", CLIPS::TYPE_SYMBOL);
@@ -854,33 +1207,57 @@ ClipsProtobufCommunicator::clips_pb_field_is_list(void *msgptr, std::string fiel
 	if (!(m || *m))
 		return false;
 
-	const Descriptor      *desc  = (*m)->GetDescriptor();
-	const FieldDescriptor *field = desc->FindFieldByName(field_name);
+	const FieldDescriptor *field = find_field(**m, field_name);
 	if (!field) {
 		return false;
 	}
 	return (field->label() == FieldDescriptor::LABEL_REPEATED);
 }
 
+/** Get the protobuf-msg template.
+ * The template is looked up once and then cached, the refbox never clears
+ * the environment once protobuf.clp has been loaded. The CLIPS environment
+ * must be locked when calling this.
+ * @return template, invalid pointer if protobuf.clp has not been loaded, yet
+ */
+CLIPS::Template::pointer
+ClipsProtobufCommunicator::msg_template()
+{
+	if (!msg_template_) {
+		msg_template_ = clips_->get_template("protobuf-msg");
+	}
+	return msg_template_;
+}
+
 void
 ClipsProtobufCommunicator::clips_assert_message(std::pair<std::string, unsigned short> &endpoint,
                                                 uint16_t                                comp_id,
                                                 uint16_t                                msg_type,
                                                 std::shared_ptr<google::protobuf::Message> &msg,
                                                 ClipsProtobufCommunicator::ClientType       ct,
-                                                long int client_id)
+                                                long int              client_id,
+                                                const struct timeval *rcvd_at)
 {
-	CLIPS::Template::pointer temp = clips_->get_template("protobuf-msg");
+	static const CLIPS::Value via_broadcast("BROADCAST", CLIPS::TYPE_SYMBOL);
+	static const CLIPS::Value via_stream("STREAM", CLIPS::TYPE_SYMBOL);
+	static const CLIPS::Value type_client("CLIENT", CLIPS::TYPE_SYMBOL);
+	static const CLIPS::Value type_server("SERVER", CLIPS::TYPE_SYMBOL);
+	static const CLIPS::Value type_peer("PEER", CLIPS::TYPE_SYMBOL);
+
+	CLIPS::Template::pointer temp = msg_template();
 	if (temp) {
 		struct timeval tv;
-		gettimeofday(&tv, 0);
+		if (rcvd_at) {
+			tv = *rcvd_at;
+		} else {
+			gettimeofday(&tv, 0);
+		}
 		void                *ptr  = new std::shared_ptr<google::protobuf::Message>(msg);
 		CLIPS::Fact::pointer fact = CLIPS::Fact::create(*clips_, temp);
 		fact->set_slot("type", msg->GetTypeName());
 		fact->set_slot("comp-id", comp_id);
 		fact->set_slot("msg-type", msg_type);
-		fact->set_slot("rcvd-via",
-		               CLIPS::Value((ct == CT_PEER) ? "BROADCAST" : "STREAM", CLIPS::TYPE_SYMBOL));
+		fact->set_slot("rcvd-via", (ct == CT_PEER) ? via_broadcast : via_stream);
 		CLIPS::Values rcvd_at(2, CLIPS::Value(CLIPS::TYPE_INTEGER));
 		rcvd_at[0] = tv.tv_sec;
 		rcvd_at[1] = tv.tv_usec;
@@ -890,23 +1267,80 @@ ClipsProtobufCommunicator::clips_assert_message(std::pair<std::string, unsigned
 		host_port[1] = CLIPS::Value(endpoint.second);
 		fact->set_slot("rcvd-from", host_port);
 		fact->set_slot("client-type",
-		               CLIPS::Value(ct == CT_CLIENT ? "CLIENT" : (ct == CT_SERVER ? "SERVER" : "PEER"),
-		                            CLIPS::TYPE_SYMBOL));
+		               ct == CT_CLIENT ? type_client : (ct == CT_SERVER ? type_server : type_peer));
 		fact->set_slot("client-id", client_id);
-		fact->set_slot("ptr", CLIPS::Value(ptr));
-		CLIPS::Fact::pointer new_fact = clips_->assert_fact(fact);
 
-		if (new_fact) {
-			msg_facts_[new_fact->index()] = new_fact;
-		} else {
+		// The message is owned by the external address, it is released by
+		// discard_message_ptr() as soon as CLIPS no longer references it.
+		// This also covers the case that the fact could not be asserted.
+		{
+			std::lock_guard<std::mutex> lock(managed_ptrs_mutex);
+			managed_ptrs.insert(ptr);
+		}
+		DATA_OBJECT ptr_value;
+		SetType(ptr_value, EXTERNAL_ADDRESS);
+		SetValue(ptr_value, EnvAddExternalAddress(clips_->cobj(), ptr, msg_ptr_type_));
+		EnvPutFactSlot(clips_->cobj(), fact->cobj(), "ptr", &ptr_value);
+
+		if (!clips_->assert_fact(fact)) {
 			//logger_->log_warn("RefBox", "Asserting protobuf-msg fact failed");
-			delete static_cast<std::shared_ptr<google::protobuf::Message> *>(ptr);
 		}
 	} else {
 		//logger_->log_warn("RefBox", "Did not get template, did you load protobuf.clp?");
 	}
 }
 
+/** Queue a received message or assert it synchronously.
+ * Called from I/O threads without the CLIPS environment being locked.
+ * @param m received message, moved to the queue on success
+ * @param rcvd_at time when the message was received, NULL for now
+ */
+void
+ClipsProtobufCommunicator::queue_message(InboundMessage &&m, const struct timeval *rcvd_at)
+{
+	m.enqueued = std::chrono::steady_clock::now();
+	if (rcvd_at) {
+		m.rcvd_at = *rcvd_at;
+	} else {
+		gettimeofday(&m.rcvd_at, 0);
+	}
+
+	if (inbound_queue_ && inbound_queue_->push(std::move(m))) {
+		size_t depth     = inbound_queue_->size();
+		size_t max_depth = inbound_max_depth_.load(std::memory_order_relaxed);
+		while (depth > max_depth
+		       && !inbound_max_depth_.compare_exchange_weak(max_depth,
+		                                                    depth,
+		                                                    std::memory_order_relaxed)) {
+		}
+	} else {
+		fawkes::MutexLocker lock(&clips_mutex_);
+		if (inbound_queue_) {
+			inbound_overflows_.fetch_add(1, std::memory_order_relaxed);
+			assert_queued_messages();
+		}
+		assert_inbound(m);
+	}
+	sig_fact_asserted_();
+}
+
+/** Assert the fact for a received message.
+ * The CLIPS environment must be locked when calling this.
+ * @param m received message
+ */
+void
+ClipsProtobufCommunicator::assert_inbound(InboundMessage &m)
+{
+	clips_assert_message(
+	  m.endpoint, m.comp_id, m.msg_type, m.msg, m.client_type, m.client_id, &m.rcvd_at);
+	if (latency_tracker_) {
+		latency_tracker_->add(latency_class_,
+		                      std::chrono::duration_cast<std::chrono::microseconds>(
+		                        std::chrono::steady_clock::now() - m.enqueued)
+		                        .count());
+	}
+}
+
 void
 ClipsProtobufCommunicator::handle_server_client_connected(ProtobufStreamServer::ClientID  client,
                                                           boost::asio::ip::tcp::endpoint &endpoint)
@@ -921,6 +1355,7 @@ ClipsProtobufCommunicator::handle_server_client_connected(ProtobufStreamServer::
 	}
 
 	fawkes::MutexLocker lock(&clips_mutex_);
+	assert_queued_messages();
 	clips_->assert_fact_f("(protobuf-server-client-connected %li %s %u)",
 	                      client_id,
 	                      endpoint.address().to_string().c_str(),
@@ -946,6 +1381,7 @@ ClipsProtobufCommunicator::handle_server_client_disconnected(ProtobufStreamServe
 
 	if (client_id >= 0) {
 		fawkes::MutexLocker lock(&clips_mutex_);
+		assert_queued_messages();
 		clips_->assert_fact_f("(protobuf-server-client-disconnected %li)", client_id);
 		clips_->refresh_agenda();
 		clips_->run();
@@ -964,13 +1400,21 @@ ClipsProtobufCommunicator::handle_server_client_msg(ProtobufStreamServer::Client
                                                     uint16_t                       msg_type,
                                                     std::shared_ptr<google::protobuf::Message> msg)
 {
-	fawkes::MutexLocker          lock(&clips_mutex_);
-	fawkes::MutexLocker          lock2(&map_mutex_);
-	RevServerClientMap::iterator c;
-	if ((c = rev_server_clients_.find(client)) != rev_server_clients_.end()) {
-		clips_assert_message(
-		  client_endpoints_[c->second], component_id, msg_type, msg, CT_SERVER, c->second);
+	InboundMessage m;
+	{
+		fawkes::MutexLocker          lock(&map_mutex_);
+		RevServerClientMap::iterator c;
+		if ((c = rev_server_clients_.find(client)) == rev_server_clients_.end()) {
+			return;
+		}
+		m.endpoint  = client_endpoints_[c->second];
+		m.client_id = c->second;
 	}
+	m.comp_id     = component_id;
+	m.msg_type    = msg_type;
+	m.msg         = std::move(msg);
+	m.client_type = CT_SERVER;
+	queue_message(std::move(m));
 }
 
 /** Handle server reception failure
@@ -985,10 +1429,14 @@ ClipsProtobufCommunicator::handle_server_client_fail(ProtobufStreamServer::Clien
                                                      uint16_t                       msg_type,
                                                      std::string                    msg)
 {
-	fawkes::MutexLocker          lock(&map_mutex_);
-	RevServerClientMap::iterator c;
-	if ((c = rev_server_clients_.find(client)) != rev_server_clients_.end()) {
-		fawkes::MutexLocker lock(&clips_mutex_);
+	{
+		fawkes::MutexLocker          lock(&map_mutex_);
+		RevServerClientMap::iterator c;
+		if ((c = rev_server_clients_.find(client)) == rev_server_clients_.end()) {
+			return;
+		}
+		fawkes::MutexLocker clips_lock(&clips_mutex_);
+		assert_queued_messages();
 		clips_->assert_fact_f("(protobuf-server-receive-failed (comp-id %u) (msg-type %u) "
 		                      "(rcvd-via STREAM) (client-id %li) (message \"%s\") "
 		                      "(rcvd-from (\"%s\" %u)))",
@@ -999,6 +1447,7 @@ ClipsProtobufCommunicator::handle_server_client_fail(ProtobufStreamServer::Clien
 		                      client_endpoints_[c->second].first.c_str(),
 		                      client_endpoints_[c->second].second);
 	}
+	sig_fact_asserted_();
 }
 
 /** Handle message that came from a peer/robot
@@ -1014,10 +1463,14 @@ ClipsProtobufCommunicator::handle_peer_msg(long int
                                            uint16_t                                   msg_type,
                                            std::shared_ptr<google::protobuf::Message> msg)
 {
-	fawkes::MutexLocker                    lock(&clips_mutex_);
-	std::pair<std::string, unsigned short> endpp =
-	  std::make_pair(endpoint.address().to_string(), endpoint.port());
-	clips_assert_message(endpp, component_id, msg_type, msg, CT_PEER, peer_id);
+	InboundMessage m;
+	m.endpoint    = std::make_pair(endpoint.address().to_string(), endpoint.port());
+	m.comp_id     = component_id;
+	m.msg_type    = msg_type;
+	m.msg         = std::move(msg);
+	m.client_type = CT_PEER;
+	m.client_id   = peer_id;
+	queue_message(std::move(m));
 }
 
 /** Handle error during peer message processing.
@@ -1046,6 +1499,7 @@ void
 ClipsProtobufCommunicator::handle_client_connected(long int client_id)
 {
 	fawkes::MutexLocker lock(&clips_mutex_);
+	assert_queued_messages();
 	clips_->assert_fact_f("(protobuf-client-connected %li)", client_id);
 	clips_->refresh_agenda();
 	clips_->run();
@@ -1056,6 +1510,7 @@ ClipsProtobufCommunicator::handle_client_disconnected(long int
                                                       const boost::system::error_code &error)
 {
 	fawkes::MutexLocker lock(&clips_mutex_);
+	assert_queued_messages();
 	clips_->assert_fact_f("(protobuf-client-disconnected %li)", client_id);
 	clips_->refresh_agenda();
 	clips_->run();
@@ -1067,9 +1522,14 @@ ClipsProtobufCommunicator::handle_client_msg(long int
                                              uint16_t                                   msg_type,
                                              std::shared_ptr<google::protobuf::Message> msg)
 {
-	fawkes::MutexLocker                    lock(&clips_mutex_);
-	std::pair<std::string, unsigned short> endpp = std::make_pair(std::string(), 0);
-	clips_assert_message(endpp, comp_id, msg_type, msg, CT_CLIENT, client_id);
+	InboundMessage m;
+	m.endpoint    = std::make_pair(std::string(), 0);
+	m.comp_id     = comp_id;
+	m.msg_type    = msg_type;
+	m.msg         = std::move(msg);
+	m.client_type = CT_CLIENT;
+	m.client_id   = client_id;
+	queue_message(std::move(m));
 }
 
 void
@@ -1078,13 +1538,17 @@ ClipsProtobufCommunicator::handle_client_receive_fail(long int    client_id,
                                                       uint16_t    msg_type,
                                                       std::string msg)
 {
-	fawkes::MutexLocker lock(&clips_mutex_);
-	clips_->assert_fact_f("(protobuf-receive-failed (client-id %li) (rcvd-via STREAM) "
-	                      "(comp-id %u) (msg-type %u) (message \"%s\"))",
-	                      client_id,
-	                      comp_id,
-	                      msg_type,
-	                      msg.c_str());
+	{
+		fawkes::MutexLocker lock(&clips_mutex_);
+		assert_queued_messages();
+		clips_->assert_fact_f("(protobuf-receive-failed (client-id %li) (rcvd-via STREAM) "
+		                      "(comp-id %u) (msg-type %u) (message \"%s\"))",
+		                      client_id,
+		                      comp_id,
+		                      msg_type,
+		                      msg.c_str());
+	}
+	sig_fact_asserted_();
 }
 
 } // end namespace protobuf_clips
@@ -38,11 +38,21 @@
 #define __PROTOBUF_CLIPS_COMMUNICATOR_H_
 
 #include <core/threading/mutex.h>
+#include <core/utils/lockfree_ring_buffer.h>
 #include <protobuf_comm/server.h>
+#include <sys/time.h>
 
+#include <atomic>
+#include <chrono>
 #include <clipsmm.h>
 #include <list>
 #include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace fawkes {
+class LatencyTracker;
+}
 
 namespace protobuf_comm {
 class ProtobufStreamClient;
@@ -119,9 +129,49 @@ public:
 		return sig_peer_sent_;
 	}
 
+	void inject_message(const std::string                          &host,
+	                    unsigned short                              port,
+	                    std::shared_ptr<google::protobuf::Message> &msg,
+	                    bool                                        via_broadcast,
+	                    const struct timeval                       &rcvd_at);
+
+	void set_latency_tracker(fawkes::LatencyTracker *tracker, unsigned int cls);
+	void set_io_threads(unsigned int num_threads);
+	void set_inbound_queue_size(size_t size);
+
+	unsigned int assert_queued_messages();
+	size_t       inbound_queue_depth() const;
+	size_t       inbound_queue_max_depth(bool reset = false);
+
+	/** Get number of messages asserted synchronously because the queue was full.
+   * @return number of inbound queue overflows */
+	unsigned long
+	inbound_queue_overflows() const
+	{
+		return inbound_overflows_.load(std::memory_order_relaxed);
+	}
+
+	/** Signal invoked after a message has been received.
+   * With an inbound queue the message has only been queued, call
+   * assert_queued_messages() before running the agenda. Otherwise the fact
+   * has been asserted, but the agenda has not been run for it, yet.
+   * @return signal
+   */
+	boost::signals2::signal<void()> &
+	signal_fact_asserted()
+	{
+		return sig_fact_asserted_;
+	}
+
 private:
 	void setup_clips();
 
+	const google::protobuf::FieldDescriptor *find_field(const google::protobuf::Message &m,
+	                                                    const std::string               &field_name);
+	void *sub_message_ref(const std::shared_ptr<google::protobuf::Message> &parent,
+	                      const google::protobuf::Message                  &sub,
+	                      bool                                              is_set);
+
 	bool          clips_pb_register_type(std::string full_name);
 	CLIPS::Values clips_pb_field_names(void *msgptr);
 	bool          clips_pb_has_field(void *msgptr, std::string field_name);
@@ -136,6 +186,7 @@ private:
 	void          clips_pb_set_field(void *msgptr, std::string field_name, CLIPS::Value value);
 	void          clips_pb_add_list(void *msgptr, std::string field_name, CLIPS::Value value);
 	void          clips_pb_send(long int client_id, void *msgptr);
+	void          clips_pb_send_multi(CLIPS::Values client_ids, void *msgptr);
 	long int      clips_pb_client_connect(std::string host, int port);
 	void          clips_pb_disconnect(long int client_id);
 	void          clips_pb_broadcast(long int peer_id, void *msgptr);
@@ -158,12 +209,30 @@ private:
 	CLIPS::Value clips_pb_connect(std::string host, int port);
 
 	typedef enum { CT_SERVER, CT_CLIENT, CT_PEER } ClientType;
+
+	/** Message received on the network waiting to be asserted. */
+	struct InboundMessage
+	{
+		std::pair<std::string, unsigned short>     endpoint;
+		uint16_t                                   comp_id;
+		uint16_t                                   msg_type;
+		std::shared_ptr<google::protobuf::Message> msg;
+		ClientType                                 client_type;
+		long int                                   client_id;
+		struct timeval                             rcvd_at;
+		std::chrono::steady_clock::time_point      enqueued;
+	};
+
+	void                     queue_message(InboundMessage &&m, const struct timeval *rcvd_at = NULL);
+	void                     assert_inbound(InboundMessage &m);
+	CLIPS::Template::pointer msg_template();
 	void clips_assert_message(std::pair<std::string, unsigned short>     &endpoint,
 	                          uint16_t                                    comp_id,
 	                          uint16_t                                    msg_type,
 	                          std::shared_ptr<google::protobuf::Message> &msg,
 	                          ClientType                                  ct,
-	                          long int                                    client_id = 0);
+	                          long int                                    client_id = 0,
+	                          const struct timeval                       *rcvd_at   = NULL);
 	void handle_server_client_connected(protobuf_comm::ProtobufStreamServer::ClientID client,
 	                                    boost::asio::ip::tcp::endpoint               &endpoint);
 	void handle_server_client_disconnected(protobuf_comm::ProtobufStreamServer::ClientID client,
@@ -204,8 +273,9 @@ private:
 	CLIPS::Environment *clips_;
 	fawkes::Mutex      &clips_mutex_;
 
-	protobuf_comm::MessageRegister      *message_register_;
-	protobuf_comm::ProtobufStreamServer *server_;
+	protobuf_comm::MessageRegister              *message_register_;
+	std::unique_ptr<protobuf_comm::AsioExecutor> executor_;
+	protobuf_comm::ProtobufStreamServer         *server_;
 
 	boost::signals2::signal<void(protobuf_comm::ProtobufStreamServer::ClientID,
 	                             std::shared_ptr<google::protobuf::Message>)>
@@ -215,6 +285,7 @@ private:
 	  sig_client_sent_;
 	boost::signals2::signal<void(long int, std::shared_ptr<google::protobuf::Message>)>
 	  sig_peer_sent_;
+	boost::signals2::signal<void()> sig_fact_asserted_;
 
 	fawkes::Mutex map_mutex_;
 	long int      next_client_id_ = 0;
@@ -227,10 +298,21 @@ private:
 
 	std::map<long int, std::pair<std::string, unsigned short>> client_endpoints_;
 
-	std::map<long int, CLIPS::Fact::pointer> msg_facts_;
+	fawkes::LatencyTracker *latency_tracker_;
+	unsigned int            latency_class_;
+
+	std::unique_ptr<fawkes::LockFreeRingBuffer<InboundMessage>> inbound_queue_;
+	std::atomic<size_t>                                          inbound_max_depth_;
+	std::atomic<unsigned long>                                   inbound_overflows_;
+	std::vector<InboundMessage>                                  inbound_batch_;
+	CLIPS::Template::pointer                                     msg_template_;
+
+	typedef std::unordered_map<std::string, const google::protobuf::FieldDescriptor *> FieldCache;
+	std::unordered_map<const google::protobuf::Descriptor *, FieldCache> field_cache_;
 
 	std::list<std::string> functions_;
 	CLIPS::Fact::pointer   avail_fact_;
+	int                    msg_ptr_type_;
 };
 
 } // end namespace protobuf_clips
@@ -55,18 +55,16 @@ namespace protobuf_comm {
 
 /** Constructor. */
 ProtobufStreamClient::ProtobufStreamClient()
-: resolver_(io_service_), socket_(io_service_), io_service_work_(io_service_)
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  resolver_(io_service_),
+  socket_(io_service_)
 {
 	message_register_     = new MessageRegister();
 	own_message_register_ = true;
-	connected_            = false;
-	outbound_active_      = false;
-	in_data_size_         = 1024;
 	frame_header_version_ = PB_FRAME_V2;
-	in_frame_header_size_ = sizeof(frame_header_t);
-	in_frame_header_      = malloc(in_frame_header_size_);
-	in_data_              = malloc(in_data_size_);
-	run_asio();
+	ctor();
 }
 
 /** Constructor.
@@ -75,18 +73,16 @@ ProtobufStreamClient::ProtobufStreamClient()
  * message creation.
  */
 ProtobufStreamClient::ProtobufStreamClient(std::vector<std::string> &proto_path)
-: resolver_(io_service_), socket_(io_service_), io_service_work_(io_service_)
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  resolver_(io_service_),
+  socket_(io_service_)
 {
 	message_register_     = new MessageRegister(proto_path);
 	own_message_register_ = true;
-	connected_            = false;
-	outbound_active_      = false;
-	in_data_size_         = 1024;
-	in_data_              = malloc(in_data_size_);
 	frame_header_version_ = PB_FRAME_V2;
-	in_frame_header_size_ = sizeof(frame_header_t);
-	in_frame_header_      = malloc(in_frame_header_size_);
-	run_asio();
+	ctor();
 }
 
 /** Constructor.
@@ -95,13 +91,47 @@ ProtobufStreamClient::ProtobufStreamClient(std::vector<std::string> &proto_path)
  */
 ProtobufStreamClient::ProtobufStreamClient(MessageRegister       *mr,
                                            frame_header_version_t header_version)
-: resolver_(io_service_),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  resolver_(io_service_),
   socket_(io_service_),
-  io_service_work_(io_service_),
   message_register_(mr),
   own_message_register_(false),
   frame_header_version_(header_version)
 {
+	ctor();
+}
+
+/** Constructor with shared executor.
+ * The client does not run its own thread, but dispatches its handlers
+ * through a strand on the given executor. Signal handlers may therefore
+ * be invoked concurrently with those of other endpoints on the executor.
+ * @param mr message register to use to (de)serialize messages
+ * @param executor executor to run I/O on, must outlive the client
+ * @param header_version protobuf protocol frame header version to use,
+ */
+ProtobufStreamClient::ProtobufStreamClient(MessageRegister       *mr,
+                                           AsioExecutor          *executor,
+                                           frame_header_version_t header_version)
+: io_service_(executor->io_service()),
+  strand_(io_service_),
+  resolver_(io_service_),
+  socket_(io_service_),
+  message_register_(mr),
+  own_message_register_(false),
+  frame_header_version_(header_version)
+{
+	ctor();
+}
+
+/** Constructor helper.
+ * Message register and frame header version must have been set.
+ */
+void
+ProtobufStreamClient::ctor()
+{
+	shutdown_        = false;
 	connected_       = false;
 	outbound_active_ = false;
 	in_data_size_    = 1024;
@@ -112,16 +142,12 @@ ProtobufStreamClient::ProtobufStreamClient(MessageRegister       *mr,
 		in_frame_header_size_ = sizeof(frame_header_t);
 	}
 	in_frame_header_ = malloc(in_frame_header_size_);
-	run_asio();
 }
 
 /** Destructor. */
 ProtobufStreamClient::~ProtobufStreamClient()
 {
-	disconnect_nosig();
-	io_service_.stop();
-	if (asio_thread_.joinable())
-		asio_thread_.join();
+	shutdown();
 	free(in_data_);
 	free(in_frame_header_);
 	if (own_message_register_) {
@@ -130,9 +156,22 @@ ProtobufStreamClient::~ProtobufStreamClient()
 }
 
 void
-ProtobufStreamClient::run_asio()
+ProtobufStreamClient::shutdown()
 {
-	asio_thread_ = std::thread([this]() { this->io_service_.run(); });
+	shutdown_ = true;
+
+	strand_.dispatch(handler_tracker_.wrap([this]() {
+		boost::system::error_code err;
+		resolver_.cancel();
+		if (socket_.is_open()) {
+			socket_.shutdown(ip::tcp::socket::shutdown_both, err);
+			socket_.close(err);
+		}
+		connected_ = false;
+	}));
+
+	handler_tracker_.wait();
+	own_executor_.reset();
 }
 
 /** Asynchronous connect.
@@ -147,16 +186,20 @@ ProtobufStreamClient::async_connect(const char *host, unsigned short port)
 {
 	ip::tcp::resolver::query query(host, boost::lexical_cast<std::string>(port));
 	resolver_.async_resolve(query,
-	                        boost::bind(&ProtobufStreamClient::handle_resolve,
-	                                    this,
-	                                    boost::asio::placeholders::error,
-	                                    boost::asio::placeholders::iterator));
+	                        strand_.wrap(handler_tracker_.wrap(
+	                          boost::bind(&ProtobufStreamClient::handle_resolve,
+	                                      this,
+	                                      boost::asio::placeholders::error,
+	                                      boost::asio::placeholders::iterator))));
 }
 
 void
 ProtobufStreamClient::handle_resolve(const boost::system::error_code &err,
                                      ip::tcp::resolver::iterator      endpoint_iterator)
 {
+	if (shutdown_)
+		return;
+
 	if (!err) {
 		// Attempt a connection to each endpoint in the list until we
 		// successfully establish a connection.
@@ -166,9 +209,10 @@ ProtobufStreamClient::handle_resolve(const boost::system::error_code &err,
 #else
 		socket_.async_connect(*endpoint_iterator,
 #endif
-		                           boost::bind(&ProtobufStreamClient::handle_connect,
-		                                       this,
-		                                       boost::asio::placeholders::error));
+		                           strand_.wrap(handler_tracker_.wrap(
+		                             boost::bind(&ProtobufStreamClient::handle_connect,
+		                                         this,
+		                                         boost::asio::placeholders::error))));
 	} else {
 		disconnect_nosig();
 		sig_disconnected_(err);
@@ -178,6 +222,9 @@ ProtobufStreamClient::handle_resolve(const boost::system::error_code &err,
 void
 ProtobufStreamClient::handle_connect(const boost::system::error_code &err)
 {
+	if (shutdown_)
+		return;
+
 	if (!err) {
 		connected_ = true;
 		start_recv();
@@ -191,14 +238,14 @@ ProtobufStreamClient::handle_connect(const boost::system::error_code &err)
 void
 ProtobufStreamClient::disconnect_nosig()
 {
-	io_service_.dispatch([this]() {
+	strand_.dispatch(handler_tracker_.wrap([this]() {
 		boost::system::error_code err;
 		if (this->socket_.is_open()) {
 			this->socket_.shutdown(ip::tcp::socket::shutdown_both, err);
 			this->socket_.close();
 		}
 		this->connected_ = false;
-	});
+	}));
 }
 
 /** Disconnect from remote host. */
@@ -214,14 +261,18 @@ ProtobufStreamClient::start_recv()
 {
 	boost::asio::async_read(socket_,
 	                        boost::asio::buffer(in_frame_header_, in_frame_header_size_),
-	                        boost::bind(&ProtobufStreamClient::handle_read_header,
-	                                    this,
-	                                    boost::asio::placeholders::error));
+	                        strand_.wrap(handler_tracker_.wrap(
+	                          boost::bind(&ProtobufStreamClient::handle_read_header,
+	                                      this,
+	                                      boost::asio::placeholders::error))));
 }
 
 void
 ProtobufStreamClient::handle_read_header(const boost::system::error_code &error)
 {
+	if (shutdown_)
+		return;
+
 	if (!error) {
 		size_t to_read;
 		if (frame_header_version_ == PB_FRAME_V1) {
@@ -244,9 +295,10 @@ ProtobufStreamClient::handle_read_header(const boost::system::error_code &error)
 		// setup new read
 		boost::asio::async_read(socket_,
 		                        boost::asio::buffer(in_data_, to_read),
-		                        boost::bind(&ProtobufStreamClient::handle_read_message,
-		                                    this,
-		                                    boost::asio::placeholders::error));
+		                        strand_.wrap(handler_tracker_.wrap(
+		                          boost::bind(&ProtobufStreamClient::handle_read_message,
+		                                      this,
+		                                      boost::asio::placeholders::error))));
 	} else {
 		disconnect_nosig();
 		sig_disconnected_(error);
@@ -256,6 +308,9 @@ ProtobufStreamClient::handle_read_header(const boost::system::error_code &error)
 void
 ProtobufStreamClient::handle_read_message(const boost::system::error_code &error)
 {
+	if (shutdown_)
+		return;
+
 	if (!error) {
 		frame_header_t   frame_header;
 		message_header_t message_header;
@@ -314,6 +369,9 @@ ProtobufStreamClient::handle_write(const boost::system::error_code &error,
 {
 	delete entry;
 
+	if (shutdown_)
+		return;
+
 	if (!error) {
 		std::lock_guard<std::mutex> lock(outbound_mutex_);
 		if (!outbound_queue_.empty()) {
@@ -321,11 +379,12 @@ ProtobufStreamClient::handle_write(const boost::system::error_code &error,
 			outbound_queue_.pop();
 			boost::asio::async_write(socket_,
 			                         entry->buffers,
-			                         boost::bind(&ProtobufStreamClient::handle_write,
-			                                     this,
-			                                     boost::asio::placeholders::error,
-			                                     boost::asio::placeholders::bytes_transferred,
-			                                     entry));
+			                         strand_.wrap(handler_tracker_.wrap(
+			                           boost::bind(&ProtobufStreamClient::handle_write,
+			                                       this,
+			                                       boost::asio::placeholders::error,
+			                                       boost::asio::placeholders::bytes_transferred,
+			                                       entry))));
 		} else {
 			outbound_active_ = false;
 		}
@@ -376,11 +435,12 @@ ProtobufStreamClient::send(uint16_t component_id, uint16_t msg_type, google::pro
 		outbound_active_ = true;
 		boost::asio::async_write(socket_,
 		                         entry->buffers,
-		                         boost::bind(&ProtobufStreamClient::handle_write,
-		                                     this,
-		                                     boost::asio::placeholders::error,
-		                                     boost::asio::placeholders::bytes_transferred,
-		                                     entry));
+		                         strand_.wrap(handler_tracker_.wrap(
+		                           boost::bind(&ProtobufStreamClient::handle_write,
+		                                       this,
+		                                       boost::asio::placeholders::error,
+		                                       boost::asio::placeholders::bytes_transferred,
+		                                       entry))));
 	}
 }
 
@@ -391,26 +451,8 @@ ProtobufStreamClient::send(uint16_t component_id, uint16_t msg_type, google::pro
 void
 ProtobufStreamClient::send(google::protobuf::Message &m)
 {
-	const google::protobuf::Descriptor     *desc     = m.GetDescriptor();
-	const google::protobuf::EnumDescriptor *enumdesc = desc->FindEnumTypeByName("CompType");
-	if (!enumdesc) {
-		throw std::logic_error("Message does not have CompType enum");
-	}
-	const google::protobuf::EnumValueDescriptor *compdesc = enumdesc->FindValueByName("COMP_ID");
-	const google::protobuf::EnumValueDescriptor *msgtdesc = enumdesc->FindValueByName("MSG_TYPE");
-	if (!compdesc || !msgtdesc) {
-		throw std::logic_error("Message CompType enum hs no COMP_ID or MSG_TYPE value");
-	}
-	int comp_id  = compdesc->number();
-	int msg_type = msgtdesc->number();
-	if (comp_id < 0 || comp_id > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid COMP_ID");
-	}
-	if (msg_type < 0 || msg_type > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid MSG_TYPE");
-	}
-
-	send(comp_id, msg_type, m);
+	MessageRegister::KeyType key = message_register_->comp_type(m);
+	send(key.first, key.second, m);
 }
 
 /** Send a message to the server.
@@ -38,17 +38,19 @@
 #define __PROTOBUF_COMM_CLIENT_H_
 
 #include <google/protobuf/message.h>
+#include <protobuf_comm/executor.h>
 #include <protobuf_comm/frame_header.h>
 #include <protobuf_comm/message_register.h>
 #include <protobuf_comm/queue_entry.h>
 
 #include <boost/asio.hpp>
+#include <atomic>
 #include <boost/signals2.hpp>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
-#include <thread>
 
 namespace protobuf_comm {
 #if 0 /* just to make Emacs auto-indent happy */
@@ -61,6 +63,9 @@ public:
 	ProtobufStreamClient();
 	ProtobufStreamClient(std::vector<std::string> &proto_path);
 	ProtobufStreamClient(MessageRegister *mr, frame_header_version_t header_version = PB_FRAME_V2);
+	ProtobufStreamClient(MessageRegister       *mr,
+	                     AsioExecutor          *executor,
+	                     frame_header_version_t header_version = PB_FRAME_V2);
 	~ProtobufStreamClient();
 
 	/** Get the client's message register.
@@ -129,8 +134,9 @@ public:
 
 private: // types
 private: // methods
+	void ctor();
 	void disconnect_nosig();
-	void run_asio();
+	void shutdown();
 	void handle_resolve(const boost::system::error_code         &err,
 	                    boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
 	void handle_connect(const boost::system::error_code &err);
@@ -142,12 +148,15 @@ private: // methods
 	void handle_read_message(const boost::system::error_code &error);
 
 private: // members
-	bool                           connected_;
-	std::mutex                     asio_mutex_;
-	boost::asio::io_service        io_service_;
-	boost::asio::ip::tcp::resolver resolver_;
-	boost::asio::ip::tcp::socket   socket_;
-	boost::asio::io_service::work  io_service_work_;
+	bool                            connected_;
+	std::mutex                      asio_mutex_;
+	std::unique_ptr<AsioExecutor>   own_executor_;
+	boost::asio::io_service        &io_service_;
+	boost::asio::io_service::strand strand_;
+	boost::asio::ip::tcp::resolver  resolver_;
+	boost::asio::ip::tcp::socket    socket_;
+	HandlerTracker                  handler_tracker_;
+	std::atomic<bool>               shutdown_;
 
 	boost::signals2::signal<void(uint16_t, uint16_t, std::shared_ptr<google::protobuf::Message>)>
 	                                                                 sig_rcvd_;
@@ -155,8 +164,6 @@ private: // members
 	boost::signals2::signal<void()>                                  sig_connected_;
 	boost::signals2::signal<void(const boost::system::error_code &)> sig_disconnected_;
 
-	std::thread asio_thread_;
-
 	std::queue<QueueEntry *> outbound_queue_;
 	std::mutex               outbound_mutex_;
 	bool                     outbound_active_;
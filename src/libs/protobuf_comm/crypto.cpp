@@ -41,7 +41,6 @@
 #ifdef HAVE_LIBCRYPTO
 #	include <openssl/evp.h>
 #	include <openssl/rand.h>
-#	include <openssl/sha.h>
 
 #	include <cstring>
 #endif
@@ -52,7 +51,12 @@ namespace protobuf_comm {
 #endif
 
 /** @class BufferEncryptor <protobuf_comm/crypto.h>
- * Encrypt buffers using AES128 in ECB mode.
+ * Encrypt buffers using AES in ECB or CBC mode.
+ * The cipher context is created once and re-initialized for each buffer.
+ * For CBC, each buffer gets a fresh IV which is generated by encrypting a
+ * message counter with the cipher key in ECB mode. The counter starts at a
+ * random value. This yields unpredictable IVs (NIST SP 800-38A, Appendix C)
+ * at the cost of a single block encryption instead of a hash per buffer.
  * @author Tim Niemueller
  */
 
@@ -63,6 +67,7 @@ namespace protobuf_comm {
  * aes-128-ecb, aes-128-cbc, aes-256-ecb, and aes-256-cbc
  */
 BufferEncryptor::BufferEncryptor(const std::string &key, std::string cipher_name)
+: key_(NULL), ctx_(NULL), iv_ctx_(NULL)
 {
 	cipher_    = cipher_by_name(cipher_name.c_str());
 	cipher_id_ = cipher_name_to_id(cipher_name.c_str());
@@ -73,20 +78,65 @@ BufferEncryptor::BufferEncryptor(const std::string &key, std::string cipher_name
 	unsigned char iv[iv_size];
 	if (!EVP_BytesToKey(
 	      cipher_, EVP_sha256(), NULL, (const unsigned char *)key.c_str(), key.size(), 8, key_, iv)) {
+		free(key_);
 		throw std::runtime_error("Failed to generate key");
 	}
 
 	if (!RAND_bytes((unsigned char *)&iv_, sizeof(iv_))) {
+		free(key_);
 		throw std::runtime_error("Failed to generate IV");
 	}
+
+	ctx_ = EVP_CIPHER_CTX_new();
+	if (!ctx_ || !EVP_EncryptInit_ex(ctx_, cipher_, NULL, key_, NULL)) {
+		EVP_CIPHER_CTX_free(ctx_);
+		free(key_);
+		throw std::runtime_error("Could not initialize cipher context");
+	}
+
+	if (iv_size > 0) {
+		const EVP_CIPHER *iv_cipher = (key_size == 16) ? EVP_aes_128_ecb() : EVP_aes_256_ecb();
+		iv_ctx_                     = EVP_CIPHER_CTX_new();
+		if (!iv_ctx_ || !EVP_EncryptInit_ex(iv_ctx_, iv_cipher, NULL, key_, NULL)) {
+			EVP_CIPHER_CTX_free(iv_ctx_);
+			EVP_CIPHER_CTX_free(ctx_);
+			free(key_);
+			throw std::runtime_error("Could not initialize IV cipher context");
+		}
+		EVP_CIPHER_CTX_set_padding(iv_ctx_, 0);
+	}
 }
 
 /** Destructor. */
 BufferEncryptor::~BufferEncryptor()
 {
+	EVP_CIPHER_CTX_free(iv_ctx_);
+	EVP_CIPHER_CTX_free(ctx_);
 	free(key_);
 }
 
+/** Generate IV for the next buffer.
+ * @param iv upon return contains the IV
+ * @param iv_size size of the IV, at most one cipher block
+ */
+void
+BufferEncryptor::generate_iv(unsigned char *iv, size_t iv_size)
+{
+	const int     block_size = EVP_CIPHER_CTX_block_size(iv_ctx_);
+	unsigned char block[EVP_MAX_BLOCK_LENGTH];
+	unsigned char out[EVP_MAX_BLOCK_LENGTH];
+
+	iv_ += 1;
+	memset(block, 0, sizeof(block));
+	memcpy(block, &iv_, sizeof(iv_));
+
+	int outl = 0;
+	if (!EVP_EncryptUpdate(iv_ctx_, out, &outl, block, block_size) || outl != block_size) {
+		throw std::runtime_error("Failed to generate IV");
+	}
+	memcpy(iv, out, iv_size);
+}
+
 /** Encrypt a buffer.
  * Uses the cipher set in the constructor.
  * @param plain plain text data
@@ -96,43 +146,33 @@ void
 BufferEncryptor::encrypt(const std::string &plain, std::string &enc)
 {
 #ifdef HAVE_LIBCRYPTO
-	const EVP_CIPHER *evp_cipher = cipher_by_id(cipher_id_);
-
-	const size_t  iv_size = EVP_CIPHER_iv_length(evp_cipher);
-	unsigned char iv_hash[SHA256_DIGEST_LENGTH];
+	const size_t  iv_size = EVP_CIPHER_iv_length(cipher_);
+	unsigned char iv[EVP_MAX_IV_LENGTH];
 
 	unsigned char *enc_m = (unsigned char *)enc.c_str();
 
 	if (iv_size > 0) {
-		iv_ += 1;
-
-		if (!SHA256((unsigned char *)&iv_, sizeof(iv_), iv_hash)) {
-			throw std::runtime_error("Failed to generate IV");
-		}
-		enc.replace(0, iv_size, (char *)iv_hash, iv_size);
+		generate_iv(iv, iv_size);
+		enc.replace(0, iv_size, (char *)iv, iv_size);
 		enc_m += iv_size;
 	}
 
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	if (!EVP_EncryptInit(ctx, evp_cipher, key_, iv_hash)) {
-		EVP_CIPHER_CTX_free(ctx);
+	// keeps cipher and key, only resets the state and sets the IV
+	if (!EVP_EncryptInit_ex(ctx_, NULL, NULL, NULL, iv_size > 0 ? iv : NULL)) {
 		throw std::runtime_error("Could not initialize cipher context");
 	}
 
 	int outl = enc.size() - iv_size;
-	if (!EVP_EncryptUpdate(ctx, enc_m, &outl, (unsigned char *)plain.c_str(), plain.size())) {
-		EVP_CIPHER_CTX_free(ctx);
+	if (!EVP_EncryptUpdate(ctx_, enc_m, &outl, (unsigned char *)plain.c_str(), plain.size())) {
 		throw std::runtime_error("EncryptUpdate failed");
 	}
 
 	int plen = 0;
-	if (!EVP_EncryptFinal_ex(ctx, enc_m + outl, &plen)) {
-		EVP_CIPHER_CTX_free(ctx);
+	if (!EVP_EncryptFinal_ex(ctx_, enc_m + outl, &plen)) {
 		throw std::runtime_error("EncryptFinal failed");
 	}
 	outl += plen;
 
-	EVP_CIPHER_CTX_free(ctx);
 	enc.resize(outl + iv_size);
 #else
 	throw std::runtime_error("Encryption support not available");
@@ -147,10 +187,8 @@ size_t
 BufferEncryptor::encrypted_buffer_size(size_t plain_length)
 {
 #ifdef HAVE_LIBCRYPTO
-	const EVP_CIPHER *evp_cipher = cipher_by_id(cipher_id_);
-
-	const size_t iv_size    = EVP_CIPHER_iv_length(evp_cipher);
-	size_t       block_size = EVP_CIPHER_block_size(evp_cipher);
+	const size_t iv_size    = EVP_CIPHER_iv_length(cipher_);
+	size_t       block_size = EVP_CIPHER_block_size(cipher_);
 
 	return (((plain_length / block_size) + 1) * block_size) + iv_size;
 #else
@@ -160,6 +198,8 @@ BufferEncryptor::encrypted_buffer_size(size_t plain_length)
 
 /** @class BufferDecryptor <protobuf_comm/crypto.h>
  * Decrypt buffers encrypted with BufferEncryptor.
+ * A cipher context is created for each cipher on first use and is
+ * re-initialized for each buffer.
  * @author Tim Niemueller
  */
 
@@ -174,17 +214,30 @@ BufferDecryptor::BufferDecryptor(const std::string &key) : key_(key)
 /** Destructor. */
 BufferDecryptor::~BufferDecryptor()
 {
+	for (auto &c : ctxs_) {
+		EVP_CIPHER_CTX_free(c.second);
+	}
 }
 
-void
-BufferDecryptor::generate_key(int cipher)
+/** Get cipher context for the given cipher.
+ * The key is derived and the context is created on first use.
+ * @param cipher cipher ID
+ * @return cipher context initialized with cipher and key
+ */
+EVP_CIPHER_CTX *
+BufferDecryptor::context(int cipher)
 {
+	auto c = ctxs_.find(cipher);
+	if (c != ctxs_.end()) {
+		return c->second;
+	}
+
 	const EVP_CIPHER *evp_cipher = cipher_by_id(cipher);
 
-	const size_t   key_size = EVP_CIPHER_key_length(evp_cipher);
-	const size_t   iv_size  = EVP_CIPHER_iv_length(evp_cipher);
-	unsigned char *key      = (unsigned char *)malloc(key_size);
-	unsigned char  iv[iv_size];
+	const size_t  key_size = EVP_CIPHER_key_length(evp_cipher);
+	const size_t  iv_size  = EVP_CIPHER_iv_length(evp_cipher);
+	unsigned char key[key_size];
+	unsigned char iv[iv_size];
 	if (!EVP_BytesToKey(evp_cipher,
 	                    EVP_sha256(),
 	                    NULL,
@@ -193,14 +246,17 @@ BufferDecryptor::generate_key(int cipher)
 	                    8,
 	                    key,
 	                    iv)) {
-		free(key);
 		throw std::runtime_error("Failed to generate key");
 	}
 
-	std::string ks((const char *)key, key_size);
-	free(key);
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || !EVP_DecryptInit_ex(ctx, evp_cipher, NULL, key, NULL)) {
+		EVP_CIPHER_CTX_free(ctx);
+		throw std::runtime_error("Could not initialize cipher context");
+	}
 
-	keys_[cipher] = ks;
+	ctxs_[cipher] = ctx;
+	return ctx;
 }
 
 /** Decrypt a buffer.
@@ -220,44 +276,64 @@ BufferDecryptor::decrypt(int         cipher,
                          size_t      plain_size)
 {
 #ifdef HAVE_LIBCRYPTO
-	if (keys_.find(cipher) == keys_.end()) {
-		generate_key(cipher);
-	}
-
-	const EVP_CIPHER *evp_cipher = cipher_by_id(cipher);
+	EVP_CIPHER_CTX *ctx = context(cipher);
 
-	const size_t         iv_size = EVP_CIPHER_iv_length(evp_cipher);
+	const size_t         iv_size = EVP_CIPHER_CTX_iv_length(ctx);
 	const unsigned char *iv      = (const unsigned char *)enc;
 	unsigned char       *enc_m   = (unsigned char *)enc + iv_size;
 	enc_size -= iv_size;
 
-	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-	if (!EVP_DecryptInit(ctx, evp_cipher, (const unsigned char *)keys_[cipher].c_str(), iv)) {
-		EVP_CIPHER_CTX_free(ctx);
+	// keeps cipher and key, only resets the state and sets the IV
+	if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv_size > 0 ? iv : NULL)) {
 		throw std::runtime_error("Could not initialize cipher context");
 	}
 
 	int outl = plain_size;
 	if (!EVP_DecryptUpdate(ctx, (unsigned char *)plain, &outl, enc_m, enc_size)) {
-		EVP_CIPHER_CTX_free(ctx);
 		throw std::runtime_error("DecryptUpdate failed");
 	}
 
 	int plen = 0;
-	if (!EVP_DecryptFinal(ctx, (unsigned char *)plain + outl, &plen)) {
-		EVP_CIPHER_CTX_free(ctx);
+	if (!EVP_DecryptFinal_ex(ctx, (unsigned char *)plain + outl, &plen)) {
 		throw std::runtime_error("DecryptFinal failed");
 	}
 	outl += plen;
 
-	EVP_CIPHER_CTX_free(ctx);
-
 	return outl;
 #else
 	throw std::runtime_error("Decryption support not available");
 #endif
 }
 
+/** Decrypt a buffer in place.
+ * The plain text is written over the cipher text, no second buffer is
+ * needed. Since the IV precedes the cipher text, the plain text starts
+ * after the IV and not at the beginning of the buffer.
+ * @param cipher cipher ID
+ * @param buffer buffer containing the IV and encrypted data, on return
+ * contains the plain text data at offset @p plain_offset
+ * @param enc_size number of encrypted bytes in @p buffer, including the IV
+ * @param plain_offset upon return, offset of the plain text in @p buffer
+ * @return number of plain text bytes
+ */
+size_t
+BufferDecryptor::decrypt_in_place(int cipher, void *buffer, size_t enc_size, size_t &plain_offset)
+{
+#ifdef HAVE_LIBCRYPTO
+	const size_t iv_size = EVP_CIPHER_CTX_iv_length(context(cipher));
+	if (enc_size < iv_size) {
+		throw std::runtime_error("Encrypted buffer shorter than IV");
+	}
+
+	// in and out pointers are identical, which OpenSSL allows, only
+	// partially overlapping buffers are rejected
+	plain_offset = iv_size;
+	return decrypt(cipher, buffer, enc_size, (unsigned char *)buffer + iv_size, enc_size - iv_size);
+#else
+	throw std::runtime_error("Decryption support not available");
+#endif
+}
+
 /** Get cipher name for PB_ENCRYPTION_* constants.
  * @param cipher cipher ID
  * @return string representing the cipher
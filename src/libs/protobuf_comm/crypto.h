@@ -67,11 +67,16 @@ public:
 
 	size_t encrypted_buffer_size(size_t plain_length);
 
+private:
+	void generate_iv(unsigned char *iv, size_t iv_size);
+
 private:
 	unsigned char         *key_;
 	long long unsigned int iv_;
 
 	const EVP_CIPHER *cipher_;
+	EVP_CIPHER_CTX   *ctx_;
+	EVP_CIPHER_CTX   *iv_ctx_;
 
 	int cipher_id_;
 };
@@ -83,13 +88,14 @@ public:
 	~BufferDecryptor();
 
 	size_t decrypt(int cipher, const void *enc, size_t enc_size, void *plain, size_t plain_size);
+	size_t decrypt_in_place(int cipher, void *buffer, size_t enc_size, size_t &plain_offset);
 
 private:
-	void generate_key(int cipher);
+	EVP_CIPHER_CTX *context(int cipher);
 
 private:
-	std::string                key_;
-	std::map<int, std::string> keys_;
+	std::string                     key_;
+	std::map<int, EVP_CIPHER_CTX *> ctxs_;
 };
 
 const char *cipher_name_by_id(int cipher);
@@ -0,0 +1,128 @@
+
+/***************************************************************************
+ *  executor.cpp - Protobuf stream protocol - shared ASIO executor
+ *
+ *  Created: Fri Oct 16 18:05:31 2026
+ *
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <protobuf_comm/executor.h>
+
+namespace protobuf_comm {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+/** @class AsioExecutor <protobuf_comm/executor.h>
+ * Thread pool running an ASIO I/O service.
+ * Stream servers, clients, and broadcast peers can either run their own
+ * single-threaded executor, or share one executor with multiple threads.
+ * In the latter case, receiving, decryption, and deserialization of
+ * different connections and peers run in parallel. Each endpoint (and each
+ * server session) dispatches its handlers through its own strand, so that
+ * messages of one connection are still processed in order. Signal handlers
+ * connected to endpoints on a shared executor must therefore be thread-safe.
+ *
+ * All endpoints using an executor must be destroyed before the executor.
+ */
+
+/** Constructor.
+ * The threads are started immediately and keep running until the
+ * executor is destroyed.
+ * @param num_threads number of threads to run the I/O service, at least one
+ * thread is always started
+ */
+AsioExecutor::AsioExecutor(unsigned int num_threads)
+: work_(new boost::asio::io_service::work(io_service_))
+{
+	if (num_threads == 0)
+		num_threads = 1;
+
+	for (unsigned int i = 0; i < num_threads; ++i) {
+		threads_.push_back(std::thread([this]() { this->io_service_.run(); }));
+	}
+}
+
+/** Destructor. */
+AsioExecutor::~AsioExecutor()
+{
+	work_.reset();
+	io_service_.stop();
+	for (std::thread &t : threads_) {
+		t.join();
+	}
+}
+
+/** @class HandlerTracker <protobuf_comm/executor.h>
+ * Track pending completion handlers of an endpoint.
+ * Handlers of an endpoint may still be queued on a shared executor when
+ * the endpoint is destroyed. The endpoint therefore wraps all handlers
+ * that reference it. On destruction, it closes its sockets, which aborts
+ * all pending operations, and then waits until all wrapped handlers have
+ * run and been destroyed.
+ */
+
+/** Constructor. */
+HandlerTracker::HandlerTracker()
+: released_(false),
+  token_(this, [](void *tracker) { static_cast<HandlerTracker *>(tracker)->release(); })
+{
+}
+
+/** Destructor.
+ * Waits for wrapped handlers if wait() has not been called before.
+ */
+HandlerTracker::~HandlerTracker()
+{
+	wait();
+}
+
+void
+HandlerTracker::release()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	released_ = true;
+	released_cond_.notify_all();
+}
+
+/** Wait for all wrapped handlers to be destroyed.
+ * No handlers may be wrapped after this has been called.
+ */
+void
+HandlerTracker::wait()
+{
+	// the last copy of the token, possibly held by a handler, notifies us
+	token_.reset();
+	std::unique_lock<std::mutex> lock(mutex_);
+	released_cond_.wait(lock, [this] { return released_; });
+}
+
+} // end namespace protobuf_comm
@@ -0,0 +1,117 @@
+
+/***************************************************************************
+ *  executor.h - Protobuf stream protocol - shared ASIO executor
+ *
+ *  Created: Fri Oct 16 18:05:31 2026
+ *
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROTOBUF_COMM_EXECUTOR_H_
+#define __PROTOBUF_COMM_EXECUTOR_H_
+
+#include <boost/asio.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace protobuf_comm {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+class AsioExecutor
+{
+public:
+	AsioExecutor(unsigned int num_threads = 1);
+	~AsioExecutor();
+
+	/** Get I/O service run by this executor.
+   * @return I/O service */
+	boost::asio::io_service &
+	io_service()
+	{
+		return io_service_;
+	}
+
+	/** Get number of threads running the I/O service.
+   * @return number of threads */
+	unsigned int
+	num_threads() const
+	{
+		return threads_.size();
+	}
+
+private:
+	boost::asio::io_service                        io_service_;
+	std::unique_ptr<boost::asio::io_service::work> work_;
+	std::vector<std::thread>                       threads_;
+};
+
+class HandlerTracker
+{
+public:
+	HandlerTracker();
+	~HandlerTracker();
+
+	/** Wrap a completion handler.
+   * The returned handler behaves like @p handler and keeps the tracker
+   * informed that it has not been destroyed, yet.
+   * @param handler handler to wrap
+   * @return tracked handler
+   */
+	template <typename Handler>
+	auto
+	wrap(Handler handler)
+	{
+		std::shared_ptr<void> token = token_;
+		return [token, handler](auto &&...args) mutable {
+			handler(std::forward<decltype(args)>(args)...);
+		};
+	}
+
+	void wait();
+
+private:
+	void release();
+
+private:
+	std::mutex              mutex_;
+	std::condition_variable released_cond_;
+	bool                    released_;
+	std::shared_ptr<void>   token_;
+};
+
+} // end namespace protobuf_comm
+
+#endif
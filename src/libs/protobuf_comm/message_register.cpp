@@ -53,12 +53,23 @@ namespace protobuf_comm {
  * The register is used to automatically parse incoming messages to the
  * appropriate type. In your application, you need to register any
  * message you want to read. All unknown messages are silently dropped.
+ *
+ * Messages returned by deserialize() are recycled. Once the last reference
+ * to such a message is released, it is cleared and kept in a small per-type
+ * free list instead of being deleted. The next message of the same type
+ * is parsed into it, re-using the memory already allocated for strings and
+ * repeated fields. Releasing a message after the register has been
+ * destroyed simply deletes it.
  * @author Tim Niemueller
  */
 
+/** Default number of recycled messages kept per message type. */
+static const size_t DEFAULT_MAX_RECYCLED = 16;
+
 /** Constructor. */
-MessageRegister::MessageRegister()
+MessageRegister::MessageRegister() : recycle_pool_(std::make_shared<RecyclePool>())
 {
+	recycle_pool_->max_per_type = DEFAULT_MAX_RECYCLED;
 	pb_srctree_  = NULL;
 	pb_importer_ = NULL;
 	pb_factory_  = NULL;
@@ -70,7 +81,9 @@ MessageRegister::MessageRegister()
  * message creation.
  */
 MessageRegister::MessageRegister(std::vector<std::string> &proto_path)
+: recycle_pool_(std::make_shared<RecyclePool>())
 {
+	recycle_pool_->max_per_type = DEFAULT_MAX_RECYCLED;
 	pb_srctree_ = new google::protobuf::compiler::DiskSourceTree();
 	for (size_t i = 0; i < proto_path.size(); ++i) {
 		pb_srctree_->MapPath("", proto_path[i]);
@@ -109,6 +122,9 @@ MessageRegister::MessageRegister(std::vector<std::string> &proto_path)
 /** Destructor. */
 MessageRegister::~MessageRegister()
 {
+	// recycled messages may be dynamic messages which must be deleted
+	// before the factory that created them
+	recycle_pool_.reset();
 	TypeMap::iterator m;
 	for (m = message_by_comp_type_.begin(); m != message_by_comp_type_.end(); ++m) {
 		delete m->second;
@@ -180,6 +196,41 @@ MessageRegister::remove_message_type(uint16_t component_id, uint16_t msg_type)
 		message_by_typename_.erase(message_by_comp_type_[key]->GetDescriptor()->full_name());
 		message_by_comp_type_.erase(key);
 	}
+
+	std::lock_guard<std::mutex> pool_lock(recycle_pool_->mutex);
+	auto                        f = recycle_pool_->free.find(key);
+	if (f != recycle_pool_->free.end()) {
+		for (google::protobuf::Message *m : f->second) {
+			delete m;
+		}
+		recycle_pool_->free.erase(f);
+	}
+}
+
+/** Get component ID and message type for a message type.
+ * The values are read from the CompType enum of the message type. The
+ * result is cached per descriptor, so that the reflection lookup is only
+ * performed once per message type.
+ * @param desc descriptor of the message type
+ * @return pair of component ID and message type
+ * @exception std::logic_error thrown if the message has no valid CompType enum
+ */
+MessageRegister::KeyType
+MessageRegister::comp_type(const google::protobuf::Descriptor *desc)
+{
+	{
+		std::lock_guard<std::mutex> lock(comp_type_mutex_);
+		CompTypeMap::const_iterator c = comp_type_by_desc_.find(desc);
+		if (c != comp_type_by_desc_.end()) {
+			return c->second;
+		}
+	}
+
+	KeyType key = key_from_desc(desc);
+
+	std::lock_guard<std::mutex> lock(comp_type_mutex_);
+	comp_type_by_desc_[desc] = key;
+	return key;
 }
 
 MessageRegister::KeyType
@@ -296,7 +347,7 @@ MessageRegister::deserialize(frame_header_t   &frame_header,
 	uint16_t msg_type  = ntohs(message_header.msg_type);
 	size_t   data_size = ntohl(frame_header.payload_size) - sizeof(message_header);
 
-	std::shared_ptr<google::protobuf::Message> m = new_message_for(comp_id, msg_type);
+	std::shared_ptr<google::protobuf::Message> m = recycled_message_for(comp_id, msg_type);
 	if (!m->ParseFromArray(data, data_size)) {
 		throw std::runtime_error("Failed to parse message");
 	}
@@ -304,4 +355,79 @@ MessageRegister::deserialize(frame_header_t   &frame_header,
 	return m;
 }
 
+/** Set maximum number of recycled messages per message type.
+ * Messages released in excess of this number are deleted. Already
+ * recycled messages are kept even if the new limit is lower.
+ * @param max_per_type maximum number of cleared messages kept per message
+ * type, 0 disables recycling
+ */
+void
+MessageRegister::set_max_recycled(size_t max_per_type)
+{
+	std::lock_guard<std::mutex> lock(recycle_pool_->mutex);
+	recycle_pool_->max_per_type = max_per_type;
+}
+
+/** Get a message instance for deserialization.
+ * A previously released message of the given type is returned if one is
+ * available, otherwise a new message is created. The returned pointer
+ * hands the message back to the recycle pool once the last reference is
+ * released.
+ * @param component_id ID of component this message type belongs to
+ * @param msg_type message type
+ * @return empty message of the given type
+ */
+std::shared_ptr<google::protobuf::Message>
+MessageRegister::recycled_message_for(uint16_t component_id, uint16_t msg_type)
+{
+	KeyType                    key(component_id, msg_type);
+	google::protobuf::Message *m = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(recycle_pool_->mutex);
+		auto                        f = recycle_pool_->free.find(key);
+		if (f != recycle_pool_->free.end() && !f->second.empty()) {
+			m = f->second.back();
+			f->second.pop_back();
+		}
+	}
+
+	if (!m) {
+		std::lock_guard<std::mutex> lock(maps_mutex_);
+		TypeMap::iterator           t = message_by_comp_type_.find(key);
+		if (t == message_by_comp_type_.end()) {
+			std::string msg = "Message type " + std::to_string(component_id) + ":"
+			                  + std::to_string(msg_type) + " not registered";
+			throw std::runtime_error(msg);
+		}
+		m = t->second->New();
+	}
+
+	std::weak_ptr<RecyclePool> weak_pool(recycle_pool_);
+	auto recycle = [weak_pool, key](google::protobuf::Message *msg) {
+		std::shared_ptr<RecyclePool> pool = weak_pool.lock();
+		if (pool) {
+			msg->Clear();
+			std::lock_guard<std::mutex>               lock(pool->mutex);
+			std::vector<google::protobuf::Message *> &free_list = pool->free[key];
+			if (free_list.size() < pool->max_per_type) {
+				free_list.push_back(msg);
+				return;
+			}
+		}
+		delete msg;
+	};
+	return std::shared_ptr<google::protobuf::Message>(m, recycle);
+}
+
+/** Destructor, deletes all messages kept for recycling. */
+MessageRegister::RecyclePool::~RecyclePool()
+{
+	for (auto &f : free) {
+		for (google::protobuf::Message *m : f.second) {
+			delete m;
+		}
+	}
+}
+
 } // end namespace protobuf_comm
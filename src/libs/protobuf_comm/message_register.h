@@ -50,6 +50,8 @@
 #include <mutex>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace google {
 namespace protobuf {
@@ -68,6 +70,9 @@ namespace protobuf_comm {
 class MessageRegister : boost::noncopyable
 {
 public:
+	/** Pair of component ID and message type. */
+	typedef std::pair<uint16_t, uint16_t> KeyType;
+
 	MessageRegister();
 	MessageRegister(std::vector<std::string> &proto_path);
 	~MessageRegister();
@@ -118,6 +123,19 @@ public:
 
 	void remove_message_type(uint16_t component_id, uint16_t msg_type);
 
+	KeyType comp_type(const google::protobuf::Descriptor *desc);
+
+	/** Get component ID and message type of a message.
+   * @param m message to get the CompType for
+   * @return pair of component ID and message type
+   * @exception std::logic_error thrown if the message has no valid CompType enum
+   */
+	KeyType
+	comp_type(const google::protobuf::Message &m)
+	{
+		return comp_type(m.GetDescriptor());
+	}
+
 	std::shared_ptr<google::protobuf::Message> new_message_for(uint16_t component_id,
 	                                                           uint16_t msg_type);
 
@@ -132,6 +150,8 @@ public:
 	std::shared_ptr<google::protobuf::Message>
 	deserialize(frame_header_t &frame_header, message_header_t &message_header, void *data);
 
+	void set_max_recycled(size_t max_per_type);
+
 	/** Mapping from message type to load error message. */
 	typedef std::multimap<std::string, std::string> LoadFailMap;
 
@@ -147,17 +167,35 @@ public:
 	}
 
 private: // members
-	typedef std::pair<uint16_t, uint16_t>                      KeyType;
-	typedef std::map<KeyType, google::protobuf::Message *>     TypeMap;
-	typedef std::map<std::string, google::protobuf::Message *> TypeNameMap;
+	typedef std::map<KeyType, google::protobuf::Message *>                      TypeMap;
+	typedef std::map<std::string, google::protobuf::Message *>                  TypeNameMap;
+	typedef std::unordered_map<const google::protobuf::Descriptor *, KeyType> CompTypeMap;
 
 	KeyType                    key_from_desc(const google::protobuf::Descriptor *desc);
 	google::protobuf::Message *create_msg(std::string &msg_type);
 
+	std::shared_ptr<google::protobuf::Message> recycled_message_for(uint16_t component_id,
+	                                                                uint16_t msg_type);
+
+	/** Cleared messages kept for reuse by deserialize(). */
+	struct RecyclePool
+	{
+		~RecyclePool();
+
+		std::mutex                                                  mutex;
+		size_t                                                      max_per_type;
+		std::map<KeyType, std::vector<google::protobuf::Message *>> free;
+	};
+
 	std::mutex  maps_mutex_;
 	TypeMap     message_by_comp_type_;
 	TypeNameMap message_by_typename_;
 
+	std::mutex  comp_type_mutex_;
+	CompTypeMap comp_type_by_desc_;
+
+	std::shared_ptr<RecyclePool> recycle_pool_;
+
 	google::protobuf::compiler::DiskSourceTree *pb_srctree_;
 	google::protobuf::compiler::Importer       *pb_importer_;
 	google::protobuf::MessageFactory           *pb_factory_;
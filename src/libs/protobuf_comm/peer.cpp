@@ -59,7 +59,9 @@ namespace protobuf_comm {
  * @param port IPv4 UDP port to listen on and to send to
  */
 ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address, unsigned short port)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), port))
 {
@@ -79,7 +81,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address, unsigned
 ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              unsigned short    send_to_port,
                                              unsigned short    recv_on_port)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port))
 {
@@ -96,7 +100,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
 ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string         address,
                                              unsigned short            port,
                                              std::vector<std::string> &proto_path)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), port))
 {
@@ -118,7 +124,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string         address,
                                              unsigned short            send_to_port,
                                              unsigned short            recv_on_port,
                                              std::vector<std::string> &proto_path)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port))
 {
@@ -135,7 +143,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string         address,
 ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              unsigned short    port,
                                              MessageRegister  *mr)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), port)),
   message_register_(mr),
@@ -156,7 +166,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              unsigned short    recv_on_port,
                                              const std::string crypto_key,
                                              const std::string cipher)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port))
 {
@@ -179,7 +191,38 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              MessageRegister  *mr,
                                              const std::string crypto_key,
                                              const std::string cipher)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  resolver_(io_service_),
+  socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port)),
+  message_register_(mr),
+  own_message_register_(false)
+{
+	ctor(address, send_to_port, crypto_key, cipher);
+}
+
+/** Constructor with shared executor.
+ * The peer does not run its own thread, but dispatches its handlers
+ * through a strand on the given executor. Signal handlers may therefore
+ * be invoked concurrently with those of other endpoints on the executor.
+ * @param address IPv4 broadcast address to send to
+ * @param send_to_port IPv4 UDP port to send data to
+ * @param recv_on_port IPv4 UDP port to receive data on
+ * @param mr message register to query for message types
+ * @param executor executor to run I/O on, must outlive the peer
+ * @param crypto_key encryption key for messages, empty to disable encryption
+ * @param cipher cipher to use for encryption
+ */
+ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
+                                             unsigned short    send_to_port,
+                                             unsigned short    recv_on_port,
+                                             MessageRegister  *mr,
+                                             AsioExecutor     *executor,
+                                             const std::string crypto_key,
+                                             const std::string cipher)
+: io_service_(executor->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port)),
   message_register_(mr),
@@ -198,7 +241,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              unsigned short    port,
                                              const std::string crypto_key,
                                              const std::string cipher)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), port))
 {
@@ -219,7 +264,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string address,
                                              MessageRegister  *mr,
                                              const std::string crypto_key,
                                              const std::string cipher)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), port)),
   message_register_(mr),
@@ -243,7 +290,9 @@ ProtobufBroadcastPeer::ProtobufBroadcastPeer(const std::string      address,
                                              unsigned short         recv_on_port,
                                              MessageRegister       *mr,
                                              frame_header_version_t header_version)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   resolver_(io_service_),
   socket_(io_service_, ip::udp::endpoint(ip::udp::v4(), recv_on_port)),
   message_register_(mr),
@@ -266,6 +315,7 @@ ProtobufBroadcastPeer::ctor(const std::string     &address,
                             const std::string      cipher,
                             frame_header_version_t header_version)
 {
+	shutdown_             = false;
 	filter_self_          = true;
 	crypto_               = false;
 	crypto_enc_           = NULL;
@@ -274,7 +324,6 @@ ProtobufBroadcastPeer::ctor(const std::string     &address,
 
 	in_data_size_ = max_packet_length;
 	in_data_      = malloc(in_data_size_);
-	enc_in_data_  = NULL;
 
 	socket_.set_option(socket_base::broadcast(true));
 	socket_.set_option(socket_base::reuse_address(true));
@@ -283,28 +332,23 @@ ProtobufBroadcastPeer::ctor(const std::string     &address,
 	outbound_active_ = true;
 	ip::udp::resolver::query query(address, boost::lexical_cast<std::string>(send_to_port));
 	resolver_.async_resolve(query,
-	                        boost::bind(&ProtobufBroadcastPeer::handle_resolve,
-	                                    this,
-	                                    boost::asio::placeholders::error,
-	                                    boost::asio::placeholders::iterator));
+	                        strand_.wrap(handler_tracker_.wrap(
+	                          boost::bind(&ProtobufBroadcastPeer::handle_resolve,
+	                                      this,
+	                                      boost::asio::placeholders::error,
+	                                      boost::asio::placeholders::iterator))));
 
 	if (!crypto_key.empty())
 		setup_crypto(crypto_key, cipher);
 
 	start_recv();
-	asio_thread_ = std::thread(&ProtobufBroadcastPeer::run_asio, this);
 }
 
 /** Destructor. */
 ProtobufBroadcastPeer::~ProtobufBroadcastPeer()
 {
-	if (asio_thread_.joinable()) {
-		io_service_.stop();
-		asio_thread_.join();
-	}
+	shutdown();
 	free(in_data_);
-	if (enc_in_data_)
-		free(enc_in_data_);
 	if (own_message_register_) {
 		delete message_register_;
 	}
@@ -338,13 +382,6 @@ ProtobufBroadcastPeer::setup_crypto(const std::string &key, const std::string &c
 
 	if (key != "" && cipher != "") {
 		crypto_enc_ = new BufferEncryptor(key, cipher);
-
-		if (!enc_in_data_) {
-			// this depends on the cipher, but nothing is two times the incoming buffer...
-			enc_in_data_size_ = 2 * in_data_size_;
-			enc_in_data_      = malloc(enc_in_data_size_);
-		}
-
 		crypto_dec_ = new BufferDecryptor(key);
 		crypto_     = true;
 		crypto_buf_ = false;
@@ -381,25 +418,32 @@ ProtobufBroadcastPeer::set_filter_self(bool filter)
 	filter_self_ = filter;
 }
 
-/** ASIO thread runnable. */
+/** Stop all I/O operations.
+ * Pending operations are aborted and their handlers are waited for, such
+ * that no handler references this peer after returning.
+ */
 void
-ProtobufBroadcastPeer::run_asio()
+ProtobufBroadcastPeer::shutdown()
 {
-#if BOOST_ASIO_VERSION > 100409
-	while (!io_service_.stopped()) {
-#endif
-		usleep(0);
-		io_service_.reset();
-		io_service_.run();
-#if BOOST_ASIO_VERSION > 100409
-	}
-#endif
+	shutdown_ = true;
+
+	strand_.dispatch(handler_tracker_.wrap([this]() {
+		boost::system::error_code err;
+		resolver_.cancel();
+		socket_.close(err);
+	}));
+
+	handler_tracker_.wait();
+	own_executor_.reset();
 }
 
 void
 ProtobufBroadcastPeer::handle_resolve(const boost::system::error_code &err,
                                       ip::udp::resolver::iterator      endpoint_iterator)
 {
+	if (shutdown_)
+		return;
+
 	if (!err) {
 		std::lock_guard<std::mutex> lock(outbound_mutex_);
 		outbound_active_   = false;
@@ -413,6 +457,9 @@ ProtobufBroadcastPeer::handle_resolve(const boost::system::error_code &err,
 void
 ProtobufBroadcastPeer::handle_recv(const boost::system::error_code &error, size_t bytes_rcvd)
 {
+	if (shutdown_)
+		return;
+
 	const size_t expected_min_size = (frame_header_version_ == PB_FRAME_V1)
 	                                   ? sizeof(frame_header_v1_t)
 	                                   : (sizeof(frame_header_t) + sizeof(message_header_t));
@@ -420,6 +467,9 @@ ProtobufBroadcastPeer::handle_recv(const boost::system::error_code &error, size_
 	if (!error && bytes_rcvd >= expected_min_size) {
 		frame_header_t frame_header;
 		size_t         header_size;
+		// offset of the message header from the start of in_data_, moves
+		// behind the IV if the message is decrypted in place
+		size_t payload_offset = sizeof(frame_header_t);
 		if (frame_header_version_ == PB_FRAME_V1) {
 			frame_header_v1_t *frame_header_v1 = static_cast<frame_header_v1_t *>(in_data_);
 			frame_header.header_version        = PB_FRAME_V1;
@@ -427,20 +477,13 @@ ProtobufBroadcastPeer::handle_recv(const boost::system::error_code &error, size_
 			frame_header.payload_size          = frame_header_v1->payload_size;
 			header_size                        = sizeof(frame_header_v1_t);
 		} else {
-			memcpy(&frame_header, crypto_buf_ ? enc_in_data_ : in_data_, sizeof(frame_header_t));
+			memcpy(&frame_header, in_data_, sizeof(frame_header_t));
 			header_size = sizeof(frame_header_t);
 
-			if (crypto_buf_) {
-				sig_rcvd_raw_(in_endpoint_,
-				              frame_header,
-				              (unsigned char *)enc_in_data_ + sizeof(frame_header_t),
-				              bytes_rcvd - sizeof(frame_header_t));
-			} else {
-				sig_rcvd_raw_(in_endpoint_,
-				              frame_header,
-				              (unsigned char *)in_data_ + sizeof(frame_header_t),
-				              bytes_rcvd - sizeof(frame_header_t));
-			}
+			sig_rcvd_raw_(in_endpoint_,
+			              frame_header,
+			              (unsigned char *)in_data_ + sizeof(frame_header_t),
+			              bytes_rcvd - sizeof(frame_header_t));
 
 			if (sig_rcvd_.num_slots() > 0) {
 				if (!crypto_buf_ && (frame_header.cipher != PB_ENCRYPTION_NONE)) {
@@ -449,18 +492,19 @@ ProtobufBroadcastPeer::handle_recv(const boost::system::error_code &error, size_
 					sig_recv_error_(in_endpoint_, "Received plain text message but encryption is enabled");
 				} else {
 					if (crypto_buf_ && (frame_header.cipher != PB_ENCRYPTION_NONE)) {
-						// we need to decrypt first
+						// we need to decrypt first, the plain text overwrites the cipher text
 						try {
-							memcpy(in_data_, enc_in_data_, sizeof(frame_header_t));
 							size_t to_decrypt = bytes_rcvd - sizeof(frame_header_t);
+							size_t iv_size    = 0;
 							bytes_rcvd =
-							  crypto_dec_->decrypt(frame_header.cipher,
-							                       (unsigned char *)enc_in_data_ + sizeof(frame_header_t),
-							                       to_decrypt,
-							                       (unsigned char *)in_data_ + sizeof(frame_header_t),
-							                       in_data_size_);
+							  crypto_dec_->decrypt_in_place(frame_header.cipher,
+							                                (unsigned char *)in_data_ + sizeof(frame_header_t),
+							                                to_decrypt,
+							                                iv_size);
 							frame_header.payload_size = htonl(bytes_rcvd);
-							bytes_rcvd += sizeof(frame_header_t);
+							payload_offset += iv_size;
+							header_size += iv_size;
+							bytes_rcvd += header_size;
 						} catch (std::runtime_error &e) {
 							sig_recv_error_(in_endpoint_, std::string("Decryption fail: ") + e.what());
 							bytes_rcvd = 0;
@@ -491,10 +535,10 @@ ProtobufBroadcastPeer::handle_recv(const boost::system::error_code &error, size_
 						  htonl(ntohl(frame_header.payload_size) + sizeof(message_header_t));
 					} else {
 						message_header_t *msg_header =
-						  static_cast<message_header_t *>((void *)((char *)in_data_ + sizeof(frame_header_t)));
+						  static_cast<message_header_t *>((void *)((char *)in_data_ + payload_offset));
 						message_header.component_id = msg_header->component_id;
 						message_header.msg_type     = msg_header->msg_type;
-						data = (char *)in_data_ + sizeof(frame_header_t) + sizeof(message_header_t);
+						data = (char *)in_data_ + payload_offset + sizeof(message_header_t);
 					}
 
 					uint16_t comp_id  = ntohs(message_header.component_id);
@@ -528,6 +572,9 @@ ProtobufBroadcastPeer::handle_sent(const boost::system::error_code &error,
 {
 	delete entry;
 
+	if (shutdown_)
+		return;
+
 	{
 		std::lock_guard<std::mutex> lock(outbound_mutex_);
 		outbound_active_ = false;
@@ -637,38 +684,21 @@ ProtobufBroadcastPeer::send(std::shared_ptr<google::protobuf::Message> m)
 void
 ProtobufBroadcastPeer::send(google::protobuf::Message &m)
 {
-	const google::protobuf::Descriptor     *desc     = m.GetDescriptor();
-	const google::protobuf::EnumDescriptor *enumdesc = desc->FindEnumTypeByName("CompType");
-	if (!enumdesc) {
-		throw std::logic_error("Message does not have CompType enum");
-	}
-	const google::protobuf::EnumValueDescriptor *compdesc = enumdesc->FindValueByName("COMP_ID");
-	const google::protobuf::EnumValueDescriptor *msgtdesc = enumdesc->FindValueByName("MSG_TYPE");
-	if (!compdesc || !msgtdesc) {
-		throw std::logic_error("Message CompType enum hs no COMP_ID or MSG_TYPE value");
-	}
-	int comp_id  = compdesc->number();
-	int msg_type = msgtdesc->number();
-	if (comp_id < 0 || comp_id > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid COMP_ID");
-	}
-	if (msg_type < 0 || msg_type > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid MSG_TYPE");
-	}
-
-	send(comp_id, msg_type, m);
+	MessageRegister::KeyType key = message_register_->comp_type(m);
+	send(key.first, key.second, m);
 }
 
 void
 ProtobufBroadcastPeer::start_recv()
 {
 	crypto_buf_ = crypto_;
-	socket_.async_receive_from(boost::asio::buffer(crypto_ ? enc_in_data_ : in_data_, in_data_size_),
+	socket_.async_receive_from(boost::asio::buffer(in_data_, in_data_size_),
 	                           in_endpoint_,
-	                           boost::bind(&ProtobufBroadcastPeer::handle_recv,
-	                                       this,
-	                                       boost::asio::placeholders::error,
-	                                       boost::asio::placeholders::bytes_transferred));
+	                           strand_.wrap(handler_tracker_.wrap(
+	                             boost::bind(&ProtobufBroadcastPeer::handle_recv,
+	                                         this,
+	                                         boost::asio::placeholders::error,
+	                                         boost::asio::placeholders::bytes_transferred))));
 }
 
 void
@@ -711,11 +741,12 @@ ProtobufBroadcastPeer::start_send()
 
 	socket_.async_send_to(entry->buffers,
 	                      outbound_endpoint_,
-	                      boost::bind(&ProtobufBroadcastPeer::handle_sent,
-	                                  this,
-	                                  boost::asio::placeholders::error,
-	                                  boost::asio::placeholders::bytes_transferred,
-	                                  entry));
+	                      strand_.wrap(handler_tracker_.wrap(
+	                        boost::bind(&ProtobufBroadcastPeer::handle_sent,
+	                                    this,
+	                                    boost::asio::placeholders::error,
+	                                    boost::asio::placeholders::bytes_transferred,
+	                                    entry))));
 }
 
 } // end namespace protobuf_comm
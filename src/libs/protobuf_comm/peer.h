@@ -38,15 +38,17 @@
 #define __PROTOBUF_COMM_PEER_H_
 
 #include <google/protobuf/message.h>
+#include <protobuf_comm/executor.h>
 #include <protobuf_comm/frame_header.h>
 #include <protobuf_comm/message_register.h>
 #include <protobuf_comm/queue_entry.h>
 
 #include <boost/asio.hpp>
+#include <atomic>
 #include <boost/signals2.hpp>
+#include <memory>
 #include <mutex>
 #include <queue>
-#include <thread>
 
 namespace protobuf_comm {
 #if 0 /* just to make Emacs auto-indent happy */
@@ -98,6 +100,13 @@ public:
 	                      MessageRegister  *mr,
 	                      const std::string crypto_key,
 	                      const std::string cipher = "aes-128-ecb");
+	ProtobufBroadcastPeer(const std::string address,
+	                      unsigned short    send_to_port,
+	                      unsigned short    recv_on_port,
+	                      MessageRegister  *mr,
+	                      AsioExecutor     *executor,
+	                      const std::string crypto_key = "",
+	                      const std::string cipher     = "aes-128-ecb");
 	~ProtobufBroadcastPeer();
 
 	void set_filter_self(bool filter);
@@ -184,7 +193,7 @@ private: // methods
 	          const std::string  cipher     = "aes-128-ecb",
 	          frame_header_version_t        = PB_FRAME_V2);
 	void determine_local_endpoints();
-	void run_asio();
+	void shutdown();
 	void start_send();
 	void start_recv();
 	void handle_resolve(const boost::system::error_code         &err,
@@ -195,9 +204,13 @@ private: // methods
 	void handle_recv(const boost::system::error_code &error, size_t bytes_rcvd);
 
 private: // members
-	boost::asio::io_service        io_service_;
-	boost::asio::ip::udp::resolver resolver_;
-	boost::asio::ip::udp::socket   socket_;
+	std::unique_ptr<AsioExecutor>   own_executor_;
+	boost::asio::io_service        &io_service_;
+	boost::asio::io_service::strand strand_;
+	boost::asio::ip::udp::resolver  resolver_;
+	boost::asio::ip::udp::socket    socket_;
+	HandlerTracker                  handler_tracker_;
+	std::atomic<bool>               shutdown_;
 
 	std::list<boost::asio::ip::udp::endpoint> local_endpoints_;
 
@@ -216,13 +229,10 @@ private: // members
 	boost::asio::ip::udp::endpoint in_endpoint_;
 
 	void  *in_data_;
-	void  *enc_in_data_;
 	size_t in_data_size_;
-	size_t enc_in_data_size_;
 
 	bool filter_self_;
 
-	std::thread      asio_thread_;
 	MessageRegister *message_register_;
 	bool             own_message_register_;
 
@@ -0,0 +1,178 @@
+/***************************************************************************
+ *  qa_comp_type.cpp - protobuf_comm CompType lookup check and benchmark
+ *
+ *  Created: Fri Oct 16 10:12:37 2026
+ *
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <msgs/AgentTask.pb.h>
+#include <msgs/BeaconSignal.pb.h>
+#include <msgs/ExplorationInfo.pb.h>
+#include <msgs/GameInfo.pb.h>
+#include <msgs/GameState.pb.h>
+#include <msgs/MachineCommands.pb.h>
+#include <msgs/MachineInfo.pb.h>
+#include <msgs/MachineReport.pb.h>
+#include <msgs/OrderInfo.pb.h>
+#include <msgs/RingInfo.pb.h>
+#include <msgs/RobotInfo.pb.h>
+#include <msgs/Time.pb.h>
+#include <msgs/VersionInfo.pb.h>
+#include <msgs/WorkpieceInfo.pb.h>
+#include <protobuf_comm/message_register.h>
+
+#include <boost/lexical_cast.hpp>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace protobuf_comm;
+using namespace llsf_msgs;
+
+/// @cond QA
+
+static MessageRegister::KeyType
+lookup_reflection(const google::protobuf::Message &m)
+{
+	const google::protobuf::Descriptor     *desc     = m.GetDescriptor();
+	const google::protobuf::EnumDescriptor *enumdesc = desc->FindEnumTypeByName("CompType");
+	const google::protobuf::EnumValueDescriptor *compdesc = enumdesc->FindValueByName("COMP_ID");
+	const google::protobuf::EnumValueDescriptor *msgtdesc = enumdesc->FindValueByName("MSG_TYPE");
+	return MessageRegister::KeyType(compdesc->number(), msgtdesc->number());
+}
+
+/** Register a message type and compare its cached CompType to reflection.
+ * The cached lookup is checked twice, once filling the cache and once
+ * answered from it.
+ * @param mr message register to check
+ * @return number of mismatches
+ */
+template <class MT>
+static unsigned int
+check_type(MessageRegister &mr)
+{
+	MT m;
+	mr.add_message_type<MT>();
+	MessageRegister::KeyType expected = lookup_reflection(m);
+	unsigned int             failures = 0;
+	for (unsigned int i = 0; i < 2; ++i) {
+		MessageRegister::KeyType key = mr.comp_type(m.GetDescriptor());
+		if (key != expected) {
+			printf("FAILED: %s is %u:%u, expected %u:%u\n",
+			       m.GetTypeName().c_str(),
+			       key.first,
+			       key.second,
+			       expected.first,
+			       expected.second);
+			++failures;
+		}
+	}
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int iterations = 1000000;
+	if (argc >= 2) {
+		iterations = boost::lexical_cast<unsigned int>(argv[1]);
+	}
+
+	MessageRegister mr;
+	GameState       gs;
+
+	unsigned int failures = 0;
+	failures += check_type<AgentTask>(mr);
+	failures += check_type<BeaconSignal>(mr);
+	failures += check_type<ExplorationInfo>(mr);
+	failures += check_type<GameInfo>(mr);
+	failures += check_type<GameState>(mr);
+	failures += check_type<SetGameState>(mr);
+	failures += check_type<SetGamePhase>(mr);
+	failures += check_type<SetTeamName>(mr);
+	failures += check_type<SetMachineState>(mr);
+	failures += check_type<MachineInfo>(mr);
+	failures += check_type<MachineReport>(mr);
+	failures += check_type<OrderInfo>(mr);
+	failures += check_type<RingInfo>(mr);
+	failures += check_type<RobotInfo>(mr);
+	failures += check_type<VersionInfo>(mr);
+	failures += check_type<WorkpieceInfo>(mr);
+
+	// a message without CompType must be rejected, also on repeated lookups
+	for (unsigned int i = 0; i < 2; ++i) {
+		try {
+			mr.comp_type(Time().GetDescriptor());
+			printf("FAILED: Time has no CompType, but lookup succeeded\n");
+			++failures;
+		} catch (std::logic_error &e) {
+		}
+	}
+
+	if (failures > 0) {
+		printf("%u CompType checks FAILED\n", failures);
+		google::protobuf::ShutdownProtobufLibrary();
+		return 1;
+	}
+	printf("Cached CompType matches reflection for all types\n");
+
+	unsigned long sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; ++i) {
+		MessageRegister::KeyType key = lookup_reflection(gs);
+		sum += key.first + key.second;
+	}
+	auto                          end      = std::chrono::steady_clock::now();
+	std::chrono::duration<double> refl_sec = end - start;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; ++i) {
+		MessageRegister::KeyType key = mr.comp_type(gs);
+		sum += key.first + key.second;
+	}
+	end                                     = std::chrono::steady_clock::now();
+	std::chrono::duration<double> cache_sec = end - start;
+
+	printf("Iterations: %u (checksum %lu)\n", iterations, sum);
+	printf("Reflection: %8.3f ms  (%6.1f ns/lookup)\n",
+	       refl_sec.count() * 1000.,
+	       refl_sec.count() * 1e9 / iterations);
+	printf("Cached:     %8.3f ms  (%6.1f ns/lookup)\n",
+	       cache_sec.count() * 1000.,
+	       cache_sec.count() * 1e9 / iterations);
+
+	// Delete all global objects allocated by libprotobuf
+	google::protobuf::ShutdownProtobufLibrary();
+	return 0;
+}
+
+/// @endcond
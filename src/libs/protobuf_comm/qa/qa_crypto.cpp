@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  qa_crypto.cpp - protobuf_comm encryption throughput benchmark
+ *
+ *  Created: Fri Oct 16 16:40:12 2026
+ *
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <protobuf_comm/crypto.h>
+
+#include <boost/lexical_cast.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace protobuf_comm;
+
+/// @cond QA
+
+int
+main(int argc, char **argv)
+{
+	unsigned int iterations = 100000;
+	if (argc >= 2) {
+		iterations = boost::lexical_cast<unsigned int>(argv[1]);
+	}
+
+	// typical sizes: beacon, team broadcast (MachineInfo/OrderInfo), max UDP payload
+	const size_t sizes[]   = {64, 512, 1400};
+	const char  *ciphers[] = {"aes-128-ecb", "aes-128-cbc", "aes-256-ecb", "aes-256-cbc"};
+
+	const std::string key = "randomkey";
+
+	printf("Iterations: %u per cipher and size\n", iterations);
+	printf("%-12s %6s %12s %10s %12s %10s\n",
+	       "cipher",
+	       "bytes",
+	       "enc ns/msg",
+	       "enc MB/s",
+	       "dec ns/msg",
+	       "dec MB/s");
+
+	for (const char *cipher : ciphers) {
+		BufferEncryptor enc(key, cipher);
+		BufferDecryptor dec(key);
+
+		for (size_t size : sizes) {
+			std::string plain(size, '\0');
+			for (size_t i = 0; i < size; ++i) {
+				plain[i] = (char)(i * 7);
+			}
+			std::string encrypted;
+			std::string decrypted(size + 32, '\0');
+
+			auto start = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < iterations; ++i) {
+				encrypted.resize(enc.encrypted_buffer_size(plain.size()));
+				enc.encrypt(plain, encrypted);
+			}
+			std::chrono::duration<double> enc_sec = std::chrono::steady_clock::now() - start;
+
+			size_t dec_size = 0;
+			start           = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < iterations; ++i) {
+				dec_size = dec.decrypt(enc.cipher_id(),
+				                       encrypted.data(),
+				                       encrypted.size(),
+				                       &decrypted[0],
+				                       decrypted.size());
+			}
+			std::chrono::duration<double> dec_sec = std::chrono::steady_clock::now() - start;
+
+			if (dec_size != size || memcmp(decrypted.data(), plain.data(), size) != 0) {
+				printf("%s: round trip for %zu bytes FAILED\n", cipher, size);
+				return 1;
+			}
+
+			double mb = (double)size * iterations / (1024. * 1024.);
+			printf("%-12s %6zu %12.1f %10.1f %12.1f %10.1f\n",
+			       cipher,
+			       size,
+			       enc_sec.count() * 1e9 / iterations,
+			       mb / enc_sec.count(),
+			       dec_sec.count() * 1e9 / iterations,
+			       mb / dec_sec.count());
+		}
+	}
+
+	return 0;
+}
+
+/// @endcond
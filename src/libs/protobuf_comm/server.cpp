@@ -62,7 +62,7 @@ namespace protobuf_comm {
 ProtobufStreamServer::Session::Session(ClientID                 id,
                                        ProtobufStreamServer    *parent,
                                        boost::asio::io_service &io_service)
-: id_(id), parent_(parent), socket_(io_service)
+: id_(id), parent_(parent), strand_(io_service), socket_(io_service)
 {
 	in_data_size_    = 1024;
 	in_data_         = malloc(in_data_size_);
@@ -97,9 +97,10 @@ ProtobufStreamServer::Session::start_read()
 {
 	boost::asio::async_read(socket_,
 	                        boost::asio::buffer(&in_frame_header_, sizeof(frame_header_t)),
-	                        boost::bind(&ProtobufStreamServer::Session::handle_read_header,
-	                                    shared_from_this(),
-	                                    boost::asio::placeholders::error));
+	                        strand_.wrap(parent_->handler_tracker_.wrap(
+	                          boost::bind(&ProtobufStreamServer::Session::handle_read_header,
+	                                      shared_from_this(),
+	                                      boost::asio::placeholders::error))));
 }
 
 /** Send a message.
@@ -112,18 +113,17 @@ ProtobufStreamServer::Session::send(uint16_t                   component_id,
                                     uint16_t                   msg_type,
                                     google::protobuf::Message &m)
 {
-	QueueEntry *entry = new QueueEntry();
-	parent_->message_register().serialize(component_id,
-	                                      msg_type,
-	                                      m,
-	                                      entry->frame_header,
-	                                      entry->message_header,
-	                                      entry->serialized_message);
-
-	entry->buffers[0] = boost::asio::buffer(&entry->frame_header, sizeof(frame_header_t));
-	entry->buffers[1] = boost::asio::buffer(&entry->message_header, sizeof(message_header_t));
-	entry->buffers[2] = boost::asio::buffer(entry->serialized_message);
+	send(parent_->serialize(component_id, msg_type, m));
+}
 
+/** Send a serialized message.
+ * The entry is only read from, therefore the same entry may be queued
+ * on multiple sessions at the same time.
+ * @param entry queue entry with serialized message
+ */
+void
+ProtobufStreamServer::Session::send(std::shared_ptr<QueueEntry> entry)
+{
 	std::lock_guard<std::mutex> lock(outbound_mutex_);
 	if (outbound_active_) {
 		outbound_queue_.push(entry);
@@ -131,45 +131,56 @@ ProtobufStreamServer::Session::send(uint16_t                   component_id,
 		outbound_active_ = true;
 		boost::asio::async_write(socket_,
 		                         entry->buffers,
-		                         boost::bind(&ProtobufStreamServer::Session::handle_write,
-		                                     shared_from_this(),
-		                                     boost::asio::placeholders::error,
-		                                     boost::asio::placeholders::bytes_transferred,
-		                                     entry));
+		                         strand_.wrap(parent_->handler_tracker_.wrap(
+		                           boost::bind(&ProtobufStreamServer::Session::handle_write,
+		                                       shared_from_this(),
+		                                       boost::asio::placeholders::error,
+		                                       boost::asio::placeholders::bytes_transferred,
+		                                       entry))));
 	}
 }
 
-/** Disconnect from client. */
+/** Disconnect from client.
+ * The socket is closed from within the session's strand, the method
+ * may return before the socket has been closed.
+ */
 void
 ProtobufStreamServer::Session::disconnect()
 {
-	boost::system::error_code err;
-	if (socket_.is_open()) {
-		socket_.shutdown(ip::tcp::socket::shutdown_both, err);
-		socket_.close();
-	}
+	Ptr session = shared_from_this();
+	strand_.dispatch(parent_->handler_tracker_.wrap([session]() {
+		boost::system::error_code err;
+		if (session->socket_.is_open()) {
+			session->socket_.shutdown(ip::tcp::socket::shutdown_both, err);
+			session->socket_.close(err);
+		}
+	}));
 }
 
 /** Write completion handler. */
 void
 ProtobufStreamServer::Session::handle_write(const boost::system::error_code &error,
                                             size_t /*bytes_transferred*/,
-                                            QueueEntry *entry)
+                                            std::shared_ptr<QueueEntry> entry)
 {
-	delete entry;
+	entry.reset();
+
+	if (parent_->shutdown_)
+		return;
 
 	if (!error) {
 		std::lock_guard<std::mutex> lock(outbound_mutex_);
 		if (!outbound_queue_.empty()) {
-			QueueEntry *entry = outbound_queue_.front();
+			std::shared_ptr<QueueEntry> entry = outbound_queue_.front();
 			outbound_queue_.pop();
 			boost::asio::async_write(socket_,
 			                         entry->buffers,
-			                         boost::bind(&ProtobufStreamServer::Session::handle_write,
-			                                     shared_from_this(),
-			                                     boost::asio::placeholders::error,
-			                                     boost::asio::placeholders::bytes_transferred,
-			                                     entry));
+			                         strand_.wrap(parent_->handler_tracker_.wrap(
+			                           boost::bind(&ProtobufStreamServer::Session::handle_write,
+			                                       shared_from_this(),
+			                                       boost::asio::placeholders::error,
+			                                       boost::asio::placeholders::bytes_transferred,
+			                                       entry))));
 		} else {
 			outbound_active_ = false;
 		}
@@ -187,6 +198,9 @@ ProtobufStreamServer::Session::handle_write(const boost::system::error_code &err
 void
 ProtobufStreamServer::Session::handle_read_header(const boost::system::error_code &error)
 {
+	if (parent_->shutdown_)
+		return;
+
 	if (!error) {
 		size_t to_read = ntohl(in_frame_header_.payload_size);
 		if (to_read > in_data_size_) {
@@ -201,9 +215,10 @@ ProtobufStreamServer::Session::handle_read_header(const boost::system::error_cod
 		// setup new read
 		boost::asio::async_read(socket_,
 		                        boost::asio::buffer(in_data_, to_read),
-		                        boost::bind(&ProtobufStreamServer::Session::handle_read_message,
-		                                    shared_from_this(),
-		                                    boost::asio::placeholders::error));
+		                        strand_.wrap(parent_->handler_tracker_.wrap(
+		                          boost::bind(&ProtobufStreamServer::Session::handle_read_message,
+		                                      shared_from_this(),
+		                                      boost::asio::placeholders::error))));
 	} else {
 		parent_->disconnected(shared_from_this(), error);
 	}
@@ -219,6 +234,9 @@ ProtobufStreamServer::Session::handle_read_header(const boost::system::error_cod
 void
 ProtobufStreamServer::Session::handle_read_message(const boost::system::error_code &error)
 {
+	if (parent_->shutdown_)
+		return;
+
 	if (!error) {
 		message_header_t *message_header = static_cast<message_header_t *>(in_data_);
 
@@ -252,16 +270,19 @@ ProtobufStreamServer::Session::handle_read_message(const boost::system::error_co
  * @param port port to listen on
  */
 ProtobufStreamServer::ProtobufStreamServer(unsigned short port)
-: io_service_(), acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port))
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port))
 {
 	message_register_     = new MessageRegister();
 	own_message_register_ = true;
 	next_cid_             = 1;
+	shutdown_             = false;
 
 	acceptor_.set_option(socket_base::reuse_address(true));
 
 	start_accept();
-	asio_thread_ = std::thread(&ProtobufStreamServer::run_asio, this);
 }
 
 /** Constructor.
@@ -272,16 +293,19 @@ ProtobufStreamServer::ProtobufStreamServer(unsigned short port)
  */
 ProtobufStreamServer::ProtobufStreamServer(unsigned short            port,
                                            std::vector<std::string> &proto_path)
-: io_service_(), acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port))
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
+  acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port))
 {
 	message_register_     = new MessageRegister(proto_path);
 	own_message_register_ = true;
 	next_cid_             = 1;
+	shutdown_             = false;
 
 	acceptor_.set_option(socket_base::reuse_address(true));
 
 	start_accept();
-	asio_thread_ = std::thread(&ProtobufStreamServer::run_asio, this);
 }
 
 /** Constructor.
@@ -289,24 +313,52 @@ ProtobufStreamServer::ProtobufStreamServer(unsigned short            port,
  * @param mr message register to use to (de)serialize messages
  */
 ProtobufStreamServer::ProtobufStreamServer(unsigned short port, MessageRegister *mr)
-: io_service_(),
+: own_executor_(new AsioExecutor()),
+  io_service_(own_executor_->io_service()),
+  strand_(io_service_),
   acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port)),
   message_register_(mr),
   own_message_register_(false)
 {
 	next_cid_ = 1;
+	shutdown_ = false;
+
+	acceptor_.set_option(socket_base::reuse_address(true));
+
+	start_accept();
+}
+
+/** Constructor with shared executor.
+ * The server does not run its own thread, but dispatches its handlers
+ * through strands on the given executor, one for accepting connections
+ * and one per client session. Messages of one client are received in
+ * order, but signal handlers may be invoked concurrently for different
+ * clients and for other endpoints on the executor.
+ * @param port port to listen on
+ * @param mr message register to use to (de)serialize messages
+ * @param executor executor to run I/O on, must outlive the server
+ */
+ProtobufStreamServer::ProtobufStreamServer(unsigned short   port,
+                                           MessageRegister *mr,
+                                           AsioExecutor    *executor)
+: io_service_(executor->io_service()),
+  strand_(io_service_),
+  acceptor_(io_service_, ip::tcp::endpoint(ip::tcp::v6(), port)),
+  message_register_(mr),
+  own_message_register_(false)
+{
+	next_cid_ = 1;
+	shutdown_ = false;
 
 	acceptor_.set_option(socket_base::reuse_address(true));
 
 	start_accept();
-	asio_thread_ = std::thread(&ProtobufStreamServer::run_asio, this);
 }
 
 /** Destructor. */
 ProtobufStreamServer::~ProtobufStreamServer()
 {
-	io_service_.stop();
-	asio_thread_.join();
+	shutdown();
 	if (own_message_register_) {
 		delete message_register_;
 	}
@@ -324,6 +376,7 @@ ProtobufStreamServer::send(ClientID                   client,
                            uint16_t                   msg_type,
                            google::protobuf::Message &m)
 {
+	std::lock_guard<std::mutex> lock(sessions_mutex_);
 	if (sessions_.find(client) == sessions_.end()) {
 		throw std::runtime_error("Client does not exist");
 	}
@@ -354,26 +407,9 @@ ProtobufStreamServer::send(ClientID                                   client,
 void
 ProtobufStreamServer::send(ClientID client, google::protobuf::Message &m)
 {
-	const google::protobuf::Descriptor     *desc     = m.GetDescriptor();
-	const google::protobuf::EnumDescriptor *enumdesc = desc->FindEnumTypeByName("CompType");
-	if (!enumdesc) {
-		throw std::logic_error("Message does not have CompType enum");
-	}
-	const google::protobuf::EnumValueDescriptor *compdesc = enumdesc->FindValueByName("COMP_ID");
-	const google::protobuf::EnumValueDescriptor *msgtdesc = enumdesc->FindValueByName("MSG_TYPE");
-	if (!compdesc || !msgtdesc) {
-		throw std::logic_error("Message CompType enum hs no COMP_ID or MSG_TYPE value");
-	}
-	int comp_id  = compdesc->number();
-	int msg_type = msgtdesc->number();
-	if (comp_id < 0 || comp_id > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid COMP_ID");
-	}
-	if (msg_type < 0 || msg_type > std::numeric_limits<uint16_t>::max()) {
-		throw std::logic_error("Message has invalid MSG_TYPE");
-	}
+	MessageRegister::KeyType key = message_register_->comp_type(m);
 
-	send(client, comp_id, msg_type, m);
+	send(client, key.first, key.second, m);
 }
 
 /** Send a message.
@@ -397,9 +433,15 @@ ProtobufStreamServer::send_to_all(uint16_t                   component_id,
                                   uint16_t                   msg_type,
                                   google::protobuf::Message &m)
 {
+	std::lock_guard<std::mutex> lock(sessions_mutex_);
+	if (sessions_.empty())
+		return;
+
+	std::shared_ptr<QueueEntry> entry = serialize(component_id, msg_type, m);
+
 	std::map<ClientID, boost::shared_ptr<Session>>::iterator s;
 	for (s = sessions_.begin(); s != sessions_.end(); ++s) {
-		send(s->first, component_id, msg_type, m);
+		s->second->send(entry);
 	}
 }
 
@@ -413,10 +455,7 @@ ProtobufStreamServer::send_to_all(uint16_t                                   com
                                   uint16_t                                   msg_type,
                                   std::shared_ptr<google::protobuf::Message> m)
 {
-	std::map<ClientID, boost::shared_ptr<Session>>::iterator s;
-	for (s = sessions_.begin(); s != sessions_.end(); ++s) {
-		send(s->first, component_id, msg_type, m);
-	}
+	send_to_all(component_id, msg_type, *m);
 }
 
 /** Send a message to all clients.
@@ -425,10 +464,7 @@ ProtobufStreamServer::send_to_all(uint16_t                                   com
 void
 ProtobufStreamServer::send_to_all(std::shared_ptr<google::protobuf::Message> m)
 {
-	std::map<ClientID, boost::shared_ptr<Session>>::iterator s;
-	for (s = sessions_.begin(); s != sessions_.end(); ++s) {
-		send(s->first, m);
-	}
+	send_to_all(*m);
 }
 
 /** Send a message to all clients.
@@ -437,18 +473,83 @@ ProtobufStreamServer::send_to_all(std::shared_ptr<google::protobuf::Message> m)
 void
 ProtobufStreamServer::send_to_all(google::protobuf::Message &m)
 {
-	std::map<ClientID, boost::shared_ptr<Session>>::iterator s;
-	for (s = sessions_.begin(); s != sessions_.end(); ++s) {
-		send(s->first, m);
+	MessageRegister::KeyType key = message_register_->comp_type(m);
+
+	send_to_all(key.first, key.second, m);
+}
+
+/** Send a message to a number of clients.
+ * The message is serialized only once and shared among the clients.
+ * Unknown client IDs are silently ignored.
+ * @param clients IDs of the clients to address
+ * @param component_id ID of the component to address
+ * @param msg_type numeric message type
+ * @param m message to send
+ */
+void
+ProtobufStreamServer::send(const std::vector<ClientID> &clients,
+                           uint16_t                     component_id,
+                           uint16_t                     msg_type,
+                           google::protobuf::Message   &m)
+{
+	std::lock_guard<std::mutex> lock(sessions_mutex_);
+	std::shared_ptr<QueueEntry> entry;
+	for (ClientID client : clients) {
+		std::map<ClientID, boost::shared_ptr<Session>>::iterator s = sessions_.find(client);
+		if (s != sessions_.end()) {
+			if (!entry) {
+				entry = serialize(component_id, msg_type, m);
+			}
+			s->second->send(entry);
+		}
 	}
 }
 
+/** Send a message to a number of clients.
+ * @param clients IDs of the clients to address
+ * @param m Message to send, the message must have an CompType enum type to
+ * specify component ID and message type.
+ */
+void
+ProtobufStreamServer::send(const std::vector<ClientID> &clients, google::protobuf::Message &m)
+{
+	MessageRegister::KeyType key = message_register_->comp_type(m);
+
+	send(clients, key.first, key.second, m);
+}
+
+/** Serialize a message into a new queue entry.
+ * @param component_id ID of the component to address
+ * @param msg_type numeric message type
+ * @param m message to serialize
+ * @return queue entry ready to be sent to any number of sessions
+ */
+std::shared_ptr<QueueEntry>
+ProtobufStreamServer::serialize(uint16_t                   component_id,
+                                uint16_t                   msg_type,
+                                google::protobuf::Message &m)
+{
+	std::shared_ptr<QueueEntry> entry = std::make_shared<QueueEntry>();
+	message_register_->serialize(component_id,
+	                             msg_type,
+	                             m,
+	                             entry->frame_header,
+	                             entry->message_header,
+	                             entry->serialized_message);
+
+	entry->buffers[0] = boost::asio::buffer(&entry->frame_header, sizeof(frame_header_t));
+	entry->buffers[1] = boost::asio::buffer(&entry->message_header, sizeof(message_header_t));
+	entry->buffers[2] = boost::asio::buffer(entry->serialized_message);
+	return entry;
+}
+
 /** Disconnect specific client.
  * @param client client ID to disconnect from
  */
 void
 ProtobufStreamServer::disconnect(ClientID client)
 {
+	std::lock_guard<std::mutex> lock(sessions_mutex_);
 	if (sessions_.find(client) != sessions_.end()) {
 		boost::shared_ptr<Session> session = sessions_[client];
 		session->disconnect();
@@ -461,17 +562,21 @@ ProtobufStreamServer::start_accept()
 {
 	Session::Ptr new_session(new Session(next_cid_++, this, io_service_));
 	acceptor_.async_accept(new_session->socket(),
-	                       boost::bind(&ProtobufStreamServer::handle_accept,
-	                                   this,
-	                                   new_session,
-	                                   boost::asio::placeholders::error));
+	                       strand_.wrap(
+	                         handler_tracker_.wrap(boost::bind(&ProtobufStreamServer::handle_accept,
+	                                                           this,
+	                                                           new_session,
+	                                                           boost::asio::placeholders::error))));
 }
 
 void
 ProtobufStreamServer::disconnected(boost::shared_ptr<Session>       session,
                                    const boost::system::error_code &error)
 {
-	sessions_.erase(session->id());
+	{
+		std::lock_guard<std::mutex> lock(sessions_mutex_);
+		sessions_.erase(session->id());
+	}
 	sig_disconnected_(session->id(), error);
 }
 
@@ -479,9 +584,15 @@ void
 ProtobufStreamServer::handle_accept(Session::Ptr                     new_session,
                                     const boost::system::error_code &error)
 {
+	if (shutdown_)
+		return;
+
 	if (!error) {
 		new_session->start_session();
-		sessions_[new_session->id()] = new_session;
+		{
+			std::lock_guard<std::mutex> lock(sessions_mutex_);
+			sessions_[new_session->id()] = new_session;
+		}
 		sig_connected_(new_session->id(), new_session->remote_endpoint());
 		new_session->start_read();
 	}
@@ -490,17 +601,23 @@ ProtobufStreamServer::handle_accept(Session::Ptr                     new_session
 }
 
 void
-ProtobufStreamServer::run_asio()
+ProtobufStreamServer::shutdown()
 {
-#if BOOST_ASIO_VERSION > 100409
-	while (!io_service_.stopped()) {
-#endif
-		usleep(0);
-		io_service_.reset();
-		io_service_.run();
-#if BOOST_ASIO_VERSION > 100409
+	shutdown_ = true;
+
+	strand_.dispatch(handler_tracker_.wrap([this]() {
+		boost::system::error_code err;
+		acceptor_.close(err);
+	}));
+	{
+		std::lock_guard<std::mutex> lock(sessions_mutex_);
+		for (auto &s : sessions_) {
+			s.second->disconnect();
+		}
 	}
-#endif
+
+	handler_tracker_.wait();
+	own_executor_.reset();
 }
 
 } // end namespace protobuf_comm
@@ -38,6 +38,7 @@
 #define __PROTOBUF_COMM_SERVER_H_
 
 #include <google/protobuf/message.h>
+#include <protobuf_comm/executor.h>
 #include <protobuf_comm/frame_header.h>
 #include <protobuf_comm/message_register.h>
 #include <protobuf_comm/queue_entry.h>
@@ -50,9 +51,9 @@
 #	define _GLIBCXX_USE_SCHED_YIELD
 #endif
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <queue>
-#include <thread>
 
 namespace protobuf_comm {
 #if 0 /* just to make Emacs auto-indent happy */
@@ -68,6 +69,7 @@ public:
 	ProtobufStreamServer(unsigned short port);
 	ProtobufStreamServer(unsigned short port, std::vector<std::string> &proto_path);
 	ProtobufStreamServer(unsigned short port, MessageRegister *mr);
+	ProtobufStreamServer(unsigned short port, MessageRegister *mr, AsioExecutor *executor);
 	~ProtobufStreamServer();
 
 	void
@@ -86,6 +88,12 @@ public:
 	void send_to_all(std::shared_ptr<google::protobuf::Message> m);
 	void send_to_all(google::protobuf::Message &m);
 
+	void send(const std::vector<ClientID> &clients,
+	          uint16_t                      component_id,
+	          uint16_t                      msg_type,
+	          google::protobuf::Message    &m);
+	void send(const std::vector<ClientID> &clients, google::protobuf::Message &m);
+
 	void disconnect(ClientID client);
 
 	/** Get the server's message register.
@@ -170,6 +178,7 @@ private:
 		void start_session();
 		void start_read();
 		void send(uint16_t component_id, uint16_t msg_type, google::protobuf::Message &m);
+		void send(std::shared_ptr<QueueEntry> entry);
 		void disconnect();
 
 	private:
@@ -177,33 +186,42 @@ private:
 		void handle_read_header(const boost::system::error_code &error);
 		void handle_write(const boost::system::error_code &error,
 		                  size_t /*bytes_transferred*/,
-		                  QueueEntry *entry);
+		                  std::shared_ptr<QueueEntry> entry);
 
 	private:
-		ClientID                       id_;
-		ProtobufStreamServer          *parent_;
-		boost::asio::ip::tcp::socket   socket_;
-		boost::asio::ip::tcp::endpoint remote_endpoint_;
+		ClientID                        id_;
+		ProtobufStreamServer           *parent_;
+		boost::asio::io_service::strand strand_;
+		boost::asio::ip::tcp::socket    socket_;
+		boost::asio::ip::tcp::endpoint  remote_endpoint_;
 
 		frame_header_t in_frame_header_;
 		size_t         in_data_size_;
 		void          *in_data_;
 
-		std::queue<QueueEntry *> outbound_queue_;
-		std::mutex               outbound_mutex_;
-		bool                     outbound_active_;
+		std::queue<std::shared_ptr<QueueEntry>> outbound_queue_;
+		std::mutex                              outbound_mutex_;
+		bool                                    outbound_active_;
 	};
 
 private: // methods
-	void run_asio();
+	std::shared_ptr<QueueEntry> serialize(uint16_t                   component_id,
+	                                      uint16_t                   msg_type,
+	                                      google::protobuf::Message &m);
+
+	void shutdown();
 	void start_accept();
 	void handle_accept(Session::Ptr new_session, const boost::system::error_code &error);
 
 	void disconnected(boost::shared_ptr<Session> session, const boost::system::error_code &error);
 
 private: // members
-	boost::asio::io_service        io_service_;
-	boost::asio::ip::tcp::acceptor acceptor_;
+	std::unique_ptr<AsioExecutor>   own_executor_;
+	boost::asio::io_service        &io_service_;
+	boost::asio::io_service::strand strand_;
+	boost::asio::ip::tcp::acceptor  acceptor_;
+	HandlerTracker                  handler_tracker_;
+	std::atomic<bool>               shutdown_;
 	boost::signals2::signal<
 	  void(ClientID, uint16_t, uint16_t, std::shared_ptr<google::protobuf::Message>)>
 	                                                                           sig_rcvd_;
@@ -211,8 +229,7 @@ private: // members
 	boost::signals2::signal<void(ClientID, boost::asio::ip::tcp::endpoint &)>  sig_connected_;
 	boost::signals2::signal<void(ClientID, const boost::system::error_code &)> sig_disconnected_;
 
-	std::thread asio_thread_;
-
+	std::mutex                                     sessions_mutex_;
 	std::map<ClientID, boost::shared_ptr<Session>> sessions_;
 
 	std::atomic<ClientID> next_cid_;
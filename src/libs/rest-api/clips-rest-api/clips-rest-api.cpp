@@ -26,7 +26,11 @@ extern "C" {
 #include <clips/clips.h>
 }
 #include <core/threading/mutex_locker.h>
+#include <utils/time/tracker.h>
+#include <webview/event_stream.h>
 
+#include <algorithm>
+#include <memory>
 #include <type_traits>
 using namespace fawkes;
 
@@ -38,7 +42,12 @@ using namespace fawkes;
 namespace llsfrb {
 /** Constructor. */
 ClipsRestApi::ClipsRestApi(CLIPS::Environment *env, fawkes::Mutex &env_mutex, Logger *logger)
-: WebviewRestApi("clips", logger), env_(env), env_mutex_(env_mutex), logger_(logger)
+: WebviewRestApi("clips", logger),
+  env_(env),
+  env_mutex_(env_mutex),
+  logger_(logger),
+  latency_tracker_(NULL),
+  game_time_event_interval_(1000)
 {
 	add_handler<WebviewRestArray<Environment>>(WebRequest::METHOD_GET,
 	                                           "/",
@@ -84,23 +93,95 @@ ClipsRestApi::ClipsRestApi(CLIPS::Environment *env, fawkes::Mutex &env_mutex, Lo
 	                                      std::bind(&ClipsRestApi::cb_get_points,
 	                                                this,
 	                                                std::placeholders::_1));
+	add_handler<WebviewRestArray<Latency>>(WebRequest::METHOD_GET,
+	                                       "/latency",
+	                                       std::bind(&ClipsRestApi::cb_get_latency,
+	                                                 this,
+	                                                 std::placeholders::_1));
+
+	// endpoints served from the snapshot only change with the facts of their template
+	static const std::map<std::string, std::string> versioned_paths = {{"/machines", "machine"},
+	                                                                   {"/orders", "order"},
+	                                                                   {"/robots", "robot"},
+	                                                                   {"/game-state", "gamestate"},
+	                                                                   {"/ring-spec", "ring-spec"},
+	                                                                   {"/points", "points"}};
+	for (const auto &p : versioned_paths) {
+		std::string tmpl_name = p.second;
+		set_versioned(WebRequest::METHOD_GET, p.first, [this, tmpl_name]() {
+			return template_version(tmpl_name);
+		});
+	}
 }
 
 /** Destructor. */
 ClipsRestApi::~ClipsRestApi()
 {
+	if (event_stream_) {
+		event_stream_->set_initial_events(nullptr);
+	}
+}
+
+/** Set latency tracker to report on the latency endpoint.
+ * @param tracker latency tracker, NULL to report no values
+ */
+void
+ClipsRestApi::set_latency_tracker(fawkes::LatencyTracker *tracker)
+{
+	latency_tracker_ = tracker;
+}
+
+/** Set stream to push game state changes to.
+ * Whenever a published snapshot changes the game state, machines, or
+ * orders, the new list is sent as "game-state", "machines", or "orders"
+ * event with the snapshot version as event ID. While the game is running
+ * its game time changes on every loop iteration, a game state event is
+ * therefore sent immediately only if another field changed, and otherwise
+ * at most once per game time interval. A new subscriber first receives
+ * all three events built from the current snapshot.
+ * @param event_stream event stream, NULL to disable events
+ * @param game_time_interval minimum time in milliseconds between game
+ * state events that only update the game time
+ */
+void
+ClipsRestApi::set_event_stream(std::shared_ptr<fawkes::WebEventStream> event_stream,
+                               unsigned int                            game_time_interval)
+{
+	if (event_stream_) {
+		event_stream_->set_initial_events(nullptr);
+	}
+	event_stream_             = event_stream;
+	game_time_event_interval_ = std::chrono::milliseconds(game_time_interval);
+	if (event_stream_) {
+		event_stream_->set_initial_events([this]() { return snapshot_events(); });
+	}
+}
+
+/** Get the values of a slot of a snapshot fact.
+ * @param fact snapshot fact
+ * @param slot_name name of field to retrieve
+ * @return slot values
+ */
+static const CLIPS::Values &
+slot_values(const ClipsRestApi::SnapshotFact &fact, const std::string &slot_name)
+{
+	auto s = fact.slots.find(slot_name);
+	if (s == fact.slots.end()) {
+		throw Exception("No slot named '%s'", slot_name.c_str());
+	}
+	return s->second;
 }
 
 /** Get a value from a fact.
- * @param fact pointer to CLIPS fact
+ * @param fact snapshot fact
  * @param slot_name name of field to retrieve
  * @return template-specific return value
  */
 template <typename T>
 T
-get_value(const CLIPS::Fact::pointer &fact, const std::string &slot_name)
+get_value(const ClipsRestApi::SnapshotFact &fact, const std::string &slot_name)
 {
-	CLIPS::Values v = fact->slot_value(slot_name);
+	const CLIPS::Values &v = slot_values(fact, slot_name);
 	if (v.empty()) {
 		throw Exception("No value for slot '%s'", slot_name.c_str());
 	}
@@ -111,15 +192,15 @@ get_value(const CLIPS::Fact::pointer &fact, const std::string &slot_name)
 }
 
 /** Specialization for bool.
- * @param fact pointer to CLIPS fact
+ * @param fact snapshot fact
  * @param slot_name name of field to retrieve
  * @return boolean value
  */
 template <>
 bool
-get_value(const CLIPS::Fact::pointer &fact, const std::string &slot_name)
+get_value(const ClipsRestApi::SnapshotFact &fact, const std::string &slot_name)
 {
-	CLIPS::Values v = fact->slot_value(slot_name);
+	const CLIPS::Values &v = slot_values(fact, slot_name);
 	if (v.empty()) {
 		throw Exception("No value for slot '%s'", slot_name.c_str());
 	}
@@ -133,14 +214,14 @@ get_value(const CLIPS::Fact::pointer &fact, const std::string &slot_name)
  * This is not a template because the overly verbose operator API
  * of CLIPS::Value can lead to ambiguous overloads, e.g., resolving
  * std::string to std::string or const char * operators.
- * @param fact pointer to CLIPS fact
+ * @param fact snapshot fact
  * @param slot_name name of field to retrieve
  * @return vector of strings from multislot
  */
 static std::vector<std::string>
-get_values(const CLIPS::Fact::pointer &fact, const std::string &slot_name)
+get_values(const ClipsRestApi::SnapshotFact &fact, const std::string &slot_name)
 {
-	CLIPS::Values            v = fact->slot_value(slot_name);
+	CLIPS::Values            v = slot_values(fact, slot_name);
 	std::vector<std::string> rv(v.size());
 	for (size_t i = 0; i < v.size(); ++i) {
 		switch (v[i].type()) {
@@ -206,7 +287,7 @@ ClipsRestApi::gen_fact(CLIPS::Fact::pointer &fact, bool formatted)
 }
 
 Machine
-ClipsRestApi::gen_machine(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_machine(const SnapshotFact &fact)
 {
 	Machine m;
 	m.set_name(get_value<std::string>(fact, "name"));
@@ -229,7 +310,7 @@ ClipsRestApi::gen_machine(CLIPS::Fact::pointer &fact)
 }
 
 Order
-ClipsRestApi::gen_order(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_order(const SnapshotFact &fact)
 {
 	Order o;
 	o.set_kind("Order");
@@ -249,7 +330,7 @@ ClipsRestApi::gen_order(CLIPS::Fact::pointer &fact)
 }
 
 Robot
-ClipsRestApi::gen_robot(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_robot(const SnapshotFact &fact)
 {
 	Robot o;
 	o.set_kind("Robot");
@@ -271,7 +352,7 @@ ClipsRestApi::gen_robot(CLIPS::Fact::pointer &fact)
 }
 
 GameState
-ClipsRestApi::gen_game_state(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_game_state(const SnapshotFact &fact)
 {
 	GameState o;
 	o.set_kind("GameState");
@@ -286,7 +367,7 @@ ClipsRestApi::gen_game_state(CLIPS::Fact::pointer &fact)
 }
 
 RingSpec
-ClipsRestApi::gen_ring_spec(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_ring_spec(const SnapshotFact &fact)
 {
 	RingSpec o;
 	o.set_kind("RingSpec");
@@ -297,7 +378,7 @@ ClipsRestApi::gen_ring_spec(CLIPS::Fact::pointer &fact)
 }
 
 Points
-ClipsRestApi::gen_points(CLIPS::Fact::pointer &fact)
+ClipsRestApi::gen_points(const SnapshotFact &fact)
 {
 	Points o;
 	o.set_kind("Points");
@@ -310,36 +391,434 @@ ClipsRestApi::gen_points(CLIPS::Fact::pointer &fact)
 	return o;
 }
 
-bool
-ClipsRestApi::match(CLIPS::Fact::pointer &fact, std::string tmpl_name, WebviewRestParams &params)
+/** Filter on a single slot value as given by a query argument. */
+struct SlotFilter
+{
+	/** Name of the slot to compare. */
+	std::string slot;
+	/** Value the slot must have, in the representation of get_values(). */
+	std::string value;
+};
+
+/** Get slot filters from the query arguments.
+ * The slot names are checked once against the deftemplate instead of
+ * against every single fact.
+ * @param env CLIPS environment
+ * @param tmpl deftemplate the filters apply to
+ * @param tmpl_name name of the deftemplate, for error messages
+ * @param params REST parameters with query arguments
+ * @return slot filters
+ */
+static std::vector<SlotFilter>
+get_slot_filters(void *env, void *tmpl, const std::string &tmpl_name, WebviewRestParams &params)
+{
+	std::map<std::string, std::string> slots_to_match = params.get_query_args();
+
+	std::vector<SlotFilter> rv;
+	rv.reserve(slots_to_match.size());
+	for (const auto &si : slots_to_match) {
+		if (!EnvDeftemplateSlotExistP(env, tmpl, si.first.c_str()))
+			throw Exception("No slot named %s for template %s", si.first.c_str(), tmpl_name.c_str());
+		// for now only single values are allowed as param
+		if (EnvDeftemplateSlotMultiP(env, tmpl, si.first.c_str()))
+			throw Exception("Slot %s for template %s is multifield (not supported)",
+			                si.first.c_str(),
+			                tmpl_name.c_str());
+		rv.push_back(SlotFilter{si.first, si.second});
+	}
+	return rv;
+}
+
+/** Check if a fact matches all slot filters.
+ * This reads the slots through the C API so that facts which do not match
+ * are skipped without wrapping them into a CLIPS::Fact.
+ * @param env CLIPS environment
+ * @param fact CLIPS fact
+ * @param filters slot filters to check
+ * @return true if all filters match, false otherwise
+ */
+static bool
+fact_matches(void *env, void *fact, const std::vector<SlotFilter> &filters)
+{
+	for (const auto &f : filters) {
+		DATA_OBJECT v;
+		if (!EnvGetFactSlot(env, fact, f.slot.c_str(), &v))
+			return false;
+		switch (GetType(v)) {
+		case FLOAT:
+			if (std::to_string(DOToDouble(v)) != f.value)
+				return false;
+			break;
+		case INTEGER:
+			if (std::to_string(DOToLong(v)) != f.value)
+				return false;
+			break;
+		case SYMBOL:
+		case STRING:
+		case INSTANCE_NAME:
+			if (f.value != DOToString(v))
+				return false;
+			break;
+		default: return false;
+		}
+	}
+	return true;
+}
+
+/** Collect all facts of a template which match the query arguments.
+ * Only the facts of the given template are visited using the fact list
+ * CLIPS keeps per deftemplate, rather than walking the whole fact base.
+ * Query arguments are compared against the slot values before the fact
+ * is converted. The environment mutex is held while collecting.
+ * @param tmpl_name name of the deftemplate
+ * @param params REST parameters, query arguments are used as slot filters
+ * @param gen function converting a matching fact to the result type
+ * @return array of converted facts
+ */
+template <typename T, typename F>
+WebviewRestArray<T>
+ClipsRestApi::collect_facts(const std::string &tmpl_name, WebviewRestParams &params, F gen)
+{
+	WebviewRestArray<T> rv;
+
+	MutexLocker lock(&env_mutex_);
+	void       *env  = env_->cobj();
+	void       *tmpl = EnvFindDeftemplate(env, tmpl_name.c_str());
+	if (!tmpl)
+		return rv;
+
+	std::vector<SlotFilter> filters = get_slot_filters(env, tmpl, tmpl_name, params);
+
+	for (void *f = EnvGetNextFactInTemplate(env, tmpl, NULL); f;
+	     f       = EnvGetNextFactInTemplate(env, tmpl, f)) {
+		if (fact_matches(env, f, filters)) {
+			CLIPS::Fact::pointer fact = CLIPS::Fact::create(*env_, f);
+			rv.push_back(gen(fact));
+		}
+	}
+	return rv;
+}
+
+/** Check if a snapshot fact matches the query arguments.
+ * @param fact snapshot fact
+ * @param tmpl_name name of the fact's template, for error messages
+ * @param slots_to_match slot values to match by slot name
+ * @return true if all slots match, false otherwise
+ */
+static bool
+snapshot_fact_matches(const ClipsRestApi::SnapshotFact         &fact,
+                      const std::string                        &tmpl_name,
+                      const std::map<std::string, std::string> &slots_to_match)
+{
+	for (const auto &si : slots_to_match) {
+		if (fact.slots.find(si.first) == fact.slots.end())
+			throw Exception("No slot named %s for template %s", si.first.c_str(), tmpl_name.c_str());
+		std::vector<std::string> v = get_values(fact, si.first);
+		// for now only single values are allowed as param
+		if (v.size() > 1)
+			throw Exception("Slot %s for template %s is multifield (not supported)",
+			                si.first.c_str(),
+			                tmpl_name.c_str());
+		if (v.size() > 0 && v[0] != si.second)
+			return false;
+	}
+	return true;
+}
 
+/** Collect all facts of a template from the current snapshot.
+ * This does not touch the CLIPS environment and does not take its mutex,
+ * readers only hold a reference to the snapshot while converting facts.
+ * @param tmpl_name name of the deftemplate
+ * @param params REST parameters, query arguments are used as slot filters
+ * @param gen function converting a matching snapshot fact to the result type
+ * @return array of converted facts, empty if no snapshot has been published
+ */
+template <typename T, typename F>
+WebviewRestArray<T>
+ClipsRestApi::collect_snapshot_facts(const std::string &tmpl_name,
+                                     WebviewRestParams &params,
+                                     F                  gen)
 {
+	WebviewRestArray<T> rv;
+
+	std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&snapshot_);
+	if (!snapshot)
+		return rv;
+	auto t = snapshot->templates.find(tmpl_name);
+	if (t == snapshot->templates.end())
+		return rv;
+
 	std::map<std::string, std::string> slots_to_match = params.get_query_args();
-	CLIPS::Template::pointer           tmpl           = fact->get_template();
-	if (tmpl->name() != tmpl_name)
+	for (const SnapshotFact &fact : t->second->facts) {
+		if (snapshot_fact_matches(fact, tmpl_name, slots_to_match))
+			rv.push_back(gen(fact));
+	}
+	return rv;
+}
+
+/** Get the version of the facts of a template in the current snapshot.
+ * @param tmpl_name template name
+ * @return version of the snapshot the template's facts last changed at,
+ * 0 if no snapshot of the template has been published
+ */
+uint64_t
+ClipsRestApi::template_version(const std::string &tmpl_name)
+{
+	std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&snapshot_);
+	if (!snapshot)
+		return 0;
+	auto t = snapshot->templates.find(tmpl_name);
+	return (t != snapshot->templates.end()) ? t->second->version : 0;
+}
+
+/** Check if two slot values are equal.
+ * @param a first values
+ * @param b second values
+ * @return true if both have the same types and values, addresses are
+ * never considered equal
+ */
+static bool
+values_equal(const CLIPS::Values &a, const CLIPS::Values &b)
+{
+	if (a.size() != b.size())
 		return false;
-	if (slots_to_match.size() == 0)
-		return true;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].type() != b[i].type())
+			return false;
+		switch (a[i].type()) {
+		case CLIPS::TYPE_FLOAT:
+			if (a[i].as_float() != b[i].as_float())
+				return false;
+			break;
+		case CLIPS::TYPE_INTEGER:
+			if (a[i].as_integer() != b[i].as_integer())
+				return false;
+			break;
+		case CLIPS::TYPE_SYMBOL:
+		case CLIPS::TYPE_STRING:
+		case CLIPS::TYPE_INSTANCE_NAME:
+			if (a[i].as_string() != b[i].as_string())
+				return false;
+			break;
+		default: return false;
+		}
+	}
+	return true;
+}
 
-	std::vector<std::string> slots = fact->slot_names();
-	for (auto &si : slots_to_match) {
-		if (std::find(slots.begin(), slots.end(), si.first) == slots.end())
-			throw Exception("No slot named %s for template %s", si.first.c_str(), tmpl->name().c_str());
-		else {
-			std::vector<std::string> v = get_values(fact, si.first);
-			// for now only single values are allowed as param
-			if (v.size() > 1)
-				throw Exception("Slot %s for template %s is multifield (not supported)",
-				                si.first.c_str(),
-				                tmpl->name().c_str());
-
-			if (v.size() > 0 && v[0] != si.second)
+/** Check if two template snapshots contain the same facts.
+ * Fact indices are ignored, a fact that was modified without changing any
+ * slot is the same fact for readers.
+ * @param a first template snapshot
+ * @param b second template snapshot
+ * @param ignored names of slots whose values are not compared
+ * @return true if both contain facts with equal slot values in the same order
+ */
+static bool
+facts_equal(const ClipsRestApi::TemplateSnapshot &a,
+            const ClipsRestApi::TemplateSnapshot &b,
+            const std::vector<std::string>       &ignored = {})
+{
+	if (a.facts.size() != b.facts.size())
+		return false;
+	for (size_t i = 0; i < a.facts.size(); ++i) {
+		const auto &sa = a.facts[i].slots;
+		const auto &sb = b.facts[i].slots;
+		if (sa.size() != sb.size())
+			return false;
+		for (auto s = sa.begin(), t = sb.begin(); s != sa.end(); ++s, ++t) {
+			if (s->first != t->first)
+				return false;
+			if (!values_equal(s->second, t->second)
+			    && std::find(ignored.begin(), ignored.end(), s->first) == ignored.end())
 				return false;
 		}
 	}
 	return true;
 }
 
+/** Publish a new snapshot of the game state.
+ * Copies the facts served by the typed endpoints into an immutable snapshot
+ * and atomically replaces the current one. Templates whose facts did not
+ * change since the previous snapshot are shared with it rather than copied.
+ * If no template changed, the current snapshot is kept and its version
+ * stays the same. Slots that are updated on every loop iteration but not
+ * served, like the last-time of the game state, are not copied and thus
+ * do not count as change.
+ * This must be called by the game thread with the environment mutex held,
+ * e.g., after running the agenda.
+ * @param version version of the new snapshot, must be larger than that of
+ * the previously published one
+ * @return true if a new snapshot has been published, false if the facts of
+ * all templates are unchanged
+ */
+bool
+ClipsRestApi::publish_snapshot(uint64_t version)
+{
+	static const char *tmpl_names[] =
+	  {"machine", "order", "robot", "gamestate", "ring-spec", "points"};
+	static const std::map<std::string, std::vector<std::string>> ignored_slots = {
+	  {"gamestate", {"last-time"}}};
+
+	std::shared_ptr<const Snapshot> prev     = std::atomic_load(&snapshot_);
+	std::shared_ptr<Snapshot>       snapshot = std::make_shared<Snapshot>();
+	snapshot->version                        = version;
+
+	std::vector<std::string> changed;
+
+	void *env = env_->cobj();
+	for (const char *tmpl_name : tmpl_names) {
+		void *tmpl = EnvFindDeftemplate(env, tmpl_name);
+		if (!tmpl)
+			continue;
+
+		long count = 0, index_sum = 0;
+		for (void *f = EnvGetNextFactInTemplate(env, tmpl, NULL); f;
+		     f       = EnvGetNextFactInTemplate(env, tmpl, f)) {
+			count++;
+			index_sum += EnvFactIndex(env, f);
+		}
+
+		std::shared_ptr<const TemplateSnapshot> prev_ts;
+		if (prev) {
+			auto p = prev->templates.find(tmpl_name);
+			if (p != prev->templates.end())
+				prev_ts = p->second;
+		}
+
+		TemplateSignature &sig = signatures_[tmpl_name];
+		if (prev_ts && sig.count == count && sig.index_sum == index_sum) {
+			snapshot->templates[tmpl_name] = prev_ts;
+			continue;
+		}
+		sig.count     = count;
+		sig.index_sum = index_sum;
+
+		auto                              ignored = ignored_slots.find(tmpl_name);
+		std::shared_ptr<TemplateSnapshot> ts      = std::make_shared<TemplateSnapshot>();
+		ts->version                               = version;
+		ts->facts.reserve(count);
+		for (void *f = EnvGetNextFactInTemplate(env, tmpl, NULL); f;
+		     f       = EnvGetNextFactInTemplate(env, tmpl, f)) {
+			CLIPS::Fact::pointer fact = CLIPS::Fact::create(*env_, f);
+			SnapshotFact         sf;
+			sf.index = fact->index();
+			for (const std::string &slot : fact->slot_names()) {
+				if (ignored != ignored_slots.end()
+				    && std::find(ignored->second.begin(), ignored->second.end(), slot)
+				         != ignored->second.end()) {
+					continue;
+				}
+				sf.slots[slot] = fact->slot_value(slot);
+			}
+			ts->facts.push_back(std::move(sf));
+		}
+
+		// facts were re-asserted, e.g., by a modify, but their values are the same
+		if (prev_ts && facts_equal(*prev_ts, *ts)) {
+			snapshot->templates[tmpl_name] = prev_ts;
+			continue;
+		}
+		changed.push_back(tmpl_name);
+		snapshot->templates[tmpl_name] = std::move(ts);
+	}
+
+	if (prev && changed.empty())
+		return false;
+
+	std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(snapshot));
+
+	if (!event_stream_ || event_stream_->num_subscribers() == 0)
+		return true;
+
+	// only templates rebuilt above have changed, the others are shared with prev
+	for (const std::string &tmpl_name : changed) {
+		std::shared_ptr<const TemplateSnapshot> ts = snapshot->templates[tmpl_name];
+		if (tmpl_name == "gamestate") {
+			auto now = std::chrono::steady_clock::now();
+			if (game_state_event_ && facts_equal(*game_state_event_, *ts, {"game-time", "cont-time"})
+			    && now - game_state_event_time_ < game_time_event_interval_) {
+				continue;
+			}
+			game_state_event_      = ts;
+			game_state_event_time_ = now;
+			event_stream_->publish("game-state",
+			                       event_data<GameState>(*ts,
+			                                             [this](const SnapshotFact &f) {
+				                                             return gen_game_state(f);
+			                                             }),
+			                       version);
+		} else if (tmpl_name == "machine") {
+			event_stream_->publish("machines",
+			                       event_data<Machine>(*ts,
+			                                           [this](const SnapshotFact &f) {
+				                                           return gen_machine(f);
+			                                           }),
+			                       version);
+		} else if (tmpl_name == "order") {
+			event_stream_->publish("orders",
+			                       event_data<Order>(*ts,
+			                                         [this](const SnapshotFact &f) {
+				                                         return gen_order(f);
+			                                         }),
+			                       version);
+		}
+	}
+	return true;
+}
+
+/** Serialize the facts of a template as event payload.
+ * @param facts snapshot of the template's facts
+ * @param gen function converting a snapshot fact to the API type
+ * @return JSON array of the converted facts
+ */
+template <typename T, typename F>
+std::string
+ClipsRestApi::event_data(const TemplateSnapshot &facts, F gen)
+{
+	WebviewRestArray<T> rv;
+	for (const SnapshotFact &fact : facts.facts) {
+		rv.push_back(gen(fact));
+	}
+	return rv.to_json();
+}
+
+/** Get events describing the current snapshot.
+ * Sent to new event stream subscribers. Only reads the published snapshot
+ * and may therefore be called from any thread.
+ * @return game state, machines, and orders events of the current snapshot
+ */
+std::vector<fawkes::WebEventStream::Event>
+ClipsRestApi::snapshot_events()
+{
+	std::vector<fawkes::WebEventStream::Event> rv;
+	std::shared_ptr<const Snapshot>            snapshot = std::atomic_load(&snapshot_);
+	if (!snapshot)
+		return rv;
+
+	for (const auto &t : snapshot->templates) {
+		const TemplateSnapshot &ts = *t.second;
+		if (t.first == "gamestate") {
+			rv.push_back({"game-state",
+			              event_data<GameState>(ts,
+			                                    [this](const SnapshotFact &f) {
+				                                    return gen_game_state(f);
+			                                    }),
+			              snapshot->version});
+		} else if (t.first == "machine") {
+			rv.push_back({"machines",
+			              event_data<Machine>(ts,
+			                                  [this](const SnapshotFact &f) { return gen_machine(f); }),
+			              snapshot->version});
+		} else if (t.first == "order") {
+			rv.push_back({"orders",
+			              event_data<Order>(ts, [this](const SnapshotFact &f) { return gen_order(f); }),
+			              snapshot->version});
+		}
+	}
+	return rv;
+}
+
 WebviewRestArray<Environment>
 ClipsRestApi::cb_list_environments()
 {
@@ -374,89 +853,74 @@ ClipsRestApi::cb_get_facts(WebviewRestParams &params)
 WebviewRestArray<Machine>
 ClipsRestApi::cb_get_machines(WebviewRestParams &params)
 {
-	MutexLocker               lock(&env_mutex_);
-	WebviewRestArray<Machine> rv;
-
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "machine", params))
-			rv.push_back(std::move(gen_machine(fact)));
-		fact = fact->next();
-	}
-	return rv;
+	return collect_snapshot_facts<Machine>("machine", params, [this](const SnapshotFact &fact) {
+		return gen_machine(fact);
+	});
 }
 
 WebviewRestArray<Order>
 ClipsRestApi::cb_get_orders(WebviewRestParams &params)
 {
-	MutexLocker             lock(&env_mutex_);
-	WebviewRestArray<Order> rv;
-
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "order", params))
-			rv.push_back(std::move(gen_order(fact)));
-		fact = fact->next();
-	}
-	return rv;
+	return collect_snapshot_facts<Order>("order", params, [this](const SnapshotFact &fact) {
+		return gen_order(fact);
+	});
 }
 
 WebviewRestArray<Robot>
 ClipsRestApi::cb_get_robots(WebviewRestParams &params)
 {
-	MutexLocker             lock(&env_mutex_);
-	WebviewRestArray<Robot> rv;
-
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "robot", params))
-			rv.push_back(std::move(gen_robot(fact)));
-		fact = fact->next();
-	}
-	return rv;
+	return collect_snapshot_facts<Robot>("robot", params, [this](const SnapshotFact &fact) {
+		return gen_robot(fact);
+	});
 }
 
 WebviewRestArray<GameState>
 ClipsRestApi::cb_get_game_state(WebviewRestParams &params)
 {
-	MutexLocker                 lock(&env_mutex_);
-	WebviewRestArray<GameState> rv;
-
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "gamestate", params))
-			rv.push_back(std::move(gen_game_state(fact)));
-		fact = fact->next();
-	}
-	return rv;
+	return collect_snapshot_facts<GameState>("gamestate", params, [this](const SnapshotFact &fact) {
+		return gen_game_state(fact);
+	});
 }
 
 WebviewRestArray<RingSpec>
 ClipsRestApi::cb_get_ring_spec(WebviewRestParams &params)
 {
-	MutexLocker                lock(&env_mutex_);
-	WebviewRestArray<RingSpec> rv;
-
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "ring-spec", params))
-			rv.push_back(std::move(gen_ring_spec(fact)));
-		fact = fact->next();
-	}
-	return rv;
+	return collect_snapshot_facts<RingSpec>("ring-spec", params, [this](const SnapshotFact &fact) {
+		return gen_ring_spec(fact);
+	});
 }
 
 WebviewRestArray<Points>
 ClipsRestApi::cb_get_points(fawkes::WebviewRestParams &params)
 {
-	MutexLocker              lock(&env_mutex_);
-	WebviewRestArray<Points> rv;
+	return collect_snapshot_facts<Points>("points", params, [this](const SnapshotFact &fact) {
+		return gen_points(fact);
+	});
+}
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "points", params))
-			rv.push_back(std::move(gen_points(fact)));
-		fact = fact->next();
+WebviewRestArray<Latency>
+ClipsRestApi::cb_get_latency(fawkes::WebviewRestParams &params)
+{
+	bool window = (params.query_arg("window") == "true");
+
+	WebviewRestArray<Latency> rv;
+	if (!latency_tracker_)
+		return rv;
+
+	for (unsigned int i = 0; i < latency_tracker_->num_classes(); ++i) {
+		LatencyTracker::Stats s = latency_tracker_->stats(i, window);
+
+		Latency o;
+		o.set_kind("Latency");
+		o.set_apiVersion(Environment::api_version());
+		o.set_name(s.name);
+		o.set_count(s.count);
+		o.set_mean_ms(s.mean_ms);
+		o.set_p50_ms(s.p50_ms);
+		o.set_p90_ms(s.p90_ms);
+		o.set_p99_ms(s.p99_ms);
+		o.set_max_ms(s.max_ms);
+		rv.push_back(std::move(o));
 	}
 	return rv;
 }
@@ -466,38 +930,11 @@ ClipsRestApi::cb_get_facts_by_tmpl_and_slots(WebviewRestParams &params)
 {
 	bool formatted = (params.consum_query_arg("formatted") == "true");
 
-	WebviewRestArray<Fact> rv;
-
-	MutexLocker          lock(&env_mutex_);
-	CLIPS::Fact::pointer fact = env_->get_facts();
-
-	while (fact) {
-		if (match(fact, params.path_arg("tmpl-name"), params))
-			rv.push_back(std::move(gen_fact(fact, formatted)));
-		fact = fact->next();
-	}
-	return rv;
-}
-
-template <typename T>
-WebviewRestArray<T>
-ClipsRestApi::cb_get_tmpl(WebviewRestParams &params, std::string tmpl_name)
-{
-	//	MutexLocker lock(&env_mutex_);
-	//	WebviewRestArray<T> rv;
-	//
-	//	CLIPS::Fact::pointer fact =  env_->get_facts();
-	//	while(fact) {
-	//		 CLIPS::Template::pointer tmpl = fact->get_template();
-	//		 if(tmpl->name() == tmpl_name)
-	//			 if(std::is_same<T, Machine>::value)
-	//			 rv.push_back(std::move(gen_machine(fact)));
-	//             if(std::is_same<T, Order>::value)
-	//			 rv.push_back(std::move(gen_order(fact)));
-	//		 fact = fact->next();
-	//    }
-	//
-	//	return rv;
+	return collect_facts<Fact>(params.path_arg("tmpl-name"),
+	                           params,
+	                           [this, formatted](CLIPS::Fact::pointer &fact) {
+		                           return gen_fact(fact, formatted);
+	                           });
 }
 
 } //end namespace llsfrb
@@ -25,6 +25,7 @@
 #include "model/Environment.h"
 #include "model/Fact.h"
 #include "model/GameState.h"
+#include "model/Latency.h"
 #include "model/Machine.h"
 #include "model/Order.h"
 #include "model/Points.h"
@@ -35,7 +36,15 @@
 #include <webview/rest_api.h>
 #include <webview/rest_array.h>
 
+#include <webview/event_stream.h>
+
 #include <clipsmm.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace fawkes {
 //from fawkes::WebviewAspect
@@ -43,6 +52,7 @@ class WebviewRestApiManager;
 //class WebviewRestArray;
 class WebviewRestParams;
 class WebviewRestApi;
+class LatencyTracker;
 } // namespace fawkes
 
 using namespace fawkes;
@@ -56,6 +66,39 @@ public:
 	ClipsRestApi(CLIPS::Environment *env, fawkes::Mutex &env_mutex, Logger *logger);
 	~ClipsRestApi();
 
+	void set_latency_tracker(fawkes::LatencyTracker *tracker);
+	void set_event_stream(std::shared_ptr<fawkes::WebEventStream> event_stream,
+	                      unsigned int                            game_time_interval = 1000);
+	bool publish_snapshot(uint64_t version);
+
+	/** Copy of a fact taken when publishing a snapshot. */
+	struct SnapshotFact
+	{
+		/** Fact index at the time of the snapshot. */
+		long index;
+		/** Slot values by slot name. */
+		std::map<std::string, CLIPS::Values> slots;
+	};
+
+	/** Facts of a single template.
+	 * Shared between consecutive snapshots while the template's facts are unchanged. */
+	struct TemplateSnapshot
+	{
+		/** Version of the snapshot the facts were copied at. */
+		uint64_t version;
+		/** Copied facts. */
+		std::vector<SnapshotFact> facts;
+	};
+
+	/** Immutable view of the game state published by the game thread. */
+	struct Snapshot
+	{
+		/** Game state version the snapshot was taken at. */
+		uint64_t version;
+		/** Facts by template name. */
+		std::map<std::string, std::shared_ptr<const TemplateSnapshot>> templates;
+	};
+
 private:
 	fawkes::WebviewRestArray<Environment> cb_list_environments();
 	fawkes::WebviewRestArray<Fact>        cb_get_facts(fawkes::WebviewRestParams &params);
@@ -66,23 +109,49 @@ private:
 	fawkes::WebviewRestArray<GameState> cb_get_game_state(fawkes::WebviewRestParams &params);
 	fawkes::WebviewRestArray<RingSpec>  cb_get_ring_spec(fawkes::WebviewRestParams &params);
 	fawkes::WebviewRestArray<Points>    cb_get_points(fawkes::WebviewRestParams &params);
-	template <typename T>
-	fawkes::WebviewRestArray<T> cb_get_tmpl(fawkes::WebviewRestParams &params, std::string tmpl_name);
+	fawkes::WebviewRestArray<Latency>   cb_get_latency(fawkes::WebviewRestParams &params);
 
+	uint64_t  template_version(const std::string &tmpl_name);
 	Fact      gen_fact(CLIPS::Fact::pointer &fact, bool formatted);
-	Machine   gen_machine(CLIPS::Fact::pointer &fact);
-	Order     gen_order(CLIPS::Fact::pointer &fact);
-	Robot     gen_robot(CLIPS::Fact::pointer &fact);
-	GameState gen_game_state(CLIPS::Fact::pointer &fact);
-	RingSpec  gen_ring_spec(CLIPS::Fact::pointer &fact);
-	Points    gen_points(CLIPS::Fact::pointer &fact);
+	Machine   gen_machine(const SnapshotFact &fact);
+	Order     gen_order(const SnapshotFact &fact);
+	Robot     gen_robot(const SnapshotFact &fact);
+	GameState gen_game_state(const SnapshotFact &fact);
+	RingSpec  gen_ring_spec(const SnapshotFact &fact);
+	Points    gen_points(const SnapshotFact &fact);
 
-	bool match(CLIPS::Fact::pointer &fact, std::string tmpl_name, fawkes::WebviewRestParams &params);
+	template <typename T, typename F>
+	fawkes::WebviewRestArray<T>
+	collect_facts(const std::string &tmpl_name, fawkes::WebviewRestParams &params, F gen);
+	template <typename T, typename F>
+	fawkes::WebviewRestArray<T>
+	collect_snapshot_facts(const std::string &tmpl_name, fawkes::WebviewRestParams &params, F gen);
+	template <typename T, typename F>
+	std::string event_data(const TemplateSnapshot &facts, F gen);
+	std::vector<fawkes::WebEventStream::Event> snapshot_events();
 
 private:
 	CLIPS::Environment *env_;
 
-	fawkes::Mutex &env_mutex_;
-	Logger        *logger_;
+	fawkes::Mutex          &env_mutex_;
+	Logger                 *logger_;
+	fawkes::LatencyTracker *latency_tracker_;
+
+	/** Facts a template snapshot was last checked against. */
+	struct TemplateSignature
+	{
+		/** Number of facts. */
+		long count;
+		/** Sum of fact indices, changes whenever a fact is (re)asserted. */
+		long index_sum;
+	};
+
+	std::shared_ptr<const Snapshot>          snapshot_;
+	std::map<std::string, TemplateSignature> signatures_;
+	std::shared_ptr<fawkes::WebEventStream>  event_stream_;
+
+	std::chrono::milliseconds               game_time_event_interval_;
+	std::shared_ptr<const TemplateSnapshot> game_state_event_;
+	std::chrono::steady_clock::time_point   game_state_event_time_;
 };
 } //end namespace llsfrb
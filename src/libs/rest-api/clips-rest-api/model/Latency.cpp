@@ -0,0 +1,216 @@
+
+/****************************************************************************
+ *  Latency
+ *  (auto-generated, do not modify directly)
+ *
+ *  CLIPS REST API.
+ *  Enables access to CLIPS environments.
+ *
+ *  API Contact: Tim Niemueller <niemueller@kbsg.rwth-aachen.de>
+ *  API Version: v1beta1
+ *  API License: Apache 2.0
+ ****************************************************************************/
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#include "Latency.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <sstream>
+
+Latency::Latency()
+{
+}
+
+Latency::Latency(const std::string &json)
+{
+	from_json(json);
+}
+
+Latency::Latency(const rapidjson::Value &v)
+{
+	from_json_value(v);
+}
+
+Latency::~Latency()
+{
+}
+
+std::string
+Latency::to_json(bool pretty) const
+{
+	rapidjson::Document d;
+
+	to_json_value(d, d);
+
+	rapidjson::StringBuffer buffer;
+	if (pretty) {
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		d.Accept(writer);
+	} else {
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		d.Accept(writer);
+	}
+
+	return buffer.GetString();
+}
+
+void
+Latency::to_json_value(rapidjson::Document &d, rapidjson::Value &v) const
+{
+	rapidjson::Document::AllocatorType &allocator = d.GetAllocator();
+	v.SetObject();
+	// Avoid unused variable warnings
+	(void)allocator;
+
+	if (kind_) {
+		rapidjson::Value v_kind;
+		v_kind.SetString(*kind_, allocator);
+		v.AddMember("kind", v_kind, allocator);
+	}
+	if (apiVersion_) {
+		rapidjson::Value v_apiVersion;
+		v_apiVersion.SetString(*apiVersion_, allocator);
+		v.AddMember("apiVersion", v_apiVersion, allocator);
+	}
+	if (name_) {
+		rapidjson::Value v_name;
+		v_name.SetString(*name_, allocator);
+		v.AddMember("name", v_name, allocator);
+	}
+	if (count_) {
+		rapidjson::Value v_count;
+		v_count.SetInt64(*count_);
+		v.AddMember("count", v_count, allocator);
+	}
+	if (mean_ms_) {
+		rapidjson::Value v_mean_ms;
+		v_mean_ms.SetFloat(*mean_ms_);
+		v.AddMember("mean-ms", v_mean_ms, allocator);
+	}
+	if (p50_ms_) {
+		rapidjson::Value v_p50_ms;
+		v_p50_ms.SetFloat(*p50_ms_);
+		v.AddMember("p50-ms", v_p50_ms, allocator);
+	}
+	if (p90_ms_) {
+		rapidjson::Value v_p90_ms;
+		v_p90_ms.SetFloat(*p90_ms_);
+		v.AddMember("p90-ms", v_p90_ms, allocator);
+	}
+	if (p99_ms_) {
+		rapidjson::Value v_p99_ms;
+		v_p99_ms.SetFloat(*p99_ms_);
+		v.AddMember("p99-ms", v_p99_ms, allocator);
+	}
+	if (max_ms_) {
+		rapidjson::Value v_max_ms;
+		v_max_ms.SetFloat(*max_ms_);
+		v.AddMember("max-ms", v_max_ms, allocator);
+	}
+}
+
+void
+Latency::from_json(const std::string &json)
+{
+	rapidjson::Document d;
+	d.Parse(json);
+
+	from_json_value(d);
+}
+
+void
+Latency::from_json_value(const rapidjson::Value &d)
+{
+	if (d.HasMember("kind") && d["kind"].IsString()) {
+		kind_ = d["kind"].GetString();
+	}
+	if (d.HasMember("apiVersion") && d["apiVersion"].IsString()) {
+		apiVersion_ = d["apiVersion"].GetString();
+	}
+	if (d.HasMember("name") && d["name"].IsString()) {
+		name_ = d["name"].GetString();
+	}
+	if (d.HasMember("count") && d["count"].IsInt64()) {
+		count_ = d["count"].GetInt64();
+	}
+	if (d.HasMember("mean-ms") && d["mean-ms"].IsFloat()) {
+		mean_ms_ = d["mean-ms"].GetFloat();
+	}
+	if (d.HasMember("p50-ms") && d["p50-ms"].IsFloat()) {
+		p50_ms_ = d["p50-ms"].GetFloat();
+	}
+	if (d.HasMember("p90-ms") && d["p90-ms"].IsFloat()) {
+		p90_ms_ = d["p90-ms"].GetFloat();
+	}
+	if (d.HasMember("p99-ms") && d["p99-ms"].IsFloat()) {
+		p99_ms_ = d["p99-ms"].GetFloat();
+	}
+	if (d.HasMember("max-ms") && d["max-ms"].IsFloat()) {
+		max_ms_ = d["max-ms"].GetFloat();
+	}
+}
+
+void
+Latency::validate(bool subcall) const
+{
+	std::vector<std::string> missing;
+	if (!kind_) {
+		missing.push_back("kind");
+	}
+	if (!apiVersion_) {
+		missing.push_back("apiVersion");
+	}
+	if (!name_) {
+		missing.push_back("name");
+	}
+	if (!count_) {
+		missing.push_back("count");
+	}
+	if (!mean_ms_) {
+		missing.push_back("mean-ms");
+	}
+	if (!p50_ms_) {
+		missing.push_back("p50-ms");
+	}
+	if (!p90_ms_) {
+		missing.push_back("p90-ms");
+	}
+	if (!p99_ms_) {
+		missing.push_back("p99-ms");
+	}
+	if (!max_ms_) {
+		missing.push_back("max-ms");
+	}
+
+	if (!missing.empty()) {
+		if (subcall) {
+			throw missing;
+		} else {
+			std::ostringstream s;
+			s << "Latency  is missing field" << ((missing.size() > 0) ? "s" : "") << ": ";
+			for (std::vector<std::string>::size_type i = 0; i < missing.size(); ++i) {
+				s << missing[i];
+				if (i < (missing.size() - 1)) {
+					s << ", ";
+				}
+			}
+			throw std::runtime_error(s.str());
+		}
+	}
+}
\ No newline at end of file
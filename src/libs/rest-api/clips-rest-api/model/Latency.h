@@ -0,0 +1,265 @@
+
+/****************************************************************************
+ *  Clips -- Schema Latency
+ *  (auto-generated, do not modify directly)
+ *
+ *  CLIPS REST API.
+ *  Enables access to CLIPS environments.
+ *
+ *  API Contact: Tim Niemueller <niemueller@kbsg.rwth-aachen.de>
+ *  API Version: v1beta1
+ *  API License: Apache 2.0
+ ****************************************************************************/
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. A runtime exception applies to
+ *  this software (see LICENSE.GPL_WRE file mentioned below for details).
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL_WRE file in the doc directory.
+ */
+
+#pragma once
+
+#define RAPIDJSON_HAS_STDSTRING 1
+
+#include <rapidjson/fwd.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/** Latency representation for JSON transfer. */
+class Latency
+{
+public:
+	/** Constructor. */
+	Latency();
+	/** Constructor from JSON.
+	 * @param json JSON string to initialize from
+	 */
+	Latency(const std::string &json);
+	/** Constructor from JSON.
+	 * @param v RapidJSON value object to initialize from.
+	 */
+	Latency(const rapidjson::Value &v);
+
+	/** Destructor. */
+	virtual ~Latency();
+
+	/** Get version of implemented API.
+	 * @return string representation of version
+	 */
+	static std::string
+	api_version()
+	{
+		return "v1beta1";
+	}
+
+	/** Render object to JSON.
+	 * @param pretty true to enable pretty printing (readable spacing)
+	 * @return JSON string
+	 */
+	virtual std::string to_json(bool pretty = false) const;
+	/** Render object to JSON.
+	 * @param d RapidJSON document to retrieve allocator from
+	 * @param v RapidJSON value to add data to
+	 */
+	virtual void to_json_value(rapidjson::Document &d, rapidjson::Value &v) const;
+	/** Retrieve data from JSON string.
+	 * @param json JSON representation suitable for this object.
+	 * Will allow partial assignment and not validate automaticaly.
+	 * @see validate()
+	 */
+	virtual void from_json(const std::string &json);
+	/** Retrieve data from JSON string.
+	 * @param v RapidJSON value suitable for this object.
+	 * Will allow partial assignment and not validate automaticaly.
+	 * @see validate()
+	 */
+	virtual void from_json_value(const rapidjson::Value &v);
+
+	/** Validate if all required fields have been set.
+	 * @param subcall true if this is called from another class, e.g.,
+	 * a sub-class or array holder. Will modify the kind of exception thrown.
+	 * @exception std::vector<std::string> thrown if required information is
+	 * missing and @p subcall is set to true. Contains a list of missing fields.
+	 * @exception std::runtime_error informative message describing the missing
+	 * fields
+	 */
+	virtual void validate(bool subcall = false) const;
+
+	// Schema: Latency
+public:
+	/** Get kind value.
+   * @return kind value
+   */
+	std::optional<std::string>
+	kind() const
+	{
+		return kind_;
+	}
+
+	/** Set kind value.
+	 * @param kind new value
+	 */
+	void
+	set_kind(const std::string &kind)
+	{
+		kind_ = kind;
+	}
+	/** Get apiVersion value.
+   * @return apiVersion value
+   */
+	std::optional<std::string>
+	apiVersion() const
+	{
+		return apiVersion_;
+	}
+
+	/** Set apiVersion value.
+	 * @param apiVersion new value
+	 */
+	void
+	set_apiVersion(const std::string &apiVersion)
+	{
+		apiVersion_ = apiVersion;
+	}
+	/** Get name value.
+   * @return name value
+   */
+	std::optional<std::string>
+	name() const
+	{
+		return name_;
+	}
+
+	/** Set name value.
+	 * @param name new value
+	 */
+	void
+	set_name(const std::string &name)
+	{
+		name_ = name;
+	}
+	/** Get count value.
+   * @return count value
+   */
+	std::optional<int64_t>
+	count() const
+	{
+		return count_;
+	}
+
+	/** Set count value.
+	 * @param count new value
+	 */
+	void
+	set_count(const int64_t &count)
+	{
+		count_ = count;
+	}
+	/** Get mean-ms value.
+   * @return mean-ms value
+   */
+	std::optional<float>
+	mean_ms() const
+	{
+		return mean_ms_;
+	}
+
+	/** Set mean-ms value.
+	 * @param mean_ms new value
+	 */
+	void
+	set_mean_ms(const float &mean_ms)
+	{
+		mean_ms_ = mean_ms;
+	}
+	/** Get p50-ms value.
+   * @return p50-ms value
+   */
+	std::optional<float>
+	p50_ms() const
+	{
+		return p50_ms_;
+	}
+
+	/** Set p50-ms value.
+	 * @param p50_ms new value
+	 */
+	void
+	set_p50_ms(const float &p50_ms)
+	{
+		p50_ms_ = p50_ms;
+	}
+	/** Get p90-ms value.
+   * @return p90-ms value
+   */
+	std::optional<float>
+	p90_ms() const
+	{
+		return p90_ms_;
+	}
+
+	/** Set p90-ms value.
+	 * @param p90_ms new value
+	 */
+	void
+	set_p90_ms(const float &p90_ms)
+	{
+		p90_ms_ = p90_ms;
+	}
+	/** Get p99-ms value.
+   * @return p99-ms value
+   */
+	std::optional<float>
+	p99_ms() const
+	{
+		return p99_ms_;
+	}
+
+	/** Set p99-ms value.
+	 * @param p99_ms new value
+	 */
+	void
+	set_p99_ms(const float &p99_ms)
+	{
+		p99_ms_ = p99_ms;
+	}
+	/** Get max-ms value.
+   * @return max-ms value
+   */
+	std::optional<float>
+	max_ms() const
+	{
+		return max_ms_;
+	}
+
+	/** Set max-ms value.
+	 * @param max_ms new value
+	 */
+	void
+	set_max_ms(const float &max_ms)
+	{
+		max_ms_ = max_ms;
+	}
+
+private:
+	std::optional<std::string> kind_;
+	std::optional<std::string> apiVersion_;
+	std::optional<std::string> name_;
+	std::optional<int64_t>     count_;
+	std::optional<float>       mean_ms_;
+	std::optional<float>       p50_ms_;
+	std::optional<float>       p90_ms_;
+	std::optional<float>       p99_ms_;
+	std::optional<float>       max_ms_;
+};
@@ -105,6 +105,10 @@ WebviewRESTRequestProcessor::process_request(const fawkes::WebRequest *request)
 			                          "REST API '" + rest_api + "' has no endpoint '" + rest_path
 			                            + "'\n");
 		}
+		// versioned replies are revalidated by the client using their ETag
+		if (reply->headers().find("ETag") != reply->headers().end()) {
+			return reply;
+		}
 		return no_caching(reply);
 	} catch (Exception &e) {
 		logger_->log_error("WebRESTProc", "REST API '%s' failed, exception follows", rest_api.c_str());
@@ -36,6 +36,7 @@
 #include <utils/misc/string_conversions.h>
 #include <utils/system/file.h>
 #include <utils/system/hostinfo.h>
+#include <webview/event_stream.h>
 #include <webview/nav_manager.h>
 #include <webview/page_reply.h>
 #include <webview/request_dispatcher.h>
@@ -148,6 +149,15 @@ WebviewServer::WebviewServer(bool                                           enab
 	                                                                rest_api_manager_.get(),
 	                                                                logger_);
 
+	event_stream_ = std::make_shared<WebEventStream>(
+	  config_->get_uint_or_default("/webview/events/queue-size", 64),
+	  config_->get_uint_or_default("/webview/events/max-subscribers", 32));
+	webview_url_manager_->add_handler(WebRequest::METHOD_GET,
+	                                  "/events",
+	                                  std::bind(&WebEventStream::subscribe,
+	                                            event_stream_.get(),
+	                                            std::placeholders::_1));
+
 	try {
 		cfg_explicit_404_ = config_->get_strings("/webview/explicit-404");
 		for (const auto &u : cfg_explicit_404_) {
@@ -192,6 +202,10 @@ WebviewServer::~WebviewServer()
 		webview_url_manager_->remove_handler(WebRequest::METHOD_GET, u);
 	}
 
+	// end streams now, suspended connections would block stopping the server
+	event_stream_->close();
+	webview_url_manager_->remove_handler(WebRequest::METHOD_GET, "/events");
+
 	dispatcher_ = NULL;
 }
 
@@ -202,6 +216,16 @@ WebviewServer::loop()
 		webserver_->process();
 }
 
+/** Get the server-sent events stream.
+ * Clients subscribe with a GET request to /events.
+ * @return event stream to publish events to
+ */
+std::shared_ptr<fawkes::WebEventStream>
+WebviewServer::event_stream() const
+{
+	return event_stream_;
+}
+
 void
 WebviewServer::tls_create(const char *tls_key_file, const char *tls_cert_file)
 {
@@ -38,6 +38,7 @@ class NetworkService;
 class WebServer;
 class WebRequestDispatcher;
 class WebReply;
+class WebEventStream;
 
 // from fawkes::WebviewAspect
 class WebUrlManager;
@@ -71,6 +72,8 @@ public:
 
 	virtual void loop();
 
+	std::shared_ptr<fawkes::WebEventStream> event_stream() const;
+
 private:
 	void              tls_create(const char *tls_key_file, const char *tls_cert_file);
 	fawkes::WebReply *produce_404();
@@ -89,6 +92,7 @@ private:
 	std::unique_ptr<WebviewRESTRequestProcessor>  rest_processor_;
 	std::unique_ptr<WebviewServiceBrowseHandler>  service_browse_handler_;
 	std::shared_ptr<fawkes::NetworkService>       webview_service_;
+	std::shared_ptr<fawkes::WebEventStream>       event_stream_;
 
 	unsigned int             cfg_port_;
 	bool                     cfg_use_ipv4_;
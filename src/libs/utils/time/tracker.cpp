@@ -25,6 +25,7 @@
 #include <core/exceptions/system.h>
 #include <utils/time/tracker.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cmath>
 #include <cstdio>
@@ -473,4 +474,191 @@ ScopedClassItemTracker::~ScopedClassItemTracker()
 	tt_.ping_end(cls_);
 }
 
+/** @class LatencyTracker "utils/time/tracker.h"
+ * Latency histograms for long running processes.
+ * Unlike TimeTracker, which keeps every single measurement, this keeps a
+ * fixed size histogram per class. Hence it can stay enabled in production
+ * without growing in memory. Values are recorded with atomic counters, any
+ * number of threads may add values concurrently. Classes must be added
+ * before values are recorded from multiple threads.
+ *
+ * Bucket i holds durations in [2^(i-1), 2^i) microseconds, bucket 0 holds
+ * durations below one microsecond. Percentiles are reported as the upper
+ * bound of the bucket they fall into, i.e., they are accurate within a
+ * factor of two.
+ *
+ * Each class has two histograms: one for the whole lifetime and a window
+ * which can be reset, e.g., after printing a periodic summary.
+ */
+
+/** Constructor. */
+LatencyTracker::LatencyTracker()
+{
+}
+
+/** Destructor. */
+LatencyTracker::~LatencyTracker()
+{
+}
+
+LatencyTracker::Histogram::Histogram()
+{
+	reset();
+}
+
+void
+LatencyTracker::Histogram::add(unsigned long usec)
+{
+	unsigned int b = 0;
+	while (b < NUM_BUCKETS - 1 && (1ul << b) <= usec)
+		++b;
+	buckets[b].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum_usec.fetch_add(usec, std::memory_order_relaxed);
+	unsigned long max = max_usec.load(std::memory_order_relaxed);
+	while (usec > max && !max_usec.compare_exchange_weak(max, usec, std::memory_order_relaxed)) {
+	}
+}
+
+void
+LatencyTracker::Histogram::reset()
+{
+	for (unsigned int i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+	count.store(0, std::memory_order_relaxed);
+	sum_usec.store(0, std::memory_order_relaxed);
+	max_usec.store(0, std::memory_order_relaxed);
+}
+
+/** Add a new class.
+ * @param name name of the class
+ * @return new class ID which is used to add values to this class
+ */
+unsigned int
+LatencyTracker::add_class(std::string name)
+{
+	if (name == "") {
+		throw Exception("LatencyTracker::add_class(): Class name may not be empty");
+	}
+	classes_.push_back(std::make_unique<TrackerClass>());
+	classes_.back()->name = name;
+	return classes_.size() - 1;
+}
+
+/** Get number of classes.
+ * @return number of classes, class IDs are in the range [0, num_classes())
+ */
+unsigned int
+LatencyTracker::num_classes() const
+{
+	return classes_.size();
+}
+
+/** Add value to class.
+ * @param cls class ID
+ * @param usec measured duration in microseconds
+ */
+void
+LatencyTracker::add(unsigned int cls, unsigned long usec)
+{
+	if (cls >= classes_.size()) {
+		throw OutOfBoundsException("Invalid class given", cls, 0, classes_.size());
+	}
+	classes_[cls]->total.add(usec);
+	classes_[cls]->window.add(usec);
+}
+
+/** Get summary of a class.
+ * @param cls class ID
+ * @param window true to get the summary of the current window, false to
+ * get the summary of all values recorded so far
+ * @return summary of the recorded values
+ */
+LatencyTracker::Stats
+LatencyTracker::stats(unsigned int cls, bool window) const
+{
+	if (cls >= classes_.size()) {
+		throw OutOfBoundsException("Invalid class given", cls, 0, classes_.size());
+	}
+	const Histogram &h = window ? classes_[cls]->window : classes_[cls]->total;
+
+	unsigned long buckets[NUM_BUCKETS];
+	unsigned long count = 0;
+	for (unsigned int i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+	double max_ms = h.max_usec.load(std::memory_order_relaxed) / 1000.;
+
+	auto percentile = [&](double p) {
+		unsigned long rank = (unsigned long)ceil(p * count);
+		unsigned long sum  = 0;
+		for (unsigned int i = 0; i < NUM_BUCKETS; ++i) {
+			sum += buckets[i];
+			if (sum >= rank && sum > 0) {
+				return std::min((1ul << i) / 1000., max_ms);
+			}
+		}
+		return max_ms;
+	};
+
+	Stats s;
+	s.name    = classes_[cls]->name;
+	s.count   = count;
+	s.mean_ms = count > 0 ? h.sum_usec.load(std::memory_order_relaxed) / 1000. / count : 0.;
+	s.p50_ms  = percentile(0.5);
+	s.p90_ms  = percentile(0.9);
+	s.p99_ms  = percentile(0.99);
+	s.max_ms  = max_ms;
+	return s;
+}
+
+/** Reset the window of all classes.
+ * Values recorded concurrently may or may not be part of the new window.
+ */
+void
+LatencyTracker::reset_window()
+{
+	for (auto &c : classes_) {
+		c->window.reset();
+	}
+}
+
+/** @class ScopedLatencyTracker "utils/time/tracker.h"
+ * Scoped latency tracking.
+ * Measures the time from construction to destruction, or to an explicit
+ * call to end(), and adds it to the given class.
+ */
+
+/** Constructor.
+ * Starts time tracking for given class on given latency tracker.
+ * @param lt latency tracker, may be NULL in which case nothing is recorded
+ * @param cls class ID
+ */
+ScopedLatencyTracker::ScopedLatencyTracker(LatencyTracker *lt, unsigned int cls)
+: lt_(lt), cls_(cls), start_(std::chrono::steady_clock::now())
+{
+}
+
+/** Destructor. */
+ScopedLatencyTracker::~ScopedLatencyTracker()
+{
+	end();
+}
+
+/** End measurement before the end of the scope.
+ * Only the first call records a value, later calls and the destructor do
+ * nothing.
+ */
+void
+ScopedLatencyTracker::end()
+{
+	if (lt_) {
+		auto d = std::chrono::steady_clock::now() - start_;
+		lt_->add(cls_, std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+		lt_ = NULL;
+	}
+}
+
 } // end namespace fawkes
@@ -26,8 +26,11 @@
 
 #include <sys/time.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -89,6 +92,71 @@ private:
 	unsigned int cls_;
 };
 
+class LatencyTracker
+{
+public:
+	/** Number of histogram buckets. */
+	static const unsigned int NUM_BUCKETS = 32;
+
+	/** Summary of the latencies recorded for a class. */
+	struct Stats
+	{
+		std::string   name;    ///< name of the class
+		unsigned long count;   ///< number of recorded values
+		double        mean_ms; ///< average latency in ms
+		double        p50_ms;  ///< median latency in ms (upper bucket bound)
+		double        p90_ms;  ///< 90th percentile in ms (upper bucket bound)
+		double        p99_ms;  ///< 99th percentile in ms (upper bucket bound)
+		double        max_ms;  ///< maximum latency in ms
+	};
+
+	LatencyTracker();
+	~LatencyTracker();
+
+	unsigned int add_class(std::string name);
+	unsigned int num_classes() const;
+
+	void  add(unsigned int cls, unsigned long usec);
+	Stats stats(unsigned int cls, bool window = false) const;
+	void  reset_window();
+
+private:
+	struct Histogram
+	{
+		std::atomic<unsigned long> buckets[NUM_BUCKETS];
+		std::atomic<unsigned long> count;
+		std::atomic<unsigned long> sum_usec;
+		std::atomic<unsigned long> max_usec;
+
+		Histogram();
+		void add(unsigned long usec);
+		void reset();
+	};
+
+	struct TrackerClass
+	{
+		std::string name;
+		Histogram   total;
+		Histogram   window;
+	};
+
+	std::vector<std::unique_ptr<TrackerClass>> classes_;
+};
+
+class ScopedLatencyTracker
+{
+public:
+	explicit ScopedLatencyTracker(LatencyTracker *lt, unsigned int cls);
+	~ScopedLatencyTracker();
+
+	void end();
+
+private:
+	LatencyTracker                       *lt_;
+	unsigned int                          cls_;
+	std::chrono::steady_clock::time_point start_;
+};
+
 } // end namespace fawkes
 
 #endif
@@ -48,12 +48,18 @@ Backend::Backend(Logger *logger, CLIPS::Environment *env, fawkes::Mutex &env_mut
  * @param port tcp port of the websocket server
  * @param ws_mode true if websocket only mode is activated
  * @param allow_control_all if this is set, devices with not local host ip addresses can send control commands
+ * @param send_queue_size maximum number of messages waiting to be sent to a single client
+ * @param policy what to do with a client whose send queue is full
  */
 void
-Backend::start(uint port, bool ws_mode, bool allow_control_all)
+Backend::start(uint               port,
+               bool               ws_mode,
+               bool               allow_control_all,
+               size_t             send_queue_size,
+               SlowConsumerPolicy policy)
 {
 	//configure server
-	server_.configure(port, ws_mode, allow_control_all);
+	server_.configure(port, ws_mode, allow_control_all, send_queue_size, policy);
 	// launch server thread
 	server_t_ = std::thread(&Server::operator(), server_);
 	logger_->log_info("Websocket", "(web-)socket-server started");
@@ -79,7 +85,7 @@ Backend::operator()()
 		data_->log_wait();
 
 		// notified -> get current value from the queue
-		std::string log = data_->log_pop();
+		OutboundMessage log = data_->log_pop();
 		// send to clients
 		data_->clients_send_all(log);
 	}
@@ -36,7 +36,11 @@ public:
 	Backend(Logger *logger, CLIPS::Environment *env, fawkes::Mutex &env_mutex);
 
 	void                  operator()();
-	void                  start(uint port, bool ws_mode = true, bool allow_control_all = false);
+	void                  start(uint               port,
+	                            bool               ws_mode           = true,
+	                            bool               allow_control_all = false,
+	                            size_t             send_queue_size   = 256,
+	                            SlowConsumerPolicy policy            = SlowConsumerPolicy::COALESCE);
 	std::shared_ptr<Data> get_data();
 
 private:
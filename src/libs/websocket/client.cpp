@@ -25,6 +25,7 @@
 #include <rapidjson/stringbuffer.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
@@ -40,22 +41,86 @@ using boost::asio::ip::tcp;
 
 namespace llsfrb::websocket {
 
+/**
+ * @brief Parse a slow consumer policy from its configuration name
+ *
+ * @param policy one of "coalesce", "drop-oldest" or "disconnect"
+ * @return SlowConsumerPolicy parsed policy
+ */
+SlowConsumerPolicy
+slow_consumer_policy_from_string(const std::string &policy)
+{
+	if (policy == "coalesce") {
+		return SlowConsumerPolicy::COALESCE;
+	} else if (policy == "drop-oldest") {
+		return SlowConsumerPolicy::DROP_OLDEST;
+	} else if (policy == "disconnect") {
+		return SlowConsumerPolicy::DISCONNECT;
+	}
+	throw Exception("Unknown slow consumer policy '%s'", policy.c_str());
+}
+
+/**
+ * @brief Construct a new Client::Client object
+ *
+ * @param send_queue_size maximum number of messages waiting to be sent to this client
+ * @param policy what to do if the client does not keep up and the queue is full
+ */
+Client::Client(size_t send_queue_size, SlowConsumerPolicy policy)
+: send_queue_size_(send_queue_size > 0 ? send_queue_size : 1),
+  policy_(policy),
+  dropped_(0),
+  delta_updates_(false)
+{
+}
+
+/**
+ * @brief Destroy the Client::Client object
+ *
+ */
+Client::~Client()
+{
+}
+
+/**
+ * @brief Wake up and join the receive and send threads
+ *
+ *  Must be called by the destructors of derived classes after disconnect().
+ */
+void
+Client::join_threads()
+{
+	send_cv_.notify_all();
+	if (client_t.joinable())
+		client_t.join();
+	if (send_t.joinable())
+		send_t.join();
+}
+
 /**
  * @brief Construct a new ClientWS::ClientWS object
  * 
  * @param socket Established WebSocket socket shared pointer user for this client
+ * @param logger Logger instance to be used
+ * @param data Data instance to be used
+ * @param can_send sets if the connected client's incoming commands are processed
+ * @param send_queue_size maximum number of messages waiting to be sent to this client
+ * @param policy what to do if the client does not keep up and the queue is full
  */
 ClientWS::ClientWS(std::shared_ptr<boost::beast::websocket::stream<tcp::socket>> socket,
                    std::shared_ptr<Logger>                                       logger,
                    std::shared_ptr<Data>                                         data,
-                   bool                                                          can_send)
-: socket(socket)
+                   bool                                                          can_send,
+                   size_t                                                        send_queue_size,
+                   SlowConsumerPolicy                                            policy)
+: Client(send_queue_size, policy), socket(socket)
 {
 	logger_   = logger;
 	data_     = data;
 	can_send_ = can_send;
 	socket->accept();
 	client_t = std::thread(&Client::receive_thread, this);
+	send_t   = std::thread(&Client::send_thread, this);
 	logger_->log_info("Websocket", "client receive thread started");
 	on_connect_update();
 }
@@ -67,7 +132,9 @@ ClientWS::ClientWS(std::shared_ptr<boost::beast::websocket::stream<tcp::socket>>
 ClientWS::~ClientWS()
 {
 	disconnect();
-	client_t.join();
+	join_threads();
+	boost::system::error_code error;
+	socket->next_layer().close(error);
 }
 
 /**
@@ -115,12 +182,16 @@ ClientWS::read()
 
 /**
  * @brief WebSocket implementation for close
- * 
+ *
+ *  Shuts down the connection, which wakes up the receive and send threads if they are
+ *  blocked on the socket. This may be called from any thread while they use the socket,
+ *  as it only issues the system call and does not modify the socket object. The socket
+ *  is closed by the destructor once both threads have been joined.
  */
 void
 ClientWS::close()
 {
-	socket->next_layer().close();
+	::shutdown(socket->next_layer().native_handle(), SHUT_RDWR);
 }
 
 /**
@@ -130,17 +201,22 @@ ClientWS::close()
  * @param logger Logger instance to be used 
  * @param data Data instance to be used
  * @param can_send sets if the connected client's incoming commands are processed
+ * @param send_queue_size maximum number of messages waiting to be sent to this client
+ * @param policy what to do if the client does not keep up and the queue is full
  */
 ClientS::ClientS(std::shared_ptr<tcp::socket> socket,
                  std::shared_ptr<Logger>      logger,
                  std::shared_ptr<Data>        data,
-                 bool                         can_send)
-: socket(socket)
+                 bool                         can_send,
+                 size_t                       send_queue_size,
+                 SlowConsumerPolicy           policy)
+: Client(send_queue_size, policy), socket(socket)
 {
 	logger_   = logger;
 	data_     = data;
 	can_send_ = can_send;
 	client_t  = std::thread(&Client::receive_thread, this);
+	send_t    = std::thread(&Client::send_thread, this);
 	logger_->log_info("Websocket", "TCP-socket client receive thread started");
 	on_connect_update();
 }
@@ -152,7 +228,9 @@ ClientS::ClientS(std::shared_ptr<tcp::socket> socket,
 ClientS::~ClientS()
 {
 	disconnect();
-	client_t.join();
+	join_threads();
+	boost::system::error_code error;
+	socket->close(error);
 }
 
 /**
@@ -198,12 +276,14 @@ ClientS::read()
 
 /**
  * @brief TCP-Socket implementation for close
- * 
+ *
+ *  Shuts down the connection, see ClientWS::close(). The socket is closed by the
+ *  destructor once the receive and send threads have been joined.
  */
 void
 ClientS::close()
 {
-	socket->close();
+	::shutdown(socket->native_handle(), SHUT_RDWR);
 }
 
 /**
@@ -223,10 +303,23 @@ Client::receive_thread()
 			//check incoming message type and call corresponding CLIPS function
 			if (!msgs.IsObject()) {
 				logger_->log_error("Websocket", "non JSON message received, won't process");
+			} else if (msgs.HasMember("command") && msgs["command"].IsString()
+			           && strcmp(msgs["command"].GetString(), "set_delta_updates") == 0) {
+				// only affects this client, hence allowed for everyone
+				rapidjson::SchemaValidator validator(*(data_->command_schema_map["set_delta_updates"]));
+				if (!msgs.Accept(validator)) {
+					logger_->log_error("Websocket", "input JSON is invalid!");
+				} else {
+					set_delta_updates(msgs["enable"].GetBool());
+				}
 			} else if (!can_send_) {
 				logger_->log_error("Websocket", "non localhost client tried to send command");
 			} else if (msgs.HasMember("command")) {
-				std::string                command = msgs["command"].GetString();
+				std::string command = msgs["command"].GetString();
+				if (data_->command_schema_map.find(command) == data_->command_schema_map.end()) {
+					logger_->log_error("Websocket", "unknown command '%s' received", command.c_str());
+					continue;
+				}
 				rapidjson::SchemaValidator validator(*(data_->command_schema_map[command]));
 				if (!msgs.Accept(validator)) {
 					logger_->log_error("Websocket", "input JSON is invalid!");
@@ -295,10 +388,146 @@ Client::receive_thread()
 void
 Client::disconnect()
 {
-	if (active) {
-		active = false;
+	if (active.exchange(false)) {
 		close();
-		logger_->log_info("Websocket", "client disconnected");
+		unsigned long dropped;
+		{
+			std::lock_guard<std::mutex> lock(send_mu_);
+			dropped = dropped_;
+		}
+		send_cv_.notify_all();
+		if (dropped > 0) {
+			logger_->log_info("Websocket",
+			                  "client disconnected (%lu messages dropped or coalesced)",
+			                  dropped);
+		} else {
+			logger_->log_info("Websocket", "client disconnected");
+		}
+	}
+}
+
+/**
+ * @brief Queue a message for sending to the client
+ *
+ *  Never blocks on the socket. If the queue is full the slow consumer policy is applied.
+ *  With the coalesce policy a pending message for the same entity is replaced in place
+ *  by the newer one, regardless of the queue level, as the client would only see the
+ *  stale state first.
+ *
+ *  With delta updates enabled, the delta payload is sent instead of the full one if the
+ *  client already received a full message for the entity. Whenever an entity message
+ *  is dropped, the next message for it is sent in full again, including a delta that is
+ *  already queued. Queued messages keep their full payload for this purpose.
+ *
+ * @param msg message to send
+ * @return true if the client is still active
+ * @return false if the client is (or has just been) disconnected
+ */
+bool
+Client::enqueue(const OutboundMessage &msg)
+{
+	if (!active)
+		return false;
+
+	std::unique_lock<std::mutex> lock(send_mu_);
+	if (policy_ == SlowConsumerPolicy::COALESCE && !msg.coalesce_key.empty()) {
+		for (auto &pending : send_queue_) {
+			if (pending.coalesce_key == msg.coalesce_key) {
+				// the pending message may be a delta the new one builds upon, send in full
+				pending.payload = msg.payload;
+				pending.delta_payload.reset();
+				++dropped_;
+				return true;
+			}
+		}
+	}
+	if (send_queue_.size() >= send_queue_size_) {
+		if (policy_ == SlowConsumerPolicy::DISCONNECT) {
+			lock.unlock();
+			logger_->log_warn("Websocket", "client does not keep up, disconnecting");
+			disconnect();
+			return false;
+		}
+		std::string key = send_queue_.front().coalesce_key;
+		send_queue_.pop_front();
+		++dropped_;
+		if (!key.empty()) {
+			// a pending delta for the entity builds upon the dropped message, send it in
+			// full instead, later deltas build upon that one
+			auto pending = std::find_if(send_queue_.begin(), send_queue_.end(), [&key](auto &m) {
+				return m.coalesce_key == key;
+			});
+			if (pending != send_queue_.end()) {
+				pending->delta_payload.reset();
+			} else {
+				delta_synced_.erase(key);
+			}
+		}
+	}
+	send_queue_.push_back(msg);
+	OutboundMessage &queued = send_queue_.back();
+	if (!delta_updates_ || msg.coalesce_key.empty()) {
+		queued.delta_payload.reset();
+	} else if (!msg.delta_payload || delta_synced_.count(msg.coalesce_key) == 0) {
+		queued.delta_payload.reset();
+		delta_synced_.insert(msg.coalesce_key);
+	}
+	lock.unlock();
+	send_cv_.notify_one();
+	return true;
+}
+
+/**
+ * @brief Enable or disable delta updates for this client
+ *
+ *  Enabling (again) resynchronizes the client, the next message for each entity is sent in
+ *  full. The client may use this to recover after noticing a gap in the entity versions.
+ *
+ * @param enable true to receive delta updates, false to receive full updates only
+ */
+void
+Client::set_delta_updates(bool enable)
+{
+	const std::lock_guard<std::mutex> lock(send_mu_);
+	delta_updates_ = enable;
+	delta_synced_.clear();
+}
+
+/**
+ * @brief Queue a message that is not associated with a specific entity
+ *
+ * @param msg message to send
+ * @return true if the client is still active
+ * @return false if the client is disconnected
+ */
+bool
+Client::enqueue(std::shared_ptr<const std::string> msg)
+{
+	return enqueue(OutboundMessage{msg, "", nullptr});
+}
+
+/**
+ * @brief Writes queued messages to the client
+ *
+ *  Runs until the client is disconnected, a failing send disconnects the client.
+ */
+void
+Client::send_thread()
+{
+	std::unique_lock<std::mutex> lock(send_mu_);
+	while (active) {
+		send_cv_.wait(lock, [this] { return !active || !send_queue_.empty(); });
+		if (!active)
+			break;
+		const OutboundMessage             &next = send_queue_.front();
+		std::shared_ptr<const std::string> payload =
+		  next.delta_payload ? next.delta_payload : next.payload;
+		send_queue_.pop_front();
+		lock.unlock();
+		if (!send(*payload)) {
+			disconnect();
+		}
+		lock.lock();
 	}
 }
 
@@ -310,24 +539,27 @@ void
 Client::on_connect_update()
 {
 	logger_->log_info("Websocket", "send on connect update");
-	std::string gamephase = data_->get_gamephase();
-	std::string gamestate = data_->get_gamestate();
+	std::shared_ptr<const Data::ConnectSnapshot> s = data_->connect_snapshot();
+	if (!s) {
+		logger_->log_warn("Websocket", "no game state published yet, skipping on connect update");
+		return;
+	}
 
-	send(data_->on_connect_known_teams());
-	send(data_->on_connect_order_count());
+	enqueue(s->known_teams);
+	enqueue(s->order_count);
 
-	if (gamestate == "RUNNING" || gamestate == "PAUSED") {
-		send(data_->on_connect_machine_info());
-		send(data_->on_connect_robot_info());
-		send(data_->on_connect_workpiece_info());
-		send(data_->on_connect_points());
+	if (s->gamestate == "RUNNING" || s->gamestate == "PAUSED") {
+		enqueue(s->machine_info);
+		enqueue(s->robot_info);
+		enqueue(s->workpiece_info);
+		enqueue(s->points);
 	}
-	if (gamephase == "PRODUCTION" || gamephase == "POST_GAME") {
-		send(data_->on_connect_order_info());
-		send(data_->on_connect_ring_spec());
+	if (s->gamephase == "PRODUCTION" || s->gamephase == "POST_GAME") {
+		enqueue(s->order_info);
+		enqueue(s->ring_spec);
 	}
-	if (gamephase == "SETUP" || gamephase == "EXPLORATION") {
-		send(data_->on_connect_ring_spec());
+	if (s->gamephase == "SETUP" || s->gamephase == "EXPLORATION") {
+		enqueue(s->ring_spec);
 	}
 }
 } // namespace llsfrb::websocket
@@ -23,14 +23,19 @@
 
 #include "data.h"
 #include "logging/logger.h"
+#include "send_queue.h"
 
 #include <sys/socket.h>
 
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <mutex>
+#include <set>
 #include <string>
 
 namespace llsfrb::websocket {
@@ -39,21 +44,41 @@ class Data; // forward declaration
 class Client
 {
 public:
+	Client(size_t send_queue_size, SlowConsumerPolicy policy);
+	virtual ~Client();
 	virtual bool        send(std::string msg) = 0;
 	virtual std::string read()                = 0;
 	virtual void        close()               = 0;
+	bool                enqueue(const OutboundMessage &msg);
+	bool                enqueue(std::shared_ptr<const std::string> msg);
 	void                receive_thread();
+	void                send_thread();
 	void                disconnect();
 	void                on_connect_update();
-	bool                active = true;
+	void                set_delta_updates(bool enable);
+	std::atomic<bool>   active{true};
+
+protected:
+	void join_threads();
 
 protected:
 	std::mutex              rd_mu;
 	std::mutex              wr_mu;
 	std::thread             client_t;
+	std::thread             send_t;
 	std::shared_ptr<Logger> logger_;
 	std::shared_ptr<Data>   data_;
 	bool                    can_send_;
+
+private:
+	std::mutex                  send_mu_;
+	std::condition_variable     send_cv_;
+	std::deque<OutboundMessage> send_queue_;
+	size_t                      send_queue_size_;
+	SlowConsumerPolicy          policy_;
+	unsigned long               dropped_;
+	bool                        delta_updates_;
+	std::set<std::string>       delta_synced_;
 };
 
 class ClientWS : public Client
@@ -62,7 +87,9 @@ public:
 	ClientWS(std::shared_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>> socket,
 	         std::shared_ptr<Logger>                                                        logger,
 	         std::shared_ptr<Data>                                                          data,
-	         bool                                                                           can_send);
+	         bool                                                                           can_send,
+	         size_t                                                                         send_queue_size,
+	         SlowConsumerPolicy                                                             policy);
 	~ClientWS();
 	bool        send(std::string msg);
 	std::string read();
@@ -78,7 +105,9 @@ public:
 	ClientS(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
 	        std::shared_ptr<Logger>                       logger,
 	        std::shared_ptr<Data>                         data,
-	        bool                                          can_send);
+	        bool                                          can_send,
+	        size_t                                        send_queue_size,
+	        SlowConsumerPolicy                            policy);
 	~ClientS();
 	bool        send(std::string msg);
 	std::string read();
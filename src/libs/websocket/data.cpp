@@ -20,16 +20,20 @@
 
 #include "data.h"
 
+#include <clips/clips.h>
 #include <core/threading/mutex_locker.h>
 #include <rapidjson/document.h>
 #include <rapidjson/filereadstream.h>
 #include <rapidjson/schema.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <utils/time/tracker.h>
 
+#include <algorithm>
 #include <condition_variable>
 #include <cstdio>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -45,7 +49,7 @@ namespace llsfrb::websocket {
  * @param logger_ logger to be used
  */
 Data::Data(std::shared_ptr<Logger> logger, CLIPS::Environment *env, fawkes::Mutex &env_mutex)
-: logger_(logger), env_mutex_(env_mutex)
+: logger_(logger), env_mutex_(env_mutex), latency_tracker_(NULL), latency_class_(0)
 {
 	env_ = std::shared_ptr<CLIPS::Environment>(env);
 
@@ -62,7 +66,8 @@ Data::Data(std::shared_ptr<Logger> logger, CLIPS::Environment *env, fawkes::Mute
 	                              "set_robot_maintenance",
 	                              "set_teamname",
 	                              "reset_machine_by_team",
-	                              "add_points_team"};
+	                              "add_points_team",
+	                              "set_delta_updates"};
 
 	for (const std::string &schema_name : schema_names) {
 		std::shared_ptr<rapidjson::SchemaDocument> sd =
@@ -108,13 +113,13 @@ Data::load_schema(std::string path)
  *
  *  This thread-safe function returns the first element from the log message queue and removes it.
  *
- * @return std::string first element from log queue
+ * @return OutboundMessage first element from log queue
  */
-std::string
+OutboundMessage
 Data::log_pop()
 {
 	const std::lock_guard<std::mutex> lock(log_mu);
-	std::string                       log = logs.front();
+	OutboundMessage                   log = logs.front();
 	logs.pop();
 	return log;
 }
@@ -125,12 +130,27 @@ Data::log_pop()
  * This thread-safe function adds an element to the log message queue.
  *
  * @param log element (std::string) to be added
+ * @param coalesce_key key of the entity the message describes, empty if none;
+ *        a slow client may skip a message if a newer one with the same key is queued
  */
 void
-Data::log_push(std::string log)
+Data::log_push(std::string log, std::string coalesce_key)
 {
+	log_push(std::make_shared<const std::string>(std::move(log)), std::move(coalesce_key));
+}
+
+/**
+ * @brief add an already shared element to log queue
+ *
+ * @param log element to be added, it is not copied
+ * @param coalesce_key key of the entity the message describes, empty if none
+ */
+void
+Data::log_push(std::shared_ptr<const std::string> log, std::string coalesce_key)
+{
+	OutboundMessage                   msg{std::move(log), std::move(coalesce_key), nullptr};
 	const std::lock_guard<std::mutex> lock(log_mu);
-	logs.push(log);
+	logs.push(std::move(msg));
 	log_cv.notify_one();
 }
 
@@ -139,20 +159,100 @@ Data::log_push(std::string log)
  *
  * This thread-safe function adds a JSON element to the log message queue.
  *
+ * If a coalesce key is given, the document is compared to the last one pushed for
+ * the same entity. An unchanged document is not sent at all. Otherwise a "version"
+ * field is added and a delta message containing only the changed fields is prepared
+ * for clients that enabled delta updates.
+ *
  * @param d element (rapidjson::Document) to be added
+ * @param coalesce_key key of the entity the message describes, empty if none
  */
 void
-Data::log_push(rapidjson::Document &d)
+Data::log_push(rapidjson::Document &d, std::string coalesce_key)
 {
-	const std::lock_guard<std::mutex>          lock(log_mu);
+	std::shared_ptr<const std::string> delta_payload;
+	if (!coalesce_key.empty() && d.IsObject()) {
+		const std::lock_guard<std::mutex> lock(entity_mu);
+		EntityState                      &state = entities_[coalesce_key];
+		if (state.doc && *state.doc == d) {
+			return;
+		}
+		++state.version;
+		if (state.doc) {
+			rapidjson::Document delta;
+			make_delta(*state.doc, d, state.version, delta);
+			rapidjson::StringBuffer                    buffer;
+			rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+			delta.Accept(writer);
+			delta_payload = std::make_shared<const std::string>(buffer.GetString(), buffer.GetSize());
+		}
+		state.doc.reset(new rapidjson::Document());
+		state.doc->CopyFrom(d, state.doc->GetAllocator());
+
+		rapidjson::Value version;
+		version.SetUint64(state.version);
+		d.AddMember("version", version, d.GetAllocator());
+	}
+
 	rapidjson::StringBuffer                    buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	d.Accept(writer);
 
-	logs.push(buffer.GetString());
+	OutboundMessage msg{std::make_shared<const std::string>(buffer.GetString(), buffer.GetSize()),
+	                    std::move(coalesce_key),
+	                    std::move(delta_payload)};
+	const std::lock_guard<std::mutex> lock(log_mu);
+	logs.push(std::move(msg));
 	log_cv.notify_one();
 }
 
+/**
+ * @brief Build a delta message between two versions of an entity
+ *
+ * The delta carries the generic type information and the identifying fields of the
+ * entity, the new version, the version it applies to and all fields that were added
+ * or changed. Fields are never removed from an entity, hence removals are not encoded.
+ *
+ * @param prev previous state of the entity
+ * @param cur current state of the entity
+ * @param version version of the current state
+ * @param delta document to write the delta to
+ */
+void
+Data::make_delta(const rapidjson::Value &prev,
+                 const rapidjson::Value &cur,
+                 uint64_t                version,
+                 rapidjson::Document    &delta)
+{
+	static const char *identity_fields[] = {"level", "type", "id", "name", "number", "team_color"};
+
+	delta.SetObject();
+	rapidjson::Document::AllocatorType &alloc = delta.GetAllocator();
+
+	for (const char *field : identity_fields) {
+		rapidjson::Value::ConstMemberIterator m = cur.FindMember(field);
+		if (m != cur.MemberEnd()) {
+			delta.AddMember(rapidjson::StringRef(field), rapidjson::Value(m->value, alloc), alloc);
+		}
+	}
+	rapidjson::Value json_value;
+	json_value.SetBool(true);
+	delta.AddMember("delta", json_value, alloc);
+	json_value.SetUint64(version);
+	delta.AddMember("version", json_value, alloc);
+	json_value.SetUint64(version - 1);
+	delta.AddMember("base_version", json_value, alloc);
+
+	rapidjson::Value fields(rapidjson::kObjectType);
+	for (rapidjson::Value::ConstMemberIterator m = cur.MemberBegin(); m != cur.MemberEnd(); ++m) {
+		rapidjson::Value::ConstMemberIterator p = prev.FindMember(m->name);
+		if (p == prev.MemberEnd() || p->value != m->value) {
+			fields.AddMember(rapidjson::Value(m->name, alloc), rapidjson::Value(m->value, alloc), alloc);
+		}
+	}
+	delta.AddMember("fields", fields, alloc);
+}
+
 /**
  * @brief check if log queue is empty
  *
@@ -197,30 +297,54 @@ Data::clients_add(std::shared_ptr<Client> client)
 /**
  * @brief send one message to all clients
  *
- *  Sends the given message to all connected clients.
+ *  Queues the given message for all connected clients. This never blocks on a client
+ *  socket, each client is served by its own send thread.
  *  Handles disconnects and removes the respective clients.
  *
  * @param msg message to be sent
  */
 void
-Data::clients_send_all(std::string msg)
+Data::clients_send_all(const OutboundMessage &msg)
 {
+	fawkes::ScopedLatencyTracker      latency(latency_tracker_, latency_class_);
 	const std::lock_guard<std::mutex> lock(cli_mu);
 
 	std::vector<std::shared_ptr<Client>> unfailed_clients;
 
 	for (auto const &client : clients) {
-		if (client->active) {
-			if (client->send(msg)) {
-				unfailed_clients.push_back(client);
-			} else {
-				client->disconnect();
-			}
+		if (client->active && client->enqueue(msg)) {
+			unfailed_clients.push_back(client);
 		}
 	}
 	clients = unfailed_clients;
 }
 
+/**
+ * @brief track the time to fan out messages to all clients
+ *
+ *  The tracker must be set before the backend is started.
+ *
+ * @param tracker latency tracker to add values to, NULL to disable
+ * @param cls class ID of the tracker to add values to
+ */
+void
+Data::set_latency_tracker(fawkes::LatencyTracker *tracker, unsigned int cls)
+{
+	latency_tracker_ = tracker;
+	latency_class_   = cls;
+}
+
+/**
+ * @brief send one message to all clients
+ *
+ * @param msg message to be sent
+ */
+void
+Data::clients_send_all(std::string msg)
+{
+	clients_send_all(OutboundMessage{std::make_shared<const std::string>(std::move(msg)), ""});
+}
+
 /**
  * @brief send one JSON document to all clients
  *
@@ -347,6 +471,44 @@ Data::match(CLIPS::Fact::pointer &fact, std::string tmpl_name)
 	return true;
 }
 
+/**
+ * @brief Get the first fact of the given template
+ *
+ *  CLIPS keeps a list of facts per deftemplate, which is updated on every assert and
+ *  retract. Walking it with next_fact() only visits facts of that template instead of
+ *  the whole fact base. The environment mutex must be held while iterating.
+ *
+ * @param tmpl_name name of the template
+ * @return CLIPS::Fact::pointer first fact, or an empty pointer if there is none
+ */
+CLIPS::Fact::pointer
+Data::first_fact(const std::string &tmpl_name)
+{
+	void *tmpl = EnvFindDeftemplate(env_->cobj(), tmpl_name.c_str());
+	if (!tmpl)
+		return CLIPS::Fact::pointer();
+	void *f = EnvGetNextFactInTemplate(env_->cobj(), tmpl, NULL);
+	if (!f)
+		return CLIPS::Fact::pointer();
+	return CLIPS::Fact::create(*env_, f);
+}
+
+/**
+ * @brief Get the next fact of the same template
+ *
+ * @param fact current fact
+ * @return CLIPS::Fact::pointer next fact, or an empty pointer if this was the last one
+ */
+CLIPS::Fact::pointer
+Data::next_fact(const CLIPS::Fact::pointer &fact)
+{
+	void *tmpl = EnvFactDeftemplate(env_->cobj(), fact->cobj());
+	void *f    = EnvGetNextFactInTemplate(env_->cobj(), tmpl, fact->cobj());
+	if (!f)
+		return CLIPS::Fact::pointer();
+	return CLIPS::Fact::create(*env_, f);
+}
+
 /**
  * @brief Gets specific machine-info fact from CLIPS and pushes it to the send queue
  *
@@ -354,24 +516,20 @@ Data::match(CLIPS::Fact::pointer &fact, std::string tmpl_name)
 void
 Data::log_push_machine_info(std::string name)
 {
-	MutexLocker          lock(&env_mutex_);
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "machine")) {
-			try {
-				if (get_value<std::string>(fact, "name") == name) {
-					rapidjson::Document d;
-					d.SetObject();
-					rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-					get_machine_info_fact(&d, alloc, fact);
-					//send it off
-					log_push(d);
-				}
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type machine");
+	MutexLocker lock(&env_mutex_);
+	for (CLIPS::Fact::pointer fact = first_fact("machine"); fact; fact = next_fact(fact)) {
+		try {
+			if (get_value<std::string>(fact, "name") == name) {
+				rapidjson::Document d;
+				d.SetObject();
+				rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+				get_machine_info_fact(&d, alloc, fact);
+				//send it off
+				log_push(d, "machine/" + name);
 			}
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type machine");
 		}
-		fact = fact->next();
 	}
 }
 
@@ -384,23 +542,19 @@ Data::log_push_order_info(int id)
 {
 	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "order")) {
-			try {
-				if (get_value<int64_t>(fact, "id") == id) {
-					rapidjson::Document d;
-					d.SetObject();
-					rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-					get_order_info_fact(&d, alloc, fact);
-					//send it off
-					log_push(d);
-				}
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type order");
+	for (CLIPS::Fact::pointer fact = first_fact("order"); fact; fact = next_fact(fact)) {
+		try {
+			if (get_value<int64_t>(fact, "id") == id) {
+				rapidjson::Document d;
+				d.SetObject();
+				rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+				get_order_info_fact(&d, alloc, fact);
+				//send it off
+				log_push(d, "order/" + std::to_string(id));
 			}
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type order");
 		}
-		fact = fact->next();
 	}
 }
 
@@ -414,32 +568,23 @@ Data::log_push_order_info_via_delivery(int delivery_id)
 {
 	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "product-processed")) {
-			try {
-				if (get_value<int64_t>(fact, "id") == delivery_id) {
-					CLIPS::Fact::pointer order = env_->get_facts();
-					while (order) {
-						if (match(fact, "order")) {
-							if (get_value<int64_t>(fact, "order") == get_value<int64_t>(order, "id")) {
-								rapidjson::Document d;
-								d.SetObject();
-								rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-								get_order_info_fact(&d, alloc, order);
-								//send it off
-								log_push(d);
-							}
-						}
-
-						order = order->next();
+	for (CLIPS::Fact::pointer fact = first_fact("product-processed"); fact; fact = next_fact(fact)) {
+		try {
+			if (get_value<int64_t>(fact, "id") == delivery_id) {
+				for (CLIPS::Fact::pointer order = first_fact("order"); order; order = next_fact(order)) {
+					if (get_value<int64_t>(fact, "order") == get_value<int64_t>(order, "id")) {
+						rapidjson::Document d;
+						d.SetObject();
+						rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+						get_order_info_fact(&d, alloc, order);
+						//send it off
+						log_push(d, "order/" + std::to_string(get_value<int64_t>(order, "id")));
 					}
 				}
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type order");
 			}
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type order");
 		}
-		fact = fact->next();
 	}
 }
 
@@ -452,24 +597,20 @@ Data::log_push_robot_info(int number, std::string name)
 {
 	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "robot")) {
-			try {
-				if (get_value<int64_t>(fact, "number") == number
-				    && get_value<std::string>(fact, "name") == name) {
-					rapidjson::Document d;
-					d.SetObject();
-					rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-					get_robot_info_fact(&d, alloc, fact);
-					//send it off bye bye
-					log_push(d);
-				}
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type robot");
+	for (CLIPS::Fact::pointer fact = first_fact("robot"); fact; fact = next_fact(fact)) {
+		try {
+			if (get_value<int64_t>(fact, "number") == number
+			    && get_value<std::string>(fact, "name") == name) {
+				rapidjson::Document d;
+				d.SetObject();
+				rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+				get_robot_info_fact(&d, alloc, fact);
+				//send it off bye bye
+				log_push(d, "robot/" + name + "/" + std::to_string(number));
 			}
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type robot");
 		}
-		fact = fact->next();
 	}
 }
 
@@ -482,21 +623,17 @@ Data::log_push_game_state()
 {
 	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "gamestate")) {
-			try {
-				rapidjson::Document d;
-				d.SetObject();
-				rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-				get_game_state_fact(&d, alloc, fact);
-				//send it off
-				log_push(d);
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type gamestate");
-			}
+	for (CLIPS::Fact::pointer fact = first_fact("gamestate"); fact; fact = next_fact(fact)) {
+		try {
+			rapidjson::Document d;
+			d.SetObject();
+			rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+			get_game_state_fact(&d, alloc, fact);
+			//send it off
+			log_push(d, "gamestate");
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type gamestate");
 		}
-		fact = fact->next();
 	}
 }
 
@@ -507,7 +644,7 @@ Data::log_push_game_state()
 void
 Data::log_push_ring_spec()
 {
-	log_push(on_connect_ring_spec());
+	log_push(on_connect_ring_spec(), "ring-spec");
 }
 
 /**
@@ -517,7 +654,7 @@ Data::log_push_ring_spec()
 void
 Data::log_push_points()
 {
-	log_push(on_connect_points());
+	log_push(on_connect_points(), "points");
 }
 
 /**
@@ -529,32 +666,28 @@ Data::log_push_workpiece_info(int id)
 {
 	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "workpiece")) {
-			try {
-				if (get_value<int64_t>(fact, "id") == id) {
-					rapidjson::Document d;
-					d.SetObject();
-					rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
-					get_workpiece_info_fact(&d, alloc, fact);
-					//send it off
-					log_push(d);
-				}
-			} catch (Exception &e) {
-				logger_->log_error("Websocket", "can't access value(s) of fact of type workpiece");
+	for (CLIPS::Fact::pointer fact = first_fact("workpiece"); fact; fact = next_fact(fact)) {
+		try {
+			if (get_value<int64_t>(fact, "id") == id) {
+				rapidjson::Document d;
+				d.SetObject();
+				rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
+				get_workpiece_info_fact(&d, alloc, fact);
+				//send it off
+				log_push(d, "workpiece/" + std::to_string(id));
 			}
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type workpiece");
 		}
-		fact = fact->next();
 	}
 }
 
 /**
  * @brief Create a string of a JSON array containing the data of all current known teams facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_known_teams()
 {
 	return on_connect_info("known-teams", &Data::get_known_teams_fact<rapidjson::Value>);
@@ -563,9 +696,9 @@ Data::on_connect_known_teams()
 /**
  * @brief Create a string of a JSON array containing the data of all current workpiece info facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_workpiece_info()
 {
 	return on_connect_info("workpiece", &Data::get_workpiece_info_fact<rapidjson::Value>);
@@ -574,9 +707,9 @@ Data::on_connect_workpiece_info()
 /**
  * @brief Create a string of a JSON array containing the data of all current robot info facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_robot_info()
 {
 	return on_connect_info("robot", &Data::get_robot_info_fact<rapidjson::Value>);
@@ -585,9 +718,9 @@ Data::on_connect_robot_info()
 /**
  * @brief  Create a string of a JSON array containing the data of all current ring spec facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_ring_spec()
 {
 	return on_connect_info("ring-spec", &Data::get_ring_spec_fact<rapidjson::Value>);
@@ -596,9 +729,9 @@ Data::on_connect_ring_spec()
 /**
  * @brief Create a string of a JSON array containing the data of all current points facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_points()
 {
 	return on_connect_info("points", &Data::get_points_fact<rapidjson::Value>);
@@ -607,9 +740,9 @@ Data::on_connect_points()
 /**
  * @brief Create a string of a JSON array containing the data of all current order info facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_order_info()
 {
 	return on_connect_info("order", &Data::get_order_info_fact<rapidjson::Value>);
@@ -618,22 +751,23 @@ Data::on_connect_order_info()
 /**
  * @brief Create a string of a JSON object containing the count of existing orders
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_order_count()
 {
-	MutexLocker                       lock(&env_mutex_);
-	std::vector<CLIPS::Fact::pointer> facts = {};
+	MutexLocker lock(&env_mutex_);
+
+	SnapshotSignature                  signature = snapshot_signature("order");
+	std::shared_ptr<const std::string> cached    = cached_snapshot("order-count", signature);
+	if (cached) {
+		return cached;
+	}
 
 	//count order info pointers
-	CLIPS::Fact::pointer fact    = env_->get_facts();
-	int                  counter = 0;
-	while (fact) {
-		if (match(fact, "order")) {
-			counter++;
-		}
-		fact = fact->next();
+	int counter = 0;
+	for (CLIPS::Fact::pointer fact = first_fact("order"); fact; fact = next_fact(fact)) {
+		counter++;
 	}
 
 	rapidjson::Document d;
@@ -652,15 +786,18 @@ Data::on_connect_order_count()
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	d.Accept(writer);
 
-	return buffer.GetString();
+	std::shared_ptr<const std::string> json =
+	  std::make_shared<const std::string>(buffer.GetString(), buffer.GetSize());
+	snapshots_["order-count"] = {signature, json};
+	return json;
 }
 
 /**
  * @brief Create a string of a JSON array containing the data of all current machine info facts
  *
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_machine_info()
 {
 	return on_connect_info("machine", &Data::get_machine_info_fact<rapidjson::Value>);
@@ -671,27 +808,30 @@ Data::on_connect_machine_info()
  *
  * @param tmpl_name
  * @param get_info_fact
- * @return std::string
+ * @return std::shared_ptr<const std::string>
  */
-std::string
+std::shared_ptr<const std::string>
 Data::on_connect_info(std::string tmpl_name,
                       void (Data::*get_info_fact)(rapidjson::Value *,
                                                   rapidjson::Document::AllocatorType &,
                                                   CLIPS::Fact::pointer))
 {
-	MutexLocker         lock(&env_mutex_);
+	MutexLocker lock(&env_mutex_);
+
+	SnapshotSignature                  signature = snapshot_signature(tmpl_name);
+	std::shared_ptr<const std::string> cached    = cached_snapshot(tmpl_name, signature);
+	if (cached) {
+		return cached;
+	}
+
 	rapidjson::Document d;
 	d.SetArray();
 	rapidjson::Document::AllocatorType &alloc = d.GetAllocator();
 	std::vector<CLIPS::Fact::pointer>   facts = {};
 
 	//get machine facts pointers
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, tmpl_name)) {
-			facts.push_back(fact);
-		}
-		fact = fact->next();
+	for (CLIPS::Fact::pointer fact = first_fact(tmpl_name); fact; fact = next_fact(fact)) {
+		facts.push_back(fact);
 	}
 	d.Reserve(facts.size(), alloc);
 
@@ -708,11 +848,128 @@ Data::on_connect_info(std::string tmpl_name,
 		}
 	}
 
-	//write to string and return
+	//write to string, remember and return
 	rapidjson::StringBuffer                    buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	d.Accept(writer);
-	return buffer.GetString();
+	std::shared_ptr<const std::string> json =
+	  std::make_shared<const std::string>(buffer.GetString(), buffer.GetSize());
+	snapshots_[tmpl_name] = {signature, json};
+	return json;
+}
+
+/**
+ * @brief Publish the data sent to freshly connected clients
+ *
+ *  Serializes everything a client receives on connect and atomically replaces the
+ *  previously published snapshot, so that client threads never need to lock the
+ *  environment. Parts whose facts did not change are taken from the snapshot cache.
+ *  If nothing changed, the previous snapshot is kept.
+ *  Must be called by the game thread with the environment mutex held.
+ *
+ * @param version version of the new snapshot, increases with every change
+ * @return true if a new snapshot has been published, false if it would equal the previous one
+ */
+bool
+Data::publish_snapshot(uint64_t version)
+{
+	std::shared_ptr<ConnectSnapshot> s = std::make_shared<ConnectSnapshot>();
+	s->version                         = version;
+
+	CLIPS::Fact::pointer gamestate = first_fact("gamestate");
+	if (gamestate) {
+		try {
+			s->gamestate = get_value<std::string>(gamestate, "state");
+			s->gamephase = get_value<std::string>(gamestate, "phase");
+		} catch (Exception &e) {
+			logger_->log_error("Websocket", "can't access value(s) of fact of type gamestate");
+		}
+	}
+	s->known_teams    = on_connect_known_teams();
+	s->order_count    = on_connect_order_count();
+	s->machine_info   = on_connect_machine_info();
+	s->order_info     = on_connect_order_info();
+	s->robot_info     = on_connect_robot_info();
+	s->workpiece_info = on_connect_workpiece_info();
+	s->ring_spec      = on_connect_ring_spec();
+	s->points         = on_connect_points();
+
+	//cached parts are shared, so comparing the pointers is enough
+	std::shared_ptr<const ConnectSnapshot> prev = std::atomic_load(&connect_snapshot_);
+	if (prev && prev->gamestate == s->gamestate && prev->gamephase == s->gamephase
+	    && prev->known_teams == s->known_teams && prev->order_count == s->order_count
+	    && prev->machine_info == s->machine_info && prev->order_info == s->order_info
+	    && prev->robot_info == s->robot_info && prev->workpiece_info == s->workpiece_info
+	    && prev->ring_spec == s->ring_spec && prev->points == s->points) {
+		return false;
+	}
+
+	std::atomic_store(&connect_snapshot_, std::shared_ptr<const ConnectSnapshot>(std::move(s)));
+	return true;
+}
+
+/**
+ * @brief Get the most recently published data for freshly connected clients
+ *
+ * @return std::shared_ptr<const ConnectSnapshot> snapshot, null if none has been published yet
+ */
+std::shared_ptr<const Data::ConnectSnapshot>
+Data::connect_snapshot()
+{
+	return std::atomic_load(&connect_snapshot_);
+}
+
+/**
+ * @brief Compute the signature of all facts a snapshot of the given template is built from
+ *
+ * Modifying a fact in CLIPS retracts it and asserts a new one with a larger fact index,
+ * so the count and index sum of the involved templates change with every modification.
+ * Must be called with the environment mutex held.
+ *
+ * @param tmpl_name template name of the snapshot
+ * @return SnapshotSignature signature of the current facts
+ */
+Data::SnapshotSignature
+Data::snapshot_signature(const std::string &tmpl_name)
+{
+	//machine and order info also read facts of other templates
+	static const std::map<std::string, std::vector<std::string>> dependencies = {
+	  {"machine", {"machine", "bs-meta", "cs-meta", "rs-meta", "ds-meta", "machine-lights"}},
+	  {"order", {"order", "product-processed", "referee-confirmation"}}};
+
+	std::vector<std::string> tmpl_names = {tmpl_name};
+	auto                     d          = dependencies.find(tmpl_name);
+	if (d != dependencies.end()) {
+		tmpl_names = d->second;
+	}
+
+	SnapshotSignature signature;
+	for (const std::string &name : tmpl_names) {
+		long int count = 0, index_sum = 0;
+		for (CLIPS::Fact::pointer fact = first_fact(name); fact; fact = next_fact(fact)) {
+			count++;
+			index_sum += fact->index();
+		}
+		signature.push_back(std::make_pair(count, index_sum));
+	}
+	return signature;
+}
+
+/**
+ * @brief Get a previously built snapshot if it is still up to date
+ *
+ * @param key key of the snapshot
+ * @param signature signature of the current facts
+ * @return std::shared_ptr<const std::string> snapshot, null if outdated or not existing
+ */
+std::shared_ptr<const std::string>
+Data::cached_snapshot(const std::string &key, const SnapshotSignature &signature)
+{
+	auto s = snapshots_.find(key);
+	if (s != snapshots_.end() && s->second.signature == signature) {
+		return s->second.json;
+	}
+	return nullptr;
 }
 
 /**
@@ -781,8 +1038,12 @@ Data::get_machine_info_fact(T                                  *o,
 	json_string.SetInt((get_value<int64_t>(fact, "rotation")));
 	(*o).AddMember("rotation", json_string, alloc);
 
-	CLIPS::Fact::pointer meta_fact = env_->get_facts();
-	while (meta_fact) {
+	// only the meta template matching the machine type can contain the machine
+	std::string meta_tmpl = get_value<std::string>(fact, "mtype");
+	std::transform(meta_tmpl.begin(), meta_tmpl.end(), meta_tmpl.begin(), ::tolower);
+	meta_tmpl += "-meta";
+	for (CLIPS::Fact::pointer meta_fact = first_fact(meta_tmpl); meta_fact;
+	     meta_fact                      = next_fact(meta_fact)) {
 		if (match(meta_fact, "cs-meta")
 		    && get_value<std::string>(fact, "name") == get_value<std::string>(meta_fact, "name")) {
 			json_string.SetString((get_value<std::string>(meta_fact, "cs-operation")).c_str(), alloc);
@@ -822,12 +1083,10 @@ Data::get_machine_info_fact(T                                  *o,
 			(*o).AddMember("ds_order", json_string, alloc);
 			break;
 		}
-		meta_fact = meta_fact->next();
 	}
-	CLIPS::Fact::pointer lights_fact = env_->get_facts();
-	while (lights_fact) {
-		if (match(lights_fact, "machine-lights")
-		    && get_value<std::string>(fact, "name") == get_value<std::string>(lights_fact, "name")) {
+	for (CLIPS::Fact::pointer lights_fact = first_fact("machine-lights"); lights_fact;
+	     lights_fact                      = next_fact(lights_fact)) {
+		if (get_value<std::string>(fact, "name") == get_value<std::string>(lights_fact, "name")) {
 			rapidjson::Value lights_array(rapidjson::kArrayType);
 			lights_array.Reserve(get_values(fact, "actual-lights").size(), alloc);
 			for (const auto &e : get_values(fact, "actual-lights")) {
@@ -838,7 +1097,6 @@ Data::get_machine_info_fact(T                                  *o,
 			(*o).AddMember("actual_lights", lights_array, alloc);
 			break;
 		}
-		lights_fact = lights_fact->next();
 	}
 }
 
@@ -922,34 +1180,30 @@ Data::get_unconfirmed_delivery_fact(rapidjson::Document::AllocatorType &alloc, i
 	rapidjson::Value unconfirmed_delivery(rapidjson::kArrayType);
 	rapidjson::Value json_string;
 
-	CLIPS::Fact::pointer delivery = env_->get_facts();
-	while (delivery) {
-		if (match(delivery, "product-processed")) {
-			if (get_value<std::string>(delivery, "confirmed") == "FALSE"
-			    && get_value<int64_t>(delivery, "order") == id
-			    && get_value<std::string>(delivery, "mtype") == "DS") {
-				CLIPS::Fact::pointer referee_confirmation = env_->get_facts();
-				while (referee_confirmation) {
-					if (match(referee_confirmation, "referee-confirmation")
-					    && get_value<int64_t>(delivery, "id")
-					         == get_value<int64_t>(referee_confirmation, "process-id")
-					    && get_value<std::string>(referee_confirmation, "state") == "REQUIRED") {
-						rapidjson::Value o;
-						o.SetObject();
-						json_string.SetInt((get_value<int64_t>(delivery, "id")));
-						o.AddMember("delivery_id", json_string, alloc);
-						json_string.SetString((get_value<std::string>(delivery, "team")).c_str(), alloc);
-						o.AddMember("team", json_string, alloc);
-						json_string.SetFloat((get_value<float>(delivery, "game-time")));
-						o.AddMember("game_time", json_string, alloc);
-
-						unconfirmed_delivery.PushBack(o, alloc);
-					}
-					referee_confirmation = referee_confirmation->next();
+	for (CLIPS::Fact::pointer delivery = first_fact("product-processed"); delivery;
+	     delivery                      = next_fact(delivery)) {
+		if (get_value<std::string>(delivery, "confirmed") == "FALSE"
+		    && get_value<int64_t>(delivery, "order") == id
+		    && get_value<std::string>(delivery, "mtype") == "DS") {
+			for (CLIPS::Fact::pointer referee_confirmation = first_fact("referee-confirmation");
+			     referee_confirmation;
+			     referee_confirmation = next_fact(referee_confirmation)) {
+				if (get_value<int64_t>(delivery, "id")
+				      == get_value<int64_t>(referee_confirmation, "process-id")
+				    && get_value<std::string>(referee_confirmation, "state") == "REQUIRED") {
+					rapidjson::Value o;
+					o.SetObject();
+					json_string.SetInt((get_value<int64_t>(delivery, "id")));
+					o.AddMember("delivery_id", json_string, alloc);
+					json_string.SetString((get_value<std::string>(delivery, "team")).c_str(), alloc);
+					o.AddMember("team", json_string, alloc);
+					json_string.SetFloat((get_value<float>(delivery, "game-time")));
+					o.AddMember("game_time", json_string, alloc);
+
+					unconfirmed_delivery.PushBack(o, alloc);
 				}
 			}
 		}
-		delivery = delivery->next();
 	}
 
 	return unconfirmed_delivery;
@@ -1171,15 +1425,11 @@ Data::get_workpiece_info_fact(T                                  *o,
 std::string
 Data::get_gamephase()
 {
-	MutexLocker                       lock(&env_mutex_);
-	std::vector<CLIPS::Fact::pointer> facts = {};
+	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "gamestate")) {
-			return get_value<std::string>(fact, "phase");
-		}
-		fact = fact->next();
+	CLIPS::Fact::pointer fact = first_fact("gamestate");
+	if (fact) {
+		return get_value<std::string>(fact, "phase");
 	}
 	return NULL;
 }
@@ -1192,15 +1442,11 @@ Data::get_gamephase()
 std::string
 Data::get_gamestate()
 {
-	MutexLocker                       lock(&env_mutex_);
-	std::vector<CLIPS::Fact::pointer> facts = {};
+	MutexLocker lock(&env_mutex_);
 
-	CLIPS::Fact::pointer fact = env_->get_facts();
-	while (fact) {
-		if (match(fact, "gamestate")) {
-			return get_value<std::string>(fact, "state");
-		}
-		fact = fact->next();
+	CLIPS::Fact::pointer fact = first_fact("gamestate");
+	if (fact) {
+		return get_value<std::string>(fact, "state");
 	}
 	return NULL;
 }
@@ -23,6 +23,7 @@
 
 #include "client.h"
 #include "logging/logger.h"
+#include "send_queue.h"
 
 #include <clipsmm.h>
 
@@ -31,12 +32,19 @@
 #include <rapidjson/schema.h>
 
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <vector>
 
+namespace fawkes {
+class LatencyTracker;
+}
+
 using namespace fawkes;
 namespace llsfrb::websocket {
 class Client; // forward declaration
@@ -45,15 +53,48 @@ class Data
 {
 public:
 	Data(std::shared_ptr<Logger> logger, CLIPS::Environment *env, fawkes::Mutex &env_mutex);
-	std::string log_pop();
-	void        log_push(std::string log);
-	void        log_push(rapidjson::Document &d);
-	bool        log_empty();
-	void        log_wait();
-	void        clients_add(std::shared_ptr<Client> client);
-	void        clients_send_all(std::string msg);
-	void        clients_send_all(rapidjson::Document &d);
+	OutboundMessage log_pop();
+	void            log_push(std::string log, std::string coalesce_key = "");
+	void log_push(std::shared_ptr<const std::string> log, std::string coalesce_key = "");
+	void log_push(rapidjson::Document &d, std::string coalesce_key = "");
+	bool            log_empty();
+	void            log_wait();
+	void            clients_add(std::shared_ptr<Client> client);
+	void            clients_send_all(const OutboundMessage &msg);
+	void            clients_send_all(std::string msg);
+	void            clients_send_all(rapidjson::Document &d);
+	void            set_latency_tracker(fawkes::LatencyTracker *tracker, unsigned int cls);
 	void        log_push_attention_message(std::string text, std::string team, std::string time);
+
+	/** Game state sent to freshly connected clients, published by the game thread. */
+	struct ConnectSnapshot
+	{
+		/** Game state version the snapshot was taken at. */
+		uint64_t version;
+		/** Current game state. */
+		std::string gamestate;
+		/** Current game phase. */
+		std::string gamephase;
+		/** Serialized known teams. */
+		std::shared_ptr<const std::string> known_teams;
+		/** Serialized order count. */
+		std::shared_ptr<const std::string> order_count;
+		/** Serialized machine info. */
+		std::shared_ptr<const std::string> machine_info;
+		/** Serialized order info. */
+		std::shared_ptr<const std::string> order_info;
+		/** Serialized robot info. */
+		std::shared_ptr<const std::string> robot_info;
+		/** Serialized workpiece info. */
+		std::shared_ptr<const std::string> workpiece_info;
+		/** Serialized ring specs. */
+		std::shared_ptr<const std::string> ring_spec;
+		/** Serialized points. */
+		std::shared_ptr<const std::string> points;
+	};
+	bool                                   publish_snapshot(uint64_t version);
+	std::shared_ptr<const ConnectSnapshot> connect_snapshot();
+
 	std::function<void(std::string)>                 clips_set_gamestate;
 	std::function<void(std::string)>                 clips_set_gamephase;
 	std::function<void()>                            clips_randomize_field;
@@ -74,16 +115,16 @@ public:
 	void        log_push_machine_info(std::string name);
 	void        log_push_workpiece_info(int id);
 	void        log_push_order_info_via_delivery(int delivery_id);
-	std::string on_connect_known_teams();
-	std::string on_connect_machine_info();
-	std::string on_connect_order_info();
-	std::string on_connect_order_count();
-	std::string on_connect_workpiece_info();
-	std::string on_connect_robot_info();
-	std::string on_connect_ring_spec();
-	std::string on_connect_points();
-	std::string get_gamestate();
-	std::string get_gamephase();
+	std::shared_ptr<const std::string> on_connect_known_teams();
+	std::shared_ptr<const std::string> on_connect_machine_info();
+	std::shared_ptr<const std::string> on_connect_order_info();
+	std::shared_ptr<const std::string> on_connect_order_count();
+	std::shared_ptr<const std::string> on_connect_workpiece_info();
+	std::shared_ptr<const std::string> on_connect_robot_info();
+	std::shared_ptr<const std::string> on_connect_ring_spec();
+	std::shared_ptr<const std::string> on_connect_points();
+	std::string                        get_gamestate();
+	std::string                        get_gamephase();
 	std::map<std::string, std::shared_ptr<rapidjson::SchemaDocument>> command_schema_map;
 	template <class T>
 	void
@@ -112,21 +153,52 @@ public:
 
 	rapidjson::Value get_unconfirmed_delivery_fact(rapidjson::Document::AllocatorType &alloc,
 	                                               int64_t                             id);
-	std::string      on_connect_info(std::string tmpl_name,
-	                                 void (Data::*get_info_fact)(rapidjson::Value *,
-                                                          rapidjson::Document::AllocatorType &,
-                                                          CLIPS::Fact::pointer));
+	std::shared_ptr<const std::string>
+	on_connect_info(std::string tmpl_name,
+	                void (Data::*get_info_fact)(rapidjson::Value *,
+	                                            rapidjson::Document::AllocatorType &,
+	                                            CLIPS::Fact::pointer));
 
 private:
+	/// per template fact count and sum of fact indices, changes whenever a fact is (re)asserted
+	typedef std::vector<std::pair<long int, long int>> SnapshotSignature;
+
+	struct Snapshot
+	{
+		SnapshotSignature                  signature;
+		std::shared_ptr<const std::string> json;
+	};
+
+	struct EntityState
+	{
+		std::unique_ptr<rapidjson::Document> doc;
+		uint64_t                             version = 0;
+	};
+
+	SnapshotSignature                          snapshot_signature(const std::string &tmpl_name);
+	std::shared_ptr<const std::string>         cached_snapshot(const std::string       &key,
+	                                                           const SnapshotSignature &signature);
+	void                                       make_delta(const rapidjson::Value &prev,
+	                                                      const rapidjson::Value &cur,
+	                                                      uint64_t                version,
+	                                                      rapidjson::Document    &delta);
 	std::shared_ptr<Logger>                    logger_;
 	std::mutex                                 log_mu;
 	std::mutex                                 cli_mu;
 	std::condition_variable                    log_cv;
-	std::queue<std::string>                    logs;
+	std::queue<OutboundMessage>                logs;
 	std::vector<std::shared_ptr<Client>>       clients;
 	std::shared_ptr<CLIPS::Environment>        env_;
 	fawkes::Mutex                             &env_mutex_;
+	std::map<std::string, Snapshot>            snapshots_;
+	std::mutex                                 entity_mu;
+	std::map<std::string, EntityState>         entities_;
+	std::shared_ptr<const ConnectSnapshot>     connect_snapshot_;
+	fawkes::LatencyTracker                    *latency_tracker_;
+	unsigned int                               latency_class_;
 	std::shared_ptr<rapidjson::SchemaDocument> load_schema(std::string path);
+	CLIPS::Fact::pointer                       first_fact(const std::string &tmpl_name);
+	CLIPS::Fact::pointer                       next_fact(const CLIPS::Fact::pointer &fact);
 };
 
 } // namespace llsfrb::websocket
@@ -0,0 +1,57 @@
+/***************************************************************************
+ *  send_queue.h - types for queueing messages to frontend clients
+ *
+ *  Created: Fri Oct 16 13:41:08 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+#ifndef _PLUGINS_WEBSOCKET_SEND_QUEUE_H_
+#define _PLUGINS_WEBSOCKET_SEND_QUEUE_H_
+
+#include <memory>
+#include <string>
+
+namespace llsfrb::websocket {
+
+/**
+ * @brief Policy applied when a client's outbound queue is full
+ *
+ */
+enum class SlowConsumerPolicy {
+	COALESCE,    ///< replace pending updates of the same entity, otherwise drop the oldest
+	DROP_OLDEST, ///< drop the oldest pending message
+	DISCONNECT   ///< disconnect the client
+};
+
+SlowConsumerPolicy slow_consumer_policy_from_string(const std::string &policy);
+
+/**
+ * @brief Message queued for sending to clients
+ *
+ *  The payload is shared among all clients it is sent to. Messages with the same
+ *  non-empty coalesce key describe the same entity, a newer one supersedes an older one.
+ *  Clients which enabled delta updates receive the delta payload instead, if there is one.
+ */
+struct OutboundMessage
+{
+	std::shared_ptr<const std::string> payload;      ///< serialized message
+	std::string                        coalesce_key; ///< entity key, empty if not coalescable
+	/// changed fields with respect to the previous message of the same entity, may be null
+	std::shared_ptr<const std::string> delta_payload;
+};
+
+} // namespace llsfrb::websocket
+
+#endif
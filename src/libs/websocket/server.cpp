@@ -79,13 +79,13 @@ Server::operator()()
 			// websocket approach
 			std::shared_ptr<boost::beast::websocket::stream<tcp::socket>> web_socket =
 			  std::make_shared<boost::beast::websocket::stream<tcp::socket>>(std::move(*socket));
-			std::shared_ptr<Client> client =
-			  std::make_shared<ClientWS>(web_socket, logger_, data_, client_can_send);
+			std::shared_ptr<Client> client = std::make_shared<ClientWS>(
+			  web_socket, logger_, data_, client_can_send, send_queue_size_, policy_);
 			data_->clients_add(client);
 		} else {
 			// socket approach
-			std::shared_ptr<Client> client =
-			  std::make_shared<ClientS>(socket, logger_, data_, client_can_send);
+			std::shared_ptr<Client> client = std::make_shared<ClientS>(
+			  socket, logger_, data_, client_can_send, send_queue_size_, policy_);
 			data_->clients_add(client);
 		}
 
@@ -99,13 +99,21 @@ Server::operator()()
  * @param port port on which the server runs on
  * @param ws_mode true if websocket only mode
  * @param allow_control_all if true, devices with not local host ip addresses can send control commands
+ * @param send_queue_size maximum number of messages waiting to be sent to a single client
+ * @param policy what to do with a client whose send queue is full
  */
 void
-Server::configure(uint port, bool ws_mode = true, bool allow_control_all = false)
+Server::configure(uint               port,
+                  bool               ws_mode,
+                  bool               allow_control_all,
+                  size_t             send_queue_size,
+                  SlowConsumerPolicy policy)
 {
 	port_              = port;
 	ws_mode_           = ws_mode;
 	allow_control_all_ = allow_control_all;
+	send_queue_size_   = send_queue_size;
+	policy_            = policy;
 }
 
 } // namespace llsfrb::websocket
@@ -23,6 +23,7 @@
 
 #include "data.h"
 #include "logging/logger.h"
+#include "send_queue.h"
 
 namespace llsfrb::websocket {
 
@@ -33,7 +34,11 @@ public:
 	Server();
 
 	void operator()();
-	void configure(uint port, bool ws_mode, bool allow_control_all);
+	void configure(uint               port,
+	               bool               ws_mode,
+	               bool               allow_control_all,
+	               size_t             send_queue_size,
+	               SlowConsumerPolicy policy);
 
 private:
 	std::shared_ptr<Data>   data_;
@@ -41,6 +46,8 @@ private:
 	uint                    port_              = 1234;
 	bool                    ws_mode_           = true;
 	bool                    allow_control_all_ = false;
+	size_t                  send_queue_size_   = 256;
+	SlowConsumerPolicy      policy_            = SlowConsumerPolicy::COALESCE;
 };
 
 } // namespace llsfrb::websocket
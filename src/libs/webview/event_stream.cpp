@@ -0,0 +1,274 @@
+
+/***************************************************************************
+ *  event_stream.cpp - Server-sent events publisher
+ *
+ *  Created: Fri Oct 16 15:12:40 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+#include <webview/event_stream.h>
+#include <webview/reply.h>
+#include <webview/request.h>
+
+#include <algorithm>
+#include <cstring>
+#include <microhttpd.h>
+
+namespace fawkes {
+
+/** @class WebEventStream <webview/event_stream.h>
+ * Server-sent events publisher.
+ * A single publisher formats each event once and hands the same frame to
+ * all subscribed HTTP clients (text/event-stream). Each subscriber has a
+ * bounded queue of pending frames. While a subscriber's queue is empty its
+ * connection is suspended in libmicrohttpd, so idle streams do not occupy a
+ * server thread; publishing resumes it. A subscriber that does not keep up
+ * and overflows its queue is disconnected rather than slowing down the
+ * publisher or buffering without bound. Browsers using EventSource then
+ * reconnect. A new subscriber first receives the events returned by the
+ * function passed to set_initial_events(), so that it starts from the
+ * current state rather than waiting for the next change.
+ *
+ * The server must be started with suspend/resume support, which
+ * WebServer enables by default.
+ */
+
+/** Reply streaming the events of one subscriber. */
+class WebEventStream::Reply : public DynamicWebReply
+{
+public:
+	Reply(std::shared_ptr<WebEventStream> stream, std::shared_ptr<Subscriber> subscriber)
+	: DynamicWebReply(WebReply::HTTP_OK), stream_(stream), subscriber_(subscriber)
+	{
+		add_header("Content-type", "text/event-stream");
+		add_header("X-Accel-Buffering", "no");
+		set_caching(false);
+	}
+
+	virtual ~Reply()
+	{
+		stream_->unsubscribe(subscriber_);
+	}
+
+	virtual size_t
+	size()
+	{
+		return MHD_SIZE_UNKNOWN;
+	}
+
+	virtual size_t
+	next_chunk(size_t pos, char *buffer, size_t buf_max_size)
+	{
+		std::lock_guard<std::mutex> lock(stream_->mutex_);
+
+		Subscriber &s = *subscriber_;
+		if (s.closed)
+			return (size_t)MHD_CONTENT_READER_END_OF_STREAM;
+
+		if (s.queue.empty()) {
+			// nothing to send, park the connection until the next publish()
+			s.suspended = true;
+			MHD_suspend_connection(s.connection);
+			return 0;
+		}
+
+		size_t written = 0;
+		while (!s.queue.empty() && written < buf_max_size) {
+			const std::string &frame = *s.queue.front();
+			size_t             n     = std::min(frame.size() - s.offset, buf_max_size - written);
+			memcpy(buffer + written, frame.data() + s.offset, n);
+			written += n;
+			s.offset += n;
+			if (s.offset == frame.size()) {
+				s.queue.pop_front();
+				s.offset = 0;
+			}
+		}
+		return written;
+	}
+
+private:
+	std::shared_ptr<WebEventStream> stream_;
+	std::shared_ptr<Subscriber>     subscriber_;
+};
+
+/** Constructor.
+ * @param queue_size maximum number of events queued per subscriber before
+ * the subscriber is disconnected
+ * @param max_subscribers maximum number of concurrent subscribers, further
+ * requests are rejected with 503 Service Unavailable
+ */
+WebEventStream::WebEventStream(size_t queue_size, size_t max_subscribers)
+: queue_size_(queue_size > 0 ? queue_size : 1),
+  max_subscribers_(max_subscribers),
+  closed_(false),
+  dropped_(0)
+{
+}
+
+/** Destructor. */
+WebEventStream::~WebEventStream()
+{
+}
+
+/** Subscribe to the event stream.
+ * This is meant to be registered as URL handler.
+ * @param request request to subscribe
+ * @return streaming reply, or an error reply if the stream is closed or
+ * the subscriber limit has been reached
+ */
+WebReply *
+WebEventStream::subscribe(const WebRequest *request)
+{
+	std::shared_ptr<Subscriber>         subscriber;
+	std::function<std::vector<Event>()> initial_events;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (closed_ || subscribers_.size() >= max_subscribers_) {
+			return no_caching(
+			  new StaticWebReply(WebReply::HTTP_SERVICE_UNAVAILABLE, "Event stream unavailable\n"));
+		}
+
+		subscriber             = std::make_shared<Subscriber>();
+		subscriber->connection = request->connection();
+		subscriber->offset     = 0;
+		subscriber->suspended  = false;
+		subscriber->closed     = false;
+		subscribers_.push_back(subscriber);
+		initial_events = initial_events_;
+	}
+
+	if (initial_events) {
+		// The subscriber is registered first, so that events published while
+		// the initial ones are generated are queued after them and not lost.
+		std::vector<std::shared_ptr<const std::string>> frames;
+		for (const Event &e : initial_events()) {
+			frames.push_back(format(e.event, e.data, e.id));
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!subscriber->closed) {
+			subscriber->queue.insert(subscriber->queue.begin(), frames.begin(), frames.end());
+		}
+	}
+
+	return new Reply(shared_from_this(), subscriber);
+}
+
+/** Set function providing the current state for new subscribers.
+ * The function is called on every subscription without holding the
+ * stream's lock, it must therefore not block on the publisher.
+ * @param initial_events function returning the events to send to a new
+ * subscriber before any published one, empty to send none
+ */
+void
+WebEventStream::set_initial_events(std::function<std::vector<Event>()> initial_events)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	initial_events_ = initial_events;
+}
+
+/** Publish an event to all subscribers.
+ * @param event event name, clients register listeners by this name
+ * @param data event payload, may span multiple lines
+ * @param id event ID, omitted if zero
+ */
+void
+WebEventStream::publish(const std::string &event, const std::string &data, uint64_t id)
+{
+	std::shared_ptr<const std::string> shared_frame = format(event, data, id);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto &s : subscribers_) {
+		if (s->closed)
+			continue;
+		if (s->queue.size() >= queue_size_) {
+			// slow consumer, drop it rather than buffer without bound
+			s->closed = true;
+			s->queue.clear();
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			s->queue.push_back(shared_frame);
+		}
+		resume(*s);
+	}
+}
+
+/** Close the stream.
+ * Ends all active subscriptions and rejects new ones. Call this before
+ * stopping the web server so that no connection remains suspended.
+ */
+void
+WebEventStream::close()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	closed_ = true;
+	for (auto &s : subscribers_) {
+		s->closed = true;
+		s->queue.clear();
+		resume(*s);
+	}
+}
+
+/** Get number of active subscribers.
+ * @return number of active subscribers
+ */
+size_t
+WebEventStream::num_subscribers()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return subscribers_.size();
+}
+
+void
+WebEventStream::unsubscribe(const std::shared_ptr<Subscriber> &subscriber)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	subscribers_.remove(subscriber);
+}
+
+void
+WebEventStream::resume(Subscriber &subscriber)
+{
+	if (subscriber.suspended) {
+		subscriber.suspended = false;
+		MHD_resume_connection(subscriber.connection);
+	}
+}
+
+/** Format an event frame.
+ * @param event event name
+ * @param data event payload, may span multiple lines
+ * @param id event ID, omitted if zero
+ * @return event frame
+ */
+std::shared_ptr<const std::string>
+WebEventStream::format(const std::string &event, const std::string &data, uint64_t id)
+{
+	std::string frame;
+	frame.reserve(event.size() + data.size() + 32);
+	if (id != 0) {
+		frame += "id: " + std::to_string(id) + "\n";
+	}
+	frame += "event: " + event + "\n";
+	std::string::size_type start = 0, end;
+	while ((end = data.find('\n', start)) != std::string::npos) {
+		frame += "data: " + data.substr(start, end - start) + "\n";
+		start = end + 1;
+	}
+	frame += "data: " + data.substr(start) + "\n\n";
+	return std::make_shared<const std::string>(std::move(frame));
+}
+
+} // end namespace fawkes
@@ -0,0 +1,104 @@
+
+/***************************************************************************
+ *  event_stream.h - Server-sent events publisher
+ *
+ *  Created: Fri Oct 16 15:12:40 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+#ifndef _LIBS_WEBVIEW_EVENT_STREAM_H_
+#define _LIBS_WEBVIEW_EVENT_STREAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct MHD_Connection;
+
+namespace fawkes {
+
+class WebReply;
+class WebRequest;
+
+class WebEventStream : public std::enable_shared_from_this<WebEventStream>
+{
+public:
+	/** An event to be sent. */
+	struct Event
+	{
+		/** Event name. */
+		std::string event;
+		/** Event payload. */
+		std::string data;
+		/** Event ID, omitted if zero. */
+		uint64_t id;
+	};
+
+	WebEventStream(size_t queue_size = 64, size_t max_subscribers = 32);
+	~WebEventStream();
+
+	WebReply *subscribe(const WebRequest *request);
+	void      publish(const std::string &event, const std::string &data, uint64_t id = 0);
+	void      close();
+	void      set_initial_events(std::function<std::vector<Event>()> initial_events);
+
+	size_t num_subscribers();
+
+	/** Get number of subscribers disconnected because they did not keep up.
+	 * @return number of dropped subscribers */
+	unsigned long
+	dropped_subscribers() const
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+private:
+	class Reply;
+
+	struct Subscriber
+	{
+		MHD_Connection                                *connection;
+		std::deque<std::shared_ptr<const std::string>> queue;
+		size_t                                         offset;
+		bool                                           suspended;
+		bool                                           closed;
+	};
+
+	void unsubscribe(const std::shared_ptr<Subscriber> &subscriber);
+	void resume(Subscriber &subscriber);
+
+	static std::shared_ptr<const std::string>
+	format(const std::string &event, const std::string &data, uint64_t id);
+
+private:
+	size_t queue_size_;
+	size_t max_subscribers_;
+
+	std::mutex                             mutex_;
+	std::list<std::shared_ptr<Subscriber>> subscribers_;
+	std::function<std::vector<Event>()>    initial_events_;
+	bool                                   closed_;
+	std::atomic<unsigned long>             dropped_;
+};
+
+} // end namespace fawkes
+
+#endif
@@ -0,0 +1,127 @@
+
+/***************************************************************************
+ *  qa_rest_api_etag.cpp - QA for conditional requests of versioned handlers
+ *
+ *  Created: Fri Oct 16 22:03:41 2026
+ ****************************************************************************/
+
+/*  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  Read the full text in the LICENSE.GPL file in the doc directory.
+ */
+
+// Do not mention in API doc
+/// @cond QA
+
+#include <logging/console.h>
+#include <webview/reply.h>
+#include <webview/request.h>
+#include <webview/rest_api.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+using namespace fawkes;
+
+static int failures = 0;
+
+static void
+check(bool cond, const char *what)
+{
+	printf("%s: %s\n", cond ? "OK  " : "FAIL", what);
+	if (!cond)
+		++failures;
+}
+
+static std::unique_ptr<WebReply>
+get(WebviewRestApi &api, const std::string &path, const std::string &if_none_match = "")
+{
+	WebRequest request(path.c_str());
+	if (!if_none_match.empty()) {
+		request.set_header("If-None-Match", if_none_match);
+	}
+	return std::unique_ptr<WebReply>(api.process_request(&request, path));
+}
+
+static std::string
+etag(const std::unique_ptr<WebReply> &reply)
+{
+	auto h = reply->headers().find("ETag");
+	return (h != reply->headers().end()) ? h->second : "";
+}
+
+int
+main(int argc, char **argv)
+{
+	llsfrb::ConsoleLogger logger;
+	WebviewRestApi        api("qa", &logger);
+
+	uint64_t     state_version = 1, other_version = 1;
+	unsigned int state_calls = 0, other_calls = 0;
+
+	api.add_handler(WebRequest::METHOD_GET,
+	                "/state",
+	                [&](std::string, WebviewRestParams &) -> std::unique_ptr<WebReply> {
+		                ++state_calls;
+		                std::string body = "state " + std::to_string(state_version);
+		                return std::make_unique<StaticWebReply>(WebReply::HTTP_OK, body);
+	                });
+	api.add_handler(WebRequest::METHOD_GET,
+	                "/other",
+	                [&](std::string, WebviewRestParams &) -> std::unique_ptr<WebReply> {
+		                ++other_calls;
+		                return std::make_unique<StaticWebReply>(WebReply::HTTP_OK, "other");
+	                });
+	api.set_versioned(WebRequest::METHOD_GET, "/state", [&]() { return state_version; });
+	api.set_versioned(WebRequest::METHOD_GET, "/other", [&]() { return other_version; });
+
+	std::unique_ptr<WebReply> r = get(api, "/state");
+	check(r->code() == WebReply::HTTP_OK && state_calls == 1, "first request is answered by handler");
+	std::string tag = etag(r);
+	check(!tag.empty(), "reply carries an ETag");
+
+	r = get(api, "/state", tag);
+	check(r->code() == WebReply::HTTP_NOT_MODIFIED, "unchanged state is not modified");
+	r = get(api, "/state", tag);
+	check(r->code() == WebReply::HTTP_NOT_MODIFIED, "second unchanged request is not modified");
+	check(etag(r) == tag, "not modified reply carries the same ETag");
+	check(state_calls == 1, "handler is not called for not modified replies");
+
+	r = get(api, "/state");
+	check(r->code() == WebReply::HTTP_OK && state_calls == 1, "unconditional request is cached");
+
+	// a change behind another route does not invalidate this one
+	++other_version;
+	r = get(api, "/state", tag);
+	check(r->code() == WebReply::HTTP_NOT_MODIFIED, "change of other route keeps tag valid");
+	r = get(api, "/other");
+	check(r->code() == WebReply::HTTP_OK && other_calls == 1, "other route is answered by handler");
+
+	++state_version;
+	r = get(api, "/state", tag);
+	check(r->code() == WebReply::HTTP_OK && state_calls == 2, "changed state is sent again");
+	check(etag(r) != tag, "changed state has a new ETag");
+	StaticWebReply *sr = dynamic_cast<StaticWebReply *>(r.get());
+	check(sr && sr->body() == "state 2", "changed state has new body");
+
+	r = get(api, "/state", etag(r));
+	check(r->code() == WebReply::HTTP_NOT_MODIFIED, "new tag is not modified");
+
+	// versions restart with the process, a tag of an earlier process with
+	// the same version must not match
+	r = get(api, "/state", "\"" + std::to_string(state_version) + "\"");
+	check(r->code() == WebReply::HTTP_OK, "tag without boot ID is not matched");
+
+	return failures == 0 ? 0 : 1;
+}
+
+/// @endcond
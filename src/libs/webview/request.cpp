@@ -81,7 +81,8 @@ header_iterator(void *cls, enum MHD_ValueKind kind, const char *key, const char
 /** Constructor.
  * @param uri URI of the request
  */
-WebRequest::WebRequest(const char *uri) : pp_(NULL), is_setup_(false), uri_(uri)
+WebRequest::WebRequest(const char *uri)
+: pp_(NULL), is_setup_(false), connection_(NULL), uri_(uri), method_(METHOD_GET)
 {
 	reply_size_ = 0;
 }
@@ -165,7 +166,8 @@ WebRequest::setup(const char     *url,
 		client_addr_ = addr_str;
 	}
 
-	is_setup_ = true;
+	connection_ = connection;
+	is_setup_   = true;
 }
 
 /** Destructor. */
@@ -112,6 +112,14 @@ public:
 		return user_;
 	}
 
+	/** Get microhttpd connection the request was received on.
+   * @return connection, NULL if the request has not been set up */
+	MHD_Connection *
+	connection() const
+	{
+		return connection_;
+	}
+
 	/** Get client address as string.
    * @return client address as string */
 	const std::string &
@@ -356,6 +364,7 @@ private:
 private:
 	MHD_PostProcessor *pp_;
 	bool               is_setup_;
+	MHD_Connection    *connection_;
 
 	std::string                        uri_;
 	std::string                        url_;
@@ -21,9 +21,14 @@
  */
 
 #include <core/exception.h>
+#include <core/threading/mutex_locker.h>
 #include <webview/rest_api.h>
 #include <webview/router.h>
 
+#include <cstdio>
+#include <random>
+#include <strings.h>
+
 using namespace llsfrb;
 
 namespace fawkes {
@@ -45,7 +50,8 @@ WebviewRestApi::WebviewRestApi(const std::string &name, llsfrb::Logger *logger)
 : name_(name),
   logger_(logger),
   pretty_json_(false),
-  router_{std::make_shared<WebviewRouter<Handler>>()}
+  router_{std::make_shared<WebviewRouter<Route>>()},
+  cache_size_(64)
 {
 }
 
@@ -58,7 +64,68 @@ WebviewRestApi::name() const
 	return name_;
 }
 
+/** Get a header value ignoring the case of its name.
+ * @param request request to get the header from
+ * @param key header name
+ * @return header value or empty string if not set
+ */
+static std::string
+header_nocase(const WebRequest *request, const char *key)
+{
+	for (const auto &h : request->headers()) {
+		if (strcasecmp(h.first.c_str(), key) == 0) {
+			return h.second;
+		}
+	}
+	return "";
+}
+
+/** Get the boot ID of this process.
+ * Route versions restart whenever the process starts. The boot ID is part
+ * of every entity tag, so that a tag cached by a client before a restart
+ * never matches a reply of the new process.
+ * @return random ID, constant for the lifetime of the process
+ */
+static const std::string &
+boot_id()
+{
+	static const std::string id = [] {
+		std::random_device rd;
+		char               buf[17];
+		snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+		return std::string(buf);
+	}();
+	return id;
+}
+
+/** Check if an If-None-Match header value matches an entity tag.
+ * @param if_none_match value of the If-None-Match header
+ * @param etag entity tag of the current reply
+ * @return true if one of the listed tags or the wildcard matches
+ */
+static bool
+etag_matches(const std::string &if_none_match, const std::string &etag)
+{
+	for (std::string tag : str_split(if_none_match, ',')) {
+		std::string::size_type b = tag.find_first_not_of(" \t");
+		std::string::size_type e = tag.find_last_not_of(" \t");
+		if (b == std::string::npos)
+			continue;
+		tag = tag.substr(b, e - b + 1);
+		if (tag.compare(0, 2, "W/") == 0)
+			tag = tag.substr(2);
+		if (tag == "*" || tag == etag)
+			return true;
+	}
+	return false;
+}
+
 /** Process REST API request.
+ * Replies of handlers marked as versioned carry an ETag derived from the
+ * version of the route and the boot ID of the process. A request whose
+ * If-None-Match header matches the current tag is answered with 304 Not
+ * Modified, and repeated requests for the same URL are answered from the
+ * cache, both without invoking the handler.
  * @param request incoming request
  * @param rest_url the URL stripped of the base URL prefix
  * @return reply
@@ -68,11 +135,73 @@ WebviewRestApi::process_request(const WebRequest *request, const std::string &re
 {
 	try {
 		std::map<std::string, std::string> path_args;
-		Handler           handler = router_->find_handler(request->method(), rest_url, path_args);
+		Route &route = router_->find_handler(request->method(), rest_url, path_args);
+
+		bool        versioned = (bool)route.version;
+		uint64_t    version   = 0;
+		std::string etag, cache_key;
+		if (versioned) {
+			// get the version before running the handler, a reply generated
+			// from newer state is then at worst revalidated once too often
+			version = route.version();
+			etag    = "\"" + boot_id() + "-" + std::to_string(version) + "\"";
+
+			if (etag_matches(header_nocase(request, "If-None-Match"), etag)) {
+				auto r = std::make_unique<WebviewRestReply>(WebReply::HTTP_NOT_MODIFIED, "");
+				r->add_header("ETag", etag);
+				r->add_header("Cache-Control", "no-cache");
+				return r.release();
+			}
+
+			cache_key = std::to_string(request->method()) + " " + rest_url;
+			for (const auto &a : request->get_values()) {
+				cache_key += (cache_key.find('?') == std::string::npos ? "?" : "&");
+				cache_key += a.first + "=" + a.second;
+			}
+
+			MutexLocker lock(&cache_mutex_);
+			auto        c = cache_.find(cache_key);
+			if (c != cache_.end() && c->second.version == version) {
+				auto r = std::make_unique<WebviewRestReply>(WebReply::HTTP_OK,
+				                                            c->second.body,
+				                                            c->second.content_type);
+				r->add_header("ETag", etag);
+				r->add_header("Cache-Control", "no-cache");
+				return r.release();
+			}
+		}
+
 		WebviewRestParams params;
 		params.set_path_args(std::move(path_args));
 		params.set_query_args(request->get_values());
-		std::unique_ptr<WebReply> reply = handler(request->body(), params);
+		std::unique_ptr<WebReply> reply = route.handler(request->body(), params);
+
+		if (versioned && reply->code() == WebReply::HTTP_OK) {
+			StaticWebReply *sreply = dynamic_cast<StaticWebReply *>(reply.get());
+			if (sreply) {
+				auto ct = reply->headers().find("Content-type");
+
+				MutexLocker lock(&cache_mutex_);
+				// replies of older versions of their route are never served again
+				if (cache_.size() >= cache_size_) {
+					for (auto c = cache_.begin(); c != cache_.end();) {
+						if (c->second.version != c->second.route_version()) {
+							c = cache_.erase(c);
+						} else {
+							++c;
+						}
+					}
+				}
+				if (cache_.size() < cache_size_ || cache_.find(cache_key) != cache_.end()) {
+					cache_[cache_key] = {route.version,
+					                     version,
+					                     sreply->body(),
+					                     ct != reply->headers().end() ? ct->second : ""};
+				}
+				reply->add_header("ETag", etag);
+				reply->add_header("Cache-Control", "no-cache");
+			}
+		}
 		return reply.release();
 	} catch (NullPointerException &e) {
 		return NULL;
@@ -87,7 +216,41 @@ WebviewRestApi::process_request(const WebRequest *request, const std::string &re
 void
 WebviewRestApi::add_handler(WebRequest::Method method, std::string path, Handler handler)
 {
-	router_->add(method, path, handler);
+	router_->add(method, path, Route{handler, nullptr});
+}
+
+/** Set maximum number of cached replies of versioned handlers.
+ * @param cache_size maximum number of cached replies, 0 to only support
+ * conditional requests
+ */
+void
+WebviewRestApi::set_reply_cache_size(size_t cache_size)
+{
+	MutexLocker lock(&cache_mutex_);
+	cache_size_ = cache_size;
+	cache_.clear();
+}
+
+/** Mark a handler as versioned.
+ * This enables conditional requests and reply caching for the handler.
+ * Its replies must only depend on the given version and the request URL
+ * including its query. Each handler can have its own version, so that a
+ * change of the state behind one handler does not invalidate the replies
+ * of the others.
+ * @param method HTTP method the handler was added for
+ * @param path path pattern the handler was added for
+ * @param version function returning the current version of the state the
+ * handler's replies depend on. The version must change whenever the reply
+ * may change.
+ */
+void
+WebviewRestApi::set_versioned(WebRequest::Method        method,
+                              const std::string        &path,
+                              std::function<uint64_t()> version)
+{
+	MutexLocker lock(&cache_mutex_);
+	router_->get(method, path).version = version;
+	cache_.clear();
 }
 
 /** Enable or disable pretty JSON printing globally.
@@ -24,12 +24,14 @@
 #define _LIBS_WEBVIEW_REST_API_H_
 
 #include <core/exception.h>
+#include <core/threading/mutex.h>
 #include <logging/logger.h>
 #include <utils/misc/string_split.h>
 #include <webview/reply.h>
 #include <webview/request.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -250,6 +252,10 @@ public:
 	const std::string &name() const;
 	void               add_handler(WebRequest::Method method, std::string path, Handler handler);
 	void               set_pretty_json(bool pretty);
+	void               set_reply_cache_size(size_t cache_size);
+	void               set_versioned(WebRequest::Method        method,
+	                                 const std::string        &path,
+	                                 std::function<uint64_t()> version);
 
 	/** Add simple handler.
 	 * For a handler that does not require input parameters and that outputs
@@ -405,10 +411,36 @@ public:
 	WebReply *process_request(const WebRequest *request, const std::string &rest_url);
 
 private:
-	std::string                             name_;
-	llsfrb::Logger                         *logger_;
-	bool                                    pretty_json_;
-	std::shared_ptr<WebviewRouter<Handler>> router_;
+	/** Registered handler. */
+	struct Route
+	{
+		/** Handler function. */
+		Handler handler;
+		/** Version of the state the reply depends on, empty if not versioned. */
+		std::function<uint64_t()> version;
+	};
+
+	/** Serialized reply of a versioned handler. */
+	struct CachedReply
+	{
+		/** Version function of the route the reply was generated for. */
+		std::function<uint64_t()> route_version;
+		/** Version the reply was generated at. */
+		uint64_t version;
+		/** Reply body. */
+		std::string body;
+		/** Reply content type. */
+		std::string content_type;
+	};
+
+	std::string                           name_;
+	llsfrb::Logger                       *logger_;
+	bool                                  pretty_json_;
+	std::shared_ptr<WebviewRouter<Route>> router_;
+
+	size_t                             cache_size_;
+	Mutex                              cache_mutex_;
+	std::map<std::string, CachedReply> cache_;
 };
 
 } // namespace fawkes
@@ -129,6 +129,24 @@ public:
 		add(method, path, handler, 0);
 	}
 
+	/** Get a handler by its registered pattern.
+	 * @param method HTTP method to match for
+	 * @param path path pattern that equals the one given when adding.
+	 * @return stored handler
+	 * @exception NullPointerException thrown if no handler has been added for the pattern
+	 */
+	T &
+	get(WebRequest::Method method, const std::string &path)
+	{
+		auto ri = std::find_if(routes_.begin(), routes_.end(), [method, &path](auto &r) -> bool {
+			return (std::get<1>(r) == method && std::get<2>(r) == path);
+		});
+		if (ri == routes_.end()) {
+			throw NullPointerException("No handler registered for %s", path.c_str());
+		}
+		return std::get<4>(*ri);
+	}
+
 	/** Remove a handler.
 	 * @param method HTTP method to match for
 	 * @param path path pattern that equals the one given when adding.
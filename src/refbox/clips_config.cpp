@@ -0,0 +1,186 @@
+/***************************************************************************
+ *  clips_config.cpp - CLIPS access to the refbox configuration
+ *
+ *  Created: Fri Oct 16 22:03:18 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clips_config.h"
+
+#include <config/config.h>
+#include <core/threading/mutex_locker.h>
+#include <logging/logger.h>
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+/** @class ClipsConfig "clips_config.h"
+ * CLIPS functions to access the refbox configuration.
+ * Provides get-clips-dirs, load-config, config-path-exists, config-get-bool,
+ * and config-get-int to the CLIPS environment. These are needed by the game
+ * code regardless of how the refbox is run, e.g., also when replaying games
+ * without any networking.
+ */
+
+/** Constructor.
+ * @param env CLIPS environment to register functions in
+ * @param env_mutex mutex to lock when accessing the environment
+ * @param config configuration to provide access to
+ * @param logger logger for warnings about unsupported values
+ * @param clips_dir directory of the game's CLIPS files, with trailing slash
+ */
+ClipsConfig::ClipsConfig(CLIPS::Environment            *env,
+                         fawkes::Mutex                 &env_mutex,
+                         std::shared_ptr<Configuration> config,
+                         Logger                        *logger,
+                         const std::string             &clips_dir)
+: clips_(env), clips_mutex_(env_mutex), config_(config), logger_(logger), clips_dir_(clips_dir)
+{
+	setup_clips();
+}
+
+/** Destructor. */
+ClipsConfig::~ClipsConfig()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+	for (auto f : functions_) {
+		clips_->remove_function(f);
+	}
+	functions_.clear();
+}
+
+#define ADD_FUNCTION(n, s)    \
+	clips_->add_function(n, s); \
+	functions_.push_back(n);
+
+/** Setup CLIPS environment. */
+void
+ClipsConfig::setup_clips()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+
+	ADD_FUNCTION("get-clips-dirs",
+	             (sigc::slot<CLIPS::Values>(
+	               sigc::mem_fun(*this, &ClipsConfig::clips_get_clips_dirs))));
+	ADD_FUNCTION("load-config",
+	             (sigc::slot<void, std::string>(
+	               sigc::mem_fun(*this, &ClipsConfig::clips_load_config))));
+	ADD_FUNCTION("config-path-exists",
+	             (sigc::slot<CLIPS::Value, std::string>(
+	               sigc::mem_fun(*this, &ClipsConfig::clips_config_path_exists))));
+	ADD_FUNCTION("config-get-bool",
+	             (sigc::slot<CLIPS::Value, std::string>(
+	               sigc::mem_fun(*this, &ClipsConfig::clips_config_get_bool))));
+	ADD_FUNCTION("config-get-int",
+	             (sigc::slot<CLIPS::Value, std::string>(
+	               sigc::mem_fun(*this, &ClipsConfig::clips_config_get_int))));
+}
+
+CLIPS::Values
+ClipsConfig::clips_get_clips_dirs()
+{
+	CLIPS::Values rv;
+	rv.push_back(clips_dir_);
+	return rv;
+}
+
+void
+ClipsConfig::clips_load_config(std::string cfg_prefix)
+{
+	std::shared_ptr<Configuration::ValueIterator> v(config_->search(cfg_prefix.c_str()));
+	while (v->next()) {
+		std::string type  = "";
+		std::string value = v->get_as_string();
+
+		if (v->is_uint())
+			type = "UINT";
+		else if (v->is_int())
+			type = "INT";
+		else if (v->is_float())
+			type = "FLOAT";
+		else if (v->is_bool())
+			type = "BOOL";
+		else if (v->is_string()) {
+			type = "STRING";
+			if (!v->is_list()) {
+				value = std::string("\"") + value + "\"";
+			}
+		} else {
+			logger_->log_warn("RefBox",
+			                  "Config value at '%s' of unknown type '%s'",
+			                  v->path(),
+			                  v->type());
+		}
+
+		if (v->is_list()) {
+			clips_->assert_fact_f("(confval (path \"%s\") (type %s) (is-list TRUE) (list-value %s))",
+			                      v->path(),
+			                      type.c_str(),
+			                      value.c_str());
+		} else {
+			clips_->assert_fact_f("(confval (path \"%s\") (type %s) (value %s))",
+			                      v->path(),
+			                      type.c_str(),
+			                      value.c_str());
+		}
+	}
+}
+
+CLIPS::Value
+ClipsConfig::clips_config_path_exists(std::string path)
+{
+	return CLIPS::Value(config_->exists(path.c_str()) ? "TRUE" : "FALSE", CLIPS::TYPE_SYMBOL);
+}
+
+CLIPS::Value
+ClipsConfig::clips_config_get_bool(std::string path)
+{
+	try {
+		bool v = config_->get_bool(path.c_str());
+		return CLIPS::Value(v ? "TRUE" : "FALSE", CLIPS::TYPE_SYMBOL);
+	} catch (fawkes::Exception &e) {
+		return CLIPS::Value("FALSE", CLIPS::TYPE_SYMBOL);
+	}
+}
+
+CLIPS::Value
+ClipsConfig::clips_config_get_int(std::string path)
+{
+	try {
+		int v = config_->get_int(path.c_str());
+		return CLIPS::Value(v);
+	} catch (fawkes::Exception &e) {
+		return CLIPS::Value(0);
+	}
+}
+
+} // end namespace llsfrb
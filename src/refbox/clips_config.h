@@ -0,0 +1,84 @@
+/***************************************************************************
+ *  clips_config.h - CLIPS access to the refbox configuration
+ *
+ *  Created: Fri Oct 16 22:03:18 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LLSF_REFBOX_CLIPS_CONFIG_H_
+#define __LLSF_REFBOX_CLIPS_CONFIG_H_
+
+#include <core/threading/mutex.h>
+
+#include <clipsmm.h>
+#include <list>
+#include <memory>
+#include <string>
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+class Configuration;
+class Logger;
+
+class ClipsConfig
+{
+public:
+	ClipsConfig(CLIPS::Environment            *env,
+	            fawkes::Mutex                 &env_mutex,
+	            std::shared_ptr<Configuration> config,
+	            Logger                        *logger,
+	            const std::string             &clips_dir);
+	~ClipsConfig();
+
+private:
+	void setup_clips();
+
+	CLIPS::Values clips_get_clips_dirs();
+	void          clips_load_config(std::string cfg_prefix);
+	CLIPS::Value  clips_config_path_exists(std::string path);
+	CLIPS::Value  clips_config_get_bool(std::string path);
+	CLIPS::Value  clips_config_get_int(std::string path);
+
+private:
+	CLIPS::Environment            *clips_;
+	fawkes::Mutex                 &clips_mutex_;
+	std::shared_ptr<Configuration> config_;
+	Logger                        *logger_;
+	std::string                    clips_dir_;
+
+	std::list<std::string> functions_;
+};
+
+} // end namespace llsfrb
+
+#endif
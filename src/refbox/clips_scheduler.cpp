@@ -0,0 +1,138 @@
+/***************************************************************************
+ *  clips_scheduler.cpp - CLIPS agenda run deadlines
+ *
+ *  Created: Fri Oct 16 23:11:52 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clips_scheduler.h"
+
+#include <core/threading/mutex_locker.h>
+
+#include <algorithm>
+#include <sys/time.h>
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+/** @class ClipsScheduler "clips_scheduler.h"
+ * CLIPS functions to register when the agenda must be run next.
+ * Provides scheduler-register-deadline, scheduler-register-game-deadline,
+ * and scheduler-set-game-speedup, which the timeout functions of the game
+ * code call whenever a timeout or game time threshold has not yet been
+ * reached. Only the earliest deadline since the last reset is kept, it is
+ * used in event-driven mode to determine when to wake up next.
+ */
+
+/** Constructor.
+ * @param env CLIPS environment to register functions in
+ * @param env_mutex mutex to lock when accessing the environment
+ */
+ClipsScheduler::ClipsScheduler(CLIPS::Environment *env, fawkes::Mutex &env_mutex)
+: clips_(env), clips_mutex_(env_mutex), next_deadline_(0.), game_speedup_(1.)
+{
+	setup_clips();
+}
+
+/** Destructor. */
+ClipsScheduler::~ClipsScheduler()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+	for (auto f : functions_) {
+		clips_->remove_function(f);
+	}
+	functions_.clear();
+}
+
+#define ADD_FUNCTION(n, s)    \
+	clips_->add_function(n, s); \
+	functions_.push_back(n);
+
+/** Setup CLIPS environment. */
+void
+ClipsScheduler::setup_clips()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+
+	ADD_FUNCTION("scheduler-register-deadline",
+	             (sigc::slot<void, double>(
+	               sigc::mem_fun(*this, &ClipsScheduler::clips_register_deadline))));
+	ADD_FUNCTION("scheduler-register-game-deadline",
+	             (sigc::slot<void, double>(
+	               sigc::mem_fun(*this, &ClipsScheduler::clips_register_game_deadline))));
+	ADD_FUNCTION("scheduler-set-game-speedup",
+	             (sigc::slot<void, double>(
+	               sigc::mem_fun(*this, &ClipsScheduler::clips_set_game_speedup))));
+}
+
+/** Register a point in time at which the agenda must be run again.
+ * @param deadline point in time in seconds since the epoch
+ */
+void
+ClipsScheduler::clips_register_deadline(double deadline)
+{
+	if (next_deadline_ == 0. || deadline < next_deadline_) {
+		next_deadline_ = deadline;
+	}
+}
+
+/** Register a game time at which the agenda must be run again.
+ * Called from timeout-sec and game-time-reached, which compare game or
+ * continuous time, whenever the threshold has not yet been reached. Game
+ * time advances with the speedup set by scheduler-set-game-speedup while
+ * the game is running. If it is paused, or follows a simulation clock,
+ * the deadline may pass before the threshold is reached. The rule then
+ * registers a new deadline on the next run, and runs remain at least
+ * timer-interval apart.
+ * @param remaining game seconds until the threshold is reached
+ */
+void
+ClipsScheduler::clips_register_game_deadline(double remaining)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	clips_register_deadline(now.tv_sec + now.tv_usec / 1000000.
+	                        + std::max(remaining, 0.) / game_speedup_);
+}
+
+/** Set the factor by which game time advances faster than real time.
+ * @param speedup game time speedup, values that are not positive are ignored
+ */
+void
+ClipsScheduler::clips_set_game_speedup(double speedup)
+{
+	if (speedup > 0.) {
+		game_speedup_ = speedup;
+	}
+}
+
+} // end namespace llsfrb
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *  clips_scheduler.h - CLIPS agenda run deadlines
+ *
+ *  Created: Fri Oct 16 23:11:52 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LLSF_REFBOX_CLIPS_SCHEDULER_H_
+#define __LLSF_REFBOX_CLIPS_SCHEDULER_H_
+
+#include <core/threading/mutex.h>
+
+#include <clipsmm.h>
+#include <list>
+#include <string>
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+class ClipsScheduler
+{
+public:
+	ClipsScheduler(CLIPS::Environment *env, fawkes::Mutex &env_mutex);
+	~ClipsScheduler();
+
+	/** Get the earliest deadline registered since the last reset.
+	 * @return point in time in seconds since the epoch, 0 if none */
+	double
+	next_deadline() const
+	{
+		return next_deadline_;
+	}
+
+	/** Forget the registered deadline, called before each agenda run. */
+	void
+	reset_deadline()
+	{
+		next_deadline_ = 0.;
+	}
+
+private:
+	void setup_clips();
+
+	void clips_register_deadline(double deadline);
+	void clips_register_game_deadline(double remaining);
+	void clips_set_game_speedup(double speedup);
+
+private:
+	CLIPS::Environment *clips_;
+	fawkes::Mutex      &clips_mutex_;
+
+	double next_deadline_;
+	double game_speedup_;
+
+	std::list<std::string> functions_;
+};
+
+} // end namespace llsfrb
+
+#endif
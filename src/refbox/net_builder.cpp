@@ -0,0 +1,521 @@
+/***************************************************************************
+ *  net_builder.cpp - Native builders for periodic network messages
+ *
+ *  Created: Fri Oct 16 16:12:40 2026
+ ****************************************************************************/
+
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "net_builder.h"
+
+#include <core/threading/mutex_locker.h>
+#include <msgs/BeaconSignal.pb.h>
+#include <msgs/MachineInfo.pb.h>
+#include <msgs/OrderInfo.pb.h>
+#include <msgs/RingInfo.pb.h>
+
+#include <cstring>
+#include <vector>
+
+// must come last, CLIPS defines macros which clash with protobuf methods
+#include <clips/clips.h>
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+namespace {
+
+/** Call a function for every fact of a template.
+ * @param env CLIPS environment
+ * @param tmpl_name name of the template
+ * @param fn function called with the fact pointer
+ */
+template <typename Function>
+void
+for_each_fact(void *env, const char *tmpl_name, Function fn)
+{
+	void *tmpl = EnvFindDeftemplate(env, tmpl_name);
+	if (!tmpl)
+		return;
+	for (void *f = EnvGetNextFactInTemplate(env, tmpl, NULL); f;
+	     f = EnvGetNextFactInTemplate(env, tmpl, f)) {
+		fn(f);
+	}
+}
+
+/** Read slots of a fact directly from the CLIPS environment.
+ * This avoids the conversion of every slot value to clipsmm values.
+ * Returned strings point into the CLIPS symbol table and remain valid
+ * as long as the fact exists.
+ */
+class FactReader
+{
+public:
+	FactReader(void *env, void *fact) : env_(env), fact_(fact)
+	{
+	}
+
+	const char *
+	symbol(const char *slot)
+	{
+		get(slot);
+		return (GetType(value_) == SYMBOL || GetType(value_) == STRING) ? DOToString(value_) : "";
+	}
+
+	bool
+	is_symbol(const char *slot, const char *sym)
+	{
+		return strcmp(symbol(slot), sym) == 0;
+	}
+
+	long long
+	integer(const char *slot)
+	{
+		get(slot);
+		return to_integer(GetType(value_), GetValue(value_));
+	}
+
+	double
+	number(const char *slot)
+	{
+		get(slot);
+		return (GetType(value_) == FLOAT) ? DOToDouble(value_)
+		                                  : (double)to_integer(GetType(value_), GetValue(value_));
+	}
+
+	/** Get a multifield slot, entries are read with the *_at methods.
+	 * @param slot slot name
+	 * @return number of entries */
+	size_t
+	multifield(const char *slot)
+	{
+		get(slot);
+		return (GetType(value_) == MULTIFIELD) ? GetDOLength(value_) : 0;
+	}
+
+	long long
+	integer_at(size_t i)
+	{
+		void *mf = GetValue(value_);
+		long  j  = GetDOBegin(value_) + i;
+		return to_integer(GetMFType(mf, j), GetMFValue(mf, j));
+	}
+
+	double
+	float_at(size_t i)
+	{
+		void *mf = GetValue(value_);
+		long  j  = GetDOBegin(value_) + i;
+		return (GetMFType(mf, j) == FLOAT) ? ValueToDouble(GetMFValue(mf, j))
+		                                   : (double)to_integer(GetMFType(mf, j), GetMFValue(mf, j));
+	}
+
+	const char *
+	symbol_at(size_t i)
+	{
+		void *mf = GetValue(value_);
+		long  j  = GetDOBegin(value_) + i;
+		return (GetMFType(mf, j) == SYMBOL || GetMFType(mf, j) == STRING)
+		         ? ValueToString(GetMFValue(mf, j))
+		         : "";
+	}
+
+private:
+	void
+	get(const char *slot)
+	{
+		if (!EnvGetFactSlot(env_, fact_, slot, &value_)) {
+			SetType(value_, SYMBOL);
+			SetValue(value_, EnvAddSymbol(env_, ""));
+		}
+	}
+
+	static long long
+	to_integer(int type, void *value)
+	{
+		if (type == INTEGER)
+			return ValueToLong(value);
+		if (type == FLOAT)
+			return (long long)ValueToDouble(value);
+		return 0;
+	}
+
+private:
+	void       *env_;
+	void       *fact_;
+	DATA_OBJECT value_;
+};
+
+/** Get the message for the next build.
+ * The cached message is cleared and reused, unless it is still referenced
+ * elsewhere, e.g., by a send queue. Clearing keeps the memory of repeated
+ * sub-messages and strings, so building a message of the same shape again
+ * does not allocate.
+ * @param cached cached message, replaced if still in use
+ * @return message to fill
+ */
+template <class MsgType>
+MsgType &
+reuse(std::shared_ptr<MsgType> &cached)
+{
+	if (!cached || cached.use_count() > 1) {
+		cached = std::make_shared<MsgType>();
+	} else {
+		cached->Clear();
+	}
+	return *cached;
+}
+
+/** Set a time message from seconds and microseconds. */
+void
+set_time(llsf_msgs::Time *t, long long sec, long long usec)
+{
+	t->set_sec(sec);
+	t->set_nsec(usec * 1000);
+}
+
+} // end of anonymous namespace
+
+/** @class ClipsNetBuilder "net_builder.h"
+ * Native builders for the periodic messages sent by the CLIPS rules.
+ * Building a message field by field from CLIPS costs a reflection lookup
+ * and a heap object per field and sub-message. The functions provided
+ * here fill a reusable message directly from the relevant facts instead.
+ * Each function returns a message pointer just like pb-create, which must
+ * be released with pb-destroy after sending.
+ *
+ * Provided CLIPS functions:
+ * - (net-create-BeaconSignal ?seq ?now) refbox beacon
+ * - (net-create-RingInfo) ring specifications
+ * - (net-create-OrderInfo) all active orders
+ * - (net-create-broadcast-MachineInfo ?team-color) public machine info
+ */
+
+/** Constructor.
+ * @param env CLIPS environment to which to provide the functions
+ * @param env_mutex mutex to lock when operating on the CLIPS environment.
+ */
+ClipsNetBuilder::ClipsNetBuilder(CLIPS::Environment *env, fawkes::Mutex &env_mutex)
+: clips_(env), clips_mutex_(env_mutex)
+{
+	setup_clips();
+}
+
+/** Destructor. */
+ClipsNetBuilder::~ClipsNetBuilder()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+	for (auto f : functions_) {
+		clips_->remove_function(f);
+	}
+	functions_.clear();
+}
+
+#define ADD_FUNCTION(n, s)    \
+	clips_->add_function(n, s); \
+	functions_.push_back(n);
+
+/** Setup CLIPS environment. */
+void
+ClipsNetBuilder::setup_clips()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+
+	ADD_FUNCTION("net-create-BeaconSignal",
+	             (sigc::slot<CLIPS::Value, long int, CLIPS::Values>(
+	               sigc::mem_fun(*this, &ClipsNetBuilder::clips_create_beacon_signal))));
+	ADD_FUNCTION("net-create-RingInfo",
+	             (sigc::slot<CLIPS::Value>(
+	               sigc::mem_fun(*this, &ClipsNetBuilder::clips_create_ring_info))));
+	ADD_FUNCTION("net-create-OrderInfo",
+	             (sigc::slot<CLIPS::Value>(
+	               sigc::mem_fun(*this, &ClipsNetBuilder::clips_create_order_info))));
+	ADD_FUNCTION("net-create-broadcast-MachineInfo",
+	             (sigc::slot<CLIPS::Value, CLIPS::Value>(
+	               sigc::mem_fun(*this, &ClipsNetBuilder::clips_create_broadcast_machine_info))));
+}
+
+template <class MsgType>
+CLIPS::Value
+ClipsNetBuilder::to_clips(std::shared_ptr<MsgType> &msg)
+{
+	return CLIPS::Value(new std::shared_ptr<google::protobuf::Message>(msg));
+}
+
+CLIPS::Value
+ClipsNetBuilder::clips_create_beacon_signal(long int seq, CLIPS::Values now)
+{
+	llsf_msgs::BeaconSignal &b = reuse(beacon_signal_);
+	if (now.size() == 2) {
+		set_time(b.mutable_time(), now[0].as_integer(), now[1].as_integer());
+	} else {
+		set_time(b.mutable_time(), 0, 0);
+	}
+	b.set_seq(seq);
+	b.set_number(0);
+	b.set_team_name("LLSF");
+	b.set_peer_name("RefBox");
+	return to_clips(beacon_signal_);
+}
+
+CLIPS::Value
+ClipsNetBuilder::clips_create_ring_info()
+{
+	void                *env = clips_->cobj();
+	llsf_msgs::RingInfo &ri  = reuse(ring_info_);
+
+	for_each_fact(env, "ring-spec", [&](void *f) {
+		FactReader           spec(env, f);
+		llsf_msgs::RingColor color;
+		if (!llsf_msgs::RingColor_Parse(spec.symbol("color"), &color))
+			return;
+		llsf_msgs::Ring *r = ri.add_rings();
+		r->set_ring_color(color);
+		r->set_raw_material(spec.integer("req-bases"));
+	});
+
+	return to_clips(ring_info_);
+}
+
+CLIPS::Value
+ClipsNetBuilder::clips_create_order_info()
+{
+	void                 *env = clips_->cobj();
+	llsf_msgs::OrderInfo &oi  = reuse(order_info_);
+
+	// deliveries awaiting confirmation are the same for all orders
+	required_confirmations_.clear();
+	for_each_fact(env, "referee-confirmation", [&](void *f) {
+		FactReader rf(env, f);
+		if (rf.is_symbol("state", "REQUIRED")) {
+			required_confirmations_.push_back(rf.integer("process-id"));
+		}
+	});
+
+	for_each_fact(env, "order", [&](void *f) {
+		FactReader order(env, f);
+		if (!order.is_symbol("active", "TRUE"))
+			return;
+
+		llsf_msgs::Order *o  = oi.add_orders();
+		long long         id = order.integer("id");
+		o->set_id(id);
+
+		llsf_msgs::Order::Complexity complexity;
+		if (llsf_msgs::Order::Complexity_Parse(order.symbol("complexity"), &complexity)) {
+			o->set_complexity(complexity);
+		}
+		o->set_competitive(order.is_symbol("competitive", "TRUE"));
+		llsf_msgs::BaseColor base_color;
+		if (llsf_msgs::BaseColor_Parse(order.symbol("base-color"), &base_color)) {
+			o->set_base_color(base_color);
+		}
+		size_t num_rings = order.multifield("ring-colors");
+		for (size_t i = 0; i < num_rings; ++i) {
+			llsf_msgs::RingColor ring_color;
+			if (llsf_msgs::RingColor_Parse(order.symbol_at(i), &ring_color)) {
+				o->add_ring_colors(ring_color);
+			}
+		}
+		llsf_msgs::CapColor cap_color;
+		if (llsf_msgs::CapColor_Parse(order.symbol("cap-color"), &cap_color)) {
+			o->set_cap_color(cap_color);
+		}
+		o->set_quantity_requested(order.integer("quantity-requested"));
+		if (order.multifield("quantity-delivered") == 2) {
+			o->set_quantity_delivered_cyan(order.integer_at(0));
+			o->set_quantity_delivered_magenta(order.integer_at(1));
+		}
+		o->set_delivery_gate(order.integer("delivery-gate"));
+		if (order.multifield("delivery-period") == 2) {
+			o->set_delivery_period_begin(order.integer_at(0));
+			o->set_delivery_period_end(order.integer_at(1));
+		}
+
+		if (required_confirmations_.empty())
+			return;
+		for_each_fact(env, "product-processed", [&](void *df) {
+			FactReader delivery(env, df);
+			if (!delivery.is_symbol("confirmed", "FALSE") || delivery.integer("order") != id
+			    || !delivery.is_symbol("mtype", "DS")) {
+				return;
+			}
+			long long delivery_id = delivery.integer("id");
+			for (long long process_id : required_confirmations_) {
+				if (process_id != delivery_id)
+					continue;
+				llsf_msgs::UnconfirmedDelivery *d = o->add_unconfirmed_deliveries();
+				d->set_id(delivery_id);
+				llsf_msgs::Team team;
+				if (llsf_msgs::Team_Parse(delivery.symbol("team"), &team)) {
+					d->set_team(team);
+				}
+				double    game_time = delivery.number("game-time");
+				long long sec       = (long long)game_time;
+				set_time(d->mutable_delivery_time(), sec, (long long)((game_time - sec) * 1000000.));
+			}
+		});
+	});
+
+	return to_clips(order_info_);
+}
+
+CLIPS::Value
+ClipsNetBuilder::clips_create_broadcast_machine_info(CLIPS::Value team_color)
+{
+	void                   *env  = clips_->cobj();
+	llsf_msgs::MachineInfo &mi   = reuse(machine_info_);
+	std::string             team = team_color.as_string();
+
+	llsf_msgs::Team team_enum;
+	bool            has_team = llsf_msgs::Team_Parse(team, &team_enum);
+	if (has_team) {
+		mi.set_team_color(team_enum);
+	}
+
+	std::string phase;
+	for_each_fact(env, "gamestate", [&](void *f) {
+		if (phase.empty())
+			phase = FactReader(env, f).symbol("phase");
+	});
+	bool send_positions = false;
+	for_each_fact(env, "send-mps-positions", [&](void *f) {
+		FactReader send(env, f);
+		size_t     num_phases = send.multifield("phases");
+		for (size_t i = 0; i < num_phases; ++i) {
+			send_positions |= (phase == send.symbol_at(i));
+		}
+	});
+	bool add_ring_colors = (phase == "SETUP" || phase == "PRODUCTION");
+	bool exploration     = (phase == "EXPLORATION");
+
+	for_each_fact(env, "machine", [&](void *f) {
+		FactReader machine(env, f);
+		if (team != machine.symbol("team"))
+			return;
+
+		const char *name      = machine.symbol("name");
+		bool        has_light = false;
+		for_each_fact(env, "machine-lights", [&](void *lf) {
+			has_light |= FactReader(env, lf).is_symbol("name", name);
+		});
+		if (!has_light)
+			return;
+
+		const char         *mtype = machine.symbol("mtype");
+		llsf_msgs::Machine *m     = mi.add_machines();
+		m->set_name(name);
+		m->set_type(mtype);
+		m->set_state(machine.symbol("state"));
+		if (has_team) {
+			m->set_team_color(team_enum);
+		}
+
+		if (add_ring_colors && strcmp(mtype, "RS") == 0) {
+			for_each_fact(env, "rs-meta", [&](void *mf) {
+				FactReader meta(env, mf);
+				if (!meta.is_symbol("name", name))
+					return;
+				size_t num_colors = meta.multifield("rs-ring-colors");
+				for (size_t i = 0; i < num_colors; ++i) {
+					llsf_msgs::RingColor ring_color;
+					if (llsf_msgs::RingColor_Parse(meta.symbol_at(i), &ring_color)) {
+						m->add_ring_colors(ring_color);
+					}
+				}
+			});
+		}
+
+		if (send_positions) {
+			llsf_msgs::Zone zone;
+			if (llsf_msgs::Zone_Parse(machine.symbol("zone"), &zone)) {
+				m->set_zone(zone);
+			}
+			long long rotation = machine.integer("rotation");
+			if (rotation != -1) {
+				m->set_rotation(rotation);
+			}
+		}
+
+		if (strcmp(mtype, "SS") == 0) {
+			for_each_fact(env, "machine-ss-shelf-slot", [&](void *sf) {
+				FactReader slot(env, sf);
+				if (!slot.is_symbol("name", name))
+					return;
+				llsf_msgs::ShelfSlotInfo *s = m->add_status_ss();
+				if (slot.multifield("position") == 2) {
+					s->set_shelf(slot.integer_at(0));
+					s->set_slot(slot.integer_at(1));
+				}
+				s->set_is_filled(slot.is_symbol("is-filled", "TRUE"));
+				s->set_description(slot.symbol("description"));
+			});
+		}
+
+		if (machine.multifield("pose") == 3) {
+			double x = machine.float_at(0), y = machine.float_at(1), ori = machine.float_at(2);
+			if (x != 0.0 || y != 0.0 || ori != 0.0) {
+				llsf_msgs::Pose2D *pose = m->mutable_pose();
+				pose->set_x(x);
+				pose->set_y(y);
+				pose->set_ori(ori);
+				if (machine.multifield("pose-time") == 2) {
+					set_time(pose->mutable_timestamp(), machine.integer_at(0), machine.integer_at(1));
+				} else {
+					set_time(pose->mutable_timestamp(), 0, 0);
+				}
+			}
+		}
+
+		if (exploration) {
+			bool reported = false;
+			for_each_fact(env, "exploration-report", [&](void *rf) {
+				FactReader report(env, rf);
+				if (reported || !report.is_symbol("rtype", "RECORD") || !report.is_symbol("name", name))
+					return;
+				reported = true;
+				m->set_correctly_reported(report.is_symbol("correctly-reported", "TRUE"));
+				llsf_msgs::ExplorationState state;
+				if (llsf_msgs::ExplorationState_Parse(report.symbol("rotation-state"), &state)) {
+					m->set_exploration_rotation_state(state);
+				}
+				if (llsf_msgs::ExplorationState_Parse(report.symbol("zone-state"), &state)) {
+					m->set_exploration_zone_state(state);
+				}
+			});
+		}
+	});
+
+	return to_clips(machine_info_);
+}
+
+} // end namespace llsfrb
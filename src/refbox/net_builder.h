@@ -0,0 +1,96 @@
+/***************************************************************************
+ *  net_builder.h - Native builders for periodic network messages
+ *
+ *  Created: Fri Oct 16 16:12:40 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LLSF_REFBOX_NET_BUILDER_H_
+#define __LLSF_REFBOX_NET_BUILDER_H_
+
+#include <core/threading/mutex.h>
+
+#include <clipsmm.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace protobuf {
+class Message;
+}
+} // namespace google
+
+namespace llsf_msgs {
+class BeaconSignal;
+class MachineInfo;
+class OrderInfo;
+class RingInfo;
+} // namespace llsf_msgs
+
+namespace llsfrb {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+
+class ClipsNetBuilder
+{
+public:
+	ClipsNetBuilder(CLIPS::Environment *env, fawkes::Mutex &env_mutex);
+	~ClipsNetBuilder();
+
+private:
+	void setup_clips();
+
+	CLIPS::Value clips_create_beacon_signal(long int seq, CLIPS::Values now);
+	CLIPS::Value clips_create_ring_info();
+	CLIPS::Value clips_create_order_info();
+	CLIPS::Value clips_create_broadcast_machine_info(CLIPS::Value team_color);
+
+	template <class MsgType>
+	CLIPS::Value to_clips(std::shared_ptr<MsgType> &msg);
+
+private:
+	CLIPS::Environment *clips_;
+	fawkes::Mutex      &clips_mutex_;
+
+	std::shared_ptr<llsf_msgs::BeaconSignal> beacon_signal_;
+	std::shared_ptr<llsf_msgs::RingInfo>     ring_info_;
+	std::shared_ptr<llsf_msgs::OrderInfo>    order_info_;
+	std::shared_ptr<llsf_msgs::MachineInfo>  machine_info_;
+	std::vector<long long>                   required_confirmations_;
+
+	std::list<std::string> functions_;
+};
+
+} // end namespace llsfrb
+
+#endif
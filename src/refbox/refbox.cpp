@@ -37,17 +37,22 @@
 
 #include "refbox.h"
 
+#include "clips_config.h"
 #include "clips_logger.h"
+#include "clips_scheduler.h"
 #include "msgs/ProductColor.pb.h"
+#include "net_builder.h"
 #include "rest-api/clips-rest-api/clips-rest-api.h"
 
 #include <config/yaml.h>
 #include <core/threading/mutex.h>
 #include <core/version.h>
+#include <logging/binary.h>
 #include <logging/console.h>
 #include <logging/file.h>
 #include <logging/multi.h>
 #include <logging/network.h>
+#include <logging/queued.h>
 #include <mps_comm/machine_factory.h>
 #include <mps_comm/stations.h>
 #include <mps_placing_clips/mps_placing_clips.h>
@@ -79,6 +84,7 @@ namespace fs = boost::filesystem;
 
 #include <boost/bind/bind.hpp>
 #include <boost/format.hpp>
+#include <cmath>
 #include <cstdlib>
 #include <sstream>
 
@@ -106,6 +112,7 @@ namespace ph = boost::placeholders;
 #	include <mongocxx/exception/operation_exception.hpp>
 #	include <mongodb_log/mongodb_log_logger.h>
 #	include <mongodb_log/mongodb_log_protobuf.h>
+#	include <mongodb_log/mongodb_log_writer.h>
 #endif
 
 #include <netcomm/utils/resolver.h>
@@ -120,6 +127,9 @@ namespace ph = boost::placeholders;
 #include <memory>
 #include <string>
 
+// must come last, CLIPS defines macros which clash with protobuf methods
+#include <clips/clips.h>
+
 using namespace protobuf_comm;
 using namespace protobuf_clips;
 using namespace llsf_utils;
@@ -158,7 +168,10 @@ handle_signal(int signum)
  * @param argv array of arguments
  */
 LLSFRefBox::LLSFRefBox(int argc, char **argv)
-: clips_mutex_(fawkes::Mutex::RECURSIVE), timer_(io_service_)
+: clips_mutex_(fawkes::Mutex::RECURSIVE),
+  timer_(io_service_),
+  wakeup_pending_(false),
+  snapshot_version_(0)
 {
 	read_config(argc, argv);
 
@@ -167,6 +180,10 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 	cfg_clips_dir_ = std::string(SHAREDIR) + "/games/rcll/";
 
 	cfg_timer_interval_ = config_->get_uint("/llsfrb/clips/timer-interval");
+	cfg_event_driven_   = config_->get_bool_or_default("/llsfrb/clips/event-driven", false);
+	cfg_max_timer_interval_ =
+	  std::max(cfg_timer_interval_,
+	           config_->get_uint_or_default("/llsfrb/clips/max-timer-interval", 1000));
 
 	log_level_ = Logger::LL_INFO;
 	try {
@@ -187,9 +204,26 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 	logger_->add_logger(new ConsoleLogger(log_level_));
 	try {
 		std::string logfile = config_->get_string("/llsfrb/log/general");
-		logger_->add_logger(new FileLogger(logfile.c_str(), log_level_));
+		logger_->add_logger(create_file_logger(logfile, log_level_));
 	} catch (fawkes::Exception &e) {
 	} // ignored, use default
+	try {
+		std::string logfile = config_->get_string("/llsfrb/log/binary/general");
+		logger_->add_logger(new BinaryLogger(logfile.c_str(), log_level_));
+	} catch (fawkes::Exception &e) {
+	} // ignored, no binary log
+
+	latency_tracker_ = std::make_unique<LatencyTracker>();
+	ttc_timer_       = latency_tracker_->add_class("handle-timer");
+	ttc_clips_lock_  = latency_tracker_->add_class("clips-lock-wait");
+	ttc_clips_run_   = latency_tracker_->add_class("clips-run");
+	ttc_pb_assert_   = latency_tracker_->add_class("pb-receive-to-assert");
+	ttc_ws_fanout_   = latency_tracker_->add_class("websocket-fan-out");
+	ttc_snapshot_    = latency_tracker_->add_class("snapshot-publish");
+	cfg_latency_summary_interval_ =
+	  config_->get_uint_or_default("/llsfrb/log/latency-summary-interval", 60);
+	latency_summary_last_ = boost::asio::deadline_timer::traits_type::now();
+
 	clips_ = std::make_unique<CLIPS::Environment>();
 	setup_clips();
 
@@ -219,10 +253,16 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 #ifdef HAVE_WEBSOCKETS
 	//launch websocket backend and add websocket logger
 	backend_ = new websocket::Backend(logger_.get(), clips_.get(), clips_mutex_);
+	backend_->get_data()->set_latency_tracker(latency_tracker_.get(), ttc_ws_fanout_);
+	publish_snapshots();
 	backend_->start(config_->get_uint("/llsfrb/websocket/port"),
 	                config_->get_bool("/llsfrb/websocket/ws-mode"),
-	                config_->get_bool("/llsfrb/websocket/allow-control-all"));
-	logger_->add_logger(new WebsocketLogger(backend_->get_data(), log_level_));
+	                config_->get_bool("/llsfrb/websocket/allow-control-all"),
+	                config_->get_uint_or_default("/llsfrb/websocket/send-queue-size", 256),
+	                websocket::slow_consumer_policy_from_string(
+	                  config_->get_string_or_default("/llsfrb/websocket/slow-consumer-policy",
+	                                                 "coalesce")));
+	add_queued_logger("websocket", new WebsocketLogger(backend_->get_data(), log_level_));
 #endif
 
 	try {
@@ -290,18 +330,21 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 							clips_->assert_fact_f("(mps-status-feedback %s READY %s)",
 							                      cfg_name.c_str(),
 							                      ready ? "TRUE" : "FALSE");
+							wakeup();
 						});
 						mps->register_busy_callback([this, cfg_name](bool busy) {
 							fawkes::MutexLocker clips_lock(&clips_mutex_);
 							clips_->assert_fact_f("(mps-status-feedback %s BUSY %s)",
 							                      cfg_name.c_str(),
 							                      busy ? "TRUE" : "FALSE");
+							wakeup();
 						});
 						mps->register_barcode_callback([this, cfg_name](unsigned long barcode) {
 							fawkes::MutexLocker clips_lock(&clips_mutex_);
 							clips_->assert_fact_f("(mps-status-feedback %s BARCODE %u)",
 							                      cfg_name.c_str(),
 							                      barcode);
+							wakeup();
 						});
 						if (mpstype == "RS") {
 							RingStation *rs = dynamic_cast<RingStation *>(mps.get());
@@ -313,6 +356,7 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 								clips_->assert_fact_f("(mps-status-feedback %s SLIDE-COUNTER %u)",
 								                      cfg_name.c_str(),
 								                      counter);
+								wakeup();
 							});
 						}
 						mps_[cfg_name] = std::move(mps);
@@ -330,8 +374,17 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 
 	mps_placing_generator_ = std::shared_ptr<mps_placing_clips::MPSPlacingGenerator>(
 	  new mps_placing_clips::MPSPlacingGenerator(clips_.get(), clips_mutex_));
-
-	logger_->add_logger(new NetworkLogger(pb_comm_->server(), log_level_));
+	net_builder_ = std::make_unique<ClipsNetBuilder>(clips_.get(), clips_mutex_);
+
+	std::string    netlog_prefix  = "/llsfrb/log/network/";
+	NetworkLogger *network_logger = new NetworkLogger(pb_comm_->server(), log_level_);
+	network_logger->set_batching(
+	  config_->get_uint_or_default((netlog_prefix + "batch-size").c_str(), 1),
+	  config_->get_uint_or_default((netlog_prefix + "batch-interval").c_str(), 50));
+	network_logger->set_rate_limit(
+	  config_->get_float_or_default((netlog_prefix + "rate-limit").c_str(), 0.),
+	  config_->get_uint_or_default((netlog_prefix + "rate-burst").c_str(), 50));
+	add_queued_logger("network", network_logger);
 
 #ifdef HAVE_WEBSOCKETS
 	setup_clips_websocket();
@@ -339,6 +392,8 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 
 #ifdef HAVE_MONGODB
 	cfg_mongodb_enabled_ = false;
+	mongodb_text_log_    = NULL;
+	mongodb_clips_log_   = NULL;
 	try {
 		cfg_mongodb_enabled_ = config_->get_bool("/llsfrb/mongodb/enable");
 	} catch (fawkes::Exception &e) {
@@ -349,11 +404,22 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 		std::string mdb_text_log  = config_->get_string("/llsfrb/mongodb/collections/text-log");
 		std::string mdb_clips_log = config_->get_string("/llsfrb/mongodb/collections/clips-log");
 		std::string mdb_protobuf  = config_->get_string("/llsfrb/mongodb/collections/protobuf");
-		clips_logger_->add_logger(new MongoDBLogLogger(cfg_mongodb_hostport_, mdb_text_log));
-
-		clips_logger_->add_logger(new MongoDBLogLogger(cfg_mongodb_hostport_, mdb_clips_log));
-
-		mongodb_protobuf_ = std::make_unique<MongoDBLogProtobuf>(cfg_mongodb_hostport_, mdb_protobuf);
+		unsigned int mdb_queue_size =
+		  config_->get_uint_or_default("/llsfrb/mongodb/writer/queue-size", 8192);
+		unsigned int mdb_batch_size =
+		  config_->get_uint_or_default("/llsfrb/mongodb/writer/batch-size", 256);
+		unsigned int mdb_flush_interval =
+		  config_->get_uint_or_default("/llsfrb/mongodb/writer/flush-interval", 500);
+		mongodb_text_log_ = new MongoDBLogLogger(
+		  cfg_mongodb_hostport_, mdb_text_log, mdb_queue_size, mdb_batch_size, mdb_flush_interval);
+		clips_logger_->add_logger(mongodb_text_log_);
+
+		mongodb_clips_log_ = new MongoDBLogLogger(
+		  cfg_mongodb_hostport_, mdb_clips_log, mdb_queue_size, mdb_batch_size, mdb_flush_interval);
+		clips_logger_->add_logger(mongodb_clips_log_);
+
+		mongodb_protobuf_ = std::make_unique<MongoDBLogProtobuf>(
+		  cfg_mongodb_hostport_, mdb_protobuf, mdb_queue_size, mdb_batch_size, mdb_flush_interval);
 
 		client_   = mongocxx::client{mongocxx::uri{"mongodb://" + cfg_mongodb_hostport_}};
 		database_ = client_["rcll"];
@@ -412,6 +478,8 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 
 	try {
 		clips_rest_api_ = std::make_unique<ClipsRestApi>(clips_.get(), clips_mutex_, logger_.get());
+		clips_rest_api_->set_latency_tracker(latency_tracker_.get());
+		publish_snapshots();
 
 		rest_api_manager_ = std::make_shared<WebviewRestApiManager>();
 		rest_api_manager_->register_api(clips_rest_api_.get());
@@ -423,6 +491,9 @@ LLSFRefBox::LLSFRefBox(int argc, char **argv)
 		                                                           service_browser,
 		                                                           config_.get(),
 		                                                           logger_.get());
+		clips_rest_api_->set_event_stream(
+		  rest_api_thread_->event_stream(),
+		  config_->get_uint_or_default("/webview/events/game-time-interval", 1000));
 		rest_api_thread_->start();
 
 	} catch (Exception &e) {
@@ -456,6 +527,34 @@ LLSFRefBox::~LLSFRefBox()
 	}
 
 	mps_placing_generator_.reset();
+	net_builder_.reset();
+	clips_config_.reset();
+	clips_scheduler_.reset();
+
+#ifdef HAVE_MONGODB
+	if (mongodb_protobuf_) {
+		stop_mongodb_writer("protobuf", mongodb_protobuf_->writer());
+		mongodb_protobuf_.reset();
+	}
+	if (mongodb_text_log_) {
+		clips_logger_->remove_logger(mongodb_text_log_);
+		stop_mongodb_writer("text", mongodb_text_log_->writer());
+		delete mongodb_text_log_;
+	}
+	if (mongodb_clips_log_) {
+		clips_logger_->remove_logger(mongodb_clips_log_);
+		stop_mongodb_writer("CLIPS", mongodb_clips_log_->writer());
+		delete mongodb_clips_log_;
+	}
+#endif
+
+	// the sinks may still have queued records for the network and websocket
+	// servers, forward them while those are still alive
+	for (QueuedLogger *l : queued_loggers_) {
+		logger_->remove_logger(l);
+		delete l;
+	}
+	queued_loggers_.clear();
 
 	// Delete all global objects allocated by libprotobuf
 	google::protobuf::ShutdownProtobufLibrary();
@@ -612,7 +711,12 @@ LLSFRefBox::setup_protobuf_comm()
 		pb_comm_ = std::make_unique<ClipsProtobufCommunicator>(clips_.get(), clips_mutex_, proto_dirs);
 	}
 
+	pb_comm_->set_latency_tracker(latency_tracker_.get(), ttc_pb_assert_);
+	pb_comm_->set_io_threads(config_->get_uint_or_default("/llsfrb/comm/io-threads", 0));
+	pb_comm_->set_inbound_queue_size(
+	  config_->get_uint_or_default("/llsfrb/comm/inbound-queue-size", 1024));
 	pb_comm_->enable_server(config_->get_uint("/llsfrb/comm/server-port"));
+	pb_comm_->signal_fact_asserted().connect(boost::bind(&LLSFRefBox::wakeup, this));
 
 	MessageRegister &mr_server = pb_comm_->message_register();
 	if (!mr_server.load_failures().empty()) {
@@ -625,6 +729,39 @@ LLSFRefBox::setup_protobuf_comm()
 	}
 }
 
+/** Create a file logger.
+ * Enables asynchronous writing if configured in /llsfrb/log/async.
+ * @param filename log file name pattern
+ * @param log_level minimum log level
+ * @return file logger
+ */
+FileLogger *
+LLSFRefBox::create_file_logger(const std::string &filename, Logger::LogLevel log_level)
+{
+	FileLogger *logger = new FileLogger(filename.c_str(), log_level);
+	if (config_->get_bool_or_default("/llsfrb/log/async/enable", false)) {
+		logger->set_async(config_->get_uint_or_default("/llsfrb/log/async/queue-size", 4096),
+		                  config_->get_uint_or_default("/llsfrb/log/async/flush-interval", 200));
+	}
+	return logger;
+}
+
+/** Add a log sink behind its own queue.
+ * Records are forwarded to the sink from a separate thread, so that a
+ * slow sink does not block logging. The queue size is read from
+ * /llsfrb/log/sink-queue-size.
+ * @param name name of the sink, used in the periodic statistics
+ * @param sink logger to add, ownership is taken
+ */
+void
+LLSFRefBox::add_queued_logger(const char *name, Logger *sink)
+{
+	unsigned int  queue_size = config_->get_uint_or_default("/llsfrb/log/sink-queue-size", 1024);
+	QueuedLogger *logger     = new QueuedLogger(name, sink, queue_size);
+	queued_loggers_.push_back(logger);
+	logger_->add_logger(logger);
+}
+
 void
 LLSFRefBox::setup_clips()
 {
@@ -635,9 +772,14 @@ LLSFRefBox::setup_clips()
 	clips_logger_->add_logger(new ConsoleLogger(log_level_));
 	try {
 		std::string logfile = config_->get_string("/llsfrb/log/clips");
-		clips_logger_->add_logger(new FileLogger(logfile.c_str(), Logger::LL_DEBUG));
+		clips_logger_->add_logger(create_file_logger(logfile, Logger::LL_DEBUG));
 	} catch (fawkes::Exception &e) {
 	} // ignored, use default
+	try {
+		std::string logfile = config_->get_string("/llsfrb/log/binary/clips");
+		clips_logger_->add_logger(new BinaryLogger(logfile.c_str(), Logger::LL_DEBUG));
+	} catch (fawkes::Exception &e) {
+	} // ignored, no binary log
 	if (config_->get_bool_or_default("/llsfrb/clips/debug", false)) {
 		clips_->evaluate("(watch rules)");
 		clips_->evaluate("(watch facts)");
@@ -661,23 +803,12 @@ LLSFRefBox::setup_clips()
 
 	clips_->build(defglobal_ver);
 
-	clips_->add_function("get-clips-dirs",
-	                     sigc::slot<CLIPS::Values>(
-	                       sigc::mem_fun(*this, &LLSFRefBox::clips_get_clips_dirs)));
+	clips_config_ = std::make_unique<ClipsConfig>(
+	  clips_.get(), clips_mutex_, config_, logger_.get(), cfg_clips_dir_);
+	clips_scheduler_ = std::make_unique<ClipsScheduler>(clips_.get(), clips_mutex_);
+
 	clips_->add_function("now",
 	                     sigc::slot<CLIPS::Values>(sigc::mem_fun(*this, &LLSFRefBox::clips_now)));
-	clips_->add_function("load-config",
-	                     sigc::slot<void, std::string>(
-	                       sigc::mem_fun(*this, &LLSFRefBox::clips_load_config)));
-	clips_->add_function("config-path-exists",
-	                     sigc::slot<CLIPS::Value, std::string>(
-	                       sigc::mem_fun(*this, &LLSFRefBox::clips_config_path_exists)));
-	clips_->add_function("config-get-bool",
-	                     sigc::slot<CLIPS::Value, std::string>(
-	                       sigc::mem_fun(*this, &LLSFRefBox::clips_config_get_bool)));
-	clips_->add_function("config-get-int",
-	                     sigc::slot<CLIPS::Value, std::string>(
-	                       sigc::mem_fun(*this, &LLSFRefBox::clips_config_get_int)));
 	clips_->add_function("print-fact-list",
 	                     sigc::slot<void, CLIPS::Values, CLIPS::Values>(
 	                       sigc::mem_fun(*this, &LLSFRefBox::clips_print_fact_list)));
@@ -730,8 +861,6 @@ LLSFRefBox::setup_clips()
 		                     sigc::slot<void, std::string, int, int, int, int>(
 		                       sigc::mem_fun(*this, &LLSFRefBox::clips_mps_ss_relocate)));
 	}
-
-	clips_->signal_periodic().connect(sigc::mem_fun(*this, &LLSFRefBox::handle_clips_periodic));
 }
 
 void
@@ -749,29 +878,6 @@ LLSFRefBox::start_clips()
 	clips_->run();
 }
 
-void
-LLSFRefBox::handle_clips_periodic()
-{
-	std::queue<int>                                    to_erase;
-	std::map<long int, CLIPS::Fact::pointer>::iterator f;
-
-	for (f = clips_msg_facts_.begin(); f != clips_msg_facts_.end(); ++f) {
-		if (f->second->refcount() == 1) {
-			//logger_->log_info("RefBox", "Fact %li can be erased", f->second->index());
-			to_erase.push(f->first);
-		}
-	}
-	while (!to_erase.empty()) {
-		long int              index = to_erase.front();
-		CLIPS::Fact::pointer &f     = clips_msg_facts_[index];
-		CLIPS::Value          v     = f->slot_value("ptr")[0];
-		void                 *ptr   = v.as_address();
-		delete static_cast<std::shared_ptr<google::protobuf::Message> *>(ptr);
-		clips_msg_facts_.erase(index);
-		to_erase.pop();
-	}
-}
-
 CLIPS::Values
 LLSFRefBox::clips_now()
 {
@@ -783,6 +889,9 @@ LLSFRefBox::clips_now()
 	return rv;
 }
 
+
+
+
 /** Convert a clips value into a string representation
  * @param v Value to convert
  * @return v represented as std::string
@@ -799,13 +908,6 @@ LLSFRefBox::clips_value_to_string(const CLIPS::Value &v)
 	}
 }
 
-CLIPS::Values
-LLSFRefBox::clips_get_clips_dirs()
-{
-	CLIPS::Values rv;
-	rv.push_back(cfg_clips_dir_);
-	return rv;
-}
 
 /** Print a list of facts as a formatted table
  * @param facts A multifield of fact indices, which all belong to the same
@@ -910,79 +1012,9 @@ LLSFRefBox::clips_print_fact_list(CLIPS::Values facts, CLIPS::Values fields)
 	}
 }
 
-void
-LLSFRefBox::clips_load_config(std::string cfg_prefix)
-{
-	std::shared_ptr<Configuration::ValueIterator> v(config_->search(cfg_prefix.c_str()));
-	while (v->next()) {
-		std::string type  = "";
-		std::string value = v->get_as_string();
-
-		if (v->is_uint())
-			type = "UINT";
-		else if (v->is_int())
-			type = "INT";
-		else if (v->is_float())
-			type = "FLOAT";
-		else if (v->is_bool())
-			type = "BOOL";
-		else if (v->is_string()) {
-			type = "STRING";
-			if (!v->is_list()) {
-				value = std::string("\"") + value + "\"";
-			}
-		} else {
-			logger_->log_warn("RefBox",
-			                  "Config value at '%s' of unknown type '%s'",
-			                  v->path(),
-			                  v->type());
-		}
 
-		if (v->is_list()) {
-			//logger_->log_info("RefBox", "(confval (path \"%s\") (type %s) (is-list TRUE) (list-value %s))",
-			//       v->path(), type.c_str(), value.c_str());
-			clips_->assert_fact_f("(confval (path \"%s\") (type %s) (is-list TRUE) (list-value %s))",
-			                      v->path(),
-			                      type.c_str(),
-			                      value.c_str());
-		} else {
-			//logger_->log_info("RefBox", "(confval (path \"%s\") (type %s) (value %s))",
-			//       v->path(), type.c_str(), value.c_str());
-			clips_->assert_fact_f("(confval (path \"%s\") (type %s) (value %s))",
-			                      v->path(),
-			                      type.c_str(),
-			                      value.c_str());
-		}
-	}
-}
 
-CLIPS::Value
-LLSFRefBox::clips_config_path_exists(std::string path)
-{
-	return CLIPS::Value(config_->exists(path.c_str()) ? "TRUE" : "FALSE", CLIPS::TYPE_SYMBOL);
-}
 
-CLIPS::Value
-LLSFRefBox::clips_config_get_bool(std::string path)
-{
-	try {
-		bool v = config_->get_bool(path.c_str());
-		return CLIPS::Value(v ? "TRUE" : "FALSE", CLIPS::TYPE_SYMBOL);
-	} catch (Exception &e) {
-		return CLIPS::Value("FALSE", CLIPS::TYPE_SYMBOL);
-	}
-}
-
-CLIPS::Value
-LLSFRefBox::clips_config_get_int(std::string path)
-{
-	try {
-		int v = config_->get_int(path.c_str());
-		return CLIPS::Value(v);
-	} catch (Exception &e) {
-		return CLIPS::Value(0);
-	}
-}
 
 bool
 LLSFRefBox::mutex_future_ready(const std::string &name)
@@ -1050,6 +1082,7 @@ LLSFRefBox::clips_mps_deliver(std::string machine)
 		                       llsfrb::mps_comm::Machine::MPSSensor::OUTPUT);
 		MutexLocker lock(&clips_mutex_);
 		clips_->assert_fact_f("(mps-feedback mps-deliver success %s)", machine.c_str());
+		wakeup();
 		return true;
 	});
 
@@ -1352,21 +1385,37 @@ LLSFRefBox::handle_server_client_fail(ProtobufStreamServer::ClientID client,
 {
 }
 
+/** Write all queued documents of a MongoDB writer and report losses.
+ * @param name name of the log, used in the warning
+ * @param writer writer to stop
+ */
+void
+LLSFRefBox::stop_mongodb_writer(const char *name, MongoDBLogWriter &writer)
+{
+	writer.stop();
+	unsigned long dropped = writer.dropped();
+	unsigned long failed  = writer.failed();
+	if (dropped > 0 || failed > 0) {
+		logger_->log_warn("RefBox",
+		                  "MongoDB %s log lost %lu documents (%lu dropped, %lu failed)",
+		                  name,
+		                  dropped + failed,
+		                  dropped,
+		                  failed);
+	}
+}
+
 void
 LLSFRefBox::add_comp_type(google::protobuf::Message &m, document *doc)
 {
-	const google::protobuf::Descriptor     *desc     = m.GetDescriptor();
-	const google::protobuf::EnumDescriptor *enumdesc = desc->FindEnumTypeByName("CompType");
-	if (!enumdesc)
-		return;
-	const google::protobuf::EnumValueDescriptor *compdesc = enumdesc->FindValueByName("COMP_ID");
-	const google::protobuf::EnumValueDescriptor *msgtdesc = enumdesc->FindValueByName("MSG_TYPE");
-	if (!compdesc || !msgtdesc)
+	MessageRegister::KeyType key;
+	try {
+		key = pb_comm_->message_register().comp_type(m);
+	} catch (std::logic_error &e) {
 		return;
-	int comp_id  = compdesc->number();
-	int msg_type = msgtdesc->number();
-	doc->append(kvp("component_id", comp_id));
-	doc->append(kvp("msg_type", msg_type));
+	}
+	doc->append(kvp("component_id", (int32_t)key.first));
+	doc->append(kvp("msg_type", (int32_t)key.second));
 }
 
 /** Handle message that was sent to a server client.
@@ -2000,7 +2049,7 @@ LLSFRefBox::clips_bson_get_time(void *bson, std::string field_name)
 void
 LLSFRefBox::start_timer()
 {
-	timer_last_ = boost::posix_time::microsec_clock::local_time();
+	timer_last_ = boost::asio::deadline_timer::traits_type::now();
 	timer_.expires_from_now(boost::posix_time::milliseconds(cfg_timer_interval_));
 	timer_.async_wait(boost::bind(&LLSFRefBox::handle_timer, this, boost::asio::placeholders::error));
 }
@@ -2021,15 +2070,176 @@ LLSFRefBox::handle_timer(const boost::system::error_code &error)
 		//sps_read_rfids();
 
 		{
-			//std::lock_guard<std::recursive_mutex> lock(clips_mutex_);
-			fawkes::MutexLocker lock(&clips_mutex_);
+			ScopedLatencyTracker latency(latency_tracker_.get(), ttc_timer_);
+			run_clips();
+			schedule_timer();
+		}
+		log_latency_summary();
+	}
+}
+
+/** Assert queued messages and the current time and run the CLIPS agenda. */
+void
+LLSFRefBox::run_clips()
+{
+	//std::lock_guard<std::recursive_mutex> lock(clips_mutex_);
+	ScopedLatencyTracker lock_wait(latency_tracker_.get(), ttc_clips_lock_);
+	fawkes::MutexLocker  lock(&clips_mutex_);
+	lock_wait.end();
+
+	timer_last_    = boost::asio::deadline_timer::traits_type::now();
+	clips_scheduler_->reset_deadline();
+	pb_comm_->assert_queued_messages();
+	clips_->assert_fact("(time (now))");
+	clips_->refresh_agenda();
+
+	ScopedLatencyTracker clips_run(latency_tracker_.get(), ttc_clips_run_);
+	clips_->run();
+	clips_run.end();
+
+	// The time fact asserted above sets the flag on every run. The readers
+	// compare the templates they serve and keep their snapshot if those
+	// are unchanged.
+	if (EnvGetFactListChanged(clips_->cobj())) {
+		EnvSetFactListChanged(clips_->cobj(), FALSE);
+		ScopedLatencyTracker publish(latency_tracker_.get(), ttc_snapshot_);
+		publish_snapshots();
+	}
+}
 
-			clips_->assert_fact("(time (now))");
-			clips_->refresh_agenda();
-			clips_->run();
+/** Publish a new snapshot of the game state to external readers.
+ * The REST API and the websocket backend serve their clients from the
+ * published snapshot so that reading does not contend for the CLIPS mutex.
+ * The snapshot version is only increased if a reader published a new
+ * snapshot because facts it serves have changed.
+ */
+void
+LLSFRefBox::publish_snapshots()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+	uint64_t            version = snapshot_version_ + 1;
+	bool                changed = false;
+#ifdef HAVE_WEBSOCKETS
+	if (backend_) {
+		changed |= backend_->get_data()->publish_snapshot(version);
+	}
+#endif
+	if (clips_rest_api_) {
+		changed |= clips_rest_api_->publish_snapshot(version);
+	}
+	if (changed) {
+		snapshot_version_ = version;
+	}
+}
+
+/** Write a summary of the main loop latencies to the log.
+ * This is done every latency-summary-interval seconds and covers the
+ * values recorded since the previous summary. A warning is issued if
+ * handling the timer regularly takes longer than the timer interval, in
+ * that case the refbox falls behind game time.
+ */
+void
+LLSFRefBox::log_latency_summary()
+{
+	if (cfg_latency_summary_interval_ == 0)
+		return;
+
+	boost::posix_time::ptime now = boost::asio::deadline_timer::traits_type::now();
+	if ((now - latency_summary_last_).total_seconds() < cfg_latency_summary_interval_)
+		return;
+	latency_summary_last_ = now;
+
+	for (unsigned int i = 0; i < latency_tracker_->num_classes(); ++i) {
+		LatencyTracker::Stats s = latency_tracker_->stats(i, /* window */ true);
+		if (s.count == 0)
+			continue;
+		logger_->log_info("RefBox",
+		                  "Latency %s: n=%lu mean=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f ms",
+		                  s.name.c_str(),
+		                  s.count,
+		                  s.mean_ms,
+		                  s.p50_ms,
+		                  s.p90_ms,
+		                  s.p99_ms,
+		                  s.max_ms);
+		if (i == ttc_timer_ && s.p99_ms > cfg_timer_interval_) {
+			logger_->log_warn("RefBox",
+			                  "Timer handling p99 of %.3f ms exceeds timer interval of %u ms, "
+			                  "falling behind game time",
+			                  s.p99_ms,
+			                  cfg_timer_interval_);
 		}
+	}
+	latency_tracker_->reset_window();
+
+	logger_->log_info("RefBox",
+	                  "Inbound queue: depth=%zu max=%zu overflows=%lu",
+	                  pb_comm_->inbound_queue_depth(),
+	                  pb_comm_->inbound_queue_max_depth(/* reset */ true),
+	                  pb_comm_->inbound_queue_overflows());
 
+	for (QueuedLogger *l : queued_loggers_) {
+		logger_->log_info("RefBox",
+		                  "Log sink %s: depth=%zu max=%zu dropped=%lu",
+		                  l->name().c_str(),
+		                  l->queue_depth(),
+		                  l->queue_max_depth(/* reset */ true),
+		                  l->dropped());
+	}
+}
+
+/** Schedule the next timer event.
+ * In periodic mode, the timer fires every timer-interval ms. In event-driven
+ * mode, it fires at the earliest deadline registered by the rules during the
+ * last run, bounded by timer-interval and max-timer-interval.
+ */
+void
+LLSFRefBox::schedule_timer()
+{
+	if (!cfg_event_driven_) {
 		timer_.expires_at(timer_.expires_at() + boost::posix_time::milliseconds(cfg_timer_interval_));
+	} else {
+		long wait_ms = cfg_max_timer_interval_;
+		{
+			fawkes::MutexLocker lock(&clips_mutex_);
+			double              next_deadline = clips_scheduler_->next_deadline();
+			if (next_deadline > 0.) {
+				struct timeval tv;
+				gettimeofday(&tv, 0);
+				double now = tv.tv_sec + tv.tv_usec / 1000000.;
+				wait_ms    = std::min(wait_ms, (long)std::ceil((next_deadline - now) * 1000.));
+			}
+		}
+		wait_ms = std::max(wait_ms, (long)cfg_timer_interval_);
+		timer_.expires_at(timer_last_ + boost::posix_time::milliseconds(wait_ms));
+	}
+	timer_.async_wait(
+	  boost::bind(&LLSFRefBox::handle_timer, this, boost::asio::placeholders::error));
+}
+
+/** Request a run of the CLIPS agenda in reaction to an external event.
+ * This is a no-op in periodic mode. It may be called from any thread,
+ * multiple requests before the next run are coalesced.
+ */
+void
+LLSFRefBox::wakeup()
+{
+	if (cfg_event_driven_ && !wakeup_pending_.exchange(true)) {
+		io_service_.post(boost::bind(&LLSFRefBox::handle_wakeup, this));
+	}
+}
+
+/** Handle wakeup request. */
+void
+LLSFRefBox::handle_wakeup()
+{
+	wakeup_pending_ = false;
+
+	boost::posix_time::ptime earliest =
+	  timer_last_ + boost::posix_time::milliseconds(cfg_timer_interval_);
+	if (timer_.expires_at() > earliest) {
+		// cancels the pending wait, the aborted handler will not re-schedule
+		timer_.expires_at(earliest);
 		timer_.async_wait(
 		  boost::bind(&LLSFRefBox::handle_timer, this, boost::asio::placeholders::error));
 	}
@@ -2128,19 +2338,23 @@ LLSFRefBox::setup_clips_websocket()
 	backend_->get_data()->clips_set_gamestate = [this](std::string state_string) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(net-SetGameState %s)", state_string.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_set_gamephase = [this](std::string phase_string) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(net-SetGamePhase %s)", phase_string.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_randomize_field = [this]() {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(net-RandomizeField)");
+		wakeup();
 	};
 	backend_->get_data()->clips_set_teamname = [this](std::string color_string,
 	                                                  std::string name_string) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(net-SetTeamName %s \"%s\")", color_string.c_str(), name_string.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_confirm_delivery =
 	  [this](int delivery_id, bool correctness, int order_id, std::string team_color) {
@@ -2150,19 +2364,23 @@ LLSFRefBox::setup_clips_websocket()
 		                        correctness ? "TRUE" : "FALSE",
 		                        order_id,
 		                        team_color.c_str());
+		  wakeup();
 	  };
 	backend_->get_data()->clips_set_order_delivered = [this](std::string team_color, int order_id) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(order-SetOrderDelivered %s %d)", team_color.c_str(), order_id);
+		wakeup();
 	};
 	backend_->get_data()->clips_production_machine_add_base = [this](std::string mname) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(production-MachineAddBase %s)", mname.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_production_set_machine_state = [this](std::string mname,
 	                                                                  std::string state) {
 		fawkes::MutexLocker clips_lock(&clips_mutex_);
 		clips_->assert_fact_f("(production-SetMachineState %s %s)", mname.c_str(), state.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_robot_set_robot_maintenance =
 	  [this](int robot_number, std::string team_color, bool maintenance) {
@@ -2171,6 +2389,7 @@ LLSFRefBox::setup_clips_websocket()
 		                        robot_number,
 		                        team_color.c_str(),
 		                        maintenance ? "TRUE" : "FALSE");
+		  wakeup();
 	  };
 	backend_->get_data()->clips_production_reset_machine_by_team = [this](std::string machine_name,
 	                                                                      std::string team_color) {
@@ -2178,6 +2397,7 @@ LLSFRefBox::setup_clips_websocket()
 		clips_->assert_fact_f("(ws-reset-machine-message %s %s)",
 		                      machine_name.c_str(),
 		                      team_color.c_str());
+		wakeup();
 	};
 	backend_->get_data()->clips_add_points_team = [this](int         points,
 	                                                     std::string team_color,
@@ -2192,6 +2412,7 @@ LLSFRefBox::setup_clips_websocket()
 		  game_time,
 		  phase.c_str(),
 		  reason.c_str());
+		wakeup();
 	};
 }
 
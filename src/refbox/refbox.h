@@ -46,16 +46,19 @@
 #include <mps_comm/machine.h>
 #include <protobuf_comm/server.h>
 #include <utils/llsf/machines.h>
+#include <utils/time/tracker.h>
 
 #ifdef HAVE_WEBSOCKETS
 #	include <websocket/backend.h>
 #endif
 
 #include <boost/asio.hpp>
+#include <atomic>
 #include <clipsmm.h>
 #include <future>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace mps_placing_clips {
 class MPSPlacingGenerator;
@@ -76,6 +79,8 @@ class WebviewRestApiManager;
 #	include <mongocxx/database.hpp>
 #	include <mongocxx/client.hpp>
 class MongoDBLogProtobuf;
+class MongoDBLogLogger;
+class MongoDBLogWriter;
 #endif
 
 namespace llsfrb {
@@ -85,6 +90,11 @@ namespace llsfrb {
 
 class Configuration;
 class MultiLogger;
+class FileLogger;
+class QueuedLogger;
+class ClipsConfig;
+class ClipsScheduler;
+class ClipsNetBuilder;
 class WebviewServer;
 class ClipsRestApi;
 
@@ -103,20 +113,23 @@ private: // methods
 
 	void start_timer();
 	void handle_timer(const boost::system::error_code &error);
+	void schedule_timer();
+	void run_clips();
+	void publish_snapshots();
+	void wakeup();
+	void handle_wakeup();
+	void log_latency_summary();
+
+	FileLogger *create_file_logger(const std::string &filename, Logger::LogLevel log_level);
+	void        add_queued_logger(const char *name, Logger *sink);
 
 	void setup_protobuf_comm();
 
 	void start_clips();
 	void setup_clips();
-	void handle_clips_periodic();
 	void setup_clips_mongodb();
 
 	CLIPS::Values clips_now();
-	CLIPS::Values clips_get_clips_dirs();
-	void          clips_load_config(std::string cfg_prefix);
-	CLIPS::Value  clips_config_path_exists(std::string path);
-	CLIPS::Value  clips_config_get_bool(std::string path);
-	CLIPS::Value  clips_config_get_int(std::string path);
 
 	bool mutex_future_ready(const std::string &name);
 
@@ -205,20 +218,25 @@ private: // methods
 
 #ifdef HAVE_MONGODB
 	void add_comp_type(google::protobuf::Message &m, bsoncxx::builder::basic::document *doc);
+	void stop_mongodb_writer(const char *name, MongoDBLogWriter &writer);
 #endif
 
 private: // members
 	std::shared_ptr<Configuration>                          config_;
 	std::unique_ptr<MultiLogger>                            logger_;
 	std::unique_ptr<MultiLogger>                            clips_logger_;
+	std::vector<QueuedLogger *>                             queued_loggers_;
 	Logger::LogLevel                                        log_level_;
+	std::unique_ptr<fawkes::LatencyTracker>                 latency_tracker_;
 	std::shared_ptr<mps_placing_clips::MPSPlacingGenerator> mps_placing_generator_;
 
 	fawkes::Mutex                                                       clips_mutex_;
 	std::unique_ptr<CLIPS::Environment>                                 clips_;
 	std::unordered_map<std::string, std::unique_ptr<mps_comm::Machine>> mps_;
 	std::unique_ptr<protobuf_clips::ClipsProtobufCommunicator>          pb_comm_;
-	std::map<long int, CLIPS::Fact::pointer>                            clips_msg_facts_;
+	std::unique_ptr<ClipsConfig>                                        clips_config_;
+	std::unique_ptr<ClipsScheduler>                                     clips_scheduler_;
+	std::unique_ptr<ClipsNetBuilder>                                    net_builder_;
 
 	std::map<std::string, std::future<bool>> mutex_futures_;
 
@@ -227,9 +245,22 @@ private: // members
 	boost::posix_time::ptime    timer_last_;
 
 	unsigned int                  cfg_timer_interval_;
+	bool                          cfg_event_driven_;
+	unsigned int                  cfg_max_timer_interval_;
+	std::atomic<bool>             wakeup_pending_;
+	uint64_t                      snapshot_version_;
 	std::string                   cfg_clips_dir_;
 	llsf_utils::MachineAssignment cfg_machine_assignment_;
 
+	unsigned int             ttc_timer_;
+	unsigned int             ttc_clips_lock_;
+	unsigned int             ttc_clips_run_;
+	unsigned int             ttc_pb_assert_;
+	unsigned int             ttc_ws_fanout_;
+	unsigned int             ttc_snapshot_;
+	unsigned int             cfg_latency_summary_interval_;
+	boost::posix_time::ptime latency_summary_last_;
+
 #ifdef HAVE_WEBSOCKETS
 	websocket::Backend *backend_;
 	void                setup_clips_websocket();
@@ -247,6 +278,8 @@ private: // members
 	bool                                cfg_mongodb_enabled_;
 	std::string                         cfg_mongodb_hostport_;
 	std::unique_ptr<MongoDBLogProtobuf> mongodb_protobuf_;
+	MongoDBLogLogger                   *mongodb_text_log_;
+	MongoDBLogLogger                   *mongodb_clips_log_;
 	mongocxx::client                    client_;
 	mongocxx::database                  database_;
 #endif
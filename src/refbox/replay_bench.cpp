@@ -0,0 +1,816 @@
+
+/***************************************************************************
+ *  replay_bench.cpp - Replay recorded games into a headless refbox
+ *
+ *  Created: Fri Oct 16 14:05:21 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clips_config.h"
+#include "clips_logger.h"
+#include "clips_scheduler.h"
+#include "net_builder.h"
+
+#include <config/yaml.h>
+#include <core/exception.h>
+#include <core/threading/mutex.h>
+#include <core/threading/mutex_locker.h>
+#include <logging/console.h>
+#include <logging/multi.h>
+#include <mps_placing_clips/mps_placing_clips.h>
+#include <msgs/BeaconSignal.pb.h>
+#include <msgs/GameInfo.pb.h>
+#include <msgs/GameState.pb.h>
+#include <msgs/MachineCommands.pb.h>
+#include <protobuf_clips/communicator.h>
+#include <utils/system/argparser.h>
+
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clipsmm.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+using namespace fawkes;
+using namespace llsfrb;
+using namespace protobuf_clips;
+
+/// @cond INTERNALS
+
+// Count heap allocations of the whole process, the per-tick difference is
+// reported. Aligned allocations are not counted.
+static std::atomic<unsigned long> g_num_allocations(0);
+
+void *
+operator new(size_t size)
+{
+	g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+	void *p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+/** Message of a recorded game to inject at a specific time. */
+struct ReplayEvent
+{
+	double                                     time;          ///< sec since game start
+	bool                                       via_broadcast; ///< inject as broadcast message
+	std::shared_ptr<google::protobuf::Message> msg;           ///< message to inject
+};
+
+/** Game reconstructed from a game report. */
+struct ReplayGame
+{
+	std::string              name;     ///< report name
+	double                   duration; ///< sec, replay ends afterwards
+	std::vector<std::string> teams;    ///< team names, cyan first, empty if no team
+	std::vector<ReplayEvent> events;   ///< messages to inject, ordered by time
+};
+
+/** Measurements of all replayed ticks. */
+struct ReplayStats
+{
+	std::vector<double> tick_latency_ms; ///< wall time per tick
+	unsigned long       rules_fired  = 0;
+	unsigned long       allocations  = 0;
+	unsigned long       injected     = 0;
+	unsigned long       asserted     = 0;
+	unsigned long       batches      = 0;
+	size_t              queue_depth  = 0;
+	unsigned long       overflows    = 0;
+	unsigned long       broadcasts   = 0;
+	unsigned long       sent         = 0;
+	unsigned long       sent_bytes   = 0;
+	double              game_time    = 0.;
+	double              wall_time    = 0.;
+	unsigned int        games        = 0;
+	unsigned int        failed_games = 0;
+};
+
+static void
+print_usage(const char *program_name)
+{
+	printf("Usage: %s [-h] [-v] [-a archive] [-c collection] [-n N] [-r N] [-b Hz]\n"
+	       "          [-C cfg-file] [-P max-p99-ms]\n"
+	       " -h              This help message\n"
+	       " -v              Print refbox output (warnings only otherwise)\n"
+	       " -a archive      gzipped mongodump archive with game reports\n"
+	       "                 (default: %s/benchmarks/rcll100.gz)\n"
+	       " -c collection   collection of the game reports (default: game_report)\n"
+	       " -n N            replay at most N games\n"
+	       " -r N            number of robots sending beacons per team (default: 3)\n"
+	       " -b Hz           beacon rate per robot (default: 1.0)\n"
+	       " -C cfg-file     additional config file, loaded last\n"
+	       " -P max-p99-ms   exit with code 2 if the 99th percentile tick latency\n"
+	       "                 exceeds the given limit (regression gate)\n",
+	       program_name,
+	       BASEDIR);
+}
+
+/** Read all documents of a collection from a gzipped mongodump archive.
+ * The archive starts with a magic number and a prelude of header and
+ * collection metadata documents. The data follows in blocks, each with a
+ * namespace header document, the documents of that namespace, and a
+ * terminator. A header with EOF set ends a namespace.
+ * @param path path to the archive
+ * @param collection name of the collection to read
+ * @param docs upon return contains the raw BSON documents
+ * @exception fawkes::Exception thrown if the archive cannot be read
+ */
+static void
+read_archive(const std::string &path, const std::string &collection, std::vector<std::string> &docs)
+{
+	gzFile f = gzopen(path.c_str(), "rb");
+	if (!f) {
+		throw fawkes::Exception("Cannot open archive %s", path.c_str());
+	}
+	std::string data;
+	char        buf[65536];
+	int         n;
+	while ((n = gzread(f, buf, sizeof(buf))) > 0) {
+		data.append(buf, n);
+	}
+	gzclose(f);
+	if (n < 0) {
+		throw fawkes::Exception("Failed to decompress archive %s", path.c_str());
+	}
+
+	const uint32_t ARCHIVE_MAGIC = 0x8199e26d;
+	const uint32_t TERMINATOR    = 0xffffffff;
+
+	auto read_u32 = [&data](size_t pos) {
+		uint32_t v;
+		memcpy(&v, data.data() + pos, sizeof(v));
+		return v;
+	};
+
+	if (data.size() < 4 || read_u32(0) != ARCHIVE_MAGIC) {
+		throw fawkes::Exception("%s is not a mongodump archive", path.c_str());
+	}
+
+	bool   in_prelude = true;
+	bool   in_block   = false;
+	bool   wanted     = false;
+	size_t pos        = 4;
+	while (pos + 4 <= data.size()) {
+		uint32_t len = read_u32(pos);
+		if (len == TERMINATOR) {
+			in_prelude = false;
+			in_block   = false;
+			pos += 4;
+			continue;
+		}
+		if (len < 5 || pos + len > data.size()) {
+			throw fawkes::Exception("Corrupt document in %s at offset %zu", path.c_str(), pos);
+		}
+		if (in_prelude) {
+			// archive header and collection metadata, not needed
+		} else if (!in_block) {
+			bsoncxx::document::view header((const uint8_t *)data.data() + pos, len);
+			auto                    coll = header.find("collection");
+			auto                    eof  = header.find("EOF");
+			wanted                       = coll != header.end() && eof != header.end()
+			         && coll->type() == bsoncxx::type::k_utf8
+			         && coll->get_utf8().value.to_string() == collection && !eof->get_bool();
+			in_block = true;
+		} else if (wanted) {
+			docs.push_back(data.substr(pos, len));
+		}
+		pos += len;
+	}
+}
+
+static double
+get_number(const bsoncxx::document::element &el)
+{
+	switch (el.type()) {
+	case bsoncxx::type::k_double: return el.get_double();
+	case bsoncxx::type::k_int32: return el.get_int32();
+	case bsoncxx::type::k_int64: return el.get_int64();
+	default: return 0.;
+	}
+}
+
+/** Reconstruct the inbound message stream of a game from its report.
+ * A report contains the game state at each phase change and the history
+ * of machine states. This yields the referee commands which drove the
+ * game, i.e., team names, game state, game phases, and machine states.
+ * Robot beacons are not recorded, they are generated during the replay.
+ * @param report game report document
+ * @param game upon return contains the reconstructed game
+ */
+static void
+reconstruct_game(const bsoncxx::document::view &report, ReplayGame &game)
+{
+	game.name     = report["report-name"] ? report["report-name"].get_utf8().value.to_string() : "";
+	game.duration = 0.;
+	game.teams.clear();
+	game.events.clear();
+
+	double start_time = report["start-time"] ? get_number(report["start-time"]) / 1000. : 0.;
+
+	if (report["teams"] && report["teams"].type() == bsoncxx::type::k_array) {
+		for (const auto &t : report["teams"].get_array().value) {
+			game.teams.push_back(t.get_utf8().value.to_string());
+		}
+	}
+	for (size_t i = 0; i < game.teams.size() && i < 2; ++i) {
+		if (game.teams[i].empty())
+			continue;
+		auto m = std::make_shared<llsf_msgs::SetTeamName>();
+		m->set_team_name(game.teams[i]);
+		m->set_team_color(i == 0 ? llsf_msgs::CYAN : llsf_msgs::MAGENTA);
+		game.events.push_back({0., false, m});
+	}
+
+	auto set_state = std::make_shared<llsf_msgs::SetGameState>();
+	set_state->set_state(llsf_msgs::GameState::RUNNING);
+	game.events.push_back({0., false, set_state});
+
+	for (const auto &el : report) {
+		std::string key = el.key().to_string();
+		if (key.compare(0, 10, "gamestate/") != 0 || el.type() != bsoncxx::type::k_document)
+			continue;
+		bsoncxx::document::view    gs = el.get_document().view();
+		llsf_msgs::GameState_Phase phase;
+		if (!gs["phase"]
+		    || !llsf_msgs::GameState_Phase_Parse(gs["phase"].get_utf8().value.to_string(), &phase)) {
+			continue;
+		}
+		double time = gs["cont-time"] ? get_number(gs["cont-time"]) : 0.;
+		auto   m    = std::make_shared<llsf_msgs::SetGamePhase>();
+		m->set_phase(phase);
+		game.events.push_back({time, false, m});
+		game.duration = std::max(game.duration, time);
+	}
+
+	if (report["machine-history"] && report["machine-history"].type() == bsoncxx::type::k_array) {
+		for (const auto &h : report["machine-history"].get_array().value) {
+			bsoncxx::document::view entry = h.get_document().view();
+			llsf_msgs::MachineState state;
+			if (!entry["name"] || !entry["state"] || !entry["time"]
+			    || !llsf_msgs::MachineState_Parse(entry["state"].get_utf8().value.to_string(), &state)) {
+				continue;
+			}
+			bsoncxx::array::view tv   = entry["time"].get_array().value;
+			double               time = get_number(tv[0]) + get_number(tv[1]) / 1000000. - start_time;
+			time                      = std::max(time, 0.);
+			auto m                    = std::make_shared<llsf_msgs::SetMachineState>();
+			m->set_machine_name(entry["name"].get_utf8().value.to_string());
+			m->set_state(state);
+			game.events.push_back({time, false, m});
+			game.duration = std::max(game.duration, time);
+		}
+	}
+
+	if (report["end-time"]) {
+		game.duration = std::max(game.duration, get_number(report["end-time"]) / 1000. - start_time);
+	}
+
+	std::stable_sort(game.events.begin(),
+	                 game.events.end(),
+	                 [](const ReplayEvent &a, const ReplayEvent &b) { return a.time < b.time; });
+}
+
+/** Headless refbox.
+ * Runs the refbox CLIPS code with the protobuf integration, but without
+ * any sockets or hardware. Time is virtual and advanced by the replay,
+ * hence games are replayed as fast as possible. Outgoing messages are
+ * serialized, but not sent.
+ */
+class ReplayRefBox
+{
+public:
+	ReplayRefBox(std::shared_ptr<Configuration> config, Logger::LogLevel log_level);
+	~ReplayRefBox();
+
+	void replay(const ReplayGame &game, unsigned int robots, double beacon_hz, ReplayStats &stats);
+
+private:
+	void          setup_clips();
+	CLIPS::Values clips_now();
+	long int      clips_pb_peer_create(std::string host, int port);
+	long int      clips_pb_peer_create_local(std::string host, int send_port, int recv_port);
+	long int
+	clips_pb_peer_create_crypto(std::string host, int port, std::string key, std::string cipher);
+	long int clips_pb_peer_create_local_crypto(std::string host,
+	                                           int         send_port,
+	                                           int         recv_port,
+	                                           std::string key,
+	                                           std::string cipher);
+	void     clips_pb_broadcast(long int peer_id, void *msgptr);
+	void     clips_pb_send(long int client_id, void *msgptr);
+	void     clips_pb_send_multi(CLIPS::Values client_ids, void *msgptr);
+	void     serialize(void *msgptr);
+
+	void inject(std::shared_ptr<google::protobuf::Message> msg, bool via_broadcast);
+
+private:
+	std::shared_ptr<Configuration>                          config_;
+	std::unique_ptr<MultiLogger>                            logger_;
+	std::unique_ptr<MultiLogger>                            clips_logger_;
+	fawkes::Mutex                                           clips_mutex_;
+	std::unique_ptr<CLIPS::Environment>                     clips_;
+	std::unique_ptr<ClipsConfig>                            clips_config_;
+	std::unique_ptr<ClipsScheduler>                         clips_scheduler_;
+	std::unique_ptr<ClipsProtobufCommunicator>              pb_comm_;
+	std::shared_ptr<mps_placing_clips::MPSPlacingGenerator> mps_placing_generator_;
+	std::unique_ptr<ClipsNetBuilder>                        net_builder_;
+
+	struct timeval now_;
+	long int       next_peer_id_;
+	std::string    buffer_;
+	ReplayStats   *stats_;
+};
+
+/** Constructor.
+ * @param config configuration to run the refbox with
+ * @param log_level minimum log level of refbox and CLIPS output
+ */
+ReplayRefBox::ReplayRefBox(std::shared_ptr<Configuration> config, Logger::LogLevel log_level)
+: config_(config), clips_mutex_(fawkes::Mutex::RECURSIVE), next_peer_id_(0), stats_(NULL)
+{
+	gettimeofday(&now_, 0);
+	std::string clips_dir = std::string(SHAREDIR) + "/games/rcll/";
+
+	logger_ = std::make_unique<MultiLogger>();
+	logger_->add_logger(new ConsoleLogger(log_level));
+	clips_logger_ = std::make_unique<MultiLogger>();
+	clips_logger_->add_logger(new ConsoleLogger(log_level));
+
+	clips_        = std::make_unique<CLIPS::Environment>();
+	clips_config_ =
+	  std::make_unique<ClipsConfig>(clips_.get(), clips_mutex_, config_, logger_.get(), clips_dir);
+	clips_scheduler_ = std::make_unique<ClipsScheduler>(clips_.get(), clips_mutex_);
+	pb_comm_ = std::make_unique<ClipsProtobufCommunicator>(clips_.get(), clips_mutex_);
+	pb_comm_->set_inbound_queue_size(
+	  config_->get_uint_or_default("/llsfrb/comm/inbound-queue-size", 1024));
+	mps_placing_generator_ =
+	  std::make_shared<mps_placing_clips::MPSPlacingGenerator>(clips_.get(), clips_mutex_);
+	net_builder_ = std::make_unique<ClipsNetBuilder>(clips_.get(), clips_mutex_);
+	setup_clips();
+
+	fawkes::MutexLocker lock(&clips_mutex_);
+	if (!clips_->batch_evaluate(clips_dir + "init.clp")) {
+		throw fawkes::Exception("Failed to initialize CLIPS environment, batch file failed.");
+	}
+	clips_->assert_fact("(init)");
+	clips_->refresh_agenda();
+	clips_->run();
+}
+
+/** Destructor. */
+ReplayRefBox::~ReplayRefBox()
+{
+	mps_placing_generator_.reset();
+	net_builder_.reset();
+	pb_comm_.reset();
+	clips_config_.reset();
+	clips_scheduler_.reset();
+	{
+		fawkes::MutexLocker lock(&clips_mutex_);
+		finalize_clips_logger(clips_->cobj());
+	}
+	clips_.reset();
+}
+
+void
+ReplayRefBox::setup_clips()
+{
+	fawkes::MutexLocker lock(&clips_mutex_);
+
+	init_clips_logger(clips_->cobj(), logger_.get(), clips_logger_.get());
+
+	clips_->build("(defglobal ?*VERSION-MAJOR* = 0 ?*VERSION-MINOR* = 0 ?*VERSION-MICRO* = 0)");
+
+	clips_->add_function("now",
+	                     sigc::slot<CLIPS::Values>(sigc::mem_fun(*this, &ReplayRefBox::clips_now)));
+	clips_->add_function("print-fact-list",
+	                     sigc::slot<void, CLIPS::Values, CLIPS::Values>(
+	                       [](CLIPS::Values, CLIPS::Values) {}));
+
+	// there are no stations, instructions are dropped
+	typedef sigc::slot<void, std::string>              MPSSlot1;
+	typedef sigc::slot<void, std::string, std::string> MPSSlot2;
+	for (const char *f : {"mps-cs-retrieve-cap",
+	                      "mps-cs-mount-cap",
+	                      "mps-reset-lights",
+	                      "mps-reset",
+	                      "mps-reset-base-counter",
+	                      "mps-deliver"}) {
+		clips_->add_function(f, MPSSlot1([](std::string) {}));
+	}
+	clips_->add_function("mps-bs-dispense", MPSSlot2([](std::string, std::string) {}));
+	clips_->add_function("mps-move-conveyor",
+	                     sigc::slot<void, std::string, std::string, std::string>(
+	                       [](std::string, std::string, std::string) {}));
+	clips_->add_function("mps-set-light",
+	                     sigc::slot<void, std::string, std::string, std::string>(
+	                       [](std::string, std::string, std::string) {}));
+	clips_->add_function("mps-set-lights",
+	                     sigc::slot<void, std::string, std::string, std::string, std::string>(
+	                       [](std::string, std::string, std::string, std::string) {}));
+	clips_->add_function("mps-ds-process",
+	                     sigc::slot<void, std::string, int>([](std::string, int) {}));
+	clips_->add_function("mps-rs-mount-ring",
+	                     sigc::slot<void, std::string, int, std::string>(
+	                       [](std::string, int, std::string) {}));
+	clips_->add_function("mps-ss-retrieve",
+	                     sigc::slot<void, std::string, int, int>([](std::string, int, int) {}));
+	clips_->add_function("mps-ss-store",
+	                     sigc::slot<void, std::string, int, int>([](std::string, int, int) {}));
+	clips_->add_function("mps-ss-relocate",
+	                     sigc::slot<void, std::string, int, int, int, int>(
+	                       [](std::string, int, int, int, int) {}));
+
+	// Replace the networking functions of the communicator, everything else
+	// of the protobuf integration is used as is. Defining a function again
+	// replaces the previous definition.
+	clips_->add_function("pb-server-enable", sigc::slot<void, int>([](int) {}));
+	clips_->add_function("pb-server-disable", sigc::slot<void>([]() {}));
+	clips_->add_function("pb-peer-create",
+	                     sigc::slot<long int, std::string, int>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_peer_create)));
+	clips_->add_function("pb-peer-create-local",
+	                     sigc::slot<long int, std::string, int, int>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_peer_create_local)));
+	clips_->add_function("pb-peer-create-crypto",
+	                     sigc::slot<long int, std::string, int, std::string, std::string>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_peer_create_crypto)));
+	clips_->add_function("pb-peer-create-local-crypto",
+	                     sigc::slot<long int, std::string, int, int, std::string, std::string>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_peer_create_local_crypto)));
+	clips_->add_function("pb-peer-destroy", sigc::slot<void, long int>([](long int) {}));
+	clips_->add_function("pb-peer-setup-crypto",
+	                     sigc::slot<void, long int, std::string, std::string>(
+	                       [](long int, std::string, std::string) {}));
+	clips_->add_function("pb-broadcast",
+	                     sigc::slot<void, long int, void *>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_broadcast)));
+	clips_->add_function("pb-send",
+	                     sigc::slot<void, long int, void *>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_send)));
+	clips_->add_function("pb-send-multi",
+	                     sigc::slot<void, CLIPS::Values, void *>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_send_multi)));
+	clips_->add_function("pb-connect",
+	                     sigc::slot<long int, std::string, int>(
+	                       sigc::mem_fun(*this, &ReplayRefBox::clips_pb_peer_create)));
+	clips_->add_function("pb-disconnect", sigc::slot<void, long int>([](long int) {}));
+}
+
+CLIPS::Values
+ReplayRefBox::clips_now()
+{
+	CLIPS::Values rv;
+	rv.push_back(now_.tv_sec);
+	rv.push_back(now_.tv_usec);
+	return rv;
+}
+
+long int
+ReplayRefBox::clips_pb_peer_create(std::string host, int port)
+{
+	return ++next_peer_id_;
+}
+
+long int
+ReplayRefBox::clips_pb_peer_create_local(std::string host, int send_port, int recv_port)
+{
+	return ++next_peer_id_;
+}
+
+long int
+ReplayRefBox::clips_pb_peer_create_crypto(std::string host,
+                                          int         port,
+                                          std::string key,
+                                          std::string cipher)
+{
+	return ++next_peer_id_;
+}
+
+long int
+ReplayRefBox::clips_pb_peer_create_local_crypto(std::string host,
+                                                int         send_port,
+                                                int         recv_port,
+                                                std::string key,
+                                                std::string cipher)
+{
+	return ++next_peer_id_;
+}
+
+void
+ReplayRefBox::serialize(void *msgptr)
+{
+	std::shared_ptr<google::protobuf::Message> *m =
+	  static_cast<std::shared_ptr<google::protobuf::Message> *>(msgptr);
+	if (!(m && *m))
+		return;
+	buffer_.clear();
+	if ((*m)->SerializeToString(&buffer_) && stats_) {
+		stats_->sent_bytes += buffer_.size();
+	}
+}
+
+void
+ReplayRefBox::clips_pb_broadcast(long int peer_id, void *msgptr)
+{
+	serialize(msgptr);
+	if (stats_)
+		stats_->broadcasts += 1;
+}
+
+void
+ReplayRefBox::clips_pb_send(long int client_id, void *msgptr)
+{
+	serialize(msgptr);
+	if (stats_)
+		stats_->sent += 1;
+}
+
+void
+ReplayRefBox::clips_pb_send_multi(CLIPS::Values client_ids, void *msgptr)
+{
+	serialize(msgptr);
+	if (stats_)
+		stats_->sent += client_ids.size();
+}
+
+/** Inject a message as if it had been received on the network.
+ * Like the I/O threads of the refbox, this only queues the message, it
+ * is asserted before the next agenda run.
+ * @param msg message to inject
+ * @param via_broadcast true to inject as broadcast message
+ */
+void
+ReplayRefBox::inject(std::shared_ptr<google::protobuf::Message> msg, bool via_broadcast)
+{
+	pb_comm_->inject_message("127.0.0.1", 4444, msg, via_broadcast, now_);
+	stats_->injected += 1;
+}
+
+/** Replay a game.
+ * The game is advanced in steps of the configured timer interval. Each
+ * tick queues the messages due, then asserts them in one batch and runs
+ * the agenda, just like the timer of the refbox does. The wall time of
+ * each tick is measured.
+ * @param game game to replay
+ * @param robots number of robots per team sending beacons
+ * @param beacon_hz beacon rate per robot
+ * @param stats statistics to add measurements to
+ */
+void
+ReplayRefBox::replay(const ReplayGame &game,
+                     unsigned int      robots,
+                     double            beacon_hz,
+                     ReplayStats      &stats)
+{
+	const double tick_sec  = config_->get_uint("/llsfrb/clips/timer-interval") / 1000.;
+	const double beacon_dt = beacon_hz > 0. ? 1. / beacon_hz : 0.;
+	const double duration  = game.duration + 1.;
+
+	stats_ = &stats;
+
+	struct timeval start;
+	gettimeofday(&start, 0);
+
+	size_t   next_event  = 0;
+	double   next_beacon = 0.;
+	uint64_t beacon_seq  = 0;
+	auto     wall_start  = std::chrono::steady_clock::now();
+	for (double t = 0.; t <= duration; t += tick_sec) {
+		long int usec = start.tv_usec + (long int)(t * 1000000.);
+		now_.tv_sec   = start.tv_sec + usec / 1000000;
+		now_.tv_usec  = usec % 1000000;
+
+		unsigned long allocs_before = g_num_allocations.load(std::memory_order_relaxed);
+		auto          tick_start    = std::chrono::steady_clock::now();
+
+		for (; next_event < game.events.size() && game.events[next_event].time <= t; ++next_event) {
+			inject(game.events[next_event].msg, game.events[next_event].via_broadcast);
+		}
+		for (; beacon_dt > 0. && next_beacon <= t; next_beacon += beacon_dt) {
+			for (size_t team = 0; team < game.teams.size() && team < 2; ++team) {
+				if (game.teams[team].empty())
+					continue;
+				for (unsigned int r = 1; r <= robots; ++r) {
+					auto b = std::make_shared<llsf_msgs::BeaconSignal>();
+					b->mutable_time()->set_sec(now_.tv_sec);
+					b->mutable_time()->set_nsec(now_.tv_usec * 1000);
+					b->set_seq(++beacon_seq);
+					b->set_number(r);
+					b->set_team_name(game.teams[team]);
+					b->set_peer_name("R-" + std::to_string(r));
+					b->set_team_color(team == 0 ? llsf_msgs::CYAN : llsf_msgs::MAGENTA);
+					b->mutable_pose()->mutable_timestamp()->CopyFrom(b->time());
+					b->mutable_pose()->set_x(r);
+					b->mutable_pose()->set_y(team == 0 ? 1. : -1.);
+					b->mutable_pose()->set_ori(0.);
+					inject(b, true);
+				}
+			}
+		}
+
+		fawkes::MutexLocker lock(&clips_mutex_);
+		clips_scheduler_->reset_deadline();
+		unsigned int asserted = pb_comm_->assert_queued_messages();
+		if (asserted > 0) {
+			stats.asserted += asserted;
+			stats.batches += 1;
+		}
+		clips_->assert_fact("(time (now))");
+		clips_->refresh_agenda();
+		stats.rules_fired += clips_->run();
+		lock.unlock();
+
+		auto tick_end = std::chrono::steady_clock::now();
+		stats.tick_latency_ms.push_back(
+		  std::chrono::duration<double, std::milli>(tick_end - tick_start).count());
+		stats.allocations += g_num_allocations.load(std::memory_order_relaxed) - allocs_before;
+	}
+	stats.wall_time +=
+	  std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	stats.game_time += duration;
+	stats.games += 1;
+	stats.queue_depth = std::max(stats.queue_depth, pb_comm_->inbound_queue_max_depth());
+	stats.overflows += pb_comm_->inbound_queue_overflows();
+	stats_ = NULL;
+}
+
+static std::shared_ptr<Configuration>
+load_config(const char *custom_cfg)
+{
+	std::shared_ptr<YamlConfiguration> config = std::make_shared<YamlConfiguration>(CONFDIR);
+	for (auto &p : fs::directory_iterator(CONFDIR)) {
+		if (fs::is_directory(p.status())) {
+			std::string default_cfg =
+			  p.path().string() + "/default_" + p.path().filename().string() + ".yaml";
+			if (fs::exists(fs::path(default_cfg))) {
+				config->load(default_cfg.c_str());
+			}
+		}
+	}
+	if (custom_cfg) {
+		config->load(custom_cfg);
+	}
+	return config;
+}
+
+static double
+percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0.;
+	size_t idx = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	return sorted[idx];
+}
+
+/// @endcond
+
+int
+main(int argc, char **argv)
+{
+	ArgumentParser argp(argc, argv, "hva:c:n:r:b:C:P:");
+	if (argp.has_arg("h")) {
+		print_usage(argv[0]);
+		return 0;
+	}
+
+	std::string archive =
+	  argp.has_arg("a") ? argp.arg("a") : std::string(BASEDIR) + "/benchmarks/rcll100.gz";
+	std::string  collection = argp.has_arg("c") ? argp.arg("c") : "game_report";
+	long int     max_games  = argp.has_arg("n") ? argp.parse_int("n") : -1;
+	unsigned int robots     = argp.has_arg("r") ? argp.parse_int("r") : 3;
+	double       beacon_hz  = argp.has_arg("b") ? argp.parse_float("b") : 1.0;
+	double       max_p99    = argp.has_arg("P") ? argp.parse_float("P") : -1.;
+
+	std::vector<std::string> docs;
+	try {
+		read_archive(archive, collection, docs);
+	} catch (fawkes::Exception &e) {
+		fprintf(stderr, "Failed to read games: %s\n", e.what_no_backtrace());
+		return 1;
+	}
+	if (max_games >= 0 && docs.size() > (size_t)max_games) {
+		docs.resize(max_games);
+	}
+	printf("Replaying %zu games from %s\n", docs.size(), archive.c_str());
+
+	CLIPS::init();
+	std::shared_ptr<Configuration> config = load_config(argp.arg("C"));
+	Logger::LogLevel log_level = argp.has_arg("v") ? Logger::LL_INFO : Logger::LL_WARN;
+
+	ReplayStats stats;
+	for (const std::string &doc : docs) {
+		ReplayGame game;
+		try {
+			reconstruct_game(bsoncxx::document::view((const uint8_t *)doc.data(), doc.size()), game);
+		} catch (std::exception &e) {
+			fprintf(stderr, "Skipping malformed game report: %s\n", e.what());
+			stats.failed_games += 1;
+			continue;
+		}
+		try {
+			// a fresh refbox per game, as in a real tournament
+			ReplayRefBox refbox(config, log_level);
+			refbox.replay(game, robots, beacon_hz, stats);
+		} catch (fawkes::Exception &e) {
+			fprintf(stderr, "Failed to replay %s: %s\n", game.name.c_str(), e.what_no_backtrace());
+			stats.failed_games += 1;
+		}
+	}
+
+	std::vector<double> &lat   = stats.tick_latency_ms;
+	size_t               ticks = std::max(lat.size(), (size_t)1);
+	std::sort(lat.begin(), lat.end());
+	double p99 = percentile(lat, 0.99);
+
+	printf("Replayed %u games (%u failed), %zu ticks\n", stats.games, stats.failed_games, lat.size());
+	printf("Game time %.1f s in %.3f s wall time (%.1fx real time)\n",
+	       stats.game_time,
+	       stats.wall_time,
+	       stats.wall_time > 0. ? stats.game_time / stats.wall_time : 0.);
+	printf("Tick latency [ms]: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+	       percentile(lat, 0.5),
+	       percentile(lat, 0.9),
+	       p99,
+	       lat.empty() ? 0. : lat.back());
+	printf("Rules fired: %lu (%.1f per tick)\n",
+	       stats.rules_fired,
+	       (double)stats.rules_fired / ticks);
+	printf("Allocations: %lu (%.1f per tick)\n",
+	       stats.allocations,
+	       (double)stats.allocations / ticks);
+	printf("Messages: %lu injected, %lu broadcast, %lu sent, %lu bytes serialized\n",
+	       stats.injected,
+	       stats.broadcasts,
+	       stats.sent,
+	       stats.sent_bytes);
+	printf("Inbound queue: %lu messages asserted in %lu batches, max depth %zu, %lu overflows\n",
+	       stats.asserted,
+	       stats.batches,
+	       stats.queue_depth,
+	       stats.overflows);
+
+	if (stats.games == 0) {
+		return 1;
+	}
+	if (max_p99 >= 0. && p99 > max_p99) {
+		printf("FAILED: p99 tick latency %.3f ms exceeds limit of %.3f ms\n", p99, max_p99);
+		return 2;
+	}
+	return 0;
+}
@@ -873,6 +873,13 @@ LLSFRefBoxShell::client_msg(uint16_t                                   comp_id,
 		log(lm->log_level(), lm->ts_sec(), lm->ts_nsec(), lm->component(), lm->message());
 	}
 
+	std::shared_ptr<llsf_log_msgs::LogMessageBatch> lmb;
+	if ((lmb = std::dynamic_pointer_cast<llsf_log_msgs::LogMessageBatch>(msg))) {
+		for (const llsf_log_msgs::LogMessage &m : lmb->messages()) {
+			log(m.log_level(), m.ts_sec(), m.ts_nsec(), m.component(), m.message());
+		}
+	}
+
 	std::shared_ptr<llsf_msgs::VersionInfo> vi;
 	if ((vi = std::dynamic_pointer_cast<llsf_msgs::VersionInfo>(msg))) {
 		logf("Connected to RefBox version %s", vi->version_string().c_str());
@@ -1224,6 +1231,7 @@ LLSFRefBoxShell::run()
 	message_register.add_message_type<llsf_msgs::AttentionMessage>();
 	message_register.add_message_type<llsf_msgs::OrderInfo>();
 	message_register.add_message_type<llsf_log_msgs::LogMessage>();
+	message_register.add_message_type<llsf_log_msgs::LogMessageBatch>();
 	message_register.add_message_type<llsf_msgs::VersionInfo>();
 	message_register.add_message_type<llsf_msgs::GameInfo>();
 
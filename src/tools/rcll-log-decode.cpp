@@ -0,0 +1,206 @@
+
+/***************************************************************************
+ *  rcll-log-decode.cpp - convert binary refbox logs to text or JSON
+ *
+ *  Created: Fri Oct 16 18:21:37 2026
+ ****************************************************************************/
+
+/*  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * - Neither the name of the authors nor the names of its contributors
+ *   may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <core/exception.h>
+#include <logging/binary_reader.h>
+#include <utils/system/argparser.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+using namespace llsfrb;
+using namespace fawkes;
+
+void
+usage(const char *progname)
+{
+	printf("Usage: %s [-h] [-j] [-l LEVEL] [-c COMPONENT] [-g TEXT] <file...>\n"
+	       " -h            This help message\n"
+	       " -j            Print one JSON object per record instead of text\n"
+	       " -l LEVEL      Minimum log level (debug, info, warn, error)\n"
+	       " -c COMPONENT  Only print records of the given component\n"
+	       " -g TEXT       Only print records whose message contains TEXT\n",
+	       progname);
+}
+
+static const char *
+level_name(Logger::LogLevel level)
+{
+	switch (level) {
+	case Logger::LL_DEBUG: return "debug";
+	case Logger::LL_INFO: return "info";
+	case Logger::LL_WARN: return "warn";
+	case Logger::LL_ERROR: return "error";
+	default: return "none";
+	}
+}
+
+static std::string
+json_escape(const std::string &s)
+{
+	std::string rv;
+	rv.reserve(s.size() + 2);
+	rv += '"';
+	for (unsigned char c : s) {
+		switch (c) {
+		case '"': rv += "\\\""; break;
+		case '\\': rv += "\\\\"; break;
+		case '\n': rv += "\\n"; break;
+		case '\r': rv += "\\r"; break;
+		case '\t': rv += "\\t"; break;
+		default:
+			if (c < 0x20) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", c);
+				rv += buf;
+			} else {
+				rv += c;
+			}
+		}
+	}
+	rv += '"';
+	return rv;
+}
+
+static void
+print_text(const BinaryLogReader::Record &r, const std::string &msg)
+{
+	struct tm t;
+	time_t    sec = r.time.tv_sec;
+	localtime_r(&sec, &t);
+	printf("%c %02d:%02d:%02d.%06ld %s%s %s\n",
+	       toupper(level_name(r.level)[0]),
+	       t.tm_hour,
+	       t.tm_min,
+	       t.tm_sec,
+	       (long)r.time.tv_usec,
+	       r.component.c_str(),
+	       r.exception ? " [EXCEPTION]:" : ":",
+	       msg.c_str());
+}
+
+static void
+print_json(const BinaryLogReader::Record &r, const std::string &msg)
+{
+	std::string args;
+	for (const BinaryLogReader::Argument &a : r.args) {
+		if (!args.empty())
+			args += ",";
+		switch (a.type) {
+		case BinaryLogger::ARG_DOUBLE:
+		case BinaryLogger::ARG_LDOUBLE: {
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.17g", a.d);
+			args += buf;
+			break;
+		}
+		case BinaryLogger::ARG_STRING: args += json_escape(a.s); break;
+		default: args += std::to_string(a.i); break;
+		}
+	}
+	printf("{\"time\":%ld.%06ld,\"level\":\"%s\",\"exception\":%s,\"component\":%s,"
+	       "\"format\":%s,\"args\":[%s],\"message\":%s}\n",
+	       (long)r.time.tv_sec,
+	       (long)r.time.tv_usec,
+	       level_name(r.level),
+	       r.exception ? "true" : "false",
+	       json_escape(r.component).c_str(),
+	       json_escape(r.format).c_str(),
+	       args.c_str(),
+	       json_escape(msg).c_str());
+}
+
+int
+main(int argc, char **argv)
+{
+	ArgumentParser argp(argc, argv, "hjl:c:g:");
+
+	if (argp.has_arg("h") || argp.num_items() < 1) {
+		usage(argv[0]);
+		exit(argp.has_arg("h") ? 0 : 1);
+	}
+
+	bool             json      = argp.has_arg("j");
+	Logger::LogLevel min_level = Logger::LL_DEBUG;
+	if (argp.has_arg("l")) {
+		std::string l = argp.arg("l");
+		if (l == "debug") {
+			min_level = Logger::LL_DEBUG;
+		} else if (l == "info") {
+			min_level = Logger::LL_INFO;
+		} else if (l == "warn") {
+			min_level = Logger::LL_WARN;
+		} else if (l == "error") {
+			min_level = Logger::LL_ERROR;
+		} else {
+			printf("Invalid log level %s\n\n", l.c_str());
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+	const char *component = argp.has_arg("c") ? argp.arg("c") : NULL;
+	const char *grep      = argp.has_arg("g") ? argp.arg("g") : NULL;
+
+	int rv = 0;
+	for (const char *filename : argp.items()) {
+		try {
+			BinaryLogReader         reader(filename);
+			BinaryLogReader::Record record;
+			while (reader.read(record)) {
+				if (record.level < min_level)
+					continue;
+				if (component && record.component != component)
+					continue;
+				std::string msg = BinaryLogReader::message(record);
+				if (grep && msg.find(grep) == std::string::npos)
+					continue;
+				if (json) {
+					print_json(record, msg);
+				} else {
+					print_text(record, msg);
+				}
+			}
+		} catch (Exception &e) {
+			// a log file may end in a partial record if the refbox crashed
+			fprintf(stderr, "%s: %s\n", filename, e.what_no_backtrace());
+			rv = 2;
+		}
+	}
+
+	return rv;
+}